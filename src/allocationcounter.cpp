@@ -0,0 +1,93 @@
+#include "allocationcounter.h"
+
+#if defined(COUNT_ALLOCATIONS) && defined(__GLIBC__)
+	#define ALLOCATIONS_COUNTED
+	#include <errno.h>
+	#include <malloc.h>
+	#include <stdlib.h>
+#endif
+
+
+#ifdef ALLOCATIONS_COUNTED
+//plain thread local storage needs no construction, so it can be used from within malloc
+static __thread uint64_t * threadCounter = nullptr;
+
+static inline void countAllocation()
+{
+	if (threadCounter != nullptr) {
+		(*threadCounter)++;
+	}
+}
+
+//the glibc allocator functions the wrappers forward to. free needs no wrapper
+extern "C" void * __libc_malloc(size_t size);
+extern "C" void * __libc_calloc(size_t count, size_t size);
+extern "C" void * __libc_realloc(void * pointer, size_t size);
+extern "C" void * __libc_memalign(size_t alignment, size_t size);
+
+extern "C" void * malloc(size_t size) __THROW
+{
+	countAllocation();
+	return __libc_malloc(size);
+}
+
+extern "C" void * calloc(size_t count, size_t size) __THROW
+{
+	countAllocation();
+	return __libc_calloc(count, size);
+}
+
+extern "C" void * realloc(void * pointer, size_t size) __THROW
+{
+	countAllocation();
+	return __libc_realloc(pointer, size);
+}
+
+extern "C" void * memalign(size_t alignment, size_t size) __THROW
+{
+	countAllocation();
+	return __libc_memalign(alignment, size);
+}
+
+extern "C" void * aligned_alloc(size_t alignment, size_t size) __THROW
+{
+	countAllocation();
+	return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void ** pointer, size_t alignment, size_t size) __THROW
+{
+	//OpenCV allocates its image buffers here
+	if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+		return EINVAL;
+	}
+	countAllocation();
+	void * result = __libc_memalign(alignment, size);
+	if (result == nullptr) {
+		return ENOMEM;
+	}
+	*pointer = result;
+	return 0;
+}
+#endif
+
+
+bool AllocationCounter::isAvailable()
+{
+#ifdef ALLOCATIONS_COUNTED
+	return true;
+#else
+	return false;
+#endif
+}
+
+uint64_t * AllocationCounter::countThread(uint64_t * counter)
+{
+#ifdef ALLOCATIONS_COUNTED
+	uint64_t * previous = threadCounter;
+	threadCounter = counter;
+	return previous;
+#else
+	return nullptr;
+#endif
+}
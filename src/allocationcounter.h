@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+
+/*!
+Debug counter of heap allocations, to check that frame analysis does not allocate once it is warmed up.
+Allocations are only counted when built with COUNT_ALLOCATIONS on glibc. malloc and friends are then replaced by wrappers
+that count and call the glibc allocator, so operator new, STL containers and OpenCV image buffers are all counted.
+Every counted thread adds its allocations to a counter of its own choosing, e.g. one per job, so detectors sharing
+worker threads don't count each other's allocations.
+*/
+class AllocationCounter
+{
+public:
+	/*!
+	Check if allocations are counted in this build.
+	*/
+	static bool isAvailable();
+
+	/*!
+	Start or stop counting the allocations of the calling thread.
+	\param[in] counter Counter the allocations of the calling thread are added to or nullptr to stop counting. Only the
+	calling thread may change it while it is set.
+	\return Returns the counter set before, e.g. to restore it later.
+	*/
+	static uint64_t * countThread(uint64_t * counter);
+};
@@ -0,0 +1,44 @@
+#include "backgroundengine.h"
+
+#include "gaussianmixtureengine.h"
+#include "vibeengine.h"
+#include "framedifferenceengine.h"
+
+
+static const char * typeNames[] = {"average", "mixture", "vibe", "difference"};
+
+
+cv::Size BackgroundEngine::getSize() const
+{
+	return size;
+}
+
+std::shared_ptr<BackgroundEngine> BackgroundEngine::create(Type type)
+{
+	switch (type) {
+		case TYPE_GAUSSIAN_MIXTURE:
+			return std::make_shared<GaussianMixtureEngine>();
+		case TYPE_VIBE:
+			return std::make_shared<VibeEngine>();
+		case TYPE_FRAME_DIFFERENCE:
+			return std::make_shared<FrameDifferenceEngine>();
+		default:
+			return std::shared_ptr<BackgroundEngine>();
+	}
+}
+
+const char * BackgroundEngine::getTypeName(Type type)
+{
+	return type >= 0 && type < TYPE_COUNT ? typeNames[type] : "unknown";
+}
+
+bool BackgroundEngine::getTypeFromName(const std::string & name, Type & type)
+{
+	for (int i = 0; i < TYPE_COUNT; ++i) {
+		if (name == typeNames[i]) {
+			type = (Type)i;
+			return true;
+		}
+	}
+	return false;
+}
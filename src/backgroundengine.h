@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <opencv2/core/core.hpp>
+
+
+/*!
+Interface for background models that classify the pixels of a greyscale frame as foreground or background.
+Engines trade CPU time and memory against robustness, e.g. against swaying foliage or flicker, so the cheapest engine
+that works for a site can be picked. \apply is called for horizontal bands of the frame in parallel, so engines must only
+touch the model and foreground rows of the band they are called for.
+*/
+class BackgroundEngine
+{
+public:
+	enum Type {TYPE_RUNNING_AVERAGE, TYPE_GAUSSIAN_MIXTURE, TYPE_VIBE, TYPE_FRAME_DIFFERENCE, TYPE_COUNT}; //!<Available engines.
+
+protected:
+	cv::Size size; //!<Size of frames the model was initialized with.
+
+	BackgroundEngine() {};
+
+public:
+	virtual Type getType() const = 0;
+
+	/*!
+	Start the model over with a frame.
+	\param[in] grey Greyscale CV_8U frame. Sets the size of the model.
+	*/
+	virtual void initialize(const cv::Mat & grey) = 0;
+
+	/*!
+	Classify pixels of a frame and update the model with it.
+	\param[in] grey Greyscale CV_8U frame of the size passed to \initialize.
+	\param[out] foreground Binary CV_8U image of the same size. Foreground pixels are set to 255, background pixels to 0. Must be allocated by the caller.
+	\param[in] rows Rows of grey to process.
+	*/
+	virtual void apply(const cv::Mat & grey, cv::Mat & foreground, const cv::Range & rows) = 0;
+
+	/*!
+	Called once after all rows of a frame have been applied, e.g. to advance history buffers.
+	*/
+	virtual void finishFrame() {};
+
+	/*!
+	Get the size of the model buffers in bytes.
+	*/
+	virtual uint64_t getMemoryUsage() const = 0;
+
+	cv::Size getSize() const;
+
+	/*!
+	Create an engine.
+	\param[in] type Engine type.
+	\return Returns the engine or an empty pointer for TYPE_RUNNING_AVERAGE. The running average is fused with thresholding in
+	\MotionKernel and run by the motion detector itself.
+	*/
+	static std::shared_ptr<BackgroundEngine> create(Type type);
+
+	/*!
+	Get the name of an engine as used on the command line, e.g. "vibe".
+	*/
+	static const char * getTypeName(Type type);
+
+	/*!
+	Look up an engine by its name.
+	\param[in] name Name as returned by \getTypeName.
+	\param[out] type Engine type if the name was found.
+	\return Returns true if the name was found.
+	*/
+	static bool getTypeFromName(const std::string & name, Type & type);
+
+	virtual ~BackgroundEngine() {};
+};
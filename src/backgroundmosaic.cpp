@@ -0,0 +1,180 @@
+#include "backgroundmosaic.h"
+
+#include <algorithm>
+
+
+//tile coordinates are negative left of and above the start pose. round towards negative infinity
+static int floorDivide(int a, int b)
+{
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+//mix the tile coordinates into the upper bits, so neighbouring tiles spread over the table
+static uint32_t getHash(int64_t key)
+{
+	return (uint32_t)(((uint64_t)key * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+
+BackgroundMosaic::BackgroundMosaic(uint32_t size, uint32_t tiles)
+	: tileSize(size), maxTiles(tiles), type(-1), scale(0), usedTiles(0), useCounter(0)
+{
+}
+
+int64_t BackgroundMosaic::getKey(int tileX, int tileY)
+{
+	return (int64_t)(((uint64_t)(uint32_t)tileY << 32) | (uint32_t)tileX);
+}
+
+uint32_t BackgroundMosaic::findSlot(int64_t key) const
+{
+	const uint32_t slotMask = tileIndices.size() - 1;
+	uint32_t slot = getHash(key) & slotMask;
+	//the table is at most half full, so there always is an empty slot to stop at
+	while (tileIndices[slot] >= 0 && tiles[tileIndices[slot]].key != key) {
+		slot = (slot + 1) & slotMask;
+	}
+	return slot;
+}
+
+void BackgroundMosaic::eraseSlot(uint32_t slot)
+{
+	const uint32_t slotMask = tileIndices.size() - 1;
+	uint32_t next = slot;
+	while (true) {
+		next = (next + 1) & slotMask;
+		if (tileIndices[next] < 0) {
+			break;
+		}
+		//move the entry into the hole if the hole lies on its probe sequence, i.e. between its home slot and its slot
+		const uint32_t home = getHash(tiles[tileIndices[next]].key) & slotMask;
+		if (((next - home) & slotMask) >= ((next - slot) & slotMask)) {
+			tileIndices[slot] = tileIndices[next];
+			slot = next;
+		}
+	}
+	tileIndices[slot] = -1;
+}
+
+void BackgroundMosaic::setup(int backgroundType, uint32_t backgroundScale)
+{
+	if (backgroundType != type || backgroundScale != scale) {
+		type = backgroundType;
+		scale = backgroundScale;
+		//tiles of the old type can not be reused. allocate all tiles at once, so tiles are never allocated while panning
+		tileData.create(maxTiles * tileSize, tileSize, type);
+		tileMasks.create(maxTiles * tileSize, tileSize, CV_8U);
+		tiles.resize(maxTiles);
+		for (uint32_t i = 0; i < maxTiles; ++i) {
+			tiles[i].data = tileData.rowRange(i * tileSize, (i + 1) * tileSize);
+			tiles[i].mask = tileMasks.rowRange(i * tileSize, (i + 1) * tileSize);
+		}
+		uint32_t slotCount = 1;
+		while (slotCount < 2 * maxTiles) {
+			slotCount *= 2;
+		}
+		tileIndices.resize(slotCount);
+		clear();
+	}
+}
+
+void BackgroundMosaic::clear()
+{
+	std::fill(tileIndices.begin(), tileIndices.end(), -1);
+	for (auto tIt = tiles.begin(); tIt != tiles.end(); ++tIt) {
+		tIt->key = 0;
+		tIt->lastUsed = 0;
+	}
+	usedTiles = 0;
+}
+
+BackgroundMosaic::Tile & BackgroundMosaic::getTile(int tileX, int tileY)
+{
+	const int64_t key = getKey(tileX, tileY);
+	uint32_t slot = findSlot(key);
+	if (tileIndices[slot] >= 0) {
+		return tiles[tileIndices[slot]];
+	}
+	uint32_t index = 0;
+	if (usedTiles < maxTiles) {
+		//take a free tile
+		index = usedTiles++;
+	}
+	else {
+		//reuse the least recently used tile
+		for (uint32_t i = 1; i < usedTiles; ++i) {
+			if (tiles[i].lastUsed < tiles[index].lastUsed) {
+				index = i;
+			}
+		}
+		eraseSlot(findSlot(tiles[index].key));
+		//erasing may have moved entries of the probe sequence of the new key
+		slot = findSlot(key);
+	}
+	Tile & tile = tiles[index];
+	tile.key = key;
+	tile.mask.setTo(0);
+	tileIndices[slot] = index;
+	return tile;
+}
+
+template <typename FUNCTION>
+void BackgroundMosaic::forEachTile(const cv::Rect & view, FUNCTION function)
+{
+	const int firstX = floorDivide(view.x, tileSize);
+	const int firstY = floorDivide(view.y, tileSize);
+	const int lastX = floorDivide(view.x + view.width - 1, tileSize);
+	const int lastY = floorDivide(view.y + view.height - 1, tileSize);
+	for (int tileY = firstY; tileY <= lastY; ++tileY) {
+		for (int tileX = firstX; tileX <= lastX; ++tileX) {
+			const cv::Rect tileRect(tileX * (int)tileSize, tileY * (int)tileSize, tileSize, tileSize);
+			const cv::Rect overlap = tileRect & view;
+			function(tileX, tileY, overlap - tileRect.tl(), overlap - view.tl());
+		}
+	}
+}
+
+void BackgroundMosaic::store(const cv::Mat & background, const cv::Point & position)
+{
+	if (background.type() != type || background.empty() || tiles.empty()) {
+		return;
+	}
+	useCounter++;
+	forEachTile(cv::Rect(position, background.size()), [&](int tileX, int tileY, const cv::Rect & inTile, const cv::Rect & inView) {
+		Tile & tile = getTile(tileX, tileY);
+		background(inView).copyTo(tile.data(inTile));
+		tile.mask(inTile).setTo(1);
+		tile.lastUsed = useCounter;
+	});
+}
+
+float BackgroundMosaic::seed(cv::Mat & background, const cv::Point & position)
+{
+	if (background.type() != type || background.empty() || tiles.empty()) {
+		return 0.0f;
+	}
+	useCounter++;
+	uint64_t seeded = 0;
+	forEachTile(cv::Rect(position, background.size()), [&](int tileX, int tileY, const cv::Rect & inTile, const cv::Rect & inView) {
+		const int32_t index = tileIndices[findSlot(getKey(tileX, tileY))];
+		if (index >= 0) {
+			Tile & tile = tiles[index];
+			const cv::Mat mask = tile.mask(inTile);
+			cv::Mat view = background(inView);
+			tile.data(inTile).copyTo(view, mask);
+			seeded += cv::countNonZero(mask);
+			tile.lastUsed = useCounter;
+		}
+	});
+	return (float)seeded / background.total();
+}
+
+uint32_t BackgroundMosaic::getTileCount() const
+{
+	return usedTiles;
+}
+
+uint64_t BackgroundMosaic::getMemoryUsage() const
+{
+	return tileIndices.capacity() * sizeof(int32_t) + tiles.capacity() * sizeof(Tile) + tileData.total() * tileData.elemSize() + tileMasks.total();
+}
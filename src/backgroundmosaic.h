@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+
+/*!
+Panoramic background model of everything the camera has seen, indexed by camera pose.
+The pose is the position of the view in mosaic pixels, e.g. accumulated from the global shift between frames.
+The mosaic is split into square tiles. Buffers for the maximum tile count are allocated in \setup and tiles are found
+through a fixed-size hash table, so storing, seeding and evicting tiles never allocate. The least recently used tile is
+evicted when more are needed. Every tile has a mask of the pixels that were written.
+*/
+class BackgroundMosaic
+{
+	struct Tile
+	{
+		int64_t key; //!<Tile coordinates packed by \getKey.
+		cv::Mat data; //!<Background pixels of tile. Part of tileData.
+		cv::Mat mask; //!<Non-zero for pixels that were written, CV_8U. Part of tileMasks.
+		uint64_t lastUsed; //!<Value of useCounter when the tile was last read or written.
+	};
+
+	uint32_t tileSize; //!<Width and height of tiles in pixels.
+	uint32_t maxTiles; //!<Maximum number of tiles kept.
+	int type; //!<Pixel type of background.
+	uint32_t scale; //!<Downscaling factor of background against full resolution.
+	cv::Mat tileData; //!<Background pixels of all tiles, one tile below the other.
+	cv::Mat tileMasks; //!<Masks of all tiles, one tile below the other.
+	std::vector<Tile> tiles; //!<All maxTiles tiles. The first usedTiles are in use, the rest are free.
+	uint32_t usedTiles; //!<Number of tiles in use.
+	std::vector<int32_t> tileIndices; //!<Open addressing hash table of indices into tiles, -1 for empty slots. Its size is a power of two of at least twice maxTiles, so probe sequences stay short.
+	uint64_t useCounter; //!<Incremented on every access for least recently used eviction.
+
+	static int64_t getKey(int tileX, int tileY);
+
+	/*!
+	Get the hash table slot holding a tile key or the empty slot where it would be inserted.
+	*/
+	uint32_t findSlot(int64_t key) const;
+
+	/*!
+	Remove the tile index from a hash table slot. Following entries of the probe sequence are moved back, so lookups
+	don't need to skip deleted slots.
+	*/
+	void eraseSlot(uint32_t slot);
+
+	/*!
+	Get a tile for writing. Takes a free tile or evicts the least recently used one if it does not exist yet.
+	*/
+	Tile & getTile(int tileX, int tileY);
+
+	/*!
+	Call a function for all tile parts overlapping a view.
+	\param[in] function Gets tile x, tile y, the rectangle in tile coordinates and the rectangle in view coordinates.
+	*/
+	template <typename FUNCTION>
+	void forEachTile(const cv::Rect & view, FUNCTION function);
+
+public:
+	/*!
+	Create empty mosaic.
+	\param[in] size Optional. Width and height of tiles in pixels.
+	\param[in] tiles Optional. Maximum number of tiles kept.
+	*/
+	BackgroundMosaic(uint32_t size = 64, uint32_t tiles = 256);
+
+	/*!
+	Set pixel type and resolution of the background. Allocates the buffers of all tiles and clears the mosaic if they
+	changed.
+	\param[in] backgroundType Type of background images, e.g. CV_32F.
+	\param[in] backgroundScale Downscaling factor of background against full resolution.
+	*/
+	void setup(int backgroundType, uint32_t backgroundScale);
+
+	/*!
+	Drop all tiles. The buffers of the tiles are kept for reuse.
+	*/
+	void clear();
+
+	/*!
+	Write a background view to the mosaic.
+	\param[in] background Background image of type set in \setup.
+	\param[in] position Position of upper left background pixel in mosaic.
+	*/
+	void store(const cv::Mat & background, const cv::Point & position);
+
+	/*!
+	Fill a background view with the parts of the mosaic that were seen before. Other pixels are not changed.
+	\param[in,out] background Background image of type set in \setup.
+	\param[in] position Position of upper left background pixel in mosaic.
+	\return Returns the fraction of background pixels that were filled.
+	*/
+	float seed(cv::Mat & background, const cv::Point & position);
+
+	uint32_t getTileCount() const;
+
+	/*!
+	Get the size of the tile buffers in bytes.
+	*/
+	uint64_t getMemoryUsage() const;
+};
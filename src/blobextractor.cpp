@@ -0,0 +1,268 @@
+#include "blobextractor.h"
+
+#include <algorithm>
+
+
+uint32_t BlobExtractor::newLabel(int32_t x, int32_t y)
+{
+	const uint32_t label = parents.size();
+	parents.push_back(label);
+	LabelStatistics labelStatistics = {x, y, x, y, 0, 0, 0, 0, 0, 0};
+	statistics.push_back(labelStatistics);
+	return label;
+}
+
+uint32_t BlobExtractor::findRoot(uint32_t label)
+{
+	//path halving. makes every other label on the path point to its grandparent
+	while (parents[label] != label) {
+		parents[label] = parents[parents[label]];
+		label = parents[label];
+	}
+	return label;
+}
+
+void BlobExtractor::unite(uint32_t a, uint32_t b)
+{
+	const uint32_t rootA = findRoot(a);
+	const uint32_t rootB = findRoot(b);
+	//the smaller label always becomes the root, so roots come before their children when merging
+	if (rootA < rootB) {
+		parents[rootB] = rootA;
+	}
+	else if (rootB < rootA) {
+		parents[rootA] = rootB;
+	}
+}
+
+const std::vector<BlobExtractor::Blob> & BlobExtractor::extract(const cv::Mat & image)
+{
+	blobs.clear();
+	blobStatistics.clear();
+	labelRegion(image, cv::Rect(0, 0, image.cols, image.rows));
+	return blobs;
+}
+
+const std::vector<BlobExtractor::Blob> & BlobExtractor::extract(const cv::Mat & image, const std::vector<cv::Rect> & regions)
+{
+	blobs.clear();
+	blobStatistics.clear();
+	for (auto rIt = regions.cbegin(); rIt != regions.cend(); ++rIt) {
+		labelRegion(image, *rIt);
+	}
+	return blobs;
+}
+
+const std::vector<BlobExtractor::Blob> & BlobExtractor::extract(const cv::Mat & image, const cv::Range & rows)
+{
+	blobs.clear();
+	blobStatistics.clear();
+	labelRegion(image, cv::Rect(0, rows.start, image.cols, rows.end - rows.start));
+	//remember which blobs the pixels on the band borders belong to, so bands can be joined later.
+	//after labelling previousLabels holds the last row of the band
+	getRowBlobs(firstRowLabels, firstRowBlobs);
+	getRowBlobs(previousLabels, lastRowBlobs);
+	return blobs;
+}
+
+void BlobExtractor::getRowBlobs(const std::vector<uint32_t> & labels, std::vector<int32_t> & rowBlobs)
+{
+	rowBlobs.resize(labels.size() - 2);
+	for (size_t i = 0; i < rowBlobs.size(); ++i) {
+		const uint32_t label = labels[i + 1];
+		rowBlobs[i] = label != 0 ? (int32_t)blobIndices[findRoot(label)] : -1;
+	}
+}
+
+const std::vector<BlobExtractor::Blob> & BlobExtractor::mergeBands(const std::vector<BlobExtractor *> & bands)
+{
+	blobs.clear();
+	blobStatistics.clear();
+	//every blob of every band becomes a label. label 0 is background
+	parents.resize(1);
+	statistics.resize(1);
+	bandOffsets.resize(bands.size());
+	for (size_t b = 0; b < bands.size(); ++b) {
+		bandOffsets[b] = parents.size();
+		const std::vector<LabelStatistics> & bandStatistics = bands[b]->blobStatistics;
+		for (auto sIt = bandStatistics.cbegin(); sIt != bandStatistics.cend(); ++sIt) {
+			parents.push_back(parents.size());
+			statistics.push_back(*sIt);
+		}
+	}
+	//unite blobs that touch across a seam, including diagonally
+	for (size_t b = 1; b < bands.size(); ++b) {
+		const std::vector<int32_t> & upper = bands[b - 1]->lastRowBlobs;
+		const std::vector<int32_t> & lower = bands[b]->firstRowBlobs;
+		const int width = lower.size();
+		for (int x = 0; x < width; ++x) {
+			if (lower[x] >= 0) {
+				for (int i = std::max(0, x - 1); i <= std::min(width - 1, x + 1); ++i) {
+					if (upper[i] >= 0) {
+						unite(bandOffsets[b - 1] + upper[i], bandOffsets[b] + lower[x]);
+					}
+				}
+			}
+		}
+	}
+	collectBlobs();
+	return blobs;
+}
+
+const std::vector<BlobExtractor::Blob> & BlobExtractor::joinRegions(const std::vector<BlobExtractor *> & parts)
+{
+	blobs.clear();
+	blobStatistics.clear();
+	for (auto pIt = parts.cbegin(); pIt != parts.cend(); ++pIt) {
+		blobs.insert(blobs.end(), (*pIt)->blobs.cbegin(), (*pIt)->blobs.cend());
+		blobStatistics.insert(blobStatistics.end(), (*pIt)->blobStatistics.cbegin(), (*pIt)->blobStatistics.cend());
+	}
+	return blobs;
+}
+
+void BlobExtractor::labelRegion(const cv::Mat & image, const cv::Rect & region)
+{
+	//label 0 is background
+	parents.resize(1);
+	statistics.resize(1);
+	const int width = region.width;
+	previousLabels.assign(width + 2, 0);
+	currentLabels.assign(width + 2, 0);
+	for (int y = region.y; y < region.y + region.height; ++y) {
+		const uint8_t * row = image.ptr<uint8_t>(y) + region.x;
+		for (int i = 0; i < width; ++i) {
+			uint32_t label = 0;
+			if (row[i] != 0) {
+				//label buffers are padded, so pixel i is at index i + 1.
+				//every labelled pixel is already equivalent to all its labelled neighbours that were scanned before it,
+				//so only the north-east neighbour can connect two different blobs
+				const uint32_t north = previousLabels[i + 1];
+				if (north != 0) {
+					label = north;
+				}
+				else {
+					const uint32_t northEast = previousLabels[i + 2];
+					const uint32_t northWest = previousLabels[i];
+					const uint32_t west = currentLabels[i];
+					if (northEast != 0) {
+						label = northEast;
+						if (northWest != 0) {
+							unite(northEast, northWest);
+						}
+						else if (west != 0) {
+							unite(northEast, west);
+						}
+					}
+					else if (northWest != 0) {
+						label = northWest;
+					}
+					else if (west != 0) {
+						label = west;
+					}
+					else {
+						label = newLabel(region.x + i, y);
+					}
+				}
+				//accumulate statistics for provisional label
+				const uint64_t x = region.x + i;
+				LabelStatistics & labelStatistics = statistics[label];
+				labelStatistics.minX = std::min(labelStatistics.minX, (int32_t)x);
+				labelStatistics.maxX = std::max(labelStatistics.maxX, (int32_t)x);
+				labelStatistics.maxY = y;
+				labelStatistics.area++;
+				labelStatistics.sumX += x;
+				labelStatistics.sumY += y;
+				labelStatistics.sumXX += x * x;
+				labelStatistics.sumYY += (uint64_t)y * y;
+				labelStatistics.sumXY += x * y;
+			}
+			currentLabels[i + 1] = label;
+		}
+		std::swap(previousLabels, currentLabels);
+		if (y == region.y) {
+			firstRowLabels = previousLabels;
+		}
+	}
+	collectBlobs();
+}
+
+void BlobExtractor::collectBlobs()
+{
+	//merge statistics of equivalent labels into their roots
+	for (uint32_t label = 1; label < parents.size(); ++label) {
+		const uint32_t root = findRoot(label);
+		if (root != label) {
+			LabelStatistics & rootStatistics = statistics[root];
+			const LabelStatistics & labelStatistics = statistics[label];
+			rootStatistics.minX = std::min(rootStatistics.minX, labelStatistics.minX);
+			rootStatistics.minY = std::min(rootStatistics.minY, labelStatistics.minY);
+			rootStatistics.maxX = std::max(rootStatistics.maxX, labelStatistics.maxX);
+			rootStatistics.maxY = std::max(rootStatistics.maxY, labelStatistics.maxY);
+			rootStatistics.area += labelStatistics.area;
+			rootStatistics.sumX += labelStatistics.sumX;
+			rootStatistics.sumY += labelStatistics.sumY;
+			rootStatistics.sumXX += labelStatistics.sumXX;
+			rootStatistics.sumYY += labelStatistics.sumYY;
+			rootStatistics.sumXY += labelStatistics.sumXY;
+		}
+	}
+	//build compact blob list from roots
+	blobIndices.resize(parents.size());
+	for (uint32_t label = 1; label < parents.size(); ++label) {
+		if (parents[label] == label) {
+			blobIndices[label] = blobs.size();
+			const LabelStatistics & labelStatistics = statistics[label];
+			const double area = labelStatistics.area;
+			const double cx = labelStatistics.sumX / area;
+			const double cy = labelStatistics.sumY / area;
+			Blob blob;
+			blob.boundingBox = cv::Rect(labelStatistics.minX, labelStatistics.minY, labelStatistics.maxX - labelStatistics.minX + 1, labelStatistics.maxY - labelStatistics.minY + 1);
+			blob.area = labelStatistics.area;
+			blob.cx = cx;
+			blob.cy = cy;
+			blob.mu20 = labelStatistics.sumXX / area - cx * cx;
+			blob.mu02 = labelStatistics.sumYY / area - cy * cy;
+			blob.mu11 = labelStatistics.sumXY / area - cx * cy;
+			blobs.push_back(blob);
+			blobStatistics.push_back(labelStatistics);
+		}
+	}
+}
+
+const std::vector<BlobExtractor::Blob> & BlobExtractor::getBlobs() const
+{
+	return blobs;
+}
+
+const BlobExtractor::Blob * BlobExtractor::getBiggestBlob() const
+{
+	const Blob * biggest = nullptr;
+	for (auto bIt = blobs.cbegin(); bIt != blobs.cend(); ++bIt) {
+		if (biggest == nullptr || bIt->area > biggest->area) {
+			biggest = &(*bIt);
+		}
+	}
+	return biggest;
+}
+
+void BlobExtractor::reserve(int width, uint32_t labelCount)
+{
+	previousLabels.reserve(width + 2);
+	currentLabels.reserve(width + 2);
+	firstRowLabels.reserve(width + 2);
+	firstRowBlobs.reserve(width);
+	lastRowBlobs.reserve(width);
+	//label 0 is background
+	parents.reserve(labelCount + 1);
+	statistics.reserve(labelCount + 1);
+	blobIndices.reserve(labelCount + 1);
+	blobs.reserve(labelCount);
+	blobStatistics.reserve(labelCount);
+}
+
+uint64_t BlobExtractor::getMemoryUsage() const
+{
+	return (parents.capacity() + previousLabels.capacity() + currentLabels.capacity() + blobIndices.capacity() + firstRowLabels.capacity() + bandOffsets.capacity()) * sizeof(uint32_t)
+		+ (firstRowBlobs.capacity() + lastRowBlobs.capacity()) * sizeof(int32_t)
+		+ (statistics.capacity() + blobStatistics.capacity()) * sizeof(LabelStatistics) + blobs.capacity() * sizeof(Blob);
+}
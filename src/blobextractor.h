@@ -0,0 +1,134 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+
+/*!
+Connected component labelling of binary images with 8-connectivity.
+A single raster scan assigns provisional labels from the labels of the previous row and the pixel to the left,
+recording label equivalences in a union-find forest and accumulating statistics per provisional label.
+Afterwards only the statistics of equivalent labels are merged, there is no second pass over the pixels and no label image.
+All scratch buffers are kept between calls, so steady state extraction does not allocate.
+*/
+class BlobExtractor
+{
+public:
+	struct Blob
+	{
+		cv::Rect boundingBox; //!<Bounding box of blob pixels.
+		uint32_t area; //!<Number of pixels in blob.
+		float cx; //!<Centroid x.
+		float cy; //!<Centroid y.
+		float mu20; //!<Central second moment in x divided by area, the variance of x.
+		float mu02; //!<Central second moment in y divided by area, the variance of y.
+		float mu11; //!<Central mixed second moment divided by area, the covariance of x and y.
+	};
+
+private:
+	struct LabelStatistics
+	{
+		int32_t minX;
+		int32_t minY;
+		int32_t maxX;
+		int32_t maxY;
+		uint64_t area;
+		uint64_t sumX;
+		uint64_t sumY;
+		uint64_t sumXX;
+		uint64_t sumYY;
+		uint64_t sumXY;
+	};
+
+	std::vector<uint32_t> parents; //!<Union-find forest of provisional labels. Label 0 is background.
+	std::vector<LabelStatistics> statistics; //!<Statistics per provisional label.
+	std::vector<uint32_t> previousLabels; //!<Provisional labels of previous row with one pixel of padding on both sides.
+	std::vector<uint32_t> currentLabels; //!<Provisional labels of current row with one pixel of padding on both sides.
+	std::vector<Blob> blobs; //!<Blobs found in last image.
+	std::vector<LabelStatistics> blobStatistics; //!<Statistics of blobs, needed for merging bands.
+	std::vector<uint32_t> blobIndices; //!<Blob index of root labels.
+	std::vector<uint32_t> firstRowLabels; //!<Provisional labels of the first row of the last region with padding.
+	std::vector<int32_t> firstRowBlobs; //!<Blob index of the pixels in the first row of the last band or -1 for background.
+	std::vector<int32_t> lastRowBlobs; //!<Blob index of the pixels in the last row of the last band or -1 for background.
+	std::vector<uint32_t> bandOffsets; //!<Index of the first blob of every band when merging.
+
+	uint32_t newLabel(int32_t x, int32_t y);
+	uint32_t findRoot(uint32_t label);
+	void unite(uint32_t a, uint32_t b);
+	void labelRegion(const cv::Mat & image, const cv::Rect & region);
+
+	/*!
+	Merge the statistics of equivalent labels into their roots and append a blob for every root to the blob list.
+	*/
+	void collectBlobs();
+
+	/*!
+	Convert provisional labels of a padded row to blob indices.
+	*/
+	void getRowBlobs(const std::vector<uint32_t> & labels, std::vector<int32_t> & rowBlobs);
+
+public:
+	/*!
+	Find all connected components in a binary image.
+	\param[in] image Binary image, CV_8U. All non-zero pixels are foreground.
+	\return Returns the blobs found in image. The list is valid until the next call.
+	*/
+	const std::vector<Blob> & extract(const cv::Mat & image);
+
+	/*!
+	Extract blobs from some regions of an image only, e.g. the parts that changed. Blob coordinates are in image coordinates.
+	\param[in] image Binary image, CV_8U. All non-zero pixels are foreground.
+	\param[in] regions Regions of image to label. They must not overlap. Blobs touching a region border are cut off there.
+	\return Returns the blobs found in all regions. The list is valid until the next call.
+	*/
+	const std::vector<Blob> & extract(const cv::Mat & image, const std::vector<cv::Rect> & regions);
+
+	/*!
+	Extract blobs from a horizontal band of an image, e.g. to split an image between threads. Blobs touching the band
+	border are cut off there, use \mergeBands to join them with the blobs of the neighbouring bands.
+	\param[in] image Binary image, CV_8U. All non-zero pixels are foreground.
+	\param[in] rows Rows of the band.
+	\return Returns the blobs found in the band. The list is valid until the next call.
+	*/
+	const std::vector<Blob> & extract(const cv::Mat & image, const cv::Range & rows);
+
+	/*!
+	Join the blobs of consecutive bands of an image to the blobs of the whole image.
+	Blobs are connected across the seams between bands, so the result is the same as from extracting the whole image.
+	\param[in] bands Extractors of the bands in top to bottom order. Each must have extracted one band with \extract.
+	\return Returns the blobs of all bands. The list is valid until the next call.
+	*/
+	const std::vector<Blob> & mergeBands(const std::vector<BlobExtractor *> & bands);
+
+	/*!
+	Join the blobs of extractors that extracted separate regions of an image, e.g. to split regions between threads.
+	Blobs are not connected across regions. They are appended in the order of the extractors, so if every extractor
+	extracted a run of consecutive regions of a list, the result is the same as from extracting all regions at once.
+	\param[in] parts Extractors in the order of their regions. Each must have extracted its regions with \extract.
+	\return Returns the blobs of all extractors. The list is valid until the next call.
+	*/
+	const std::vector<Blob> & joinRegions(const std::vector<BlobExtractor *> & parts);
+
+	/*!
+	Get the blobs from the last call to \extract or \mergeBands.
+	*/
+	const std::vector<Blob> & getBlobs() const;
+
+	/*!
+	Get the blob with the biggest pixel area.
+	\return Returns a pointer to the biggest blob from the last call to \extract or nullptr if there was none.
+	*/
+	const Blob * getBiggestBlob() const;
+
+	/*!
+	Reserve the buffers up front, so extraction does not allocate unless an image needs more labels.
+	\param[in] width Maximum image width.
+	\param[in] labelCount Number of provisional labels per image to reserve for.
+	*/
+	void reserve(int width, uint32_t labelCount);
+
+	/*!
+	Get the size of the label, statistics and blob buffers in bytes.
+	*/
+	uint64_t getMemoryUsage() const;
+};
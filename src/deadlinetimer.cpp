@@ -0,0 +1,58 @@
+#include "deadlinetimer.h"
+
+#include <iostream>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "consolestyle.h"
+
+
+DeadlineTimer::DeadlineTimer()
+	: descriptor(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC))
+{
+	if (descriptor < 0) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to create timerfd for deadlines!" << ConsoleStyle() << std::endl;
+	}
+}
+
+bool DeadlineTimer::isAvailable() const
+{
+	return descriptor >= 0;
+}
+
+bool DeadlineTimer::setDeadline(uint64_t timestampUs)
+{
+	//an all-zero time would disarm the timer, so fire a deadline of 0 one ns later
+	itimerspec deadline = {};
+	deadline.it_value.tv_sec = timestampUs / 1000000;
+	deadline.it_value.tv_nsec = (timestampUs % 1000000) * 1000;
+	if (timestampUs == 0) {
+		deadline.it_value.tv_nsec = 1;
+	}
+	//arming also clears expirations of an earlier deadline that were not read yet
+	return timerfd_settime(descriptor, TFD_TIMER_ABSTIME, &deadline, nullptr) == 0;
+}
+
+void DeadlineTimer::cancel()
+{
+	const itimerspec disarm = {};
+	timerfd_settime(descriptor, 0, &disarm, nullptr);
+}
+
+bool DeadlineTimer::clear()
+{
+	uint64_t expirations = 0;
+	return descriptor >= 0 && read(descriptor, &expirations, sizeof(expirations)) == sizeof(expirations);
+}
+
+int DeadlineTimer::getDescriptor() const
+{
+	return descriptor;
+}
+
+DeadlineTimer::~DeadlineTimer()
+{
+	if (descriptor >= 0) {
+		close(descriptor);
+	}
+}
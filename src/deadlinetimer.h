@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+
+
+/*!
+Timer firing at an absolute CLOCK_MONOTONIC time, e.g. when a launcher movement must be stopped.
+Backed by a Linux timerfd, so it can be waited on with epoll together with other descriptors and the deadline does not drift
+by the time it took to arm the timer. Deadlines are in the time base of getTimestampUs().
+*/
+class DeadlineTimer
+{
+	int descriptor; //!<timerfd of timer or -1.
+
+	DeadlineTimer(const DeadlineTimer &);
+	DeadlineTimer & operator=(const DeadlineTimer &);
+
+public:
+	DeadlineTimer();
+
+	/*!
+	Check if the timer can be used.
+	\return Returns true if the timerfd could be created.
+	*/
+	bool isAvailable() const;
+
+	/*!
+	Arm the timer. Replaces a deadline set before.
+	\param[in] timestampUs Time the timer fires in us, as returned by getTimestampUs(). Deadlines in the past fire right away.
+	\return Returns true if the timer was armed.
+	*/
+	bool setDeadline(uint64_t timestampUs);
+
+	/*!
+	Disarm the timer. Expirations that were not read yet are cleared too.
+	*/
+	void cancel();
+
+	/*!
+	Clear the expiration after the timer fired.
+	\return Returns true if the timer fired since it was armed and false if not.
+	*/
+	bool clear();
+
+	/*!
+	Get the timerfd, e.g. to wait for it with epoll. It is readable after the deadline has passed. Clear it with \clear.
+	*/
+	int getDescriptor() const;
+
+	~DeadlineTimer();
+};
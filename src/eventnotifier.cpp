@@ -0,0 +1,66 @@
+#include "eventnotifier.h"
+
+#include <iostream>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "consolestyle.h"
+#include "timestamp.h"
+
+
+EventNotifier::EventNotifier()
+	: descriptor(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+	if (descriptor < 0) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to create eventfd for notifications!" << ConsoleStyle() << std::endl;
+	}
+}
+
+bool EventNotifier::isAvailable() const
+{
+	return descriptor >= 0;
+}
+
+void EventNotifier::notify()
+{
+	//adds to the counter. can only fail if the counter would overflow, which means the waiter gets woken up anyway
+	const uint64_t value = 1;
+	if (write(descriptor, &value, sizeof(value)) < 0) {
+		return;
+	}
+}
+
+bool EventNotifier::wait(uint32_t timeoutMs)
+{
+	if (descriptor < 0) {
+		return false;
+	}
+	const uint64_t deadline = getTimestampUs() + timeoutMs * 1000ULL;
+	pollfd request = {descriptor, POLLIN, 0};
+	int result = 0;
+	while ((result = poll(&request, 1, timeoutMs)) < 0 && errno == EINTR) {
+		//interrupted by a signal. wait for the rest of the time
+		const uint64_t now = getTimestampUs();
+		timeoutMs = now < deadline ? (deadline - now + 999) / 1000 : 0;
+	}
+	if (result <= 0) {
+		return false;
+	}
+	//reading resets the counter
+	uint64_t value = 0;
+	return read(descriptor, &value, sizeof(value)) == sizeof(value);
+}
+
+int EventNotifier::getDescriptor() const
+{
+	return descriptor;
+}
+
+EventNotifier::~EventNotifier()
+{
+	if (descriptor >= 0) {
+		close(descriptor);
+	}
+}
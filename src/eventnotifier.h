@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+
+/*!
+Wakes up a thread waiting for something to happen in other threads, e.g. for new detection results.
+Backed by a Linux eventfd, so the descriptor can also be waited on with poll or epoll together with other descriptors.
+Notifications are counted till the next wait, so a notification sent before the waiting thread got to wait is not lost.
+*/
+class EventNotifier
+{
+	int descriptor; //!<eventfd of notifier or -1.
+
+	EventNotifier(const EventNotifier &);
+	EventNotifier & operator=(const EventNotifier &);
+
+public:
+	EventNotifier();
+
+	/*!
+	Check if the notifier can be used.
+	\return Returns true if the eventfd could be created.
+	*/
+	bool isAvailable() const;
+
+	/*!
+	Wake up the waiting thread. Can be called from any thread and never blocks.
+	*/
+	void notify();
+
+	/*!
+	Wait for notifications and clear them.
+	\param[in] timeoutMs Maximum time to wait in ms. Pass 0 to only check.
+	\return Returns true if there were notifications since the last wait and false on timeout.
+	*/
+	bool wait(uint32_t timeoutMs);
+
+	/*!
+	Get the eventfd, e.g. to wait for it with epoll. It is readable while there are notifications. Clear them with \wait(0).
+	*/
+	int getDescriptor() const;
+
+	~EventNotifier();
+};
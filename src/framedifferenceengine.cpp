@@ -0,0 +1,58 @@
+#include "framedifferenceengine.h"
+
+#include <cstdlib>
+
+
+FrameDifferenceEngine::FrameDifferenceEngine(int differenceThreshold)
+	: threshold(differenceThreshold), currentIndex(0)
+{
+}
+
+BackgroundEngine::Type FrameDifferenceEngine::getType() const
+{
+	return TYPE_FRAME_DIFFERENCE;
+}
+
+void FrameDifferenceEngine::initialize(const cv::Mat & grey)
+{
+	size = grey.size();
+	for (uint32_t i = 0; i < 3; ++i) {
+		grey.copyTo(history[i]);
+	}
+	currentIndex = 0;
+}
+
+void FrameDifferenceEngine::apply(const cv::Mat & grey, cv::Mat & foreground, const cv::Range & rows)
+{
+	cv::Mat & current = history[currentIndex];
+	const cv::Mat & previous = history[(currentIndex + 2) % 3];
+	const cv::Mat & beforePrevious = history[(currentIndex + 1) % 3];
+	//stores through uint8_t pointers may alias members, so keep them in locals
+	const int width = size.width;
+	const int limit = threshold;
+	for (int y = rows.start; y < rows.end; ++y) {
+		const uint8_t * row = grey.ptr<uint8_t>(y);
+		const uint8_t * previousRow = previous.ptr<uint8_t>(y);
+		const uint8_t * beforePreviousRow = beforePrevious.ptr<uint8_t>(y);
+		uint8_t * currentRow = current.ptr<uint8_t>(y);
+		uint8_t * foregroundRow = foreground.ptr<uint8_t>(y);
+		//branch free, so the compiler can vectorize the loop
+		for (int x = 0; x < width; ++x) {
+			const int value = row[x];
+			const int difference0 = std::abs(value - previousRow[x]);
+			const int difference1 = std::abs(value - beforePreviousRow[x]);
+			foregroundRow[x] = (difference0 > limit && difference1 > limit) ? 255 : 0;
+			currentRow[x] = value;
+		}
+	}
+}
+
+void FrameDifferenceEngine::finishFrame()
+{
+	currentIndex = (currentIndex + 1) % 3;
+}
+
+uint64_t FrameDifferenceEngine::getMemoryUsage() const
+{
+	return history[0].total() + history[1].total() + history[2].total();
+}
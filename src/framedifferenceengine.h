@@ -0,0 +1,30 @@
+#pragma once
+
+#include "backgroundengine.h"
+
+
+/*!
+Three-frame differencing. A pixel is foreground if it differs from both of the two previous frames, which finds the
+current position of a moving object without the ghost at its previous position that plain two-frame differencing leaves.
+Needs no model besides the last two frames and one compare per frame, so it is the engine for weak CPUs.
+Objects standing still or moving less than their size per frame are not detected.
+*/
+class FrameDifferenceEngine : public BackgroundEngine
+{
+	int threshold; //!<Pixels with a difference greater than threshold to both previous frames are foreground.
+	cv::Mat history[3]; //!<Ring of the current and the two previous frames.
+	uint32_t currentIndex; //!<Index of the current frame in history.
+
+public:
+	/*!
+	Create engine.
+	\param[in] differenceThreshold Optional. Grey level difference needed to both previous frames.
+	*/
+	FrameDifferenceEngine(int differenceThreshold = 40);
+
+	Type getType() const;
+	void initialize(const cv::Mat & grey);
+	void apply(const cv::Mat & grey, cv::Mat & foreground, const cv::Range & rows);
+	void finishFrame();
+	uint64_t getMemoryUsage() const;
+};
@@ -0,0 +1,225 @@
+#include "framering.h"
+
+#include <errno.h>
+
+#include "timestamp.h"
+
+
+FrameRing::FrameRing(uint32_t count)
+	: slots(count < 4 ? 4 : count), mutex(PTHREAD_MUTEX_INITIALIZER),
+	  newestSlot(-1), writeSlot(-1), lastSequence(0), lastReadSequence(0), droppedFrames(0), closed(false)
+{
+	//use the monotonic clock for timed waits, so they are not affected by changes to the system time
+	pthread_condattr_t attributes;
+	pthread_condattr_init(&attributes);
+	pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+	pthread_cond_init(&condition, &attributes);
+	pthread_condattr_destroy(&attributes);
+}
+
+void FrameRing::allocate(const cv::Size & size, int type)
+{
+	pthread_mutex_lock(&mutex);
+	for (auto sIt = slots.begin(); sIt != slots.end(); ++sIt) {
+		sIt->image.create(size, type);
+		sIt->timestamp = 0;
+		sIt->sequence = 0;
+		sIt->readers = 0;
+	}
+	newestSlot = -1;
+	writeSlot = -1;
+	closed = false;
+	pthread_mutex_unlock(&mutex);
+}
+
+FrameRing::Slot * FrameRing::beginWrite()
+{
+	Slot * result = nullptr;
+	pthread_mutex_lock(&mutex);
+	//find the oldest slot that is neither the newest frame nor held by a reader
+	int32_t oldest = -1;
+	for (int32_t i = 0; i < (int32_t)slots.size(); ++i) {
+		if (i != newestSlot && slots[i].readers == 0 && (oldest < 0 || slots[i].sequence < slots[oldest].sequence)) {
+			oldest = i;
+		}
+	}
+	if (oldest >= 0) {
+		writeSlot = oldest;
+		result = &slots[oldest];
+	}
+	pthread_mutex_unlock(&mutex);
+	return result;
+}
+
+void FrameRing::commitWrite(uint64_t timestamp)
+{
+	pthread_mutex_lock(&mutex);
+	if (writeSlot >= 0) {
+		//if the previous newest frame was never read, it is dropped now
+		if (newestSlot >= 0 && slots[newestSlot].sequence > lastReadSequence) {
+			droppedFrames++;
+		}
+		slots[writeSlot].timestamp = timestamp;
+		slots[writeSlot].sequence = ++lastSequence;
+		newestSlot = writeSlot;
+		writeSlot = -1;
+		pthread_cond_signal(&condition);
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+void FrameRing::abortWrite()
+{
+	pthread_mutex_lock(&mutex);
+	writeSlot = -1;
+	pthread_mutex_unlock(&mutex);
+}
+
+FrameRing::Slot * FrameRing::acquireNewest(uint32_t timeoutMs)
+{
+	Slot * result = nullptr;
+	//calculate absolute wait deadline
+	const uint64_t deadline = getTimestampUs() + (uint64_t)timeoutMs * 1000;
+	timespec deadlineSpec;
+	deadlineSpec.tv_sec = deadline / 1000000;
+	deadlineSpec.tv_nsec = (deadline % 1000000) * 1000;
+	pthread_mutex_lock(&mutex);
+	//wait until there is a frame we have not seen yet
+	while (!closed && (newestSlot < 0 || slots[newestSlot].sequence <= lastReadSequence)) {
+		if (pthread_cond_timedwait(&condition, &mutex, &deadlineSpec) == ETIMEDOUT) {
+			break;
+		}
+	}
+	if (!closed && newestSlot >= 0 && slots[newestSlot].sequence > lastReadSequence) {
+		result = &slots[newestSlot];
+		result->readers++;
+		lastReadSequence = result->sequence;
+	}
+	pthread_mutex_unlock(&mutex);
+	return result;
+}
+
+void FrameRing::retain(Slot * slot)
+{
+	//the slot is held already, so the writer can not pick it in the meantime
+	if (slot != nullptr) {
+		slot->readers++;
+	}
+}
+
+void FrameRing::release(Slot * slot)
+{
+	//the writer only picks slots with no readers, so dropping the last hold without the mutex is safe
+	if (slot != nullptr) {
+		slot->readers--;
+	}
+}
+
+void FrameRing::close()
+{
+	pthread_mutex_lock(&mutex);
+	closed = true;
+	pthread_cond_broadcast(&condition);
+	pthread_mutex_unlock(&mutex);
+}
+
+uint64_t FrameRing::getCapturedFrames()
+{
+	pthread_mutex_lock(&mutex);
+	const uint64_t result = lastSequence;
+	pthread_mutex_unlock(&mutex);
+	return result;
+}
+
+uint64_t FrameRing::getDroppedFrames()
+{
+	pthread_mutex_lock(&mutex);
+	const uint64_t result = droppedFrames;
+	pthread_mutex_unlock(&mutex);
+	return result;
+}
+
+uint32_t FrameRing::getSlotCount() const
+{
+	//slots are only created by the constructor
+	return slots.size();
+}
+
+uint64_t FrameRing::getMemoryUsage()
+{
+	uint64_t result = 0;
+	pthread_mutex_lock(&mutex);
+	for (auto sIt = slots.cbegin(); sIt != slots.cend(); ++sIt) {
+		if (sIt->bufferIndex < 0) {
+			result += sIt->image.total() * sIt->image.elemSize();
+		}
+	}
+	pthread_mutex_unlock(&mutex);
+	return result;
+}
+
+FrameRing::~FrameRing()
+{
+	pthread_cond_destroy(&condition);
+}
+
+
+FrameHandle::FrameHandle()
+	: ring(nullptr), slot(nullptr)
+{
+}
+
+FrameHandle::FrameHandle(FrameRing * frameRing, FrameRing::Slot * frameSlot)
+	: ring(frameRing), slot(frameSlot)
+{
+}
+
+FrameHandle::FrameHandle(const FrameHandle & other)
+	: ring(other.ring), slot(other.slot)
+{
+	if (ring != nullptr) {
+		ring->retain(slot);
+	}
+}
+
+FrameHandle & FrameHandle::operator=(const FrameHandle & other)
+{
+	//hold the new slot first, in case both refer to the same
+	if (other.ring != nullptr) {
+		other.ring->retain(other.slot);
+	}
+	reset();
+	ring = other.ring;
+	slot = other.slot;
+	return *this;
+}
+
+bool FrameHandle::empty() const
+{
+	return slot == nullptr;
+}
+
+const cv::Mat & FrameHandle::getImage() const
+{
+	static const cv::Mat emptyImage;
+	return slot != nullptr ? slot->image : emptyImage;
+}
+
+uint64_t FrameHandle::getTimestamp() const
+{
+	return slot != nullptr ? slot->timestamp : 0;
+}
+
+void FrameHandle::reset()
+{
+	if (ring != nullptr) {
+		ring->release(slot);
+	}
+	ring = nullptr;
+	slot = nullptr;
+}
+
+FrameHandle::~FrameHandle()
+{
+	reset();
+}
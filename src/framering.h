@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <pthread.h>
+#include <opencv2/core/core.hpp>
+
+
+/*!
+Fixed ring of preallocated frame slots shared between one capture thread and one analysis thread.
+The capture thread always writes to a slot that is neither the newest frame nor held by the reader, so it never waits.
+The reader always gets the newest frame. Frames overwritten before the reader got to them are counted as dropped.
+Held slots can be passed on as \FrameHandle, e.g. to publish frames to other threads without copying them.
+*/
+class FrameRing
+{
+public:
+	struct Slot
+	{
+		cv::Mat image; //!<Captured frame data.
+		uint64_t timestamp; //!<CLOCK_MONOTONIC capture time in us.
+		uint64_t sequence; //!<Capture sequence number. Starts at 1, 0 means the slot was never written.
+		std::atomic<uint32_t> readers; //!<Number of times the slot is currently held by readers or handles. Changed without the ring mutex when released.
+		int32_t bufferIndex; //!<Index of the source driver buffer image refers to or -1 if the image owns its data.
+
+		Slot() : timestamp(0), sequence(0), readers(0), bufferIndex(-1) {};
+	};
+
+private:
+	std::vector<Slot> slots; //!<The frame slots.
+	pthread_mutex_t mutex; //!<The mutex protecting the slot bookkeeping. Never held while copying frame data.
+	pthread_cond_t condition; //!<Signalled when a new frame was committed or the ring was closed.
+	int32_t newestSlot; //!<Index of the slot holding the newest frame or -1.
+	int32_t writeSlot; //!<Index of the slot currently being written or -1.
+	uint64_t lastSequence; //!<Sequence number of the last committed frame.
+	uint64_t lastReadSequence; //!<Sequence number of the last frame handed to the reader.
+	uint64_t droppedFrames; //!<Number of frames that were never handed to the reader.
+	bool closed; //!<If true the ring has been closed and readers will not wait anymore.
+
+public:
+	/*!
+	Create frame ring.
+	\param[in] count Optional. Number of slots. Needs to be at least 6: The newest frame, one being written, one being analyzed
+	and three held by handles to published frames, e.g. in a \TripleBuffer and by the thread reading it.
+	*/
+	FrameRing(uint32_t count = 6);
+
+	/*!
+	Preallocate all slot images.
+	\param[in] size Frame size.
+	\param[in] type OpenCV type of frames, e.g. CV_8UC3.
+	\note Call this before starting the capture and analysis threads.
+	*/
+	void allocate(const cv::Size & size, int type);
+
+	/*!
+	Get a free slot for writing the next frame to.
+	\return Returns a slot that is not the newest frame and not held by any reader or nullptr if there is none.
+	\note Call \commitWrite or \abortWrite when done.
+	*/
+	Slot * beginWrite();
+
+	/*!
+	Publish the slot returned by \beginWrite as the newest frame and wake up the reader.
+	\param[in] timestamp Capture time of frame in us.
+	*/
+	void commitWrite(uint64_t timestamp);
+
+	/*!
+	Return the slot returned by \beginWrite without publishing it, e.g. if capturing failed.
+	*/
+	void abortWrite();
+
+	/*!
+	Wait for and hold the newest frame that has not been handed out yet.
+	\param[in] timeoutMs Maximum time to wait for a new frame in ms.
+	\return Returns the slot with the newest frame or nullptr if the wait timed out or the ring was closed.
+	\note Call \release when done with the slot or pass it on to a \FrameHandle.
+	*/
+	Slot * acquireNewest(uint32_t timeoutMs);
+
+	/*!
+	Hold a slot that is already held once more. Does not lock the ring.
+	\param[in] slot Slot to hold. May be nullptr.
+	*/
+	void retain(Slot * slot);
+
+	/*!
+	Release a slot held via \acquireNewest or \retain, so it can be reused for capturing. Does not lock the ring.
+	\param[in] slot Slot to release. May be nullptr.
+	*/
+	void release(Slot * slot);
+
+	/*!
+	Close ring and wake up a waiting reader, e.g. when shutting down.
+	*/
+	void close();
+
+	uint64_t getCapturedFrames();
+	uint64_t getDroppedFrames();
+
+	/*!
+	Get the number of slots. A slot referring to a driver buffer holds it till the slot is written again.
+	*/
+	uint32_t getSlotCount() const;
+
+	/*!
+	Get the memory of the slot images the ring owns. Images referring to driver buffers are not counted.
+	\return Returns the size of the slot images in bytes.
+	*/
+	uint64_t getMemoryUsage();
+
+	~FrameRing();
+};
+
+
+/*!
+Refcounted read-only reference to the frame in a ring slot. The slot is not reused for capturing while handles refer to it.
+Copying a handle is one atomic increment, the frame data is never copied.
+\note All handles must be released before the ring is destroyed.
+*/
+class FrameHandle
+{
+	FrameRing * ring; //!<Ring the slot belongs to.
+	FrameRing::Slot * slot; //!<Slot referred to or nullptr.
+
+public:
+	FrameHandle();
+
+	/*!
+	Create handle from a held slot.
+	\param[in] frameRing Ring the slot belongs to.
+	\param[in] frameSlot Slot held via \FrameRing::acquireNewest. The handle takes over the hold and releases it when destroyed.
+	*/
+	FrameHandle(FrameRing * frameRing, FrameRing::Slot * frameSlot);
+
+	FrameHandle(const FrameHandle & other);
+	FrameHandle & operator=(const FrameHandle & other);
+
+	bool empty() const;
+
+	/*!
+	Get the frame. Must not be modified.
+	\return Returns the frame in source pixel format or an empty image if the handle is empty.
+	*/
+	const cv::Mat & getImage() const;
+
+	/*!
+	Get the CLOCK_MONOTONIC capture time of the frame in us.
+	*/
+	uint64_t getTimestamp() const;
+
+	/*!
+	Release the slot and make the handle empty.
+	*/
+	void reset();
+
+	~FrameHandle();
+};
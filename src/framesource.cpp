@@ -0,0 +1,101 @@
+#include "framesource.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+
+uint32_t FrameSource::getWidth() const
+{
+	return width;
+}
+
+uint32_t FrameSource::getHeight() const
+{
+	return height;
+}
+
+double FrameSource::getFps() const
+{
+	return fps;
+}
+
+FrameSource::PixelFormat FrameSource::getFormat() const
+{
+	return format;
+}
+
+cv::Size FrameSource::getImageSize() const
+{
+	if (format == FORMAT_NV12 || format == FORMAT_I420) {
+		return cv::Size(width, height + height / 2);
+	}
+	return cv::Size(width, height);
+}
+
+int FrameSource::getImageType() const
+{
+	switch (format) {
+		case FORMAT_BGR:
+			return CV_8UC3;
+		case FORMAT_YUYV:
+			return CV_8UC2;
+		default:
+			return CV_8UC1;
+	}
+}
+
+uint32_t FrameSource::getBitsPerPixel(PixelFormat pixelFormat)
+{
+	switch (pixelFormat) {
+		case FORMAT_BGR:
+			return 24;
+		case FORMAT_GREY:
+			return 8;
+		case FORMAT_YUYV:
+			return 16;
+		case FORMAT_NV12:
+		case FORMAT_I420:
+			return 12;
+		default:
+			return 0;
+	}
+}
+
+cv::Mat FrameSource::getLuma(const cv::Mat & image, PixelFormat pixelFormat, cv::Mat & buffer)
+{
+	switch (pixelFormat) {
+		case FORMAT_GREY:
+			return image;
+		case FORMAT_NV12:
+		case FORMAT_I420:
+			//the luma plane comes first, followed by the chroma planes
+			return image.rowRange(0, image.rows * 2 / 3);
+		case FORMAT_YUYV:
+			//luma is interleaved with chroma, so extract it. no color conversion is done here
+			cv::cvtColor(image, buffer, CV_YUV2GRAY_YUY2);
+			return buffer;
+		default:
+			cv::cvtColor(image, buffer, CV_BGR2GRAY);
+			return buffer;
+	}
+}
+
+void FrameSource::convertToBGR(cv::Mat & destination, const cv::Mat & image, PixelFormat pixelFormat)
+{
+	switch (pixelFormat) {
+		case FORMAT_GREY:
+			cv::cvtColor(image, destination, CV_GRAY2BGR);
+			break;
+		case FORMAT_YUYV:
+			cv::cvtColor(image, destination, CV_YUV2BGR_YUY2);
+			break;
+		case FORMAT_NV12:
+			cv::cvtColor(image, destination, CV_YUV2BGR_NV12);
+			break;
+		case FORMAT_I420:
+			cv::cvtColor(image, destination, CV_YUV2BGR_I420);
+			break;
+		default:
+			image.copyTo(destination);
+			break;
+	}
+}
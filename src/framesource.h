@@ -0,0 +1,108 @@
+#pragma once
+
+#include <string>
+#include <opencv2/core/core.hpp>
+
+
+/*!
+Interface for everything that delivers frames to the motion detector, e.g. cameras and video files.
+Frames are delivered in the native pixel format of the source, so detection can read the luma plane directly
+and color conversion is only done when a frame is actually displayed.
+*/
+class FrameSource
+{
+public:
+	enum PixelFormat {FORMAT_UNKNOWN, FORMAT_BGR, FORMAT_GREY, FORMAT_YUYV, FORMAT_NV12, FORMAT_I420}; //!<Supported source pixel formats.
+
+protected:
+	uint32_t width; //!<Width of frames.
+	uint32_t height; //!<Height of frames.
+	double fps; //!<Frames/s of source.
+	PixelFormat format; //!<Pixel format of frames.
+
+	FrameSource() : width(0), height(0), fps(0.0), format(FORMAT_UNKNOWN) {};
+
+public:
+	/*!
+	Check if the source has been opened successfully.
+	*/
+	virtual bool isOpened() const = 0;
+
+	/*!
+	Check if the source is a live source, e.g. a camera.
+	\return Returns true for live sources, which block in \read till the next frame is available. Sources that do not block, e.g. files, need to be paced by the caller.
+	*/
+	virtual bool isLive() const = 0;
+
+	/*!
+	Check if the source hands out driver buffers instead of filling the image passed to \read.
+	\return Returns true if images returned by \read refer to driver buffers that must be given back via \requeue.
+	*/
+	virtual bool usesDriverBuffers() const { return false; };
+
+	/*!
+	Get the memory the source holds for frames internally, e.g. driver buffers.
+	\return Returns the size of the buffers in bytes.
+	*/
+	virtual uint64_t getBufferMemory() const { return 0; };
+
+	/*!
+	Read next frame from source.
+	\param[in,out] image Image to read frame to. If the source uses driver buffers, the image will refer to the driver buffer.
+	\param[out] bufferIndex Index of the driver buffer image refers to or -1.
+	\param[out] timestamp CLOCK_MONOTONIC capture time of the frame in us.
+	\return Returns true if a frame was read.
+	*/
+	virtual bool read(cv::Mat & image, int32_t & bufferIndex, uint64_t & timestamp) = 0;
+
+	/*!
+	Give a driver buffer returned by \read back to the source, so it can be filled again.
+	\param[in] bufferIndex Index of driver buffer. Nothing is done for -1.
+	*/
+	virtual void requeue(int32_t bufferIndex) {};
+
+	/*!
+	Close source and free all buffers. Images returned by \read must not be used anymore.
+	*/
+	virtual void close() = 0;
+
+	uint32_t getWidth() const;
+	uint32_t getHeight() const;
+	double getFps() const;
+	PixelFormat getFormat() const;
+
+	/*!
+	Get the size of images returned by \read.
+	\note For planar YUV formats the image has 1.5 times as many rows as the frame, because the chroma planes follow the luma plane.
+	*/
+	cv::Size getImageSize() const;
+
+	/*!
+	Get the OpenCV type of images returned by \read, e.g. CV_8UC3 for FORMAT_BGR.
+	*/
+	int getImageType() const;
+
+	/*!
+	Get the number of bits per pixel the pixel format uses.
+	*/
+	static uint32_t getBitsPerPixel(PixelFormat pixelFormat);
+
+	/*!
+	Get the luma plane of an image in a source pixel format.
+	\param[in] image Image returned by \read.
+	\param[in] pixelFormat Pixel format of image.
+	\param[in] buffer Buffer used if the luma plane is not stored in a separate plane and needs to be extracted.
+	\return Returns a header referring to the luma plane of image, if the format has one, or to buffer.
+	*/
+	static cv::Mat getLuma(const cv::Mat & image, PixelFormat pixelFormat, cv::Mat & buffer);
+
+	/*!
+	Convert an image in a source pixel format to BGR.
+	\param[out] destination The BGR conversion target.
+	\param[in] image Image returned by \read.
+	\param[in] pixelFormat Pixel format of image.
+	*/
+	static void convertToBGR(cv::Mat & destination, const cv::Mat & image, PixelFormat pixelFormat);
+
+	virtual ~FrameSource() {};
+};
@@ -0,0 +1,232 @@
+#include "gaussianmixtureengine.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+	#define MIXTURE_SSE2
+	#include <emmintrin.h>
+#elif defined(__GNUC__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+	#define MIXTURE_NEON
+	#include <arm_neon.h>
+#endif
+
+
+const float GaussianMixtureEngine::matchDistance2 = 2.5f * 2.5f;
+const float GaussianMixtureEngine::backgroundWeight = 0.7f;
+const float GaussianMixtureEngine::initialVariance = 15.0f * 15.0f;
+const float GaussianMixtureEngine::minVariance = 4.0f * 4.0f;
+const float GaussianMixtureEngine::initialWeight = 0.05f;
+
+
+//The update is written once for a scalar and for 4 pixels in SIMD registers. GCC supports +, -, * and / on vector types,
+//so only loads, stores, compares, min and max need overloads. Decisions are 0 / 1 masks multiplied in, so there are no branches
+template <typename VEC> static inline VEC splat(float value);
+template <typename VEC> static inline VEC load(const float * source);
+template <typename VEC> static inline VEC loadLuma(const uint8_t * source);
+
+template <> inline float splat<float>(float value) { return value; }
+template <> inline float load<float>(const float * source) { return *source; }
+template <> inline float loadLuma<float>(const uint8_t * source) { return *source; }
+static inline void store(float * destination, float value) { *destination = value; }
+static inline float less(float a, float b) { return a < b ? 1.0f : 0.0f; }
+static inline float minimum(float a, float b) { return std::min(a, b); }
+static inline float maximum(float a, float b) { return std::max(a, b); }
+//foreground is stored as 255, background as 0
+static inline void storeMask(uint8_t * destination, float mask) { *destination = mask > 0.5f ? 255 : 0; }
+
+#if defined(MIXTURE_SSE2)
+typedef __m128 Vector;
+template <> inline __m128 splat<__m128>(float value) { return _mm_set1_ps(value); }
+template <> inline __m128 load<__m128>(const float * source) { return _mm_loadu_ps(source); }
+template <> inline __m128 loadLuma<__m128>(const uint8_t * source)
+{
+	int32_t bytes;
+	memcpy(&bytes, source, 4);
+	const __m128i zero = _mm_setzero_si128();
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero));
+}
+static inline void store(float * destination, __m128 value) { _mm_storeu_ps(destination, value); }
+static inline __m128 less(__m128 a, __m128 b) { return _mm_and_ps(_mm_cmplt_ps(a, b), _mm_set1_ps(1.0f)); }
+static inline __m128 minimum(__m128 a, __m128 b) { return _mm_min_ps(a, b); }
+static inline __m128 maximum(__m128 a, __m128 b) { return _mm_max_ps(a, b); }
+static inline void storeMask(uint8_t * destination, __m128 mask)
+{
+	//1.0f becomes 255, 0.0f becomes 0
+	const __m128i mask32 = _mm_cvtps_epi32(_mm_mul_ps(mask, _mm_set1_ps(255.0f)));
+	const __m128i mask8 = _mm_packus_epi16(_mm_packs_epi32(mask32, mask32), mask32);
+	const int32_t bytes = _mm_cvtsi128_si32(mask8);
+	memcpy(destination, &bytes, 4);
+}
+#elif defined(MIXTURE_NEON)
+typedef float32x4_t Vector;
+template <> inline float32x4_t splat<float32x4_t>(float value) { return vdupq_n_f32(value); }
+template <> inline float32x4_t load<float32x4_t>(const float * source) { return vld1q_f32(source); }
+template <> inline float32x4_t loadLuma<float32x4_t>(const uint8_t * source)
+{
+	uint8_t bytes[8] = {source[0], source[1], source[2], source[3], 0, 0, 0, 0};
+	return vcvtq_f32_u32(vmovl_u16(vget_low_u16(vmovl_u8(vld1_u8(bytes)))));
+}
+static inline void store(float * destination, float32x4_t value) { vst1q_f32(destination, value); }
+static inline float32x4_t less(float32x4_t a, float32x4_t b) { return vreinterpretq_f32_u32(vandq_u32(vcltq_f32(a, b), vreinterpretq_u32_f32(vdupq_n_f32(1.0f)))); }
+static inline float32x4_t minimum(float32x4_t a, float32x4_t b) { return vminq_f32(a, b); }
+static inline float32x4_t maximum(float32x4_t a, float32x4_t b) { return vmaxq_f32(a, b); }
+static inline void storeMask(uint8_t * destination, float32x4_t mask)
+{
+	//1.0f becomes 255, 0.0f becomes 0
+	const uint16x4_t mask16 = vmovn_u32(vcvtq_u32_f32(vmulq_n_f32(mask, 255.0f)));
+	const uint8x8_t mask8 = vmovn_u16(vcombine_u16(mask16, mask16));
+	destination[0] = vget_lane_u8(mask8, 0);
+	destination[1] = vget_lane_u8(mask8, 1);
+	destination[2] = vget_lane_u8(mask8, 2);
+	destination[3] = vget_lane_u8(mask8, 3);
+}
+#endif
+
+/*!
+Update the Gaussians of one or 4 pixels with their values and classify them.
+\param[in] value Grey values of pixels.
+\param[in,out] w, m, v Pointers to weight, mean and variance of the pixels in the three planes.
+\return Returns 1 for foreground, 0 for background pixels.
+*/
+template <typename VEC>
+static inline VEC updateGaussians(VEC value, float * w[3], float * m[3], float * v[3], float rate, float matchDistance2, float backgroundWeight, float initialVariance, float minVariance, float initialWeight)
+{
+	const VEC one = splat<VEC>(1.0f);
+	const VEC vRate = splat<VEC>(rate);
+	const VEC keep = splat<VEC>(1.0f - rate);
+	const VEC distance2 = splat<VEC>(matchDistance2);
+	const VEC mean0 = load<VEC>(m[0]);
+	const VEC mean1 = load<VEC>(m[1]);
+	const VEC mean2 = load<VEC>(m[2]);
+	VEC variance0 = load<VEC>(v[0]);
+	VEC variance1 = load<VEC>(v[1]);
+	VEC variance2 = load<VEC>(v[2]);
+	const VEC d0 = value - mean0;
+	const VEC d1 = value - mean1;
+	const VEC d2 = value - mean2;
+	const VEC e0 = d0 * d0;
+	const VEC e1 = d1 * d1;
+	const VEC e2 = d2 * d2;
+	//only the first matching Gaussian is updated
+	const VEC match0 = less(e0, distance2 * variance0);
+	const VEC match1 = (one - match0) * less(e1, distance2 * variance1);
+	const VEC match2 = (one - match0 - match1) * less(e2, distance2 * variance2);
+	const VEC matched = match0 + match1 + match2;
+	VEC weight0 = keep * load<VEC>(w[0]) + vRate * match0;
+	VEC weight1 = keep * load<VEC>(w[1]) + vRate * match1;
+	VEC weight2 = keep * load<VEC>(w[2]) + vRate * match2;
+	VEC newMean0 = mean0 + vRate * match0 * d0;
+	VEC newMean1 = mean1 + vRate * match1 * d1;
+	VEC newMean2 = mean2 + vRate * match2 * d2;
+	const VEC minVar = splat<VEC>(minVariance);
+	variance0 = maximum(variance0 + vRate * match0 * (e0 - variance0), minVar);
+	variance1 = maximum(variance1 + vRate * match1 * (e1 - variance1), minVar);
+	variance2 = maximum(variance2 + vRate * match2 * (e2 - variance2), minVar);
+	//without a match the Gaussian with the lowest weight is replaced by one around the value
+	const VEC replace0 = (one - matched) * (one - less(minimum(weight1, weight2), weight0));
+	const VEC replace1 = (one - matched - replace0) * (one - less(weight2, weight1));
+	const VEC replace2 = one - matched - replace0 - replace1;
+	const VEC newWeight = splat<VEC>(initialWeight);
+	const VEC newVariance = splat<VEC>(initialVariance);
+	weight0 = weight0 + replace0 * (newWeight - weight0);
+	weight1 = weight1 + replace1 * (newWeight - weight1);
+	weight2 = weight2 + replace2 * (newWeight - weight2);
+	newMean0 = newMean0 + replace0 * (value - newMean0);
+	newMean1 = newMean1 + replace1 * (value - newMean1);
+	newMean2 = newMean2 + replace2 * (value - newMean2);
+	variance0 = variance0 + replace0 * (newVariance - variance0);
+	variance1 = variance1 + replace1 * (newVariance - variance1);
+	variance2 = variance2 + replace2 * (newVariance - variance2);
+	const VEC normalize = one / (weight0 + weight1 + weight2);
+	weight0 = weight0 * normalize;
+	weight1 = weight1 * normalize;
+	weight2 = weight2 * normalize;
+	//the matched Gaussian is background if the Gaussians ranked before it by weight / standard deviation
+	//do not make up the background weight yet. compare squared ranks to avoid the square roots
+	const VEC matchedWeight = match0 * weight0 + match1 * weight1 + match2 * weight2;
+	const VEC matchedVariance = match0 * variance0 + match1 * variance1 + match2 * variance2;
+	const VEC matchedRank = matchedWeight * matchedWeight;
+	const VEC rankedBefore = (one - match0) * weight0 * less(matchedRank * variance0, weight0 * weight0 * matchedVariance)
+		+ (one - match1) * weight1 * less(matchedRank * variance1, weight1 * weight1 * matchedVariance)
+		+ (one - match2) * weight2 * less(matchedRank * variance2, weight2 * weight2 * matchedVariance);
+	store(w[0], weight0);
+	store(w[1], weight1);
+	store(w[2], weight2);
+	store(m[0], newMean0);
+	store(m[1], newMean1);
+	store(m[2], newMean2);
+	store(v[0], variance0);
+	store(v[1], variance1);
+	store(v[2], variance2);
+	return one - matched * less(rankedBefore, splat<VEC>(backgroundWeight));
+}
+
+
+GaussianMixtureEngine::GaussianMixtureEngine(float rate)
+	: learningRate(rate)
+{
+}
+
+BackgroundEngine::Type GaussianMixtureEngine::getType() const
+{
+	return TYPE_GAUSSIAN_MIXTURE;
+}
+
+void GaussianMixtureEngine::initialize(const cv::Mat & grey)
+{
+	size = grey.size();
+	const size_t planeSize = size.area();
+	weights.assign(gaussianCount * planeSize, 0.0f);
+	means.assign(gaussianCount * planeSize, 0.0f);
+	variances.assign(gaussianCount * planeSize, initialVariance);
+	//the first Gaussian starts with the frame and all the weight
+	for (int y = 0; y < size.height; ++y) {
+		const uint8_t * row = grey.ptr<uint8_t>(y);
+		float * weightRow = weights.data() + y * size.width;
+		float * meanRow = means.data() + y * size.width;
+		for (int x = 0; x < size.width; ++x) {
+			weightRow[x] = 1.0f;
+			meanRow[x] = row[x];
+		}
+	}
+}
+
+void GaussianMixtureEngine::apply(const cv::Mat & grey, cv::Mat & foreground, const cv::Range & rows)
+{
+	const size_t planeSize = size.area();
+	for (int y = rows.start; y < rows.end; ++y) {
+		const uint8_t * row = grey.ptr<uint8_t>(y);
+		uint8_t * foregroundRow = foreground.ptr<uint8_t>(y);
+		const size_t offset = y * size.width;
+		float * w[3] = {weights.data() + offset, weights.data() + offset + planeSize, weights.data() + offset + 2 * planeSize};
+		float * m[3] = {means.data() + offset, means.data() + offset + planeSize, means.data() + offset + 2 * planeSize};
+		float * v[3] = {variances.data() + offset, variances.data() + offset + planeSize, variances.data() + offset + 2 * planeSize};
+		int x = 0;
+#if defined(MIXTURE_SSE2) || defined(MIXTURE_NEON)
+		for (; x + 4 <= size.width; x += 4) {
+			const Vector mask = updateGaussians<Vector>(loadLuma<Vector>(row + x), w, m, v, learningRate, matchDistance2, backgroundWeight, initialVariance, minVariance, initialWeight);
+			storeMask(foregroundRow + x, mask);
+			for (uint32_t i = 0; i < 3; ++i) {
+				w[i] += 4;
+				m[i] += 4;
+				v[i] += 4;
+			}
+		}
+#endif
+		for (; x < size.width; ++x) {
+			const float mask = updateGaussians<float>(row[x], w, m, v, learningRate, matchDistance2, backgroundWeight, initialVariance, minVariance, initialWeight);
+			storeMask(foregroundRow + x, mask);
+			for (uint32_t i = 0; i < 3; ++i) {
+				w[i]++;
+				m[i]++;
+				v[i]++;
+			}
+		}
+	}
+}
+
+uint64_t GaussianMixtureEngine::getMemoryUsage() const
+{
+	return (weights.capacity() + means.capacity() + variances.capacity()) * sizeof(float);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+#include "backgroundengine.h"
+
+
+/*!
+Per pixel mixture of Gaussians after Stauffer and Grimson. Every pixel is modelled by three weighted Gaussians of its grey
+value. A value matching a Gaussian updates it, otherwise the weakest Gaussian is replaced. The Gaussians with the highest
+weight / standard deviation that together make up a minimum weight are background, so a pixel switching between a few
+values, e.g. swaying foliage or flicker, is learned as background.
+Weights, means and variances are stored structure-of-arrays, one plane per Gaussian, so 4 neighbouring pixels are loaded
+into one register. The update is branch free and runs on 4 pixels at a time with SSE2 or NEON.
+*/
+class GaussianMixtureEngine : public BackgroundEngine
+{
+	static const uint32_t gaussianCount = 3; //!<Number of Gaussians per pixel.
+	static const float matchDistance2; //!<Squared number of standard deviations a value may be away from a matching mean.
+	static const float backgroundWeight; //!<Minimum sum of weights of the Gaussians considered background.
+	static const float initialVariance; //!<Variance of a new Gaussian.
+	static const float minVariance; //!<Variance a Gaussian can not get below, so noise-free pixels do not become overly sensitive.
+	static const float initialWeight; //!<Weight of a new Gaussian.
+
+	float learningRate; //!<Rate weights, means and variances are updated with.
+	std::vector<float> weights; //!<gaussianCount planes of size.
+	std::vector<float> means; //!<gaussianCount planes of size.
+	std::vector<float> variances; //!<gaussianCount planes of size.
+
+public:
+	/*!
+	Create engine.
+	\param[in] rate Optional. Learning rate per frame.
+	*/
+	GaussianMixtureEngine(float rate = 0.01f);
+
+	Type getType() const;
+	void initialize(const cv::Mat & grey);
+	void apply(const cv::Mat & grey, cv::Mat & foreground, const cv::Range & rows);
+	uint64_t getMemoryUsage() const;
+};
@@ -1,61 +1,59 @@
 #include "keyboard.h"
 
 #include <iostream>
-#include <sstream>
 #include <vector>
-#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <cstring>
+#include <dirent.h>
+#include <sys/inotify.h>
 #include <linux/input.h>
 
 #include "consolestyle.h"
+#include "timestamp.h"
 
-//Inspired by "logkeys" found on Google code: http://code.google.com/p/logkeys/
-#define EXE_GREP "/bin/grep"
-#define COMMAND_STR_DEVICES (EXE_GREP " -E 'Handlers|EV=' /proc/bus/input/devices | " EXE_GREP " -B1 'EV=120013' | " EXE_GREP " -Eo 'event[0-9]+' ")
+//older kernel headers have no names for the timestamp fields, which changed on 32bit systems with 64bit time_t
+#ifndef input_event_sec
+	#define input_event_sec time.tv_sec
+	#define input_event_usec time.tv_usec
+#endif
 
-Keyboard::Keyboard(std::string devicePath)
-	: path(devicePath), thread(0), mutex(PTHREAD_MUTEX_INITIALIZER), active(false), keyboardDescriptor(0) 
+#define INPUT_DIRECTORY "/dev/input"
+
+static inline bool testBit(const uint8_t * bits, uint32_t bit)
 {
-    //if the caller didn't pass a keyboard device event node, so auto-detect it
-    if (devicePath.empty()) {
-	    //extract input number from /proc/bus/input/devices  
-    	FILE * pipe = popen(COMMAND_STR_DEVICES, "r");
-	    if (pipe) {
-	        //read returned data from system command
-	        std::stringstream output;
-	        char buffer[128];
-	        while (!feof(pipe)) {
-		        if (fgets(buffer, 128, pipe) != nullptr) {
-                    output << buffer;
-                }
-            }
-	        pclose(pipe);
-	        //find first device entry that has an "event..." handler entry
-	        std::string line;
-	        while(std::getline(output, line)) {
-		        const std::string::size_type start = line.find("event");
-		        if (start != std::string::npos) {
-		            //search end of "event..." string
-		            const std::string::size_type end = line.find_first_of(" \t\f\v\n\r");
-		            const std::string::size_type length = (end == std::string::npos ? line.size() - start : end - start);
-		            //extract string
-		            devicePath = "/dev/input/" + line.substr(start, length);
-		            std::cout << ConsoleStyle(ConsoleStyle::GREEN) << "Auto-detected keyboard at \"" << devicePath << "\"." << ConsoleStyle() << std::endl;
-		            break;
-		        }
-	        }
-	    }
-	    else {
-		    std::cout << ConsoleStyle(ConsoleStyle::RED) << "Pipe error!" << ConsoleStyle() << std::endl;
-        }
-    }
-    //if device path is still empty, use a default
-    if (devicePath.empty()) {
-        devicePath = "/dev/input/event0";
-    }
+	return (bits[bit / 8] & (1 << (bit % 8))) != 0;
+}
+
+//get the event device numbers in /dev/input sorted, so the device opened is the same on every start
+static std::vector<int> getEventDevices()
+{
+	std::vector<int> numbers;
+	DIR * directory = opendir(INPUT_DIRECTORY);
+	if (directory != nullptr) {
+		dirent * entry = nullptr;
+		while ((entry = readdir(directory)) != nullptr) {
+			if (strncmp(entry->d_name, "event", 5) == 0) {
+				numbers.push_back(atoi(entry->d_name + 5));
+			}
+		}
+		closedir(directory);
+	}
+	std::sort(numbers.begin(), numbers.end());
+	return numbers;
+}
 
+Keyboard::Keyboard(std::string devicePath, bool grabDevice)
+	: path(devicePath), grab(grabDevice), keyboardDescriptor(0), hotplugDescriptor(-1), monotonicTimestamps(false), resyncing(false), syncTimestamp(0), syncPending(false)
+{
+	for (uint32_t i = 0; i < KeyStateWords; ++i) {
+		keyState[i] = 0;
+		syncState[i] = 0;
+	}
     //store old termios
     tcgetattr(keyboardDescriptor, &oldTermios);
     termios newTermios = oldTermios;
@@ -65,114 +63,333 @@ Keyboard::Keyboard(std::string devicePath)
     //newTermios.c_cc[VMIN] = 1;
     //newTermios.c_cc[VTIME] = 0;
     //tcsetattr(0, TCSANOW, &newTermios);
+    if (!reactor.isAvailable()) {
+        return;
+    }
+    //the consumer notifies when it drained events while key changes wait for room in the queue
+    if (!roomNotifier.isAvailable() || !reactor.add(roomNotifier.getDescriptor(), EPOLLIN, &Keyboard::handleRoom, this)) {
+        std::cout << ConsoleStyle(ConsoleStyle::YELLOW) << "Failed to watch the key event queue. Key changes that did not fit into it are delayed till the next key event." << ConsoleStyle() << std::endl;
+    }
+    //watch for input devices being plugged in, so a keyboard can be replaced while running.
+    //nodes are created before their permissions are set, so opening is tried again when their attributes change
+    hotplugDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (hotplugDescriptor >= 0 && (inotify_add_watch(hotplugDescriptor, INPUT_DIRECTORY, IN_CREATE | IN_ATTRIB) < 0 || !reactor.add(hotplugDescriptor, EPOLLIN, &Keyboard::handleHotplug, this))) {
+        close(hotplugDescriptor);
+        hotplugDescriptor = -1;
+    }
+    if (hotplugDescriptor < 0) {
+        std::cout << ConsoleStyle(ConsoleStyle::YELLOW) << "Failed to watch \"" INPUT_DIRECTORY "\". Keyboards can not be hotplugged." << ConsoleStyle() << std::endl;
+    }
+    //if the caller didn't pass a keyboard device event node, auto-detect it
+    if (devicePath.empty() ? openFirstKeyboard() : openDevice(devicePath, false)) {
+        return;
+    }
+    if (devicePath.empty()) {
+        std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to find a keyboard!" << ConsoleStyle() << std::endl;
+    }
+    else {
+        std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to open keyboard at \"" << devicePath << "\"!" << ConsoleStyle() << std::endl;
+    }
+    if (hotplugDescriptor >= 0) {
+        std::cout << ConsoleStyle(ConsoleStyle::YELLOW) << "Waiting for a keyboard to be plugged in." << ConsoleStyle() << std::endl;
+    }
+}
+
+bool Keyboard::isKeyboardDevice(int descriptor)
+{
+	//a keyboard reports keys with autorepeat and has letter keys. mice and buttons don't
+	uint8_t types[EV_CNT / 8 + 1] = {};
+	uint8_t keys[KEY_CNT / 8 + 1] = {};
+	if (ioctl(descriptor, EVIOCGBIT(0, sizeof(types)), types) < 0 || ioctl(descriptor, EVIOCGBIT(EV_KEY, sizeof(keys)), keys) < 0) {
+		return false;
+	}
+	return testBit(types, EV_KEY) && testBit(types, EV_REP)
+		&& testBit(keys, KEY_ESC) && testBit(keys, KEY_A) && testBit(keys, KEY_ENTER) && testBit(keys, KEY_SPACE);
+}
+
+bool Keyboard::openDevice(const std::string & devicePath, bool checkCapabilities)
+{
     //open keyboard device
-    keyboardDescriptor = open(devicePath.c_str(), O_RDONLY | O_NONBLOCK);
-    if (keyboardDescriptor > 0) {
-		//get keyboard name
-		char temp[256];
-		ioctl(keyboardDescriptor, EVIOCGNAME(256), temp);
-		temp[255] = '\0';
-		name = temp;
-		std::cout << ConsoleStyle(ConsoleStyle::GREEN) << "Opened keyboard \"" << name << "\" at \"" << devicePath << "\"." << ConsoleStyle() << std::endl;
-		//clear keyboard state
-		memset(keyboardState, 0, sizeof(keyboardState));
-		//start key poll thread
-        active = true;
-        if (pthread_create(&thread, 0, &Keyboard::keyLoop, this) == 0) {
-			std::cout << ConsoleStyle(ConsoleStyle::GREEN) << "Started keyboard thread." << ConsoleStyle() << std::endl;
+    const int descriptor = open(devicePath.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (descriptor < 0) {
+        return false;
+    }
+    if (checkCapabilities && !isKeyboardDevice(descriptor)) {
+        close(descriptor);
+        return false;
+    }
+    if (!reactor.add(descriptor, EPOLLIN, &Keyboard::handleKeyboard, this)) {
+        close(descriptor);
+        return false;
+    }
+    keyboardDescriptor = descriptor;
+	//get keyboard name
+	char temp[256];
+	ioctl(keyboardDescriptor, EVIOCGNAME(256), temp);
+	temp[255] = '\0';
+	name = temp;
+	//have the kernel stamp events with the clock all other time stamps use
+	int clock = CLOCK_MONOTONIC;
+	monotonicTimestamps = ioctl(keyboardDescriptor, EVIOCSCLOCKID, &clock) == 0;
+	if (!monotonicTimestamps) {
+		std::cout << ConsoleStyle(ConsoleStyle::YELLOW) << "Keyboard can not report monotonic timestamps. Using read time." << ConsoleStyle() << std::endl;
+	}
+	if (grab && ioctl(keyboardDescriptor, EVIOCGRAB, 1) != 0) {
+		std::cout << ConsoleStyle(ConsoleStyle::YELLOW) << "Failed to grab keyboard. Key presses reach other programs too." << ConsoleStyle() << std::endl;
+	}
+	std::cout << ConsoleStyle(ConsoleStyle::GREEN) << "Opened keyboard \"" << name << "\" at \"" << devicePath << "\"." << ConsoleStyle() << std::endl;
+	//pick up keys that are held down already
+	resyncing = false;
+	synchronizeKeyState(getTimestampUs());
+	return true;
+}
+
+bool Keyboard::openFirstKeyboard()
+{
+	const std::vector<int> numbers = getEventDevices();
+	for (auto nIt = numbers.cbegin(); nIt != numbers.cend(); ++nIt) {
+		if (openDevice(INPUT_DIRECTORY "/event" + std::to_string(*nIt), true)) {
+			return true;
 		}
-		else {
-			std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to start keyboard thread!" << ConsoleStyle() << std::endl;
-			thread = 0;
-			active = false;
-			close(keyboardDescriptor);
-			keyboardDescriptor = 0;
+	}
+	return false;
+}
+
+void Keyboard::closeDevice()
+{
+	if (keyboardDescriptor <= 0) {
+		return;
+	}
+	reactor.remove(keyboardDescriptor);
+	close(keyboardDescriptor);
+	keyboardDescriptor = 0;
+	//release the keys that were down, so the consumer does not wait for releases that never come
+	for (uint32_t i = 0; i < KeyStateWords; ++i) {
+		syncState[i] = 0;
+	}
+	requestKeyState(getTimestampUs());
+}
+
+void Keyboard::handleKeyboard(void * obj, uint32_t events)
+{
+	Keyboard * keyboard = reinterpret_cast<Keyboard *>(obj);
+	//key changes that did not fit into the queue go first, so events stay in order
+	if (keyboard->syncPending && !keyboard->flushKeyState()) {
+		return;
+	}
+	//read as many events at once as fit into the queue. the rest waits in the kernel till the queue was drained
+	input_event inputEvents[ReadBatchSize];
+	uint32_t count = 0;
+	while (!keyboard->syncPending && (count = keyboard->keyEvents.getFreeCount()) > 0) {
+		count = count < ReadBatchSize ? count : ReadBatchSize;
+		const ssize_t size = read(keyboard->keyboardDescriptor, inputEvents, count * sizeof(input_event));
+		if (size < 0 && (errno == EAGAIN || errno == EINTR)) {
+			return;
 		}
-    }
+		if (size <= 0) {
+			//the device is gone, e.g. because it was unplugged
+			std::cout << ConsoleStyle(ConsoleStyle::YELLOW) << "Lost keyboard \"" << keyboard->name << "\"." << ConsoleStyle() << std::endl;
+			keyboard->closeDevice();
+			if (!(keyboard->path.empty() ? keyboard->openFirstKeyboard() : keyboard->openDevice(keyboard->path, false))) {
+				std::cout << ConsoleStyle(ConsoleStyle::YELLOW) << "Waiting for a keyboard to be plugged in." << ConsoleStyle() << std::endl;
+			}
+			return;
+		}
+		const uint32_t readCount = size / sizeof(input_event);
+		for (uint32_t i = 0; i < readCount; ++i) {
+			keyboard->handleEvent(inputEvents[i]);
+		}
+		if (readCount < count) {
+			return;
+		}
+	}
+}
+
+void Keyboard::handleEvent(const input_event & inputEvent)
+{
+	const uint64_t timestamp = monotonicTimestamps ? (uint64_t)inputEvent.input_event_sec * 1000000 + inputEvent.input_event_usec : getTimestampUs();
+	if (inputEvent.type == EV_SYN) {
+		if (inputEvent.code == SYN_DROPPED) {
+			//the kernel buffer overflowed. ignore the incomplete events till the end of the report, then read the state
+			resyncing = true;
+			std::cout << ConsoleStyle(ConsoleStyle::YELLOW) << "Keyboard events were dropped by the kernel. Synchronizing key state." << ConsoleStyle() << std::endl;
+		}
+		else if (inputEvent.code == SYN_REPORT && resyncing) {
+			resyncing = false;
+			synchronizeKeyState(timestamp);
+		}
+		return;
+	}
+	if (resyncing || inputEvent.type != EV_KEY || inputEvent.code >= KEY_CNT) {
+		return;
+	}
+	//the values are: 0 for released, 1 for pressed, 2 for autorepeat
+	const bool down = inputEvent.value != 0;
+	if (!syncPending) {
+		const KeyEvent keyEvent = {inputEvent.code, inputEvent.value, timestamp};
+		if (keyEvents.push(keyEvent)) {
+			setKeyState(inputEvent.code, down);
+			return;
+		}
+		//the queue is full. keep the state and queue the change when there is room
+		for (uint32_t i = 0; i < KeyStateWords; ++i) {
+			syncState[i] = keyState[i].load(std::memory_order_relaxed);
+		}
+	}
+	//merge the change into the state waiting to be queued. autorepeats are lost meanwhile
+	const uint64_t bit = 1ULL << (inputEvent.code % 64);
+	syncState[inputEvent.code / 64] = down ? syncState[inputEvent.code / 64] | bit : syncState[inputEvent.code / 64] & ~bit;
+	requestKeyState(timestamp);
+}
+
+void Keyboard::synchronizeKeyState(uint64_t timestamp)
+{
+	uint8_t keys[KEY_CNT / 8 + 1] = {};
+	if (ioctl(keyboardDescriptor, EVIOCGKEY(sizeof(keys)), keys) < 0) {
+		return;
+	}
+	//queue the changes the consumer missed
+	for (uint32_t i = 0; i < KeyStateWords; ++i) {
+		syncState[i] = 0;
+	}
+	for (uint32_t key = 0; key < KEY_CNT; ++key) {
+		if (testBit(keys, key)) {
+			syncState[key / 64] |= 1ULL << (key % 64);
+		}
+	}
+	requestKeyState(timestamp);
+}
+
+void Keyboard::requestKeyState(uint64_t timestamp)
+{
+	syncTimestamp = timestamp;
+	syncPending.store(true, std::memory_order_relaxed);
+	//pairs with the fence in getKeyEvent: either the consumer sees the pending changes and notifies or the flush sees its room
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	flushKeyState();
+}
+
+bool Keyboard::flushKeyState()
+{
+	//queue the changes from the key state to syncState. keys change state only once their event was queued
+	for (uint32_t key = 0; key < KEY_CNT; ++key) {
+		const bool down = (syncState[key / 64] & (1ULL << (key % 64))) != 0;
+		if (down != isKeyDown(key)) {
+			const KeyEvent keyEvent = {(uint16_t)key, down ? 1 : 0, syncTimestamp};
+			if (!keyEvents.push(keyEvent)) {
+				return false;
+			}
+			setKeyState(key, down);
+		}
+	}
+	syncPending.store(false, std::memory_order_relaxed);
+	return true;
+}
+
+void Keyboard::setKeyState(uint16_t key, bool down)
+{
+	const uint64_t bit = 1ULL << (key % 64);
+	if (down) {
+		keyState[key / 64].fetch_or(bit, std::memory_order_relaxed);
+	}
 	else {
-		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to open keyboard at \"" << devicePath << "\"!" << ConsoleStyle() << std::endl;
+		keyState[key / 64].fetch_and(~bit, std::memory_order_relaxed);
 	}
 }
 
-void * Keyboard::keyLoop(void * obj)
+void Keyboard::handleRoom(void * obj, uint32_t events)
 {
 	Keyboard * keyboard = reinterpret_cast<Keyboard *>(obj);
-	//start thread loop
-    while (keyboard != nullptr && keyboard->active) {
-		//read keyboard event
-		input_event inputEvent;
-		if (read(keyboard->keyboardDescriptor, reinterpret_cast<void *>(&inputEvent), sizeof(inputEvent)) > 0) {
-			if (inputEvent.type & EV_KEY) {
-				//copy key value to keyboard state array. block mutex before
-				pthread_mutex_lock(&keyboard->mutex);
-				keyboard->keyboardState[inputEvent.code] = inputEvent.value;
-				if (inputEvent.value > 0) {
-				    //add key to list of pressed keys
-				    keyboard->pressedKeys[inputEvent.code] = true;
-				}
-				pthread_mutex_unlock(&keyboard->mutex);
-				//std::cout << "Key " << inputEvent.code << " = " << inputEvent.value << std::endl;
-				//the values are: 0 for released, 1 for pressed, 2 for autorepeat
+	keyboard->roomNotifier.wait(0);
+	//events waiting in the kernel are read when the device is readable again after the flush
+	if (keyboard->syncPending) {
+		keyboard->flushKeyState();
+	}
+}
+
+void Keyboard::handleHotplug(void * obj, uint32_t events)
+{
+	Keyboard * keyboard = reinterpret_cast<Keyboard *>(obj);
+	//inotify events have a variable length name, so read them into a buffer aligned like the event struct
+	alignas(inotify_event) char buffer[4096];
+	ssize_t size = 0;
+	while ((size = read(keyboard->hotplugDescriptor, buffer, sizeof(buffer))) > 0) {
+		for (const char * position = buffer; position < buffer + size; ) {
+			const inotify_event * event = reinterpret_cast<const inotify_event *>(position);
+			position += sizeof(inotify_event) + event->len;
+			if (keyboard->keyboardDescriptor > 0 || event->len == 0 || strncmp(event->name, "event", 5) != 0) {
+				continue;
+			}
+			const std::string devicePath = std::string(INPUT_DIRECTORY "/") + event->name;
+			if (keyboard->path.empty()) {
+				keyboard->openDevice(devicePath, true);
+			}
+			else if (devicePath == keyboard->path) {
+				keyboard->openDevice(devicePath, false);
 			}
 		}
-		//sleep 20ms between polling keyboard
-		usleep(20 * 1000);
 	}
 }
 
 bool Keyboard::isAvailable() const
 {
-	return (keyboardDescriptor > 0 && active);
+	return reactor.isAvailable() && (keyboardDescriptor > 0 || hotplugDescriptor >= 0);
 }
 
-int32_t Keyboard::getKeyState(uint32_t key)
+bool Keyboard::isConnected() const
 {
-	bool result = false;
-	//block mutex for member variables
-	pthread_mutex_lock(&mutex);
-	if (active && key < KEY_CNT) {
-		result = (keyboardState[key] > 0);
-	}
-	pthread_mutex_unlock(&mutex);
-	return result;
+	return keyboardDescriptor > 0;
 }
 
-bool Keyboard::keyWasPressed(uint32_t key)
+int Keyboard::getDescriptor() const
 {
-    bool result = false;
-    //block mutex for member variables
-	pthread_mutex_lock(&mutex);
-	//try to find key in list
-    if (pressedKeys.find(key) != pressedKeys.cend()) {
-        result = true;
-    }
-    pthread_mutex_unlock(&mutex);
-    return result;
+	return reactor.getDescriptor();
 }
 
-void Keyboard::clearPressedKeys()
+bool Keyboard::readEvents()
 {
-    //block mutex for member variables
-	pthread_mutex_lock(&mutex);
-    pressedKeys.clear();
-    pthread_mutex_unlock(&mutex);
+	return reactor.runOnce(0) >= 0;
+}
+
+bool Keyboard::isKeyDown(uint32_t key) const
+{
+	if (key >= KEY_CNT) {
+		return false;
+	}
+	return (keyState[key / 64].load(std::memory_order_relaxed) & (1ULL << (key % 64))) != 0;
+}
+
+bool Keyboard::getKeyEvent(KeyEvent & event)
+{
+	if (!keyEvents.pop(event)) {
+		return false;
+	}
+	//wake up the producer if key changes wait for the room just drained
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (syncPending.load(std::memory_order_relaxed)) {
+		roomNotifier.notify();
+	}
+	return true;
 }
 
 Keyboard::~Keyboard()
 {
 	std::cout << "Closing keyboard." << std::endl;
-	if (thread != 0) {
-		active = false;
-		pthread_join(thread, 0);
-		thread = 0;
-	}
 	if (keyboardDescriptor > 0) {
+		reactor.remove(keyboardDescriptor);
 		close(keyboardDescriptor);
 		keyboardDescriptor = 0;
 	}
+	if (roomNotifier.isAvailable()) {
+		reactor.remove(roomNotifier.getDescriptor());
+	}
+	if (hotplugDescriptor >= 0) {
+		reactor.remove(hotplugDescriptor);
+		close(hotplugDescriptor);
+		hotplugDescriptor = -1;
+	}
     //turn on ECHO again
     //tcsetattr(0, TCSAFLUSH/*TCSANOW*/, &oldTermios);
     //flush streams
     //tcflush(TCIOFLUSH, TCION);
 }
-
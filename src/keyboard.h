@@ -1,61 +1,114 @@
 #pragma once
 
-#include <map>
+#include <atomic>
 #include <string>
-#include <pthread.h>
 #include <linux/input.h>
 #include <termios.h>
- 
 
+#include "eventnotifier.h"
+#include "reactor.h"
+#include "spscqueue.h"
+
+
+/*!
+Key input from a Linux input device.
+Wait for \getDescriptor in an event loop and call \readEvents when it is readable. All pending events are read at once and
+queued with their kernel timestamps, then the consumer drains them in order with \getKeyEvent, so fast presses are never
+merged or lost. \readEvents and \getKeyEvent may run in different threads.
+Key changes that don't fit into the queue, e.g. after the kernel dropped events or when a keyboard with keys held down is
+unplugged, are queued as room is drained. Device events are not read meanwhile, so events stay in order.
+Keyboards are hotplugged: if the device is unplugged, the next one plugged in is opened.
+*/
 class Keyboard
 {
-	std::string path; //!<linux device path.
-	std::string name; //!<device name.
+public:
+	struct KeyEvent
+	{
+		uint16_t code; //!<Linux key code, e.g. KEY_ESC.
+		int32_t value; //!<0 for released, 1 for pressed, 2 for autorepeat.
+		uint64_t timestamp; //!<Time the kernel received the event in us, as returned by getTimestampUs().
+	};
+
+private:
+	static const uint32_t EventCapacity = 256; //!<Number of key events queued till the consumer drains them.
+	static const uint32_t ReadBatchSize = 64; //!<Maximum number of input events read from the device at once.
+	static const uint32_t KeyStateWords = (KEY_CNT + 63) / 64; //!<Number of words in the key state bitset.
 
-    pthread_t thread; //!<key polling thread.
-	pthread_mutex_t mutex; //!<The mutex protecting the keyboardState member.
-    bool active; //!<flags to keep the thread running or stop it.
+	std::string path; //!<linux device path. Empty for autodetection.
+	std::string name; //!<device name.
+	bool grab; //!<If true the device is grabbed, so its events don't reach the console or other programs.
 
-    int keyboardDescriptor; //!<File descriptor for keyboard device.
-    int32_t keyboardState[KEY_CNT]; //!<State of the individual keys in the device.
-    std::map<int32_t, bool> pressedKeys; //!<List of keys that were pressed since the list was last cleared.
+	Reactor reactor; //!<Waits for the device and for changes in /dev/input. Its descriptor is waited for by the caller.
+    int keyboardDescriptor; //!<File descriptor for keyboard device or 0 while no keyboard is connected.
+    int hotplugDescriptor; //!<inotify descriptor watching /dev/input or -1.
+    bool monotonicTimestamps; //!<true if the device reports CLOCK_MONOTONIC timestamps.
+    bool resyncing; //!<true after the kernel dropped events. Events are ignored till the key state was read again.
+    std::atomic<uint64_t> keyState[KeyStateWords]; //!<Bit per key that is set while the key is down. Only changed for queued events.
+    SpscQueue<KeyEvent, EventCapacity> keyEvents; //!<Events read but not drained yet.
+    uint64_t syncState[KeyStateWords]; //!<Key state to reach by queueing key changes while syncPending. Producer thread only.
+    uint64_t syncTimestamp; //!<Timestamp of the key changes queued to reach syncState.
+    std::atomic<bool> syncPending; //!<true while key changes to reach syncState wait for room in the queue.
+    EventNotifier roomNotifier; //!<Notified by the consumer when it drained events while syncPending.
     termios oldTermios; //!<Old termios state store before turning off echoing.
 
-	static void * keyLoop(void * obj);
+	static void handleKeyboard(void * obj, uint32_t events);
+	static void handleHotplug(void * obj, uint32_t events);
+	static void handleRoom(void * obj, uint32_t events);
+	static bool isKeyboardDevice(int descriptor);
+
+	bool openDevice(const std::string & devicePath, bool checkCapabilities);
+	bool openFirstKeyboard();
+	void closeDevice();
+	void handleEvent(const input_event & inputEvent);
+	void synchronizeKeyState(uint64_t timestamp);
+	void requestKeyState(uint64_t timestamp);
+	bool flushKeyState();
+	void setKeyState(uint16_t key, bool down);
 
 public:
     /*!
-    Create keyboard interface and start polling keyboard.
+    Create keyboard interface and open the keyboard device.
     \param[in] devicePath Optional. Device path to open keyboard at, e.g. "/dev/input/event3".
+    \param[in] grabDevice Optional. Grab the device, so key presses don't reach the console or other programs.
     \note If \devicePath is empty, the keyboard will be autodetected.
     */
-	Keyboard(std::string devicePath);
+	Keyboard(std::string devicePath, bool grabDevice = false);
 
     /*!
     Check if keyboard interface is available.
-    \return Returns true if the keyboard interface can be used.
+    \return Returns true if the keyboard interface can be used, even if no keyboard is connected but one can be hotplugged.
     */
 	bool isAvailable() const;
-	
+
+    /*!
+    Check if a keyboard device is open right now.
+    */
+	bool isConnected() const;
+
+	/*!
+	Get the descriptor to wait for, e.g. with epoll. It is readable while there are unread key events or device changes.
+	*/
+	int getDescriptor() const;
+
+	/*!
+	Read all pending key events and device changes. Never blocks. Producer thread only.
+	\return Returns false if waiting for the devices failed.
+	*/
+	bool readEvents();
+
 	/*!
-	Check current state of a key.
+	Check current state of a key. Can be called from any thread.
 	\param[in] key Scancode of key to check.
-	\return Returns the current state of the key. 0 for released, 1 for pressed, 2 for autorepeat.
+	\return Returns true if the key is down according to the events read so far.
 	*/
-    int32_t getKeyState(uint32_t key);
-    
-    /*!
-    Check if a key was pressed since \clearPressedKeys was called.
-    \param[in] key Scancode of key to check.
-    \return Returns true if the key was pressed.
-    */
-    bool keyWasPressed(uint32_t key);
-    
+    bool isKeyDown(uint32_t key) const;
+
     /*!
-    Clear the list of pressed keys.
-    \note Call this in your loop that polls the keys.
+    Get the oldest key event that was not drained yet. Consumer thread only.
+    \param[out] event The key event.
+    \return Returns false if there are no events.
     */
-    void clearPressedKeys();
+    bool getKeyEvent(KeyEvent & event);
 
 	~Keyboard();
 };
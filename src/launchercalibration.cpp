@@ -0,0 +1,205 @@
+#include "launchercalibration.h"
+
+#include <cmath>
+#include <iostream>
+#include <unistd.h>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "consolestyle.h"
+#include "timestamp.h"
+
+
+const int LauncherCalibration::sampleDurations[] = {60, 120, 180, 240};
+const uint32_t LauncherCalibration::settleTime = 400;
+
+static const MissileControl::LauncherCommand calibrationDirections[] = {MissileControl::LEFT, MissileControl::RIGHT, MissileControl::UP, MissileControl::DOWN};
+static const char * directionNames[] = {"left", "right", "up", "down"};
+
+
+LauncherCalibration::LauncherCalibration()
+{
+}
+
+int LauncherCalibration::getIndex(MissileControl::LauncherCommand direction)
+{
+	switch (direction) {
+		case MissileControl::LEFT:
+			return 0;
+		case MissileControl::RIGHT:
+			return 1;
+		case MissileControl::UP:
+			return 2;
+		case MissileControl::DOWN:
+			return 3;
+		default:
+			return -1;
+	}
+}
+
+bool LauncherCalibration::isValid() const
+{
+	return directions[0].valid && directions[1].valid && directions[2].valid && directions[3].valid;
+}
+
+const LauncherCalibration::Direction & LauncherCalibration::getDirection(MissileControl::LauncherCommand direction) const
+{
+	static const Direction invalid;
+	const int index = getIndex(direction);
+	return index >= 0 ? directions[index] : invalid;
+}
+
+int LauncherCalibration::getPulseDuration(MissileControl::LauncherCommand direction, float pixels) const
+{
+	const Direction & model = getDirection(direction);
+	if (!model.valid || pixels <= 0.0f) {
+		return 0;
+	}
+	return (int)(model.lagMs + pixels / model.pixelsPerMs + 0.5f);
+}
+
+bool LauncherCalibration::fit(MissileControl::LauncherCommand direction, const std::vector<Sample> & samples)
+{
+	const int index = getIndex(direction);
+	if (index < 0) {
+		return false;
+	}
+	directions[index].valid = false;
+	//pulses shorter than the lag did not move at all and are not on the line
+	double sumD = 0.0;
+	double sumP = 0.0;
+	double sumDD = 0.0;
+	double sumDP = 0.0;
+	uint32_t count = 0;
+	for (auto sIt = samples.cbegin(); sIt != samples.cend(); ++sIt) {
+		if (sIt->pixels >= 1.0f) {
+			sumD += sIt->durationMs;
+			sumP += sIt->pixels;
+			sumDD += (double)sIt->durationMs * sIt->durationMs;
+			sumDP += sIt->durationMs * sIt->pixels;
+			count++;
+		}
+	}
+	const double denominator = count * sumDD - sumD * sumD;
+	if (count < 2 || denominator <= 0.0) {
+		return false;
+	}
+	//pixels = slope * duration + offset, so the lag is where the line crosses zero
+	const double slope = (count * sumDP - sumD * sumP) / denominator;
+	const double offset = (sumP - slope * sumD) / count;
+	if (slope <= 0.0) {
+		return false;
+	}
+	directions[index].pixelsPerMs = slope;
+	directions[index].lagMs = std::max(0.0, -offset / slope);
+	directions[index].valid = true;
+	return true;
+}
+
+bool LauncherCalibration::grabFrame(MotionDetector & detector, cv::Mat & grey)
+{
+	cv::Mat frame;
+	//drop the frame that was published already and wait for the next one
+	detector.getLastFrame(frame);
+	const uint64_t timeout = getTimestampUs() + 2000000;
+	while (!detector.getLastFrame(frame)) {
+		const uint64_t now = getTimestampUs();
+		if (now > timeout) {
+			return false;
+		}
+		detector.waitForResult((timeout - now + 999) / 1000);
+	}
+	cv::Mat converted;
+	cv::cvtColor(frame, converted, CV_BGR2GRAY);
+	converted.convertTo(grey, CV_32F);
+	return true;
+}
+
+bool LauncherCalibration::calibrate(MotionDetector & detector, MissileControl & control, uint32_t launcher)
+{
+	if (!detector.isAvailable() || detector.isPaused() || !control.isAvailable() || launcher >= control.getLauncherCount()) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Calibration needs a running motion detector and launcher!" << ConsoleStyle() << std::endl;
+		return false;
+	}
+	std::cout << "Calibrating movement of launcher " << launcher << "..." << std::endl;
+	std::vector<Sample> samples[4];
+	cv::Mat before;
+	cv::Mat after;
+	cv::Mat window;
+	//move back and forth with the same pulse, so the launcher stays around its start position
+	for (uint32_t i = 0; i < sizeof(sampleDurations) / sizeof(sampleDurations[0]); ++i) {
+		for (uint32_t d = 0; d < 4; ++d) {
+			if (!grabFrame(detector, before)) {
+				std::cout << ConsoleStyle(ConsoleStyle::RED) << "No frames from motion detector!" << ConsoleStyle() << std::endl;
+				return false;
+			}
+			if (window.size() != before.size()) {
+				cv::createHanningWindow(window, before.size(), CV_32F);
+			}
+			control.executeCommand(launcher, calibrationDirections[d], sampleDurations[i], true);
+			//use the time the launcher actually moved, not the time asked for
+			int durationMs = sampleDurations[i];
+			MissileControl::SegmentReport segment;
+			if (control.waitForIdle(launcher, sampleDurations[i] + 1000) && control.getLastSegment(launcher, segment) && segment.command == calibrationDirections[d]) {
+				durationMs = (int)((segment.stopTimestamp - segment.startTimestamp + 500) / 1000);
+			}
+			usleep(settleTime * 1000);
+			if (!grabFrame(detector, after)) {
+				std::cout << ConsoleStyle(ConsoleStyle::RED) << "No frames from motion detector!" << ConsoleStyle() << std::endl;
+				return false;
+			}
+			//only the shift along the movement axis counts. shifts beyond half the frame wrap around and are useless
+			const cv::Point2d shift = cv::phaseCorrelate(before, after, window);
+			const float pixels = std::fabs(d < 2 ? shift.x : shift.y);
+			const float limit = (d < 2 ? before.cols : before.rows) * 0.4f;
+			std::cout << "Pulse " << directionNames[d] << " " << durationMs << "ms: " << pixels << " pixels." << std::endl;
+			if (pixels < limit) {
+				Sample sample = {durationMs, pixels};
+				samples[d].push_back(sample);
+			}
+		}
+	}
+	bool result = true;
+	for (uint32_t d = 0; d < 4; ++d) {
+		if (fit(calibrationDirections[d], samples[d])) {
+			std::cout << "Direction " << directionNames[d] << ": " << directions[d].pixelsPerMs << " pixels/ms after " << directions[d].lagMs << "ms lag." << std::endl;
+		}
+		else {
+			std::cout << ConsoleStyle(ConsoleStyle::YELLOW) << "Failed to calibrate direction " << directionNames[d] << "!" << ConsoleStyle() << std::endl;
+			result = false;
+		}
+	}
+	return result;
+}
+
+bool LauncherCalibration::load(const std::string & fileName)
+{
+	cv::FileStorage file(fileName, cv::FileStorage::READ);
+	if (!file.isOpened()) {
+		return false;
+	}
+	for (uint32_t d = 0; d < 4; ++d) {
+		const cv::FileNode node = file[directionNames[d]];
+		directions[d].valid = false;
+		if (!node.empty()) {
+			node["pixelsPerMs"] >> directions[d].pixelsPerMs;
+			node["lagMs"] >> directions[d].lagMs;
+			directions[d].valid = directions[d].pixelsPerMs > 0.0f;
+		}
+	}
+	return isValid();
+}
+
+bool LauncherCalibration::save(const std::string & fileName) const
+{
+	cv::FileStorage file(fileName, cv::FileStorage::WRITE);
+	if (!file.isOpened()) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to write calibration to \"" << fileName << "\"!" << ConsoleStyle() << std::endl;
+		return false;
+	}
+	for (uint32_t d = 0; d < 4; ++d) {
+		if (directions[d].valid) {
+			file << directionNames[d] << "{" << "pixelsPerMs" << directions[d].pixelsPerMs << "lagMs" << directions[d].lagMs << "}";
+		}
+	}
+	return true;
+}
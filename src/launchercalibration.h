@@ -0,0 +1,97 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "missilecontrol.h"
+#include "motiondetector.h"
+
+
+/*!
+Model of how far the launcher, and the camera riding on it, turns for a movement pulse.
+Per direction the image shift is modelled as pixelsPerMs * (duration - lag), where lag is the start-up time of the motor.
+The model is measured by issuing timed pulses and finding the shift between the frames before and after each pulse with
+phase correlation. With it a pixel error can be turned into one correctly sized pulse.
+*/
+class LauncherCalibration
+{
+public:
+	struct Direction
+	{
+		float pixelsPerMs; //!<Image shift per ms of movement after the start-up lag.
+		float lagMs; //!<Pulse duration in ms before the launcher starts moving.
+		bool valid; //!<True if the direction was calibrated.
+
+		Direction() : pixelsPerMs(0.0f), lagMs(0.0f), valid(false) {};
+	};
+
+	struct Sample
+	{
+		int durationMs; //!<Duration of pulse.
+		float pixels; //!<Measured image shift along the movement axis.
+	};
+
+private:
+	static const int sampleDurations[]; //!<Pulse durations measured in ms.
+	static const uint32_t settleTime; //!<Time to wait after a pulse for the launcher to come to rest in ms.
+
+	Direction directions[4]; //!<Model of LEFT, RIGHT, UP and DOWN.
+
+	static int getIndex(MissileControl::LauncherCommand direction);
+
+	/*!
+	Wait for the first frame analyzed after now and convert it for phase correlation.
+	*/
+	static bool grabFrame(MotionDetector & detector, cv::Mat & grey);
+
+public:
+	LauncherCalibration();
+
+	/*!
+	Check if all four directions are calibrated.
+	*/
+	bool isValid() const;
+
+	/*!
+	Get the model of one direction.
+	\param[in] direction LEFT, RIGHT, UP or DOWN.
+	*/
+	const Direction & getDirection(MissileControl::LauncherCommand direction) const;
+
+	/*!
+	Get the pulse duration needed to shift the image by some pixels.
+	\param[in] direction LEFT, RIGHT, UP or DOWN.
+	\param[in] pixels Wanted shift along the movement axis.
+	\return Returns the duration in ms or 0 if the direction is not calibrated.
+	*/
+	int getPulseDuration(MissileControl::LauncherCommand direction, float pixels) const;
+
+	/*!
+	Fit the model of a direction to measured pulses with least squares.
+	\param[in] direction LEFT, RIGHT, UP or DOWN.
+	\param[in] samples Measured pulses. Pulses that did not move the launcher are ignored.
+	\return Returns true if the samples gave a valid model.
+	*/
+	bool fit(MissileControl::LauncherCommand direction, const std::vector<Sample> & samples);
+
+	/*!
+	Measure the model of all directions. Moves the launcher back and forth with pulses of increasing length.
+	\param[in] detector Motion detector of the camera mounted on the launcher. Detection must not be paused.
+	\param[in] control Launcher control.
+	\param[in] launcher Index of the launcher the camera rides on.
+	\return Returns true if all directions could be calibrated.
+	\note The scene should be static and textured. Shifts must stay below half the frame size for phase correlation to work.
+	*/
+	bool calibrate(MotionDetector & detector, MissileControl & control, uint32_t launcher);
+
+	/*!
+	Load calibration from a YAML or XML file.
+	*/
+	bool load(const std::string & fileName);
+
+	/*!
+	Store calibration in a YAML or XML file.
+	*/
+	bool save(const std::string & fileName) const;
+};
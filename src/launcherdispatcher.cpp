@@ -0,0 +1,121 @@
+#include "launcherdispatcher.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+LauncherDispatcher::LauncherDispatcher(uint32_t launcherCount, uint32_t sourceCount, float pixelTime)
+	: launchers(launcherCount), assigned(launcherCount, -1), msPerPixel(pixelTime)
+{
+	for (uint32_t i = 0; i < launcherCount; ++i) {
+		launchers[i].sources.resize(sourceCount, false);
+		launchers[i].busyUntil = 0;
+		launchers[i].commandLatencyUs = 0;
+		launchers[i].engagedSource = -1;
+	}
+	//the camera of a source rides on one launcher. with fewer launchers than sources they aim at several sources
+	for (uint32_t source = 0; launcherCount > 0 && source < sourceCount; ++source) {
+		launchers[source % launcherCount].sources[source] = true;
+	}
+}
+
+void LauncherDispatcher::setSource(uint32_t launcher, uint32_t source, bool engage)
+{
+	if (launcher < launchers.size() && source < launchers[launcher].sources.size()) {
+		launchers[launcher].sources[source] = engage;
+	}
+}
+
+void LauncherDispatcher::clearSources()
+{
+	for (auto lIt = launchers.begin(); lIt != launchers.end(); ++lIt) {
+		std::fill(lIt->sources.begin(), lIt->sources.end(), false);
+	}
+}
+
+bool LauncherDispatcher::canEngage(uint32_t launcher, uint32_t source) const
+{
+	return launcher < launchers.size() && source < launchers[launcher].sources.size() && launchers[launcher].sources[source];
+}
+
+void LauncherDispatcher::setCalibration(uint32_t launcher, const LauncherCalibration & model)
+{
+	if (launcher < launchers.size() && model.isValid()) {
+		launchers[launcher].calibration = model;
+	}
+}
+
+void LauncherDispatcher::setState(uint32_t launcher, uint64_t busyUntil, uint64_t commandLatency)
+{
+	if (launcher < launchers.size()) {
+		launchers[launcher].busyUntil = busyUntil;
+		launchers[launcher].commandLatencyUs = commandLatency;
+	}
+}
+
+float LauncherDispatcher::getMoveTime(const Launcher & launcher, float offset, MissileControl::LauncherCommand negative, MissileControl::LauncherCommand positive) const
+{
+	if (launcher.calibration.isValid()) {
+		return launcher.calibration.getPulseDuration(offset < 0.0f ? negative : positive, std::fabs(offset));
+	}
+	return std::fabs(offset) * msPerPixel;
+}
+
+uint64_t LauncherDispatcher::getEngageTime(uint32_t launcher, const Target & target, uint64_t now) const
+{
+	const Launcher & state = launchers[launcher];
+	//both axes move at the same time with diagonal commands
+	const float moveMs = std::max(getMoveTime(state, target.dx, MissileControl::LEFT, MissileControl::RIGHT), getMoveTime(state, target.dy, MissileControl::UP, MissileControl::DOWN));
+	//movement towards this target is no reason to hand it to another launcher
+	const uint64_t busyUs = ((int32_t)target.source != state.engagedSource && state.busyUntil > now) ? state.busyUntil - now : 0;
+	return busyUs + state.commandLatencyUs + (uint64_t)(moveMs * 1000.0f);
+}
+
+bool LauncherDispatcher::isNeeded(uint32_t launcher, const std::vector<Target> & targets, uint32_t first) const
+{
+	for (uint32_t t = first; t < targets.size(); ++t) {
+		if (canEngage(launcher, targets[t].source)) {
+			//check if another free launcher could engage the target
+			bool alternative = false;
+			for (uint32_t l = 0; !alternative && l < launchers.size(); ++l) {
+				alternative = l != launcher && assigned[l] < 0 && canEngage(l, targets[t].source);
+			}
+			if (!alternative) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void LauncherDispatcher::assign(const std::vector<Target> & targets, uint64_t now, std::vector<Assignment> & assignments)
+{
+	assignments.clear();
+	std::fill(assigned.begin(), assigned.end(), -1);
+	for (uint32_t t = 0; t < targets.size(); ++t) {
+		//find the free launcher that is on this target first. a launcher that is the only one for a later target
+		//is only taken if there is no other, so as many targets as possible are engaged
+		int32_t best = -1;
+		uint64_t bestTime = 0;
+		bool bestNeeded = false;
+		for (uint32_t l = 0; l < launchers.size(); ++l) {
+			if (assigned[l] < 0 && canEngage(l, targets[t].source)) {
+				const uint64_t time = getEngageTime(l, targets[t], now);
+				const bool needed = isNeeded(l, targets, t + 1);
+				if (best < 0 || (bestNeeded && !needed) || (bestNeeded == needed && time < bestTime)) {
+					best = l;
+					bestTime = time;
+					bestNeeded = needed;
+				}
+			}
+		}
+		if (best >= 0) {
+			assigned[best] = targets[t].source;
+			Assignment assignment = {(uint32_t)best, t, bestTime, launchers[best].engagedSource != assigned[best]};
+			assignments.push_back(assignment);
+		}
+	}
+	for (uint32_t l = 0; l < launchers.size(); ++l) {
+		launchers[l].engagedSource = assigned[l];
+	}
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "launchercalibration.h"
+
+
+/*!
+Decides which launcher engages which target when there are several launchers.
+Targets are handed out most important first, each to the free launcher that can be on target first, unless that
+launcher is the only one left for a later target. The time till a launcher is on target is estimated from its current
+pose, i.e. the offset of the target from its aim point, the planned movement it still has to finish and its command
+latency. Every launcher engages at most one target, so launchers covering different targets work in parallel. A launcher keeps its target while it moves towards it, so the
+time it is busy with that target does not count against it.
+Launchers only engage targets of the sources they can aim at. By default the camera of source i rides on launcher
+i % launcherCount, so a single launcher aims at all sources and launchers with overlapping sectors can be given
+each other's sources with \setSource.
+*/
+class LauncherDispatcher
+{
+public:
+	struct Target
+	{
+		uint32_t source; //!<Index of the source the target was seen by.
+		float dx; //!<Offset of target from aim point in x in pixels. Positive values move the launcher right.
+		float dy; //!<Offset of target from aim point in y in pixels. Positive values move the launcher down.
+	};
+
+	struct Assignment
+	{
+		uint32_t launcher; //!<Index of launcher.
+		uint32_t target; //!<Index of the target in the list passed to \assign.
+		uint64_t engageUs; //!<Estimated time till the launcher is on target in us.
+		bool changed; //!<true if the launcher engaged another source before, e.g. to reset its controller.
+	};
+
+private:
+	struct Launcher
+	{
+		std::vector<bool> sources; //!<true for the sources the launcher can aim at.
+		LauncherCalibration calibration; //!<Movement per pulse if valid.
+		uint64_t busyUntil; //!<End of the planned movement in us.
+		uint64_t commandLatencyUs; //!<Time from issuing a command till it reaches the launcher in us.
+		int32_t engagedSource; //!<Source of the target engaged last or -1.
+	};
+
+	std::vector<Launcher> launchers; //!<State per launcher.
+	std::vector<int32_t> assigned; //!<Source assigned to each launcher by \assign or -1. Kept, so assigning doesn't allocate.
+	float msPerPixel; //!<Movement time per pixel of offset for launchers without calibration.
+
+	/*!
+	Get the time in ms needed to move one axis by an offset.
+	*/
+	float getMoveTime(const Launcher & launcher, float offset, MissileControl::LauncherCommand negative, MissileControl::LauncherCommand positive) const;
+
+	/*!
+	Check if a launcher is the only free one that can engage one of the targets from index first on.
+	*/
+	bool isNeeded(uint32_t launcher, const std::vector<Target> & targets, uint32_t first) const;
+
+public:
+	/*!
+	Create dispatcher.
+	\param[in] launcherCount Number of launchers.
+	\param[in] sourceCount Number of sources targets are seen by.
+	\param[in] pixelTime Optional. Movement time per pixel of offset in ms for launchers without calibration.
+	*/
+	LauncherDispatcher(uint32_t launcherCount, uint32_t sourceCount, float pixelTime = 2.0f);
+
+	/*!
+	Set if a launcher can aim at the targets of a source.
+	\param[in] launcher Index of launcher.
+	\param[in] source Index of source.
+	\param[in] engage Optional. Pass false to keep the launcher away from the source.
+	*/
+	void setSource(uint32_t launcher, uint32_t source, bool engage = true);
+
+	/*!
+	Keep all launchers away from all sources, e.g. before setting an explicit mapping with \setSource.
+	*/
+	void clearSources();
+
+	/*!
+	Check if a launcher can aim at the targets of a source.
+	*/
+	bool canEngage(uint32_t launcher, uint32_t source) const;
+
+	/*!
+	Estimate movement times from a measured launcher model.
+	\param[in] launcher Index of launcher.
+	\param[in] model Calibration. Ignored if not valid.
+	*/
+	void setCalibration(uint32_t launcher, const LauncherCalibration & model);
+
+	/*!
+	Update what a launcher is doing.
+	\param[in] launcher Index of launcher.
+	\param[in] busyUntil End of the planned movement in us, e.g. from \MissileControl::getPlanEnd.
+	\param[in] commandLatency Latency in us, e.g. from \MissileControl::getCommandLatency.
+	*/
+	void setState(uint32_t launcher, uint64_t busyUntil, uint64_t commandLatency);
+
+	/*!
+	Estimate the time till a launcher is on a target.
+	\param[in] launcher Index of launcher.
+	\param[in] target Target. The launcher must be able to aim at its source.
+	\param[in] now Current CLOCK_MONOTONIC time in us.
+	\return Returns the time in us.
+	*/
+	uint64_t getEngageTime(uint32_t launcher, const Target & target, uint64_t now) const;
+
+	/*!
+	Assign targets to launchers.
+	\param[in] targets Targets, most important first, e.g. in the order of \TargetSelector::selectAll.
+	\param[in] now Current CLOCK_MONOTONIC time in us.
+	\param[out] assignments One entry per launcher that engages a target. Launchers not listed have no target.
+	*/
+	void assign(const std::vector<Target> & targets, uint64_t now, std::vector<Assignment> & assignments);
+};
@@ -0,0 +1,54 @@
+#include "leadpredictor.h"
+
+#include <algorithm>
+
+
+LeadPredictor::LeadPredictor(uint64_t fireDelay, uint64_t maxLead)
+	: commandLatencyUs(0), fireDelayUs(fireDelay), maxLeadUs(maxLead)
+{
+}
+
+void LeadPredictor::setCommandLatency(uint64_t latency)
+{
+	commandLatencyUs = latency;
+}
+
+uint64_t LeadPredictor::getCommandLatency() const
+{
+	return commandLatencyUs;
+}
+
+void LeadPredictor::setFireDelay(uint64_t delay)
+{
+	fireDelayUs = delay;
+}
+
+uint64_t LeadPredictor::getFireDelay() const
+{
+	return fireDelayUs;
+}
+
+LeadPredictor::Aim LeadPredictor::predict(const MotionDetector::MotionInformation & motion, float centerX, float centerY, uint64_t time) const
+{
+	//the pipeline latency is the time since the frame was captured
+	const uint64_t lead = std::min(time > motion.timestamp ? time - motion.timestamp : 0, maxLeadUs);
+	const float seconds = lead / 1000000.0f;
+	Aim aim;
+	aim.x = motion.cx + motion.vx * seconds;
+	aim.y = motion.cy + motion.vy * seconds;
+	aim.dx = aim.x - centerX;
+	aim.dy = aim.y - centerY;
+	aim.distance2 = aim.dx * aim.dx + aim.dy * aim.dy;
+	aim.leadUs = lead;
+	return aim;
+}
+
+LeadPredictor::Aim LeadPredictor::getMoveAim(const MotionDetector::MotionInformation & motion, float centerX, float centerY, uint64_t now) const
+{
+	return predict(motion, centerX, centerY, now + commandLatencyUs);
+}
+
+LeadPredictor::Aim LeadPredictor::getFireAim(const MotionDetector::MotionInformation & motion, float centerX, float centerY, uint64_t now) const
+{
+	return predict(motion, centerX, centerY, now + commandLatencyUs + fireDelayUs);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "motiondetector.h"
+
+
+/*!
+Predicts where a moving target will be when a launcher command takes effect.
+Motion information is already old when it arrives, because capture and processing take time. Sending a command to the
+launcher takes time too and a shot needs time to wind up and fly. The target center is moved along the velocity of its
+track by the sum of these delays. Pipeline latency is measured with the capture time stamp of the motion, the
+command latency should be fed from \MissileControl::getCommandLatency.
+*/
+class LeadPredictor
+{
+public:
+	struct Aim
+	{
+		float x; //!<Predicted target center x.
+		float y; //!<Predicted target center y.
+		float dx; //!<Offset of predicted target center from aim point in x.
+		float dy; //!<Offset of predicted target center from aim point in y.
+		uint32_t distance2; //!<Squared distance of predicted target center to aim point.
+		uint64_t leadUs; //!<Time from capture of the motion to the predicted time in us.
+	};
+
+private:
+	uint64_t commandLatencyUs; //!<Time from issuing a command till it reached the launcher in us.
+	uint64_t fireDelayUs; //!<Time from the fire command reaching the launcher till the projectile arrives in us.
+	uint64_t maxLeadUs; //!<Leads are limited to this, because velocities can't be extrapolated far.
+
+	Aim predict(const MotionDetector::MotionInformation & motion, float centerX, float centerY, uint64_t time) const;
+
+public:
+	/*!
+	Create predictor.
+	\param[in] fireDelay Optional. Time from the fire command reaching the launcher till the projectile arrives at the target in us.
+	\param[in] maxLead Optional. Maximum lead time in us.
+	*/
+	LeadPredictor(uint64_t fireDelay = 500000, uint64_t maxLead = 2000000);
+
+	/*!
+	Set the time a command needs to reach the launcher.
+	\param[in] latency Latency in us, e.g. from \MissileControl::getCommandLatency.
+	*/
+	void setCommandLatency(uint64_t latency);
+	uint64_t getCommandLatency() const;
+
+	/*!
+	Set the time from the fire command reaching the launcher till the projectile arrives at the target.
+	\param[in] delay Delay in us, the fire mechanism wind up plus the flight time.
+	*/
+	void setFireDelay(uint64_t delay);
+	uint64_t getFireDelay() const;
+
+	/*!
+	Predict where a target will be when a movement command issued now reaches the launcher.
+	\param[in] motion Motion of target including its velocity.
+	\param[in] centerX Aim point x, usually the frame center.
+	\param[in] centerY Aim point y, usually the frame center.
+	\param[in] now Current CLOCK_MONOTONIC time in us.
+	*/
+	Aim getMoveAim(const MotionDetector::MotionInformation & motion, float centerX, float centerY, uint64_t now) const;
+
+	/*!
+	Predict where a target will be when a shot fired now arrives. See \getMoveAim.
+	*/
+	Aim getFireAim(const MotionDetector::MotionInformation & motion, float centerX, float centerY, uint64_t now) const;
+};
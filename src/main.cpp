@@ -3,18 +3,33 @@
 #include <memory>
 
 #include "consolestyle.h"
+#include "eventnotifier.h"
+#include "reactor.h"
 #include "motiondetector.h"
 #include "missilecontrol.h"
 #include "keyboard.h"
 #include "framebuffer.h"
+#include "targetselector.h"
+#include "launcherdispatcher.h"
+#include "leadpredictor.h"
+#include "servocontroller.h"
+#include "timestamp.h"
 
 
 const char * OPENCV_WINDOW_NAME = "Frame";
+const char * CALIBRATION_FILE = "launcher.yml";
 std::string inputDevice;
-int cameraIndex = 0;
-std::string videoFile = "";
+bool grabKeyboard = false;
+std::vector<int> cameraIndices;
+std::vector<std::string> videoFiles;
 bool drawToFramebuffer = false;
 bool drawUsingOpenCV = false;
+bool runBenchmark = false;
+bool runCalibration = false;
+std::vector<std::string> launcherSources;
+uint32_t threadCount = 0;
+uint32_t fireDelayMs = 500;
+BackgroundEngine::Type engineType = BackgroundEngine::TYPE_RUNNING_AVERAGE;
 std::shared_ptr<Framebuffer> frameBuffer;
 cv::Mat frame;
 cv::Mat converted;
@@ -23,19 +38,36 @@ cv::Mat converted;
 void printUsage()
 {
     std::cout << "Command line options:" << std::endl;
-    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "-c <INDEX>" << ConsoleStyle() << " - Capture from INDEXth camera." << std::endl;
-    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "-f <FILE>" << ConsoleStyle() << " - Capture from video FILE." << std::endl;
+    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "-c <INDEX>" << ConsoleStyle() << " - Capture from INDEXth camera. Can be given multiple times." << std::endl;
+    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "-f <FILE>" << ConsoleStyle() << " - Capture from video FILE. Raw 320x240 camera dumps need the extension .yuyv, .grey, .nv12 or .i420. Can be given multiple times." << std::endl;
     std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "-df" << ConsoleStyle() << " - Display video frames in console framebuffer." << std::endl;
     std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "-do" << ConsoleStyle() << " - Display video frames using OpenCV." << std::endl;
     std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "-k <DEVICE>" << ConsoleStyle() << " - Use keyboard DEVICE e.g. \"/dev/input/event3\"" << std::endl;
+    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "-kg" << ConsoleStyle() << " - Grab keyboard, so key presses don't reach the console or other programs." << std::endl;
+    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "-j <THREADS>" << ConsoleStyle() << " - Run motion detection on THREADS threads. Default is one per CPU core." << std::endl;
+    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "-l <MS>" << ConsoleStyle() << " - Time from the fire command reaching the launcher till the projectile hits in MS for aiming ahead of moving targets. Default is 500." << std::endl;
+    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "-e <ENGINE>" << ConsoleStyle() << " - Background model ENGINE: \"average\" (default), \"mixture\", \"vibe\" or \"difference\"." << std::endl;
+    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "-cal" << ConsoleStyle() << " - Measure launcher movement per pulse with the camera of each launcher and store it in \"" << CALIBRATION_FILE << "\", \"launcher1.yml\" etc." << std::endl;
+    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "-la <LAUNCHER>:<SOURCE>" << ConsoleStyle() << " - LAUNCHER, an index or USB BUS-PORT, aims at targets of SOURCE, counting cameras first, then files. Can be given multiple times. Default is source i on launcher i modulo launcher count." << std::endl;
+    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "-b" << ConsoleStyle() << " - Benchmark motion detection on 1 to THREADS threads, compare background engines and quit." << std::endl;
     std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "? or --help" << ConsoleStyle() << " - Show this help." << std::endl;
     std::cout << "Available keys:" << std::endl;
     std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "Cursor keys" << ConsoleStyle() << " - Control launcher." << std::endl;
+    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "TAB" << ConsoleStyle() << " - Switch manually controlled launcher." << std::endl;
     std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "SPACE" << ConsoleStyle() << " - Stop launcher." << std::endl;
     std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "ENTER" << ConsoleStyle() << " - Fire launcher." << std::endl;
-    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "1" << ConsoleStyle() << " - Arm/unarm launcher." << std::endl;
+    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "1" << ConsoleStyle() << " - Arm/unarm launchers." << std::endl;
+    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "v" << ConsoleStyle() << " - Steer launchers towards targets on/off." << std::endl;
+    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "g" << ConsoleStyle() << " - Switch background engine." << std::endl;
     std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "a" << ConsoleStyle() << " - Adaptive/fixed binary threshold." << std::endl;
     std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "d/f" << ConsoleStyle() << " - De-/increase binary threshold." << std::endl;
+    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "b" << ConsoleStyle() << " - Float/fixed point background." << std::endl;
+    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "s" << ConsoleStyle() << " - Selective background update on/off." << std::endl;
+    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "p" << ConsoleStyle() << " - Detect at full, 1/2 or 1/4 resolution." << std::endl;
+    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "t" << ConsoleStyle() << " - Process changed tiles only on/off." << std::endl;
+    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "e" << ConsoleStyle() << " - Camera motion compensation on/off." << std::endl;
+    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "o" << ConsoleStyle() << " - Panoramic background mosaic on/off. Needs camera motion compensation." << std::endl;
+    std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "m" << ConsoleStyle() << " - Show frame and memory statistics per source." << std::endl;
     std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "ESC" << ConsoleStyle() << " - Quit program." << std::endl;
 }
 
@@ -62,11 +94,16 @@ bool parseCommandLine(int argc, char * argv[])
                 return false;
             }
         }
+        else if (argument == "-kg") {
+            grabKeyboard = true;
+        }
         else if (argument == "-c") {
             //read camera index from next argument
             if (++i < argc) {
                 std::stringstream ss(argv[i]);
+                int cameraIndex = 0;
                 ss >> cameraIndex;
+                cameraIndices.push_back(cameraIndex);
             }
             else {
                 std::cout << ConsoleStyle(ConsoleStyle::RED) << "Option -c needs an argument!" << ConsoleStyle() << std::endl;
@@ -77,7 +114,7 @@ bool parseCommandLine(int argc, char * argv[])
         else if (argument == "-f") {
             //read video file from next argument
             if (++i < argc) {
-                videoFile = argv[i];
+                videoFiles.push_back(argv[i]);
             }
             else {
                 std::cout << ConsoleStyle(ConsoleStyle::RED) << "Option -f needs an argument!" << ConsoleStyle() << std::endl;
@@ -85,6 +122,60 @@ bool parseCommandLine(int argc, char * argv[])
                 return false;
             }
         }
+        else if (argument == "-j") {
+            //read detection thread count from next argument
+            if (++i < argc) {
+                std::stringstream ss(argv[i]);
+                ss >> threadCount;
+            }
+            else {
+                std::cout << ConsoleStyle(ConsoleStyle::RED) << "Option -j needs an argument!" << ConsoleStyle() << std::endl;
+                printUsage();
+                return false;
+            }
+        }
+        else if (argument == "-l") {
+            //read fire delay from next argument
+            if (++i < argc) {
+                std::stringstream ss(argv[i]);
+                ss >> fireDelayMs;
+            }
+            else {
+                std::cout << ConsoleStyle(ConsoleStyle::RED) << "Option -l needs an argument!" << ConsoleStyle() << std::endl;
+                printUsage();
+                return false;
+            }
+        }
+        else if (argument == "-e") {
+            //read background engine from next argument
+            if (++i >= argc) {
+                std::cout << ConsoleStyle(ConsoleStyle::RED) << "Option -e needs an argument!" << ConsoleStyle() << std::endl;
+                printUsage();
+                return false;
+            }
+            if (!BackgroundEngine::getTypeFromName(argv[i], engineType)) {
+                std::cout << ConsoleStyle(ConsoleStyle::RED) << "Error: Unknown background engine \"" << argv[i] << "\"!" << ConsoleStyle() << std::endl;
+                printUsage();
+                return false;
+            }
+        }
+        else if (argument == "-b") {
+            runBenchmark = true;
+        }
+        else if (argument == "-cal") {
+            runCalibration = true;
+        }
+        else if (argument == "-la") {
+            //read launcher and source from next argument. the launcher is looked up when the launchers were found
+            if (++i < argc) {
+                launcherSources.push_back(argv[i]);
+            }
+            else {
+                std::cout << ConsoleStyle(ConsoleStyle::RED) << "Option -la needs an argument!" << ConsoleStyle() << std::endl;
+                printUsage();
+                return false;
+            }
+        }
         else if (argument == "-df") {
             //enable drawing of camera/video frames to console framebuffer
             if (drawUsingOpenCV) {
@@ -109,6 +200,57 @@ bool parseCommandLine(int argc, char * argv[])
     return true;
 }
 
+//launcher 0 keeps the file name of single launcher setups
+std::string getCalibrationFile(uint32_t launcher)
+{
+    if (launcher == 0) {
+        return CALIBRATION_FILE;
+    }
+    std::stringstream ss;
+    ss << "launcher" << launcher << ".yml";
+    return ss.str();
+}
+
+//called by the analysis threads of all sources. wakes up the main loop
+void notifyResult(void * context, uint64_t sequence, const MotionDetector::MotionInformation & motion)
+{
+    reinterpret_cast<EventNotifier *>(context)->notify();
+}
+
+void readKeyboard(void * context, uint32_t events)
+{
+    reinterpret_cast<Keyboard *>(context)->readEvents();
+}
+
+void clearNotifier(void * context, uint32_t events)
+{
+    reinterpret_cast<EventNotifier *>(context)->wait(0);
+}
+
+void benchmarkDetection()
+{
+    //time the detection chain with an increasing number of threads to show how it scales
+    const uint32_t maxThreads = threadCount == 0 ? WorkerPool::getCpuCount() : threadCount;
+    double singleThreadMs = 0.0;
+    for (uint32_t threads = 1; threads <= maxThreads; ++threads) {
+        MotionDetector motionDetector;
+        motionDetector.setThreadCount(threads);
+        const double miliseconds = motionDetector.benchmark(640, 480, 200);
+        if (threads == 1) {
+            singleThreadMs = miliseconds;
+        }
+        std::cout << "640x480, " << threads << " thread(s): " << miliseconds << "ms/frame, speedup " << singleThreadMs / miliseconds << "x." << std::endl;
+    }
+    //compare the background engines on all threads
+    for (int type = 0; type < BackgroundEngine::TYPE_COUNT; ++type) {
+        MotionDetector motionDetector;
+        motionDetector.setThreadCount(maxThreads);
+        motionDetector.setBackgroundEngine((BackgroundEngine::Type)type);
+        const double miliseconds = motionDetector.benchmark(640, 480, 200);
+        std::cout << "640x480, " << BackgroundEngine::getTypeName((BackgroundEngine::Type)type) << " engine: " << miliseconds << "ms/frame, " << motionDetector.getStatistics().memoryBytes / 1024 << "KiB memory." << std::endl;
+    }
+}
+
 int main(int argc, char * argv[])
 {
     std::cout << ConsoleStyle(ConsoleStyle::CYAN) << "MeeZeeMissile v0.8.2 - Motion detection and USB launcher control." << ConsoleStyle() << std::endl;
@@ -116,6 +258,10 @@ int main(int argc, char * argv[])
     if (!parseCommandLine(argc, argv)) {
         return -1;
     }
+    if (runBenchmark) {
+        benchmarkDetection();
+        return 0;
+    }
 
     //check for proper priviliges
     if (geteuid() != 0) {
@@ -124,24 +270,47 @@ int main(int argc, char * argv[])
     }
     
     //initialize interfaces
-    Keyboard keyboard(inputDevice);
+    Keyboard keyboard(inputDevice, grabKeyboard);
     if (!keyboard.isAvailable()) {
         std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to initialize keyboard interface!" << ConsoleStyle() << std::endl;
         return -3;
     }
-    MotionDetector motionDetector;
-    if (videoFile.empty() && cameraIndex >= 0) {
-        if (!motionDetector.openCamera(cameraIndex) || !motionDetector.isAvailable()) {
-            std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to initialize motion detector!" << ConsoleStyle() << std::endl;
+    //all sources share one worker pool, so the cores are balanced between them
+    if (cameraIndices.empty() && videoFiles.empty()) {
+        cameraIndices.push_back(0);
+    }
+    std::shared_ptr<WorkerPool> workerPool = std::make_shared<WorkerPool>(threadCount);
+    //the main loop sleeps till any source has a result. created before the sources, so it outlives their analysis threads
+    EventNotifier resultNotifier;
+    std::vector<std::shared_ptr<MotionDetector>> motionDetectors;
+    for (auto cIt = cameraIndices.cbegin(); cIt != cameraIndices.cend(); ++cIt) {
+        std::shared_ptr<MotionDetector> motionDetector = std::make_shared<MotionDetector>();
+        motionDetector->setWorkerPool(workerPool);
+        motionDetector->setBackgroundEngine(engineType);
+        if (!motionDetector->openCamera(*cIt) || !motionDetector->isAvailable()) {
+            std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to initialize motion detector for camera " << *cIt << "!" << ConsoleStyle() << std::endl;
             return -4;
         }
+        motionDetector->subscribe(notifyResult, &resultNotifier);
+        motionDetectors.push_back(motionDetector);
     }
-    else if (!videoFile.empty()) {
-        if (!motionDetector.openVideo(videoFile) || !motionDetector.isAvailable()) {
-            std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to initialize motion detector!" << ConsoleStyle() << std::endl;
+    for (auto fIt = videoFiles.cbegin(); fIt != videoFiles.cend(); ++fIt) {
+        std::shared_ptr<MotionDetector> motionDetector = std::make_shared<MotionDetector>();
+        motionDetector->setWorkerPool(workerPool);
+        motionDetector->setBackgroundEngine(engineType);
+        if (!motionDetector->openVideo(*fIt) || !motionDetector->isAvailable()) {
+            std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to initialize motion detector for \"" << *fIt << "\"!" << ConsoleStyle() << std::endl;
             return -4;
         }
+        motionDetector->subscribe(notifyResult, &resultNotifier);
+        motionDetectors.push_back(motionDetector);
     }
+    //detection settings are the same for all sources, so read them from the first one
+    MotionDetector & firstDetector = *motionDetectors.front();
+    TargetSelector targetSelector(motionDetectors.size());
+    LeadPredictor leadPredictor(fireDelayMs * 1000);
+    bool autoAim = false;
+    uint32_t displaySource = 0;
     //if the user wants to draw to framebuffer, create one
     if (drawToFramebuffer) {
         frameBuffer = std::make_shared<Framebuffer>();
@@ -159,61 +328,274 @@ int main(int argc, char * argv[])
 		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to initialize missile control!" << ConsoleStyle() << std::endl;
 		return -6;
 	}
+	//every launcher engages the targets of the sources it aims at, so several targets are engaged at once
+	const uint32_t launcherCount = missileControl.getLauncherCount();
+	LauncherDispatcher dispatcher(launcherCount, motionDetectors.size());
+	if (!launcherSources.empty()) {
+	    dispatcher.clearSources();
+	    for (auto lsIt = launcherSources.cbegin(); lsIt != launcherSources.cend(); ++lsIt) {
+	        const size_t separator = lsIt->rfind(':');
+	        const int32_t launcher = separator == std::string::npos ? -1 : missileControl.findLauncher(lsIt->substr(0, separator));
+	        std::stringstream ss(separator == std::string::npos ? "" : lsIt->substr(separator + 1));
+	        uint32_t source = 0;
+	        if (launcher < 0 || !(ss >> source) || source >= motionDetectors.size()) {
+	            std::cout << ConsoleStyle(ConsoleStyle::RED) << "No launcher or source for \"" << *lsIt << "\"!" << ConsoleStyle() << std::endl;
+	            return -6;
+	        }
+	        dispatcher.setSource(launcher, source);
+	    }
+	}
+	std::vector<ServoController> servoControllers(launcherCount);
+	for (uint32_t launcher = 0; launcher < launcherCount; ++launcher) {
+	    MissileControl::LauncherInfo info;
+	    missileControl.getLauncherInfo(launcher, info);
+	    std::cout << "Launcher " << launcher << ": " << info.description << " on USB " << (int)info.busNumber << "-" << (int)info.portNumber << ", sources";
+	    //the camera riding on the launcher is the first source it aims at
+	    int32_t cameraSource = -1;
+	    for (uint32_t source = 0; source < motionDetectors.size(); ++source) {
+	        if (dispatcher.canEngage(launcher, source)) {
+	            std::cout << " " << source;
+	            cameraSource = cameraSource < 0 ? source : cameraSource;
+	        }
+	    }
+	    std::cout << "." << std::endl;
+	    //measure or load how far the launcher moves per pulse, so pixel errors can be corrected with one pulse
+	    LauncherCalibration calibration;
+	    if (runCalibration && cameraSource >= 0) {
+	        if (calibration.calibrate(*motionDetectors[cameraSource], missileControl, launcher)) {
+	            calibration.save(getCalibrationFile(launcher));
+	        }
+	    }
+	    else {
+	        calibration.load(getCalibrationFile(launcher));
+	    }
+	    if (calibration.isValid()) {
+	        servoControllers[launcher].setCalibration(calibration);
+	        dispatcher.setCalibration(launcher, calibration);
+	        std::cout << ConsoleStyle(ConsoleStyle::GREEN) << "Using calibration of launcher " << launcher << "." << ConsoleStyle() << std::endl;
+	    }
+	}
+	uint32_t manualLauncher = 0;
+	std::vector<TargetSelector::Target> targets;
+	std::vector<LauncherDispatcher::Target> dispatchTargets;
+	std::vector<LauncherDispatcher::Assignment> assignments;
+
+	//the main loop sleeps till a key event or a result arrives, so both are handled right away
+	Reactor reactor;
+	if (!reactor.isAvailable()
+		|| !reactor.add(keyboard.getDescriptor(), EPOLLIN, readKeyboard, &keyboard)
+		|| !reactor.add(resultNotifier.getDescriptor(), EPOLLIN, clearNotifier, &resultNotifier)) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to set up event loop!" << ConsoleStyle() << std::endl;
+		return -7;
+	}
 
     //start detection and control loop
-	while (keyboard.isAvailable()) { // && motionDetector.isAvailable())
-		if (keyboard.keyWasPressed(1)) {
+	while (keyboard.isAvailable()) {
+		if (reactor.runOnce(-1) < 0) {
+			std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to wait for events!" << ConsoleStyle() << std::endl;
 			break;
 		}
-		else if (keyboard.keyWasPressed(2)) {
-		    missileControl.setArmed(!missileControl.isArmed());
-		    if (missileControl.isArmed())
-		        std::cout << "Launcher armed!" << std::endl;
-		    else
-		        std::cout << "Launcher unarmed!" << std::endl;
-		}
-		else if (keyboard.keyWasPressed(30)) {
-		    motionDetector.setUseAdaptiveThreshold(!motionDetector.getUseAdaptiveThreshold());
-		    if (motionDetector.getUseAdaptiveThreshold())
-		        std::cout << "Using adaptive threshold." << std::endl;
-		    else
-		        std::cout << "Using fixed threshold of " << motionDetector.getBinaryThreshold() << "." << std::endl;
-		}
-		else if (keyboard.keyWasPressed(32) && motionDetector.getBinaryThreshold() >= 5.0) {
-		    motionDetector.setBinaryThreshold(motionDetector.getBinaryThreshold() - 5.0);
-		    std::cout << "Binary threshold: " << motionDetector.getBinaryThreshold() << "." << std::endl;
-		}
-		else if (keyboard.keyWasPressed(33) && motionDetector.getBinaryThreshold() <= 250.0) {
-		    motionDetector.setBinaryThreshold(motionDetector.getBinaryThreshold() + 5.0);
-		    std::cout << "Binary threshold: " << motionDetector.getBinaryThreshold() << "." << std::endl;
-		}
-		else if (keyboard.keyWasPressed(105)) {
-		    missileControl.executeCommand(MissileControl::LauncherCommand::LEFT, 250);
-		}
-		else if (keyboard.keyWasPressed(106)) {
-		    missileControl.executeCommand(MissileControl::LauncherCommand::RIGHT, 250);
+		//handle the key events in the order they happened. releases need no handling
+		bool quit = false;
+		Keyboard::KeyEvent keyEvent;
+		while (!quit && keyboard.getKeyEvent(keyEvent)) {
+			if (keyEvent.value == 0) {
+				continue;
+			}
+			if (keyEvent.code == 1) {
+				quit = true;
+			}
+			else if (keyEvent.code == 2) {
+			    const bool arm = !missileControl.isArmed(0);
+			    for (uint32_t i = 0; i < launcherCount; ++i) {
+			        missileControl.setArmed(i, arm);
+			    }
+			    if (arm)
+			        std::cout << "Launchers armed!" << std::endl;
+			    else
+			        std::cout << "Launchers unarmed!" << std::endl;
+			}
+			else if (keyEvent.code == 15) {
+			    manualLauncher = (manualLauncher + 1) % launcherCount;
+			    std::cout << "Manual control of launcher " << manualLauncher << "." << std::endl;
+			}
+			else if (keyEvent.code == 47) {
+			    autoAim = !autoAim;
+			    for (auto scIt = servoControllers.begin(); scIt != servoControllers.end(); ++scIt) {
+			        scIt->reset();
+			    }
+			    if (autoAim)
+			        std::cout << "Steering launcher towards target." << std::endl;
+			    else
+			        std::cout << "Manual launcher control." << std::endl;
+			}
+			else if (keyEvent.code == 34) {
+			    const BackgroundEngine::Type type = (BackgroundEngine::Type)((firstDetector.getBackgroundEngine() + 1) % BackgroundEngine::TYPE_COUNT);
+			    for (auto dIt = motionDetectors.begin(); dIt != motionDetectors.end(); ++dIt) {
+			        (*dIt)->setBackgroundEngine(type);
+			    }
+			    std::cout << "Using " << BackgroundEngine::getTypeName(type) << " background engine." << std::endl;
+			}
+			else if (keyEvent.code == 30) {
+			    const bool enable = !firstDetector.getUseAdaptiveThreshold();
+			    for (auto dIt = motionDetectors.begin(); dIt != motionDetectors.end(); ++dIt) {
+			        (*dIt)->setUseAdaptiveThreshold(enable);
+			    }
+			    if (enable)
+			        std::cout << "Using adaptive threshold." << std::endl;
+			    else
+			        std::cout << "Using fixed threshold of " << firstDetector.getBinaryThreshold() << "." << std::endl;
+			}
+			else if (keyEvent.code == 32 && firstDetector.getBinaryThreshold() >= 5.0) {
+			    const double threshold = firstDetector.getBinaryThreshold() - 5.0;
+			    for (auto dIt = motionDetectors.begin(); dIt != motionDetectors.end(); ++dIt) {
+			        (*dIt)->setBinaryThreshold(threshold);
+			    }
+			    std::cout << "Binary threshold: " << threshold << "." << std::endl;
+			}
+			else if (keyEvent.code == 33 && firstDetector.getBinaryThreshold() <= 250.0) {
+			    const double threshold = firstDetector.getBinaryThreshold() + 5.0;
+			    for (auto dIt = motionDetectors.begin(); dIt != motionDetectors.end(); ++dIt) {
+			        (*dIt)->setBinaryThreshold(threshold);
+			    }
+			    std::cout << "Binary threshold: " << threshold << "." << std::endl;
+			}
+			else if (keyEvent.code == 48) {
+			    const bool enable = !firstDetector.getUseFixedPointBackground();
+			    for (auto dIt = motionDetectors.begin(); dIt != motionDetectors.end(); ++dIt) {
+			        (*dIt)->setUseFixedPointBackground(enable);
+			    }
+			    if (enable)
+			        std::cout << "Using fixed point background." << std::endl;
+			    else
+			        std::cout << "Using float background." << std::endl;
+			}
+			else if (keyEvent.code == 31) {
+			    const bool enable = !firstDetector.getUseSelectiveUpdate();
+			    for (auto dIt = motionDetectors.begin(); dIt != motionDetectors.end(); ++dIt) {
+			        (*dIt)->setUseSelectiveUpdate(enable);
+			    }
+			    if (enable)
+			        std::cout << "Not updating background of foreground pixels." << std::endl;
+			    else
+			        std::cout << "Updating background of all pixels." << std::endl;
+			}
+			else if (keyEvent.code == 25) {
+			    const uint32_t level = (firstDetector.getPyramidLevel() + 1) % 3;
+			    for (auto dIt = motionDetectors.begin(); dIt != motionDetectors.end(); ++dIt) {
+			        (*dIt)->setPyramidLevel(level);
+			    }
+			    std::cout << "Detecting at 1/" << (1 << level) << " resolution." << std::endl;
+			}
+			else if (keyEvent.code == 20) {
+			    const bool enable = !firstDetector.getUseTiles();
+			    for (auto dIt = motionDetectors.begin(); dIt != motionDetectors.end(); ++dIt) {
+			        (*dIt)->setUseTiles(enable);
+			    }
+			    if (enable)
+			        std::cout << "Processing changed tiles only." << std::endl;
+			    else
+			        std::cout << "Processing whole frame." << std::endl;
+			}
+			else if (keyEvent.code == 18) {
+			    const bool enable = !firstDetector.getUseEgoMotionCompensation();
+			    for (auto dIt = motionDetectors.begin(); dIt != motionDetectors.end(); ++dIt) {
+			        (*dIt)->setUseEgoMotionCompensation(enable);
+			    }
+			    if (enable)
+			        std::cout << "Compensating camera motion." << std::endl;
+			    else
+			        std::cout << "Not compensating camera motion." << std::endl;
+			}
+			else if (keyEvent.code == 24) {
+			    const bool enable = !firstDetector.getUseBackgroundMosaic();
+			    for (auto dIt = motionDetectors.begin(); dIt != motionDetectors.end(); ++dIt) {
+			        (*dIt)->setUseBackgroundMosaic(enable);
+			    }
+			    if (enable)
+			        std::cout << "Keeping background mosaic." << std::endl;
+			    else
+			        std::cout << "Not keeping background mosaic." << std::endl;
+			}
+			else if (keyEvent.code == 50) {
+			    for (uint32_t i = 0; i < motionDetectors.size(); ++i) {
+			        const MotionDetector::Statistics statistics = motionDetectors[i]->getStatistics();
+			        std::cout << "Source " << i << ": " << statistics.capturedFrames << " frames captured, " << statistics.analyzedFrames << " analyzed, " << statistics.droppedFrames << " dropped, ";
+			        std::cout << statistics.lastLatencyUs / 1000.0 << "ms latency, " << statistics.memoryBytes / 1024 << "KiB memory";
+			        if (firstDetector.getUseEgoMotionCompensation()) {
+			            std::cout << ", camera at " << statistics.cameraX << "," << statistics.cameraY << ", " << statistics.mosaicTiles << " mosaic tiles";
+			        }
+			        if (AllocationCounter::isAvailable()) {
+			            std::cout << ", " << statistics.allocations << " allocations after warm-up";
+			        }
+			        std::cout << "." << std::endl;
+			    }
+			    for (uint32_t i = 0; i < launcherCount; ++i) {
+			        uint64_t maxTransferLatency = 0;
+			        const uint64_t transferLatency = missileControl.getTransferLatency(i, &maxTransferLatency);
+			        std::cout << "Launcher " << i << " command latency " << missileControl.getCommandLatency(i) / 1000.0 << "ms, USB transfers " << transferLatency / 1000.0 << "ms, at most " << maxTransferLatency / 1000.0 << "ms." << std::endl;
+			        MissileControl::SegmentReport segment;
+			        if (missileControl.getLastSegment(i, segment)) {
+			            std::cout << "Launcher " << i << " last segment " << MissileControl::getCommandName(segment.command);
+			            if (segment.durationMs != INT_MIN) {
+			                std::cout << " planned " << segment.durationMs << "ms,";
+			            }
+			            std::cout << " ran " << (segment.stopTimestamp - segment.startTimestamp) / 1000.0 << "ms, started " << (segment.startTimestamp - segment.issueTimestamp) / 1000.0 << "ms after issue." << std::endl;
+			        }
+			    }
+			}
+			else if (keyEvent.code == 105) {
+			    missileControl.executeCommand(manualLauncher, MissileControl::LauncherCommand::LEFT, 250, true);
+			    servoControllers[manualLauncher].reset();
+			}
+			else if (keyEvent.code == 106) {
+			    missileControl.executeCommand(manualLauncher, MissileControl::LauncherCommand::RIGHT, 250, true);
+			    servoControllers[manualLauncher].reset();
+			}
+			else if (keyEvent.code == 103) {
+			    missileControl.executeCommand(manualLauncher, MissileControl::LauncherCommand::UP, 250, true);
+			    servoControllers[manualLauncher].reset();
+			}
+			else if (keyEvent.code == 108) {
+			    missileControl.executeCommand(manualLauncher, MissileControl::LauncherCommand::DOWN, 250, true);
+			    servoControllers[manualLauncher].reset();
+			}
+			else if (keyEvent.code == 57) {
+			    missileControl.executeCommand(manualLauncher, MissileControl::LauncherCommand::STOP);
+			}
+			else if (keyEvent.code == 28) {
+			    missileControl.executeCommand(manualLauncher, MissileControl::LauncherCommand::FIRE);
+			}
 		}
-		else if (keyboard.keyWasPressed(103)) {
-		    missileControl.executeCommand(MissileControl::LauncherCommand::UP, 250);
-		}
-		else if (keyboard.keyWasPressed(108)) {
-		    missileControl.executeCommand(MissileControl::LauncherCommand::DOWN, 250);
-		}
-		else if (keyboard.keyWasPressed(57)) {
-		    missileControl.executeCommand(MissileControl::LauncherCommand::STOP);
-		}
-		else if (keyboard.keyWasPressed(28)) {
-		    missileControl.executeCommand(MissileControl::LauncherCommand::FIRE);
+		if (quit) {
+			break;
 		}
-		//clear list of pressed keys
-		keyboard.clearPressedKeys();
+        //collect motion from all sources and pick the targets the launchers engage
+        bool motionChanged = false;
+        for (uint32_t i = 0; i < motionDetectors.size(); ++i) {
+            MotionDetector::MotionInformation motionInfo;
+            if (motionDetectors[i]->getLastMotion(motionInfo)) {
+                targetSelector.update(i, motionInfo);
+                motionChanged = true;
+            }
+        }
+        const bool targetSelected = targetSelector.selectAll(getTimestampUs(), targets);
+        if (targetSelected) {
+            //show the source the most important target is in
+            displaySource = targets.front().source;
+        }
 		//draw image to framebuffer or OpenCV window
+        MotionDetector & motionDetector = *motionDetectors[displaySource];
         if (drawToFramebuffer && frameBuffer->isAvailable()) {
             if (motionDetector.getLastFrame(frame, true) && !frame.empty()) {
-                //convert frame to screen depth
-                MotionDetector::convertFrame(converted, frame, CV_8U);
+                //convert frame to screen depth. BGR frames already have it, so don't copy them
+                const cv::Mat * screenFrame = &frame;
+                if (frame.depth() != CV_8U) {
+                    MotionDetector::convertFrame(converted, frame, CV_8U);
+                    screenFrame = &converted;
+                }
                 //draw frame to screen
-                frameBuffer->drawBuffer(frameBuffer->getWidth() - converted.size().width, 0, converted.ptr<const unsigned char>(), converted.size().width, converted.size().height, 24);
+                frameBuffer->drawBuffer(frameBuffer->getWidth() - screenFrame->size().width, 0, screenFrame->ptr<const unsigned char>(), screenFrame->size().width, screenFrame->size().height, 24);
             }
         }
         if (drawUsingOpenCV) {
@@ -222,15 +604,53 @@ int main(int argc, char * argv[])
                 cv::waitKey(5);
             }
         }
-        //check if the missile launcher is directed at the center of the motion
-        MotionDetector::MotionInformation motionInfo;
-        if (motionDetector.getLastMotion(motionInfo) && motionInfo.motionDetected) {
-            if (motionInfo.distance2 < (8*8)) {
-                missileControl.executeCommand(MissileControl::LauncherCommand::FIRE);
-                std::cout << "Motion close to target. Shooting!" << std::endl;
+        if (motionChanged && targetSelected) {
+            const uint64_t now = getTimestampUs();
+            //hand every target to the launcher that is on it first. the latency of each launcher is part of that time,
+            //so the offsets are predicted without it
+            leadPredictor.setCommandLatency(0);
+            dispatchTargets.clear();
+            for (auto tIt = targets.cbegin(); tIt != targets.cend(); ++tIt) {
+                const MotionDetector & targetDetector = *motionDetectors[tIt->source];
+                const LeadPredictor::Aim aim = leadPredictor.getMoveAim(tIt->motion, targetDetector.getWidth() / 2.0f, targetDetector.getHeight() / 2.0f, now);
+                const LauncherDispatcher::Target dispatchTarget = {tIt->source, aim.dx, aim.dy};
+                dispatchTargets.push_back(dispatchTarget);
+            }
+            for (uint32_t i = 0; i < launcherCount; ++i) {
+                dispatcher.setState(i, missileControl.getPlanEnd(i), missileControl.getCommandLatency(i));
+            }
+            dispatcher.assign(dispatchTargets, now, assignments);
+            for (auto aIt = assignments.cbegin(); aIt != assignments.cend(); ++aIt) {
+                const uint32_t launcher = aIt->launcher;
+                const TargetSelector::Target & target = targets[aIt->target];
+                ServoController & servoController = servoControllers[launcher];
+                if (aIt->changed) {
+                    servoController.reset();
+                }
+                leadPredictor.setCommandLatency(missileControl.getCommandLatency(launcher));
+                const MotionDetector & targetDetector = *motionDetectors[target.source];
+                const float centerX = targetDetector.getWidth() / 2.0f;
+                const float centerY = targetDetector.getHeight() / 2.0f;
+                //steer towards where the target will be when the command reaches the launcher
+                bool moving = false;
+                if (autoAim) {
+                    const LeadPredictor::Aim moveAim = leadPredictor.getMoveAim(target.motion, centerX, centerY, now);
+                    const ServoController::Command command = servoController.update(moveAim.dx, moveAim.dy, now);
+                    if (command.command != MissileControl::LauncherCommand::NONE) {
+                        //a new correction replaces whatever the launcher is doing
+                        missileControl.executeCommand(launcher, command.command, command.durationMs, true);
+                        moving = true;
+                    }
+                }
+                //check if the missile launcher is directed at where the selected target will be when the shot arrives.
+                //the launcher executes one command at a time, so don't replace a movement that was just issued
+                const LeadPredictor::Aim aim = leadPredictor.getFireAim(target.motion, centerX, centerY, now);
+                if (!moving && aim.distance2 < (8*8)) {
+                    missileControl.executeCommand(launcher, MissileControl::LauncherCommand::FIRE);
+                    std::cout << "Launcher " << launcher << ": motion close to target in source " << target.source << " " << aim.leadUs / 1000 << "ms ahead. Shooting!" << std::endl;
+                }
             }
         }
-        //usleep(1 * 1000);
 	}
 
 	return 0;
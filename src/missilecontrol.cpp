@@ -2,9 +2,12 @@
 
 #include <iostream>
 #include <cstring>
+#include <sstream>
 #include <unistd.h>
+#include <sys/time.h>
 
 #include "consolestyle.h"
+#include "timestamp.h"
 
 
 //Byte sequence to send to the device. The first two init commands are for the M&S launcher only
@@ -27,14 +30,28 @@ static uint8_t * sequences[] = {nullptr, SEQUENCE_STOP,
 								SEQUENCE_LEFTUP, SEQUENCE_RIGHTUP, SEQUENCE_LEFTDOWN, SEQUENCE_RIGHTDOWN, 
 								SEQUENCE_FIRE};
 
-const uint32_t MissileControl::controlInterval = 20;
 const uint32_t MissileControl::usbControlTimeout = 500;
 
 
+MissileControl::Launcher::Launcher(MissileControl * owner, const LauncherInfo & launcherInfo, libusb_device_handle * handle)
+	: control(owner), info(launcherInfo), usbLauncher(handle),
+	  planReplaced(false), idle(true), planEndTimestamp(0), segmentStarting(false), segmentSequence(0), lastCommand(NONE),
+	  commandLatencyUs(0), transferLatencyUs(0), maxTransferLatencyUs(0), armed(true)
+{
+	const SegmentReport noSegment = {NONE, INT_MIN, 0, 0, 0};
+	lastSegment = noSegment;
+	nextSegment = noSegment;
+	startingSegment = noSegment;
+	runningSegment = noSegment;
+	for (uint32_t i = 0; i < TransferCount; ++i) {
+		transfers[i].launcher = this;
+		transfers[i].transfer = nullptr;
+		transfers[i].busy = false;
+	}
+}
+
 MissileControl::MissileControl()
-	: thread(0), mutex(PTHREAD_MUTEX_INITIALIZER), active(false), 
-	  usbContext(nullptr), usbLauncher(nullptr),
-	  currentCommand(NONE), currentRemainingTime(INT_MIN), armed(true)
+	: thread(0), mutex(PTHREAD_MUTEX_INITIALIZER), active(false), usbContext(nullptr)
 {
 	std::cout << "Initializing missile control..." << std::endl;
 
@@ -63,7 +80,7 @@ MissileControl::MissileControl()
     libusb_device * * devices;
     size_t deviceCount = libusb_get_device_list(usbContext, &devices);
     std::cout << "Found " << deviceCount << " USB devices." << std::endl;
-    //iterate through USB devices looking for launcher
+    //iterate through USB devices looking for launchers. all of them are claimed
     for(int i = 0; i < deviceCount; i++)
     {
         //get ith device and try to get descriptor
@@ -80,198 +97,596 @@ MissileControl::MissileControl()
 			}
 		}
         if (slIt != supportedLaunchers.cend()) {
-            std::cout << slIt->description << " launcher found on Bus" << libusb_get_bus_number(device)
-                                           << ", Adress " << libusb_get_device_address(device)
+            std::cout << slIt->description << " launcher found on Bus " << (int)libusb_get_bus_number(device)
+                                           << ", Port " << (int)libusb_get_port_number(device)
+                                           << ", Adress " << (int)libusb_get_device_address(device)
                                            << ", Speed " << libusb_get_device_speed(device) << "." << std::endl;
-            //try to open device
-            if (errnum = libusb_open(device, &usbLauncher)) {
-                std::cout << ConsoleStyle(ConsoleStyle::RED) << "Unable to open device. Error: " << libusb_error_name(errnum) << "." << ConsoleStyle() << std::endl;
-                continue;
-            }
-            //check if the kernel driver uses the device interfaces 0/1
-            if (libusb_kernel_driver_active(usbLauncher, 0)) {
-                //if the kernel driver is active, try to detach it from the device
-                if (errnum = libusb_detach_kernel_driver(usbLauncher, 0)) {
-                    std::cout << ConsoleStyle(ConsoleStyle::RED) << "Unable to detach kernel driver form device interface 0. Error: " << libusb_error_name(errnum) << "." << ConsoleStyle() << std::endl;
-                    libusb_close(usbLauncher);
-                    usbLauncher = nullptr;
-                    continue;
-                }
-            }
-            if (libusb_kernel_driver_active(usbLauncher, 1)) {
-                //if the kernel driver is active, try to detach it from the device
-                if (errnum = libusb_detach_kernel_driver(usbLauncher, 1)) {
-                    std::cout << ConsoleStyle(ConsoleStyle::RED) << "Unable to detach kernel driver form device interface 1. Error: " << libusb_error_name(errnum) << "." << ConsoleStyle() << std::endl;
-                    libusb_close(usbLauncher);
-                    usbLauncher = nullptr;
-                    continue;
-                }
-            }
-            //set configuration
-            if (errnum = libusb_set_configuration(usbLauncher, 1)) {
-                std::cout << ConsoleStyle(ConsoleStyle::RED) << "Unable to set device configuration. Error: " << libusb_error_name(errnum) << "." << ConsoleStyle() << std::endl;
-                libusb_close(usbLauncher);
-                usbLauncher = nullptr;
-                continue;
-            }
-            //now claim interface 0
-            if (errnum = libusb_claim_interface(usbLauncher, 0)) {
-                std::cout << ConsoleStyle(ConsoleStyle::RED) << "Unable to claim device interface 0. Error: " << libusb_error_name(errnum) << "." << ConsoleStyle() << std::endl;
-                libusb_close(usbLauncher);
-                usbLauncher = nullptr;
+            libusb_device_handle * usbLauncher = claimDevice(device);
+            if (usbLauncher == nullptr) {
                 continue;
             }
-            //now claim interface 1
-            if (errnum = libusb_claim_interface(usbLauncher, 1)) {
-                std::cout << ConsoleStyle(ConsoleStyle::RED) << "Unable to claim device interface 1. Error: " << libusb_error_name(errnum) << "." << ConsoleStyle() << std::endl;
-                libusb_close(usbLauncher);
-                usbLauncher = nullptr;
-                continue;
-            }
-            
-            //libusb_set_altinterface(launcher, 0); needed?!
-
-			//worked. store model
-			launcherInfo = *slIt;
-
-			std::cout << ConsoleStyle(ConsoleStyle::GREEN) << "Missile control available." << ConsoleStyle() << std::endl;
-            break;
+			//worked. store model and address
+			LauncherInfo info = *slIt;
+			info.busNumber = libusb_get_bus_number(device);
+			info.portNumber = libusb_get_port_number(device);
+			launchers.push_back(std::make_shared<Launcher>(this, info, usbLauncher));
+			std::cout << ConsoleStyle(ConsoleStyle::GREEN) << "Missile control available for launcher " << launchers.size() - 1 << "." << ConsoleStyle() << std::endl;
         }
     }
     libusb_free_device_list(devices, 1);
 
-	//now if a launcher was found, create a thread for it
-	if (launcherInfo.model != LAUNCHER_UNKNOWN && usbLauncher != nullptr) {
+	//now if launchers were found, create one thread for all of them
+	if (!launchers.empty()) {
+		//the control thread sleeps till a command was issued, a segment has ended or libusb has USB events
+		bool eventsAvailable = reactor.isAvailable() && commandNotifier.isAvailable()
+			&& reactor.add(commandNotifier.getDescriptor(), EPOLLIN, &MissileControl::handleCommand, this);
+		for (auto lIt = launchers.cbegin(); eventsAvailable && lIt != launchers.cend(); ++lIt) {
+			Launcher & launcher = **lIt;
+			eventsAvailable = launcher.idleNotifier.isAvailable() && launcher.segmentTimer.isAvailable()
+				&& reactor.add(launcher.segmentTimer.getDescriptor(), EPOLLIN, &Launcher::handleSegmentDeadline, &launcher);
+			//allocate all transfers now, so sending commands never allocates
+			for (uint32_t i = 0; eventsAvailable && i < TransferCount; ++i) {
+				launcher.transfers[i].transfer = libusb_alloc_transfer(0);
+				eventsAvailable = launcher.transfers[i].transfer != nullptr;
+			}
+		}
+		if (eventsAvailable) {
+			//add the descriptors libusb has now and get notified about the ones it adds or removes later
+			const libusb_pollfd ** usbDescriptors = libusb_get_pollfds(usbContext);
+			if (usbDescriptors != nullptr) {
+				for (const libusb_pollfd ** udIt = usbDescriptors; *udIt != nullptr; ++udIt) {
+					addUsbDescriptor((*udIt)->fd, (*udIt)->events, this);
+				}
+				libusb_free_pollfds(usbDescriptors);
+			}
+			libusb_set_pollfd_notifiers(usbContext, &MissileControl::addUsbDescriptor, &MissileControl::removeUsbDescriptor, this);
+		}
 		active = true;
-		if (pthread_create(&thread, 0, &MissileControl::controlLoop, this) == 0) {
-			std::cout << ConsoleStyle(ConsoleStyle::GREEN) << "Started control thread." << ConsoleStyle() << std::endl;
+		if (eventsAvailable && pthread_create(&thread, 0, &MissileControl::controlLoop, this) == 0) {
+			std::cout << ConsoleStyle(ConsoleStyle::GREEN) << "Started control thread for " << launchers.size() << " launcher(s)." << ConsoleStyle() << std::endl;
 		}
 		else {
 			std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to start control thread!" << ConsoleStyle() << std::endl;
 			thread = 0;
 			active = false;
-			libusb_release_interface(usbLauncher, 0);
-            libusb_release_interface(usbLauncher, 1);
-			libusb_close(usbLauncher);
-            usbLauncher = nullptr;
+			libusb_set_pollfd_notifiers(usbContext, nullptr, nullptr, nullptr);
+			for (auto lIt = launchers.begin(); lIt != launchers.end(); ++lIt) {
+				(*lIt)->close();
+			}
+			launchers.clear();
 		}
 	}
 }
 
+libusb_device_handle * MissileControl::claimDevice(libusb_device * device)
+{
+    int errnum = 0;
+    libusb_device_handle * usbLauncher = nullptr;
+    //try to open device
+    if (errnum = libusb_open(device, &usbLauncher)) {
+        std::cout << ConsoleStyle(ConsoleStyle::RED) << "Unable to open device. Error: " << libusb_error_name(errnum) << "." << ConsoleStyle() << std::endl;
+        return nullptr;
+    }
+    //check if the kernel driver uses the device interfaces 0/1
+    if (libusb_kernel_driver_active(usbLauncher, 0)) {
+        //if the kernel driver is active, try to detach it from the device
+        if (errnum = libusb_detach_kernel_driver(usbLauncher, 0)) {
+            std::cout << ConsoleStyle(ConsoleStyle::RED) << "Unable to detach kernel driver form device interface 0. Error: " << libusb_error_name(errnum) << "." << ConsoleStyle() << std::endl;
+            libusb_close(usbLauncher);
+            return nullptr;
+        }
+    }
+    if (libusb_kernel_driver_active(usbLauncher, 1)) {
+        //if the kernel driver is active, try to detach it from the device
+        if (errnum = libusb_detach_kernel_driver(usbLauncher, 1)) {
+            std::cout << ConsoleStyle(ConsoleStyle::RED) << "Unable to detach kernel driver form device interface 1. Error: " << libusb_error_name(errnum) << "." << ConsoleStyle() << std::endl;
+            libusb_close(usbLauncher);
+            return nullptr;
+        }
+    }
+    //set configuration
+    if (errnum = libusb_set_configuration(usbLauncher, 1)) {
+        std::cout << ConsoleStyle(ConsoleStyle::RED) << "Unable to set device configuration. Error: " << libusb_error_name(errnum) << "." << ConsoleStyle() << std::endl;
+        libusb_close(usbLauncher);
+        return nullptr;
+    }
+    //now claim interface 0
+    if (errnum = libusb_claim_interface(usbLauncher, 0)) {
+        std::cout << ConsoleStyle(ConsoleStyle::RED) << "Unable to claim device interface 0. Error: " << libusb_error_name(errnum) << "." << ConsoleStyle() << std::endl;
+        libusb_close(usbLauncher);
+        return nullptr;
+    }
+    //now claim interface 1
+    if (errnum = libusb_claim_interface(usbLauncher, 1)) {
+        std::cout << ConsoleStyle(ConsoleStyle::RED) << "Unable to claim device interface 1. Error: " << libusb_error_name(errnum) << "." << ConsoleStyle() << std::endl;
+        libusb_close(usbLauncher);
+        return nullptr;
+    }
+    //libusb_set_altinterface(launcher, 0); needed?!
+    return usbLauncher;
+}
+
 void * MissileControl::controlLoop(void * obj)
 {
-    LauncherCommand lastCommand = NONE;
 	MissileControl * control = reinterpret_cast<MissileControl *>(obj);
-	//start thread loop
-	while (control != nullptr && control->active) {
-		//block/unblock mutex while reading/modifying command
+	//sleep till there is something to do instead of polling for commands
+	control->reactor.run();
+	return nullptr;
+}
+
+void MissileControl::handleCommand(void * obj, uint32_t events)
+{
+	MissileControl * control = reinterpret_cast<MissileControl *>(obj);
+	control->commandNotifier.wait(0);
+	//the notifier is shared, so look at the plans of all launchers
+	for (auto lIt = control->launchers.begin(); lIt != control->launchers.end(); ++lIt) {
+		(*lIt)->handlePlan();
+	}
+}
+
+void MissileControl::Launcher::handlePlan()
+{
+	pthread_mutex_lock(&control->mutex);
+	const bool replaced = planReplaced;
+	planReplaced = false;
+	pthread_mutex_unlock(&control->mutex);
+	if (replaced) {
+		//end the running segment now. a command still being transferred is superseded too
+		segmentTimer.cancel();
+		nextSegment.command = NONE;
+		segmentStarting = false;
+		++segmentSequence;
+		startNextSegment();
+	}
+	else if (!segmentStarting && runningSegment.durationMs == INT_MIN) {
+		//segments without duration end as soon as there is a next one
+		startNextSegment();
+	}
+}
+
+void MissileControl::Launcher::handleSegmentDeadline(void * obj, uint32_t events)
+{
+	Launcher * launcher = reinterpret_cast<Launcher *>(obj);
+	if (launcher->segmentTimer.clear()) {
+		launcher->startNextSegment();
+	}
+}
+
+bool MissileControl::isMovement(LauncherCommand command)
+{
+	return command != NONE && command != STOP && command != FIRE;
+}
+
+void MissileControl::Launcher::startNextSegment()
+{
+	if (nextSegment.command == NONE) {
 		pthread_mutex_lock(&control->mutex);
-		//check if a command was issued
-		if (control->currentCommand != NONE) {
-			//check if a STOP command is needed now
-			if (control->currentRemainingTime != INT_MIN && control->currentRemainingTime <= 0) {
-				control->currentCommand = STOP;
-				control->currentRemainingTime = INT_MIN;
-			}
-			if (control->currentRemainingTime != INT_MIN && control->currentRemainingTime > 0) {
-				control->currentRemainingTime -= controlInterval;
-			}
-			if (control->currentCommand != lastCommand) {
-			    //if the launcher is not armed, ignore a FIRE command
-			    if (control->currentCommand != FIRE || (control->currentCommand == FIRE && control->armed)) {
-			        //copy command sequences to command buffer
-			        uint8_t commandBuffer[64];
-			        memset(commandBuffer, 0, sizeof(commandBuffer));		
-			        memcpy(commandBuffer, sequences[control->currentCommand], 8);
-			        //send command to device
-			        int errnum = 0;
-			        if (control->launcherInfo.model == LAUNCHER_M_S) {
-				        //needed for M&S launchers
-				        if ((errnum = libusb_control_transfer(control->usbLauncher, LIBUSB_DT_HID, LIBUSB_REQUEST_SET_CONFIGURATION, LIBUSB_RECIPIENT_ENDPOINT, 0x01, SEQUENCE_INITA, sizeof(SEQUENCE_INITA), usbControlTimeout) <= 0) ||
-					        (errnum = libusb_control_transfer(control->usbLauncher, LIBUSB_DT_HID, LIBUSB_REQUEST_SET_CONFIGURATION, LIBUSB_RECIPIENT_ENDPOINT, 0x01, SEQUENCE_INITB, sizeof(SEQUENCE_INITB), usbControlTimeout) <= 0) ||
-					        (errnum = libusb_control_transfer(control->usbLauncher, LIBUSB_DT_HID, LIBUSB_REQUEST_SET_CONFIGURATION, LIBUSB_RECIPIENT_ENDPOINT, 0x01, commandBuffer, 64, usbControlTimeout) <= 0)) {
-				            //                                                   0x21,                      0x09,               0x02, 0x01
-						        std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to send command to device. Error: " << libusb_error_name(errnum) << "." << ConsoleStyle() << std::endl;
-						        control->currentCommand = NONE;
-						        control->currentRemainingTime = INT_MIN;
-				        }
-			        }
-			        else if (control->launcherInfo.model == LAUNCHER_CHEEKY) {
-				        //sufficient for Dream Cheeky launchers
-				        if (errnum = libusb_control_transfer(control->usbLauncher, LIBUSB_DT_HID, LIBUSB_REQUEST_SET_CONFIGURATION, LIBUSB_RECIPIENT_ENDPOINT, 0x00, commandBuffer, 8, usbControlTimeout) <= 0) {
-					        std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to send command to device. Error: " << libusb_error_name(errnum) << "." << ConsoleStyle() << std::endl;
-					        control->currentCommand = NONE;
-					        control->currentRemainingTime = INT_MIN;
-				        }
-			        }
-			    }
-			}
-			//if the command was to fire or stop, switch command to NONE
-			if (control->currentCommand == STOP || control->currentCommand == FIRE) {
-				control->currentCommand = NONE;
-				control->currentRemainingTime = INT_MIN;
-			}
-			lastCommand = control->currentCommand;
+		if (!plannedSegments.empty()) {
+			nextSegment = plannedSegments.front();
+			plannedSegments.pop_front();
+		}
+		pthread_mutex_unlock(&control->mutex);
+	}
+	if (nextSegment.command == NONE) {
+		//nothing planned. a timed movement must be stopped when its time is up
+		if (isMovement(runningSegment.command) && runningSegment.durationMs != INT_MIN) {
+			const SegmentReport stop = {STOP, INT_MIN, 0, 0, 0};
+			nextSegment = stop;
+		}
+		else {
+			pthread_mutex_lock(&control->mutex);
+			idle = plannedSegments.empty();
+			pthread_mutex_unlock(&control->mutex);
+			idleNotifier.notify();
+			return;
+		}
+	}
+	//the launcher keeps moving, so the same movement is not sent again and the segment starts right away
+	if (nextSegment.command == lastCommand) {
+		const SegmentReport segment = nextSegment;
+		nextSegment.command = NONE;
+		beginSegment(segment, getTimestampUs());
+		return;
+	}
+	//if the launcher is not armed, ignore a FIRE command
+	if (nextSegment.command == FIRE && !armed) {
+		nextSegment.command = NONE;
+		startNextSegment();
+		return;
+	}
+	++segmentSequence;
+	const int result = submitCommand(nextSegment.command);
+	if (result == 0) {
+		//the segment waits for transfers to complete
+		--segmentSequence;
+		return;
+	}
+	if (result < 0) {
+		//the launcher state is unknown now, so send the next command even if it is the same
+		lastCommand = NONE;
+		nextSegment.command = NONE;
+		startNextSegment();
+		return;
+	}
+	startingSegment = nextSegment;
+	segmentStarting = true;
+	nextSegment.command = NONE;
+	lastCommand = isMovement(startingSegment.command) ? startingSegment.command : NONE;
+}
+
+void MissileControl::Launcher::beginSegment(const SegmentReport & segment, uint64_t timestamp)
+{
+	//the running segment ended when the command of the next one reached the device
+	if (runningSegment.command != NONE) {
+		runningSegment.stopTimestamp = timestamp;
+		pthread_mutex_lock(&control->mutex);
+		lastSegment = runningSegment;
+		pthread_mutex_unlock(&control->mutex);
+	}
+	runningSegment = segment;
+	runningSegment.startTimestamp = timestamp;
+	runningSegment.stopTimestamp = 0;
+	segmentStarting = false;
+	if (segment.durationMs != INT_MIN) {
+		//the end is an absolute time, so it does not drift by the time it took to get here
+		segmentTimer.setDeadline(timestamp + segment.durationMs * 1000ULL);
+	}
+	else {
+		startNextSegment();
+	}
+}
+
+int MissileControl::Launcher::submitCommand(LauncherCommand command)
+{
+	//M&S launchers need two init sequences before every command
+	const uint32_t needed = info.model == LAUNCHER_M_S ? 3 : 1;
+	Transfer * freeTransfers[3];
+	uint32_t freeCount = 0;
+	for (uint32_t i = 0; i < TransferCount && freeCount < needed; ++i) {
+		if (!transfers[i].busy) {
+			freeTransfers[freeCount++] = &transfers[i];
+		}
+	}
+	if (freeCount < needed) {
+		return 0;
+	}
+	for (uint32_t i = 0; i < needed; ++i) {
+		freeTransfers[i]->carriesCommand = (i == needed - 1);
+		freeTransfers[i]->sequence = segmentSequence;
+	}
+	//copy command sequences to command buffer
+	uint8_t commandBuffer[MaxTransferData];
+	memset(commandBuffer, 0, sizeof(commandBuffer));
+	memcpy(commandBuffer, sequences[command], 8);
+	//submit all transfers at once. they are queued on the control endpoint and reach the device in order
+	bool submitted = true;
+	if (info.model == LAUNCHER_M_S) {
+		//needed for M&S launchers
+		submitted = submitTransfer(*freeTransfers[0], 0x01, SEQUENCE_INITA, sizeof(SEQUENCE_INITA))
+			&& submitTransfer(*freeTransfers[1], 0x01, SEQUENCE_INITB, sizeof(SEQUENCE_INITB))
+			&& submitTransfer(*freeTransfers[2], 0x01, commandBuffer, 64);
+	}
+	else if (info.model == LAUNCHER_CHEEKY) {
+		//sufficient for Dream Cheeky launchers
+		submitted = submitTransfer(*freeTransfers[0], 0x00, commandBuffer, 8);
+	}
+	return submitted ? 1 : -1;
+}
+
+bool MissileControl::Launcher::submitTransfer(Transfer & transfer, uint16_t index, const uint8_t * data, uint16_t length)
+{
+	//                                                          0x21,                      0x09,                     0x02
+	libusb_fill_control_setup(transfer.buffer, LIBUSB_DT_HID, LIBUSB_REQUEST_SET_CONFIGURATION, LIBUSB_RECIPIENT_ENDPOINT, index, length);
+	memcpy(transfer.buffer + LIBUSB_CONTROL_SETUP_SIZE, data, length);
+	libusb_fill_control_transfer(transfer.transfer, usbLauncher, transfer.buffer, &MissileControl::transferCompleted, &transfer, usbControlTimeout);
+	transfer.submitTimestamp = getTimestampUs();
+	int errnum = 0;
+	if (errnum = libusb_submit_transfer(transfer.transfer)) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to send command to device. Error: " << libusb_error_name(errnum) << "." << ConsoleStyle() << std::endl;
+		return false;
+	}
+	transfer.busy = true;
+	return true;
+}
+
+void LIBUSB_CALL MissileControl::transferCompleted(libusb_transfer * usbTransfer)
+{
+	Transfer & transfer = *reinterpret_cast<Transfer *>(usbTransfer->user_data);
+	Launcher * launcher = transfer.launcher;
+	MissileControl * control = launcher->control;
+	transfer.busy = false;
+	const uint64_t now = getTimestampUs();
+	//only the command of the segment being started matters. older ones were superseded
+	const bool starting = transfer.carriesCommand && launcher->segmentStarting && transfer.sequence == launcher->segmentSequence;
+	if (usbTransfer->status != LIBUSB_TRANSFER_COMPLETED) {
+		if (usbTransfer->status != LIBUSB_TRANSFER_CANCELLED) {
+			std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to send command to device. Transfer status: " << usbTransfer->status << "." << ConsoleStyle() << std::endl;
+		}
+		if (starting) {
+			//the launcher state is unknown now, so send the next command even if it is the same
+			launcher->lastCommand = NONE;
+			launcher->segmentStarting = false;
+			launcher->startNextSegment();
+			return;
+		}
+	}
+	else {
+		//measure the time the transfer took and the time from issuing the command till it reached the device
+		const uint64_t transferLatency = now - transfer.submitTimestamp;
+		pthread_mutex_lock(&control->mutex);
+		launcher->transferLatencyUs = launcher->transferLatencyUs == 0 ? transferLatency : (7 * launcher->transferLatencyUs + transferLatency) / 8;
+		launcher->maxTransferLatencyUs = transferLatency > launcher->maxTransferLatencyUs ? transferLatency : launcher->maxTransferLatencyUs;
+		if (starting && launcher->startingSegment.issueTimestamp != 0) {
+			const uint64_t latency = now - launcher->startingSegment.issueTimestamp;
+			launcher->commandLatencyUs = launcher->commandLatencyUs == 0 ? latency : (7 * launcher->commandLatencyUs + latency) / 8;
 		}
-		//unlock mutex again
 		pthread_mutex_unlock(&control->mutex);
-		//sleep controlInterval between launcher commands
-		usleep(controlInterval * 1000);
+		if (starting) {
+			launcher->beginSegment(launcher->startingSegment, now);
+			return;
+		}
+	}
+	//a segment might wait for free transfers
+	if (launcher->nextSegment.command != NONE && !launcher->segmentStarting) {
+		launcher->startNextSegment();
 	}
 }
 
-bool MissileControl::executeCommand(LauncherCommand command, int durationMs)
+void MissileControl::handleUsbEvents(void * obj, uint32_t events)
 {
-	if (isAvailable()) {
-		//if the command is fire or stop, the duration is set to INT_MIN anyway
-		if (command == NONE || command == FIRE || command == STOP) {
-			durationMs = INT_MIN;
+	MissileControl * control = reinterpret_cast<MissileControl *>(obj);
+	//handle what is pending without waiting, the reactor does the waiting
+	timeval zero = {0, 0};
+	libusb_handle_events_timeout_completed(control->usbContext, &zero, nullptr);
+}
+
+void MissileControl::addUsbDescriptor(int descriptor, short events, void * obj)
+{
+	MissileControl * control = reinterpret_cast<MissileControl *>(obj);
+	//libusb passes poll() flags. POLLIN and POLLOUT have the same values as EPOLLIN and EPOLLOUT
+	control->reactor.add(descriptor, static_cast<uint16_t>(events), &MissileControl::handleUsbEvents, control);
+}
+
+void MissileControl::removeUsbDescriptor(int descriptor, void * obj)
+{
+	MissileControl * control = reinterpret_cast<MissileControl *>(obj);
+	control->reactor.remove(descriptor);
+}
+
+MissileControl::Launcher * MissileControl::getLauncher(uint32_t launcher) const
+{
+	return launcher < launchers.size() ? launchers[launcher].get() : nullptr;
+}
+
+uint32_t MissileControl::getLauncherCount() const
+{
+	return launchers.size();
+}
+
+bool MissileControl::getLauncherInfo(uint32_t launcher, LauncherInfo & info) const
+{
+	const Launcher * device = getLauncher(launcher);
+	if (device == nullptr) {
+		return false;
+	}
+	info = device->info;
+	return true;
+}
+
+int32_t MissileControl::findLauncher(uint8_t busNumber, uint8_t portNumber) const
+{
+	for (uint32_t i = 0; i < launchers.size(); ++i) {
+		if (launchers[i]->info.busNumber == busNumber && launchers[i]->info.portNumber == portNumber) {
+			return i;
 		}
-		//else if the duration if smaller than 0, set it to INT_MIN too
-		else if (durationMs < 0) {
-		    durationMs = INT_MIN;
+	}
+	return -1;
+}
+
+int32_t MissileControl::findLauncher(const std::string & address) const
+{
+	std::stringstream ss(address);
+	int number = -1;
+	if (!(ss >> number) || number < 0) {
+		return -1;
+	}
+	//"BUS-PORT" is a USB address, a plain number an index
+	char separator = 0;
+	int portNumber = -1;
+	if (ss >> separator) {
+		return (separator == '-' && ss >> portNumber && portNumber >= 0) ? findLauncher(number, portNumber) : -1;
+	}
+	return number < (int)launchers.size() ? number : -1;
+}
+
+bool MissileControl::executeCommand(uint32_t launcher, LauncherCommand command, int durationMs, bool replacePlan)
+{
+	//if the command is fire or stop, the duration is set to INT_MIN anyway
+	if (command == NONE || command == FIRE || command == STOP) {
+		durationMs = INT_MIN;
+	}
+	const Segment segment = {command, durationMs};
+	return executePlan(launcher, std::vector<Segment>(1, segment), replacePlan || command == STOP);
+}
+
+bool MissileControl::executePlan(uint32_t launcher, const std::vector<Segment> & segments, bool replacePlan)
+{
+	Launcher * device = getLauncher(launcher);
+	if (!isAvailable() || device == nullptr) {
+		return false;
+	}
+	const uint64_t now = getTimestampUs();
+	pthread_mutex_lock(&mutex);
+	if (replacePlan) {
+		device->plannedSegments.clear();
+		device->planReplaced = true;
+	}
+	//a new plan starts now, an appended one when the planned segments end
+	uint64_t planEnd = (replacePlan || device->planEndTimestamp < now) ? now : device->planEndTimestamp;
+	for (auto sIt = segments.cbegin(); sIt != segments.cend(); ++sIt) {
+		if (sIt->command != NONE) {
+			//if the duration if smaller than 0, set it to INT_MIN
+			const SegmentReport segment = {sIt->command, sIt->durationMs < 0 ? INT_MIN : sIt->durationMs, now, 0, 0};
+			device->plannedSegments.push_back(segment);
+			device->idle = false;
+			planEnd += segment.durationMs != INT_MIN ? segment.durationMs * 1000ULL : 0;
 		}
+	}
+	device->planEndTimestamp = planEnd;
+	pthread_mutex_unlock(&mutex);
+	//wake up the control thread right away
+	commandNotifier.notify();
+	return true;
+}
+
+bool MissileControl::waitForIdle(uint32_t launcher, uint32_t timeoutMs)
+{
+	Launcher * device = getLauncher(launcher);
+	if (device == nullptr) {
+		return false;
+	}
+	const uint64_t deadline = getTimestampUs() + timeoutMs * 1000ULL;
+	while (true) {
 		pthread_mutex_lock(&mutex);
-		currentCommand = command;
-		currentRemainingTime = durationMs;
+		const bool result = device->idle;
 		pthread_mutex_unlock(&mutex);
-		return true;
+		const uint64_t now = getTimestampUs();
+		if (result || now >= deadline) {
+			return result;
+		}
+		device->idleNotifier.wait((deadline - now + 999) / 1000);
+	}
+}
+
+uint64_t MissileControl::getPlanEnd(uint32_t launcher)
+{
+	Launcher * device = getLauncher(launcher);
+	if (device == nullptr) {
+		return 0;
+	}
+	pthread_mutex_lock(&mutex);
+	const uint64_t result = device->planEndTimestamp;
+	pthread_mutex_unlock(&mutex);
+	return result;
+}
+
+bool MissileControl::getLastSegment(uint32_t launcher, SegmentReport & report)
+{
+	Launcher * device = getLauncher(launcher);
+	if (device == nullptr) {
+		return false;
+	}
+	pthread_mutex_lock(&mutex);
+	report = device->lastSegment;
+	pthread_mutex_unlock(&mutex);
+	return report.command != NONE;
+}
+
+const char * MissileControl::getCommandName(LauncherCommand command)
+{
+	static const char * names[] = {"NONE", "STOP", "LEFT", "RIGHT", "UP", "DOWN", "LEFTUP", "RIGHTUP", "LEFTDOWN", "RIGHTDOWN", "FIRE"};
+	return command <= FIRE ? names[command] : "UNKNOWN";
+}
+
+uint64_t MissileControl::getCommandLatency(uint32_t launcher)
+{
+	Launcher * device = getLauncher(launcher);
+	if (device == nullptr) {
+		return 0;
 	}
-	return false;
+	pthread_mutex_lock(&mutex);
+	const uint64_t result = device->commandLatencyUs;
+	pthread_mutex_unlock(&mutex);
+	return result;
+}
+
+uint64_t MissileControl::getTransferLatency(uint32_t launcher, uint64_t * maxLatencyUs)
+{
+	Launcher * device = getLauncher(launcher);
+	if (device == nullptr) {
+		return 0;
+	}
+	pthread_mutex_lock(&mutex);
+	const uint64_t result = device->transferLatencyUs;
+	if (maxLatencyUs != nullptr) {
+		*maxLatencyUs = device->maxTransferLatencyUs;
+	}
+	pthread_mutex_unlock(&mutex);
+	return result;
 }
 
 bool MissileControl::isAvailable() const
 {
-	return (usbContext != nullptr && usbLauncher != nullptr && active);
+	return (usbContext != nullptr && !launchers.empty() && active);
 }
 
-void MissileControl::setArmed(bool arm)
+void MissileControl::setArmed(uint32_t launcher, bool arm)
 {
-    armed = arm;
+	Launcher * device = getLauncher(launcher);
+	if (device != nullptr) {
+		device->armed = arm;
+	}
 }
 
-bool MissileControl::isArmed() const
+bool MissileControl::isArmed(uint32_t launcher) const
 {
-    return armed;
+	const Launcher * device = getLauncher(launcher);
+	return device != nullptr && device->armed;
+}
+
+void MissileControl::Launcher::close()
+{
+	for (uint32_t i = 0; i < TransferCount; ++i) {
+		if (transfers[i].transfer != nullptr && !transfers[i].busy) {
+			libusb_free_transfer(transfers[i].transfer);
+			transfers[i].transfer = nullptr;
+		}
+	}
+	if (usbLauncher != nullptr) {
+		libusb_release_interface(usbLauncher, 0);
+		libusb_release_interface(usbLauncher, 1);
+		libusb_close(usbLauncher);
+		usbLauncher = nullptr;
+	}
 }
 
 MissileControl::~MissileControl()
 {
 	std::cout << "Shutting down missile control." << std::endl;
 	if (thread != 0) {
-		active = false;
+		reactor.stop();
 		pthread_join(thread, 0);
 		thread = 0;
+		active = false;
 	}
     if (usbContext) {
-        if (usbLauncher != nullptr) {
-            libusb_release_interface(usbLauncher, 0);
-            libusb_release_interface(usbLauncher, 1);
-            libusb_close(usbLauncher);
-            usbLauncher = nullptr;
+        libusb_set_pollfd_notifiers(usbContext, nullptr, nullptr, nullptr);
+        //cancel transfers still in flight of all launchers and wait for them, they can only be freed after completing
+        for (auto lIt = launchers.begin(); lIt != launchers.end(); ++lIt) {
+            Launcher & launcher = **lIt;
+            launcher.nextSegment.command = NONE;
+            launcher.segmentStarting = false;
+            for (uint32_t i = 0; i < TransferCount; ++i) {
+                if (launcher.transfers[i].busy) {
+                    libusb_cancel_transfer(launcher.transfers[i].transfer);
+                }
+            }
         }
+        const uint64_t deadline = getTimestampUs() + usbControlTimeout * 1000ULL;
+        for (auto lIt = launchers.begin(); lIt != launchers.end(); ++lIt) {
+            for (uint32_t i = 0; i < TransferCount && getTimestampUs() < deadline; ) {
+                if ((*lIt)->transfers[i].busy) {
+                    timeval timeout = {0, 10000};
+                    libusb_handle_events_timeout_completed(usbContext, &timeout, nullptr);
+                }
+                else {
+                    ++i;
+                }
+            }
+            (*lIt)->close();
+        }
+        launchers.clear();
         libusb_exit(usbContext);
         usbContext = nullptr;
     }
 }
-
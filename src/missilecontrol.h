@@ -1,9 +1,17 @@
 #pragma once
 
+#include <deque>
+#include <memory>
 #include <string>
 #include <vector>
+#include <climits>
+#include <pthread.h>
 #include <libusb.h>
 
+#include "reactor.h"
+#include "eventnotifier.h"
+#include "deadlinetimer.h"
+
 
 class MissileControl
 {
@@ -11,65 +19,263 @@ public:
 	enum LauncherModel {LAUNCHER_UNKNOWN, LAUNCHER_M_S, LAUNCHER_CHEEKY}; //!<Supported USB launcher models.
 	enum LauncherCommand {NONE, STOP, LEFT, RIGHT, UP, DOWN, LEFTUP, RIGHTUP, LEFTDOWN, RIGHTDOWN, FIRE}; //!<Supported launcher commands.
 
-private:
-	static const uint32_t controlInterval; //!<sleep time for the control thread in ms.
-	static const uint32_t usbControlTimeout; //!<timeout in ms for usb control transfer functions.
+	struct Segment
+	{
+		LauncherCommand command; //!<Command to send.
+		int durationMs; //!<Time in ms till the next segment starts or INT_MIN to start it as soon as there is one.
+	};
 
-    pthread_t thread; //!<launcher control thread.
-	pthread_mutex_t mutex; //!<The mutex protecting the member variables.
-    bool active; //!<flags to keep the thread running or stop it.
+	struct SegmentReport
+	{
+		LauncherCommand command; //!<Command of the segment.
+		int durationMs; //!<Planned duration in ms or INT_MIN.
+		uint64_t issueTimestamp; //!<Time the segment was planned in us or 0 if the control thread added it.
+		uint64_t startTimestamp; //!<Time the command reached the device in us.
+		uint64_t stopTimestamp; //!<Time the command of the next segment reached the device in us.
+	};
 
-	libusb_context * usbContext; //!<libusb context.
-	libusb_device_handle * usbLauncher; //!<Launcher USB device handle.
-	
 	struct LauncherInfo {
 		LauncherModel model;
 		uint16_t usbVendorId;
 		uint16_t usbProductId;
 		std::string description;
+		uint8_t busNumber; //!<USB bus the launcher is connected to.
+		uint8_t portNumber; //!<USB port the launcher is connected to.
 
 		LauncherInfo() 
-			: model(LAUNCHER_UNKNOWN), usbVendorId(0), usbProductId(0) {};
+			: model(LAUNCHER_UNKNOWN), usbVendorId(0), usbProductId(0), busNumber(0), portNumber(0) {};
 		LauncherInfo(LauncherModel launcherModel, uint16_t vendorId, uint16_t productId, const std::string & desc)
-			: model(launcherModel), usbVendorId(vendorId), usbProductId(productId), description(desc) {};
+			: model(launcherModel), usbVendorId(vendorId), usbProductId(productId), description(desc), busNumber(0), portNumber(0) {};
 	};
+
+private:
+	static const uint32_t usbControlTimeout; //!<timeout in ms for usb control transfer functions.
+	static const uint32_t TransferCount = 12; //!<Number of preallocated transfers per launcher. Enough for four M&S commands in flight.
+	static const uint32_t MaxTransferData = 64; //!<Largest payload of a transfer in bytes.
+
+	struct Launcher;
+
+	struct Transfer
+	{
+		Launcher * launcher; //!<Owner of the transfer, for the completion callback.
+		libusb_transfer * transfer; //!<Preallocated libusb transfer.
+		bool busy; //!<true while the transfer is submitted.
+		bool carriesCommand; //!<true for the transfer carrying the command, false for the M&S init sequences before it.
+		uint64_t submitTimestamp; //!<Time the transfer was submitted in us.
+		uint32_t sequence; //!<Number of the segment the transfer belongs to.
+		uint8_t buffer[LIBUSB_CONTROL_SETUP_SIZE + MaxTransferData]; //!<Setup packet followed by the payload.
+	};
+
+	/*!
+	One claimed launcher and its command scheduler. Launchers run their segments independently of each other, but share
+	the control thread and the libusb context of the \MissileControl.
+	*/
+	struct Launcher
+	{
+		MissileControl * control; //!<Owner. Its mutex protects the members shared with other threads.
+		LauncherInfo info; //!<Model and USB address.
+		libusb_device_handle * usbLauncher; //!<Launcher USB device handle.
+		EventNotifier idleNotifier; //!<Notified by the control thread when all planned segments were started.
+		DeadlineTimer segmentTimer; //!<Fires when the running segment ends and the next one must be started.
+		Transfer transfers[TransferCount]; //!<Transfers, reused for all commands. Only used by the control thread.
+
+		std::deque<SegmentReport> plannedSegments; //!<Segments waiting to be started, oldest first.
+		bool planReplaced; //!<If true the running segment is ended right away to start the new plan.
+		bool idle; //!<true if all planned segments were started.
+		uint64_t planEndTimestamp; //!<Time the planned segments are expected to end in us.
+		SegmentReport lastSegment; //!<The last segment that ended. command is NONE if none did yet.
+		//Only used by the control thread
+		SegmentReport nextSegment; //!<Segment taken from the plan that waits for free transfers or command NONE.
+		SegmentReport startingSegment; //!<Segment whose command is being transferred.
+		SegmentReport runningSegment; //!<Segment that reached the device or command NONE.
+		bool segmentStarting; //!<true while the command of startingSegment is being transferred.
+		uint32_t segmentSequence; //!<Number of the last segment submitted. Completions of older segments are ignored.
+		LauncherCommand lastCommand; //!<The movement the launcher executes or NONE.
+		uint64_t commandLatencyUs; //!<Smoothed time from issuing a command till it reached the device in us.
+		uint64_t transferLatencyUs; //!<Smoothed time from submitting a transfer till it completed in us.
+		uint64_t maxTransferLatencyUs; //!<Longest time from submitting a transfer till it completed in us.
+		bool armed; //!<If true the launcher is armed and will shoot if a fire command is executed.
+
+		Launcher(MissileControl * owner, const LauncherInfo & launcherInfo, libusb_device_handle * handle);
+
+		static void handleSegmentDeadline(void * obj, uint32_t events);
+
+		/*!
+		Start the plan right away if it was replaced or nothing is running that must end first. Called by the control thread.
+		*/
+		void handlePlan();
+
+		/*!
+		End the running segment and start the next planned one. If nothing is planned after a timed movement, a STOP is
+		started. Called by the control thread.
+		*/
+		void startNextSegment();
+
+		/*!
+		Make a segment the running one when its command reached the device and arm the timer for its end.
+		\param[in] timestamp Time the command reached the device in us.
+		*/
+		void beginSegment(const SegmentReport & segment, uint64_t timestamp);
+
+		/*!
+		Submit the transfers for a command without waiting for them. M&S init sequences are submitted together with the
+		command, so the device gets them back to back. Called by the control thread.
+		\return Returns 1 if the transfers were submitted, 0 if there are not enough free transfers and -1 if submitting failed.
+		*/
+		int submitCommand(LauncherCommand command);
+
+		/*!
+		Submit one control transfer.
+		\return Returns true if the transfer was submitted.
+		*/
+		bool submitTransfer(Transfer & transfer, uint16_t index, const uint8_t * data, uint16_t length);
+
+		/*!
+		Cancel the transfers in flight and release the device. Called after the control thread stopped.
+		*/
+		void close();
+	};
+
+    pthread_t thread; //!<launcher control thread.
+	pthread_mutex_t mutex; //!<The mutex protecting the member variables.
+    bool active; //!<true while the control thread is running.
+	Reactor reactor; //!<Event loop of the control thread. Waits for commands, segment deadlines and the USB descriptors of libusb.
+	EventNotifier commandNotifier; //!<Notified by \executePlan to wake up the control thread.
+
+	libusb_context * usbContext; //!<libusb context shared by all launchers.
 	std::vector<LauncherInfo> supportedLaunchers;
-	LauncherInfo launcherInfo;
-	
-	LauncherCommand currentCommand; //!<The current command sent to the launcher.
-	int currentRemainingTime; //!<The time remaining till a stop command must be issued.
-	bool armed; //!<If true the launcher is armed and will shoot if a fire command is executed.
+	std::vector<std::shared_ptr<Launcher>> launchers; //!<All claimed launchers, in the order they were found.
 
 	static void * controlLoop(void * obj);
+	static void handleCommand(void * obj, uint32_t events);
+	static void handleUsbEvents(void * obj, uint32_t events);
+	static void addUsbDescriptor(int descriptor, short events, void * obj);
+	static void removeUsbDescriptor(int descriptor, void * obj);
+	static void LIBUSB_CALL transferCompleted(libusb_transfer * transfer);
+
+	static bool isMovement(LauncherCommand command);
+
+	/*!
+	Try to open and claim a launcher device.
+	\return Returns the device handle or nullptr if the device can't be used.
+	*/
+	static libusb_device_handle * claimDevice(libusb_device * device);
+
+	/*!
+	Get a launcher by index or nullptr if there is no such launcher.
+	*/
+	Launcher * getLauncher(uint32_t launcher) const;
 
 public:
     /*!
-    Detect and claim first supported USB missile launcher.
+    Detect and claim all supported USB missile launchers.
     */
 	MissileControl();
 
     /*!
     Check if launcher control is available.
-    \return Returns true if a launcher was found and can be controlled via \executeCommand.
+    \return Returns true if at least one launcher was found and can be controlled via \executeCommand.
     */	
 	bool isAvailable() const;
 
 	/*!
-	Executes a launcher command.
+	Get the number of launchers claimed. Launchers are addressed by their index from 0 to count - 1.
+	*/
+	uint32_t getLauncherCount() const;
+
+	/*!
+	Get model and USB address of a launcher.
+	\param[in] launcher Index of launcher.
+	\param[out] info Launcher information.
+	\return Returns false if there is no such launcher.
+	*/
+	bool getLauncherInfo(uint32_t launcher, LauncherInfo & info) const;
+
+	/*!
+	Find a launcher by the USB bus and port it is connected to, so it stays the same if the launchers are found in a different order.
+	\return Returns the index of the launcher or -1 if there is none at that address.
+	*/
+	int32_t findLauncher(uint8_t busNumber, uint8_t portNumber) const;
+
+	/*!
+	Find a launcher by index, e.g. "1", or by USB bus and port, e.g. "1-4".
+	\return Returns the index of the launcher or -1 if there is no such launcher.
+	*/
+	int32_t findLauncher(const std::string & address) const;
+
+	/*!
+	Executes a launcher command after the planned ones.
+	\param[in] launcher Index of launcher.
 	\param[in] command The command to issue to the launcher.
 	\param[in] duration Optional. Duration in ms the command should be executed before a STOP command is issued. With duration == INT_MIN no stop command will be issued.
+	\param[in] replacePlan Optional. Drop the planned commands and end the running one right away, e.g. for manual control. STOP always does.
 	\return Returns true if the command was issued, false if not.
-	\note The minimum duration is the loop delay of about 20ms
+	\note Never waits for the device. Commands are queued, so none is lost.
+	*/
+	bool executeCommand(uint32_t launcher, LauncherCommand command, int durationMs = INT_MIN, bool replacePlan = false);
+
+	/*!
+	Queue segments that run back to back, e.g. {RIGHTUP, 130}, {STOP, INT_MIN}, {FIRE, INT_MIN}.
+	Every segment starts when its command reached the device and ends at an absolute CLOCK_MONOTONIC deadline, so
+	durations don't drift with load. If the last segment is a timed movement, a STOP follows it.
+	\param[in] launcher Index of launcher. The plans of other launchers are not affected.
+	\param[in] segments Segments to run. Segments with command NONE are skipped, negative durations mean INT_MIN.
+	\param[in] replacePlan Optional. Drop the planned segments and end the running one right away.
+	\return Returns true if the segments were queued.
+	*/
+	bool executePlan(uint32_t launcher, const std::vector<Segment> & segments, bool replacePlan = false);
+
+	/*!
+	Wait till all planned segments of a launcher were started and the last timed one ended.
+	\param[in] launcher Index of launcher.
+	\param[in] timeoutMs Maximum time to wait in ms.
+	\return Returns true if the launcher is idle and false on timeout.
+	*/
+	bool waitForIdle(uint32_t launcher, uint32_t timeoutMs);
+
+	/*!
+	Get the time the planned segments of a launcher are expected to end, e.g. to find the launcher that is free first.
+	\param[in] launcher Index of launcher.
+	\return Returns the CLOCK_MONOTONIC time in us. It is in the past if the launcher has nothing to do.
+	\note The estimate is the sum of the planned durations. It does not include the command latency.
+	*/
+	uint64_t getPlanEnd(uint32_t launcher);
+
+	/*!
+	Get the start and stop times the launcher achieved for the last segment that ended.
+	\param[in] launcher Index of launcher.
+	\param[out] report Times of the segment.
+	\return Returns false if no segment ended yet.
+	*/
+	bool getLastSegment(uint32_t launcher, SegmentReport & report);
+
+	/*!
+	Get the name of a command, e.g. for printing.
+	*/
+	static const char * getCommandName(LauncherCommand command);
+
+	/*!
+	Get the time from \executeCommand until the command reached the device, e.g. to aim ahead of moving targets.
+	\param[in] launcher Index of launcher.
+	\return Returns the smoothed latency of the last commands in us or 0 if no command was sent yet.
 	*/
-	bool executeCommand(LauncherCommand command, int durationMs = INT_MIN);
+	uint64_t getCommandLatency(uint32_t launcher);
+
+	/*!
+	Get the time USB transfers to the device take, from submitting till completion.
+	\param[in] launcher Index of launcher.
+	\param[out] maxLatencyUs Optional. Longest transfer time so far in us.
+	\return Returns the smoothed latency of the last transfers in us or 0 if no transfer completed yet.
+	*/
+	uint64_t getTransferLatency(uint32_t launcher, uint64_t * maxLatencyUs = nullptr);
 	
 	/*!
-	Set the state of the launcher to armed. It will shoot if a FIRE command is executed.
+	Set the state of a launcher to armed. It will shoot if a FIRE command is executed.
+	\param[in] launcher Index of launcher.
 	\param[in] arm Arm or unarm launcher.
     */
-	void setArmed(bool arm);
-	bool isArmed() const;
+	void setArmed(uint32_t launcher, bool arm);
+	bool isArmed(uint32_t launcher) const;
 
 	~MissileControl();
-};
-
+};
\ No newline at end of file
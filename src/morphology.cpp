@@ -0,0 +1,134 @@
+#include "morphology.h"
+
+#include <algorithm>
+
+
+//Maximum operation for dilation. Pixels outside of the image must not change the result, so they are treated as 0.
+struct MaximumOperation
+{
+	static inline uint8_t neutral() { return 0; }
+	static inline uint8_t apply(uint8_t a, uint8_t b) { return a > b ? a : b; }
+};
+
+//Minimum operation for erosion. Pixels outside of the image are treated as 255.
+struct MinimumOperation
+{
+	static inline uint8_t neutral() { return 255; }
+	static inline uint8_t apply(uint8_t a, uint8_t b) { return a < b ? a : b; }
+};
+
+//Apply operation to whole rows. Kept in simple loops so the compiler can vectorize them.
+template <typename OPERATION>
+static inline void applyRows(uint8_t * destination, const uint8_t * a, const uint8_t * b, int width)
+{
+	for (int x = 0; x < width; ++x) {
+		destination[x] = OPERATION::apply(a[x], b[x]);
+	}
+}
+
+template <typename OPERATION>
+void Morphology::filter(const cv::Mat & source, cv::Mat & destination, uint32_t radius, const cv::Range & rows)
+{
+	const int width = source.cols;
+	const int height = source.rows;
+	destination.create(height, width, CV_8U);
+	if (radius == 0) {
+		source.rowRange(rows).copyTo(destination.rowRange(rows));
+		return;
+	}
+	//The padded source is split into blocks of kernel size. For every position the running result from the
+	//start of its block (forward) and to the end of its block (backward) is stored. Every kernel window spans
+	//at most two blocks, so its result is op(backward[start], forward[end]).
+	const int kernelSize = 2 * radius + 1;
+	//source rows the kernel windows of the band can reach
+	const int firstRow = std::max(0, rows.start - (int)radius);
+	const int lastRow = std::min(height, rows.end + (int)radius);
+	horizontal.create(lastRow - firstRow, width, CV_8U);
+	//horizontal pass. pad row with radius neutral pixels on both sides and round up to a multiple of kernel size
+	const int paddedWidth = ((width + 2 * radius + kernelSize - 1) / kernelSize) * kernelSize;
+	paddedRow.assign(paddedWidth, OPERATION::neutral());
+	forwardRow.resize(paddedWidth);
+	backwardRow.resize(paddedWidth);
+	for (int y = firstRow; y < lastRow; ++y) {
+		std::copy(source.ptr<uint8_t>(y), source.ptr<uint8_t>(y) + width, paddedRow.begin() + radius);
+		for (int block = 0; block < paddedWidth; block += kernelSize) {
+			forwardRow[block] = paddedRow[block];
+			for (int x = block + 1; x < block + kernelSize; ++x) {
+				forwardRow[x] = OPERATION::apply(forwardRow[x - 1], paddedRow[x]);
+			}
+			backwardRow[block + kernelSize - 1] = paddedRow[block + kernelSize - 1];
+			for (int x = block + kernelSize - 2; x >= block; --x) {
+				backwardRow[x] = OPERATION::apply(backwardRow[x + 1], paddedRow[x]);
+			}
+		}
+		applyRows<OPERATION>(horizontal.ptr<uint8_t>(y - firstRow), backwardRow.data(), forwardRow.data() + 2 * radius, width);
+	}
+	//vertical pass. same as above, but working on whole rows at once. rows outside of the image are neutral.
+	//padding rows past the reach of the band are never used, so they are neutral too
+	const int bandHeight = rows.end - rows.start;
+	const int paddedHeight = ((bandHeight + 2 * radius + kernelSize - 1) / kernelSize) * kernelSize;
+	forward.create(paddedHeight, width, CV_8U);
+	backward.create(paddedHeight, width, CV_8U);
+	for (int block = 0; block < paddedHeight; block += kernelSize) {
+		for (int y = block; y < block + kernelSize; ++y) {
+			const int sourceY = rows.start + y - (int)radius;
+			uint8_t * forwardData = forward.ptr<uint8_t>(y);
+			if (sourceY < firstRow || sourceY >= lastRow) {
+				std::fill(forwardData, forwardData + width, OPERATION::neutral());
+			}
+			else {
+				std::copy(horizontal.ptr<uint8_t>(sourceY - firstRow), horizontal.ptr<uint8_t>(sourceY - firstRow) + width, forwardData);
+			}
+			if (y > block) {
+				applyRows<OPERATION>(forwardData, forward.ptr<uint8_t>(y - 1), forwardData, width);
+			}
+		}
+		for (int y = block + kernelSize - 1; y >= block; --y) {
+			const int sourceY = rows.start + y - (int)radius;
+			uint8_t * backwardData = backward.ptr<uint8_t>(y);
+			if (sourceY < firstRow || sourceY >= lastRow) {
+				std::fill(backwardData, backwardData + width, OPERATION::neutral());
+			}
+			else {
+				std::copy(horizontal.ptr<uint8_t>(sourceY - firstRow), horizontal.ptr<uint8_t>(sourceY - firstRow) + width, backwardData);
+			}
+			if (y < block + kernelSize - 1) {
+				applyRows<OPERATION>(backwardData, backward.ptr<uint8_t>(y + 1), backwardData, width);
+			}
+		}
+	}
+	for (int y = 0; y < bandHeight; ++y) {
+		applyRows<OPERATION>(destination.ptr<uint8_t>(rows.start + y), backward.ptr<uint8_t>(y), forward.ptr<uint8_t>(y + 2 * radius), width);
+	}
+}
+
+void Morphology::dilate(const cv::Mat & source, cv::Mat & destination, uint32_t radius)
+{
+	filter<MaximumOperation>(source, destination, radius, cv::Range(0, source.rows));
+}
+
+void Morphology::erode(const cv::Mat & source, cv::Mat & destination, uint32_t radius)
+{
+	filter<MinimumOperation>(source, destination, radius, cv::Range(0, source.rows));
+}
+
+void Morphology::dilate(const cv::Mat & source, cv::Mat & destination, uint32_t radius, const cv::Range & rows)
+{
+	filter<MaximumOperation>(source, destination, radius, rows);
+}
+
+void Morphology::erode(const cv::Mat & source, cv::Mat & destination, uint32_t radius, const cv::Range & rows)
+{
+	filter<MinimumOperation>(source, destination, radius, rows);
+}
+
+void Morphology::close(const cv::Mat & source, cv::Mat & destination, uint32_t radius)
+{
+	filter<MaximumOperation>(source, destination, radius, cv::Range(0, source.rows));
+	filter<MinimumOperation>(destination, destination, radius, cv::Range(0, destination.rows));
+}
+
+uint64_t Morphology::getMemoryUsage() const
+{
+	return horizontal.total() + forward.total() + backward.total() + paddedRow.capacity() + forwardRow.capacity() + backwardRow.capacity();
+}
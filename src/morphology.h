@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+
+/*!
+Rectangular dilation and erosion of 8-bit images using the van Herk/Gil-Werman algorithm.
+The filters are separable and need 3 comparisons per pixel and pass, independent of the kernel size.
+Results are identical to cv::dilate and cv::erode with the default 3x3 kernel, border handling and radius iterations,
+because iterating a 3x3 rectangle radius times is the same as applying a (2 * radius + 1)^2 rectangle once.
+*/
+class Morphology
+{
+	cv::Mat horizontal; //!<Result of the horizontal pass.
+	cv::Mat forward; //!<Running maxima/minima of row blocks in downward direction for the vertical pass.
+	cv::Mat backward; //!<Running maxima/minima of row blocks in upward direction for the vertical pass.
+	std::vector<uint8_t> paddedRow; //!<Source row padded with neutral values for the horizontal pass.
+	std::vector<uint8_t> forwardRow; //!<Running maxima/minima of pixel blocks in forward direction for the horizontal pass.
+	std::vector<uint8_t> backwardRow; //!<Running maxima/minima of pixel blocks in backward direction for the horizontal pass.
+
+	template <typename OPERATION>
+	void filter(const cv::Mat & source, cv::Mat & destination, uint32_t radius, const cv::Range & rows);
+
+public:
+	/*!
+	Dilate image with a rectangular kernel. Like cv::dilate(source, destination, cv::Mat(), cv::Point(-1, -1), radius).
+	\param[in] source Source image, CV_8U.
+	\param[out] destination Destination image. May be the same as source.
+	\param[in] radius Kernel radius. The kernel is (2 * radius + 1) pixels wide and high.
+	*/
+	void dilate(const cv::Mat & source, cv::Mat & destination, uint32_t radius);
+
+	/*!
+	Erode image with a rectangular kernel. Like cv::erode(source, destination, cv::Mat(), cv::Point(-1, -1), radius).
+	\param[in] source Source image, CV_8U.
+	\param[out] destination Destination image. May be the same as source.
+	\param[in] radius Kernel radius. The kernel is (2 * radius + 1) pixels wide and high.
+	*/
+	void erode(const cv::Mat & source, cv::Mat & destination, uint32_t radius);
+
+	/*!
+	Dilate a band of rows only, e.g. to split an image between threads. Rows around the band up to radius are read
+	from source, so the result is the same as for the whole image. Source and destination must not be the same
+	when other bands are processed at the same time.
+	\param[in] source Source image, CV_8U.
+	\param[out] destination Destination image. Must be allocated with the size of source.
+	\param[in] radius Kernel radius. The kernel is (2 * radius + 1) pixels wide and high.
+	\param[in] rows Rows of destination to compute.
+	*/
+	void dilate(const cv::Mat & source, cv::Mat & destination, uint32_t radius, const cv::Range & rows);
+
+	/*!
+	Erode a band of rows only. See \dilate.
+	*/
+	void erode(const cv::Mat & source, cv::Mat & destination, uint32_t radius, const cv::Range & rows);
+
+	/*!
+	Morphological close. Like cv::morphologyEx(source, destination, cv::MORPH_CLOSE, cv::Mat(), cv::Point(-1, -1), radius).
+	\param[in] source Source image, CV_8U.
+	\param[out] destination Destination image. May be the same as source.
+	\param[in] radius Kernel radius of dilation and erosion.
+	*/
+	void close(const cv::Mat & source, cv::Mat & destination, uint32_t radius);
+
+	/*!
+	Get the size of the scratch buffers in bytes.
+	*/
+	uint64_t getMemoryUsage() const;
+};
@@ -1,115 +1,111 @@
 #include "motiondetector.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <sstream>
 #include <unistd.h>
 
 //#define DO_TIMING
-#ifdef DO_TIMING
-    #include <time.h>
-#endif
 
 #include "consolestyle.h"
+#include "timestamp.h"
+#include "videocapturesource.h"
+#include "v4l2source.h"
+#include "rawfilesource.h"
 
 
+//scratch buffers are reserved for this many blobs and tracks and one provisional label per this many pixels
+static const uint32_t ReservedBlobs = 256;
+static const uint32_t ReservedTracks = 64;
+static const uint32_t PixelsPerReservedLabel = 64;
+//analyzed frames after the warm-up that may still allocate, e.g. scratch buffers created on first use
+static const uint32_t AllocationWarmupFrames = 2;
+
 MotionDetector::MotionDetector()
-	: motionChanged(false),
-	  thread(0), mutex(PTHREAD_MUTEX_INITIALIZER), active(false), paused(false),
-	  videoWidth(0), videoHeight(0), videoFps(0.0), videoBitsPerColor(0), videoColors(0),
-      pollingInterval(0), frameNr(0), framesToIgnore(0), frameChanged(false),
-      useMorphology(false), useAdaptiveThreshold(false), binaryThreshold(70.0)
+	: captureThread(0), thread(0), active(false), paused(false),
+	  videoWidth(0), videoHeight(0), videoFormat(FrameSource::FORMAT_UNKNOWN), videoFps(0.0),
+      frameNr(0), framesToIgnore(0), resultSequence(0), motionSequence(0), tracksSequence(0), frameSequence(0), analyzedFrames(0), allocations(0), bandAllocations(0), subscriberMutex(PTHREAD_MUTEX_INITIALIZER), nextSubscriberId(1), poolThreadCount(0), backgroundEngineType(BackgroundEngine::TYPE_RUNNING_AVERAGE),
+      useMorphology(false), useAdaptiveThreshold(false), useFixedPointBackground(false), useSelectiveUpdate(false), useTiles(false), useEgoMotionCompensation(false), useBackgroundMosaic(false), pyramidLevel(0), threadCount(0), binaryThreshold(70.0)
 {
 }
 
 bool MotionDetector::openVideo(const std::string & fileName, uint32_t width, uint32_t height, double fps)
 {
-	if(videoCapture.open(fileName)) {
-		std::cout << ConsoleStyle(ConsoleStyle::GREEN) << "Opened video file \"" << fileName << "\" for motion detection." << ConsoleStyle() << std::endl;
-		return setupCapture(videoCapture, width, height, fps);
+	//raw frame dumps are read directly, everything else goes through OpenCV
+	if (RawFileSource::isRawFile(fileName)) {
+		std::shared_ptr<RawFileSource> source = std::make_shared<RawFileSource>();
+		if (source->open(fileName, width, height, fps)) {
+			return setupCapture(source);
+		}
 	}
 	else {
-		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to open video file \"" << fileName << "\" for motion detection!" << ConsoleStyle() << std::endl;
+		std::shared_ptr<VideoCaptureSource> source = std::make_shared<VideoCaptureSource>();
+		if (source->openFile(fileName, width, height, fps)) {
+			return setupCapture(source);
+		}
 	}
     return false;
 }
 
 bool MotionDetector::openCamera(int cameraIndex, uint32_t width, uint32_t height, double fps)
 {
-	if(videoCapture.open(cameraIndex)) {
-		std::cout << ConsoleStyle(ConsoleStyle::GREEN) << "Opened camera #" << cameraIndex << " for motion detection." << ConsoleStyle() << std::endl;
-		return setupCapture(videoCapture, width, height, fps);
+	//try native V4L2 capture first, so the luma plane can be used without conversion
+	std::stringstream devicePath;
+	devicePath << "/dev/video" << cameraIndex;
+	std::shared_ptr<V4L2Source> v4l2Source = std::make_shared<V4L2Source>();
+	//the ring holds on to a driver buffer till its slot is written again
+	if (v4l2Source->open(devicePath.str(), width, height, fps, frameRing.getSlotCount())) {
+		return setupCapture(v4l2Source);
 	}
-	else {
-		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to open camera #" << cameraIndex << " for motion detection!" << ConsoleStyle() << std::endl;
+	//fall back to OpenCV capture
+	std::cout << ConsoleStyle(ConsoleStyle::YELLOW) << "Native V4L2 capture not possible, falling back to OpenCV capture." << ConsoleStyle() << std::endl;
+	std::shared_ptr<VideoCaptureSource> source = std::make_shared<VideoCaptureSource>();
+	if (source->openCamera(cameraIndex, width, height, fps)) {
+		return setupCapture(source);
 	}
     return false;
 }
 
-bool MotionDetector::setupCapture(cv::VideoCapture & captureDevice, uint32_t width, uint32_t height, double fps)
-{
-	//try capturing at wanted resolution and fps
-	captureDevice.set(CV_CAP_PROP_FRAME_WIDTH, width);
-	captureDevice.set(CV_CAP_PROP_FRAME_HEIGHT, height);
-	captureDevice.set(CV_CAP_PROP_FPS, fps);
-	//poll first frame for checking values
-	cv::Mat frame;
-	if (captureDevice.grab() && captureDevice.retrieve(frame)) {
-		//get frame values
-		videoWidth = frame.size().width;
-		videoHeight = frame.size().height;
-        videoColors = frame.channels();
-        switch (frame.depth()) {
-            case CV_8U:
-            case CV_8S:
-                videoBitsPerColor = 8;
-                break;
-            case CV_16U:
-            case CV_16S:
-                videoBitsPerColor = 16;
-                break;
-            case CV_32S:
-            case CV_32F:
-                videoBitsPerColor = 32;
-                break;
-            case CV_64F:
-                videoBitsPerColor = 64;
-                break;
-        }
-		const double newFps = captureDevice.get(CV_CAP_PROP_FPS);
-		if (newFps > 0.0) {
-			videoFps = newFps;
-		}
-		else {
-			std::cout << ConsoleStyle(ConsoleStyle::YELLOW) << "Failed to properly set fps!" << ConsoleStyle() << std::endl;
-			videoFps = fps;
-		}
-		std::cout << ConsoleStyle(ConsoleStyle::GREEN) << "Capturing at " << videoWidth << "x" << videoHeight << "@" << videoBitsPerColor * videoColors << "bpp with " << videoFps << " frames/s now." << ConsoleStyle() << std::endl;
-		//calculate polling interval. It's a bit less than the frame interval, to not skip any frames
-		pollingInterval = 1000.0 / videoFps * 0.9;
-		//calculate the number of frames to ignore before starting detection
-        framesToIgnore = 3.0 * videoFps;
-		//set up images needed for motion detection
-		const cv::Size imageSize(videoWidth, videoHeight);
-		greyFrame = cv::Mat(imageSize, CV_8U);
-		movingAverage = cv::Mat(imageSize, CV_32F);
-		averageGrey = cv::Mat(imageSize, CV_8U);
-		difference = cv::Mat(imageSize, CV_8U);
-		//start frame polling thread
-		active = true;
+bool MotionDetector::setupCapture(std::shared_ptr<FrameSource> source)
+{
+	frameSource = source;
+	//get frame values
+	videoWidth = frameSource->getWidth();
+	videoHeight = frameSource->getHeight();
+	videoFormat = frameSource->getFormat();
+	videoFps = frameSource->getFps();
+	std::cout << ConsoleStyle(ConsoleStyle::GREEN) << "Capturing at " << videoWidth << "x" << videoHeight << "@" << FrameSource::getBitsPerPixel(videoFormat) << "bpp with " << videoFps << " frames/s now." << ConsoleStyle() << std::endl;
+	std::cout << "Using " << MotionKernel::getInstructionSetName(kernel.getInstructionSet()) << " motion detection kernel on " << getThreadCount() << " thread(s)." << std::endl;
+	//calculate the number of frames to ignore before starting detection
+	framesToIgnore = 3.0 * videoFps;
+	//set up images needed for motion detection. sources handing out driver buffers do not need preallocated frames
+	const cv::Size imageSize(videoWidth, videoHeight);
+	if (!frameSource->usesDriverBuffers()) {
+		frameRing.allocate(frameSource->getImageSize(), frameSource->getImageType());
+	}
+	const cv::Size detectionSize(videoWidth >> pyramidLevel, videoHeight >> pyramidLevel);
+	movingAverage = cv::Mat(detectionSize, useFixedPointBackground ? CV_16U : CV_32F);
+	reserveBuffers(detectionSize);
+	//start frame capture and analysis threads
+	active = true;
+	if (pthread_create(&captureThread, 0, &MotionDetector::captureLoop, this) == 0) {
 		if (pthread_create(&thread, 0, &MotionDetector::frameLoop, this) == 0) {
-			std::cout << ConsoleStyle(ConsoleStyle::GREEN) << "Started frame polling thread." << ConsoleStyle() << std::endl;
-            return true;
-		}
-		else {
-			std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to start frame polling thread!" << ConsoleStyle() << std::endl;
-			thread = 0;
-			active = false;
-			captureDevice.release();
+			std::cout << ConsoleStyle(ConsoleStyle::GREEN) << "Started frame capture and analysis threads." << ConsoleStyle() << std::endl;
+			return true;
 		}
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to start frame analysis thread!" << ConsoleStyle() << std::endl;
+		thread = 0;
+		active = false;
+		pthread_join(captureThread, 0);
+		captureThread = 0;
 	}
 	else {
-		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to grab first frame!" << ConsoleStyle() << std::endl;
-		captureDevice.release();
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to start frame capture thread!" << ConsoleStyle() << std::endl;
+		captureThread = 0;
+		active = false;
 	}
+	frameSource->close();
     return false;
 }
 
@@ -129,7 +125,7 @@ bool MotionDetector::isPaused() const
 
 bool MotionDetector::isAvailable() const
 {
-	return (videoCapture.isOpened() && active);
+	return (frameSource && frameSource->isOpened() && active);
 }
 
 uint32_t MotionDetector::getWidth() const
@@ -147,6 +143,11 @@ double MotionDetector::getFps() const
 	return videoFps;
 }
 
+FrameSource::PixelFormat MotionDetector::getFormat() const
+{
+	return videoFormat;
+}
+
 void MotionDetector::setUseMorphology(bool enable)
 {
 	useMorphology = enable;
@@ -177,43 +178,227 @@ double MotionDetector::getBinaryThreshold() const
     return binaryThreshold;
 }
 
+void MotionDetector::setUseFixedPointBackground(bool enable)
+{
+    useFixedPointBackground = enable;
+}
+
+bool MotionDetector::getUseFixedPointBackground() const
+{
+    return useFixedPointBackground;
+}
+
+void MotionDetector::setUseSelectiveUpdate(bool enable)
+{
+    useSelectiveUpdate = enable;
+}
+
+bool MotionDetector::getUseSelectiveUpdate() const
+{
+    return useSelectiveUpdate;
+}
+
+void MotionDetector::setUseTiles(bool enable)
+{
+    useTiles = enable;
+}
+
+bool MotionDetector::getUseTiles() const
+{
+    return useTiles;
+}
+
+void MotionDetector::setUseEgoMotionCompensation(bool enable)
+{
+    useEgoMotionCompensation = enable;
+}
+
+bool MotionDetector::getUseEgoMotionCompensation() const
+{
+    return useEgoMotionCompensation;
+}
+
+void MotionDetector::setUseBackgroundMosaic(bool enable)
+{
+    useBackgroundMosaic = enable;
+}
+
+bool MotionDetector::getUseBackgroundMosaic() const
+{
+    return useBackgroundMosaic;
+}
+
+void MotionDetector::setBackgroundEngine(BackgroundEngine::Type type)
+{
+    backgroundEngineType = type;
+}
+
+BackgroundEngine::Type MotionDetector::getBackgroundEngine() const
+{
+    return backgroundEngineType;
+}
+
+void MotionDetector::setPyramidLevel(uint32_t level)
+{
+    pyramidLevel = level > 2 ? 2 : level;
+}
+
+uint32_t MotionDetector::getPyramidLevel() const
+{
+    return pyramidLevel;
+}
+
+void MotionDetector::setThreadCount(uint32_t count)
+{
+    threadCount = count;
+}
+
+uint32_t MotionDetector::getThreadCount() const
+{
+    return threadCount == 0 ? WorkerPool::getCpuCount() : threadCount;
+}
+
+void MotionDetector::setWorkerPool(std::shared_ptr<WorkerPool> pool)
+{
+    workerPool = pool;
+    poolThreadCount = pool->getThreadCount();
+    threadCount = poolThreadCount;
+    bands.clear();
+}
+
 bool MotionDetector::getLastMotion(MotionInformation & motionInfo)
 {
-	bool result = false;
-	//block mutex for member variables
-	pthread_mutex_lock(&mutex);
-	if (motionChanged) {
-		motionInfo = lastMotion;
-		motionChanged = false;
-		result = true;
+	//switch to the newest result. the analysis thread is never blocked
+	results.fetch();
+	const Result & result = results.getReadBuffer();
+	if (result.sequence == motionSequence) {
+		return false;
 	}
-	pthread_mutex_unlock(&mutex);
-	return result;
+	motionInfo = result.motion;
+	motionSequence = result.sequence;
+	return true;
+}
+
+bool MotionDetector::getTracks(std::vector<Tracker::Track> & tracks)
+{
+	results.fetch();
+	const Result & result = results.getReadBuffer();
+	if (result.sequence == tracksSequence) {
+		return false;
+	}
+	tracks = result.tracks;
+	tracksSequence = result.sequence;
+	return true;
+}
+
+bool MotionDetector::getLastFrame(FrameHandle & handle)
+{
+	results.fetch();
+	const Result & result = results.getReadBuffer();
+	if (result.sequence == frameSequence || result.frame.empty()) {
+		return false;
+	}
+	handle = result.frame;
+	frameSequence = result.sequence;
+	return true;
 }
 
 bool MotionDetector::getLastFrame(cv::Mat & lastFrame, bool drawMotion)
 {
-	bool result = false;
-	//block mutex for member variables
-	pthread_mutex_lock(&mutex);
-	if (frameChanged) {
-		lastFrame = frame.clone();
-		//overlay frame motion rect if caller wants to and if motion was detected
-		if (drawMotion && lastMotion.motionDetected) {
-			cv::rectangle(lastFrame, cv::Point(lastMotion.x, lastMotion.y), cv::Point(lastMotion.x + lastMotion.w, lastMotion.y + lastMotion.h), CV_RGB(255, 0, 0));
-			//mark center of motion
-			cv::line(lastFrame, cv::Point(lastMotion.cx - 3, lastMotion.cy), cv::Point(lastMotion.cx + 3, lastMotion.cy), CV_RGB(255, 0, 0));
-			cv::line(lastFrame, cv::Point(lastMotion.cx, lastMotion.cy - 3), cv::Point(lastMotion.cx, lastMotion.cy + 3), CV_RGB(255, 0, 0));
-			//mark center of frame
-			const int cx = lastFrame.size().width / 2;
-			const int cy = lastFrame.size().height / 2;
-			cv::line(lastFrame, cv::Point(cx - 3, cy), cv::Point(cx + 3, cy), CV_RGB(0, 255, 0));
-			cv::line(lastFrame, cv::Point(cx, cy - 3), cv::Point(cx, cy + 3), CV_RGB(0, 255, 0));
+	results.fetch();
+	const Result & result = results.getReadBuffer();
+	if (result.sequence == frameSequence || result.frame.empty()) {
+		return false;
+	}
+	//build BGR image only now that it is actually needed. the read buffer belongs to this thread, so no lock is needed
+	FrameSource::convertToBGR(lastFrame, result.frame.getImage(), videoFormat);
+	//overlay frame motion rect if caller wants to and if motion was detected
+	const MotionInformation & lastMotion = result.motion;
+	if (drawMotion && lastMotion.motionDetected) {
+		cv::rectangle(lastFrame, cv::Point(lastMotion.x, lastMotion.y), cv::Point(lastMotion.x + lastMotion.w, lastMotion.y + lastMotion.h), CV_RGB(255, 0, 0));
+		//mark center of motion
+		cv::line(lastFrame, cv::Point(lastMotion.cx - 3, lastMotion.cy), cv::Point(lastMotion.cx + 3, lastMotion.cy), CV_RGB(255, 0, 0));
+		cv::line(lastFrame, cv::Point(lastMotion.cx, lastMotion.cy - 3), cv::Point(lastMotion.cx, lastMotion.cy + 3), CV_RGB(255, 0, 0));
+		//mark center of frame
+		const int cx = lastFrame.size().width / 2;
+		const int cy = lastFrame.size().height / 2;
+		cv::line(lastFrame, cv::Point(cx - 3, cy), cv::Point(cx + 3, cy), CV_RGB(0, 255, 0));
+		cv::line(lastFrame, cv::Point(cx, cy - 3), cv::Point(cx, cy + 3), CV_RGB(0, 255, 0));
+	}
+	//overlay tracks with their IDs
+	if (drawMotion) {
+		for (auto tIt = result.tracks.cbegin(); tIt != result.tracks.cend(); ++tIt) {
+			cv::rectangle(lastFrame, tIt->boundingBox, CV_RGB(255, 255, 0));
+			cv::putText(lastFrame, std::to_string(tIt->id), cv::Point(tIt->boundingBox.x, tIt->boundingBox.y - 2), cv::FONT_HERSHEY_PLAIN, 1.0, CV_RGB(255, 255, 0));
+		}
+	}
+	frameSequence = result.sequence;
+	return true;
+}
+
+bool MotionDetector::waitForResult(uint32_t timeoutMs)
+{
+	return resultNotifier.wait(timeoutMs);
+}
+
+bool MotionDetector::waitForMotion(MotionInformation & motionInfo, uint32_t timeoutMs)
+{
+	const uint64_t deadline = getTimestampUs() + timeoutMs * 1000ULL;
+	//the notification of a result already read may still be pending, so wait again till a new result is there
+	while (!getLastMotion(motionInfo)) {
+		const uint64_t now = getTimestampUs();
+		if (now >= deadline || !resultNotifier.wait((deadline - now + 999) / 1000)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int MotionDetector::getResultDescriptor() const
+{
+	return resultNotifier.getDescriptor();
+}
+
+uint32_t MotionDetector::subscribe(ResultCallback callback, void * context)
+{
+	pthread_mutex_lock(&subscriberMutex);
+	Subscriber subscriber = {nextSubscriberId++, callback, context, 0};
+	subscribers.push_back(subscriber);
+	pthread_mutex_unlock(&subscriberMutex);
+	return subscriber.id;
+}
+
+void MotionDetector::unsubscribe(uint32_t id)
+{
+	pthread_mutex_lock(&subscriberMutex);
+	for (auto sIt = subscribers.begin(); sIt != subscribers.end(); ++sIt) {
+		if (sIt->id == id) {
+			subscribers.erase(sIt);
+			break;
 		}
-		frameChanged = false;
-		result = true;
 	}
-	pthread_mutex_unlock(&mutex);
+	pthread_mutex_unlock(&subscriberMutex);
+}
+
+MotionDetector::Statistics MotionDetector::getStatistics()
+{
+	results.fetch();
+	Statistics result = results.getReadBuffer().statistics;
+	//the capture counters live in the frame ring
+	result.capturedFrames = frameRing.getCapturedFrames();
+	result.droppedFrames = frameRing.getDroppedFrames();
+	result.analyzedFrames = analyzedFrames;
+	return result;
+}
+
+bool MotionDetector::getTileActivity(cv::Mat & activity)
+{
+	results.fetch();
+	const cv::Mat & tileActivity = results.getReadBuffer().tileActivity;
+	const bool result = !tileActivity.empty();
+	if (result) {
+		tileActivity.copyTo(activity);
+	}
 	return result;
 }
 
@@ -222,127 +407,582 @@ bool MotionDetector::convertFrame(cv::Mat & destination, const cv::Mat & source,
     source.convertTo(destination, bpp);
 }
 
+void * MotionDetector::captureLoop(void * obj)
+{
+	MotionDetector * detector = reinterpret_cast<MotionDetector *>(obj);
+	//video files are paced to their frame rate, cameras deliver frames at their own pace
+	const bool liveSource = detector->frameSource->isLive();
+	const uint64_t frameInterval = 1000000.0 / detector->videoFps;
+	uint64_t nextFrameTime = getTimestampUs();
+	//start thread loop
+	while (detector != nullptr && detector->active) {
+		if (!liveSource) {
+			//sleep till absolute time of next frame, so processing time does not add up
+			nextFrameTime += frameInterval;
+			timespec deadline;
+			deadline.tv_sec = nextFrameTime / 1000000;
+			deadline.tv_nsec = (nextFrameTime % 1000000) * 1000;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr);
+		}
+		//get free ring slot to capture to. there always is one unless the analysis thread misbehaves
+		FrameRing::Slot * slot = detector->frameRing.beginWrite();
+		if (slot == nullptr) {
+			usleep(1000);
+			continue;
+		}
+		//give the driver buffer the slot referred to back to the source before reusing the slot
+		detector->frameSource->requeue(slot->bufferIndex);
+		slot->bufferIndex = -1;
+		//read frame from source. this blocks till the next frame is available
+		uint64_t timestamp = 0;
+		if (detector->frameSource->read(slot->image, slot->bufferIndex, timestamp)) {
+			detector->frameRing.commitWrite(timestamp);
+			continue;
+		}
+		detector->frameRing.abortWrite();
+		//no frame. the video might have ended, so don't spin
+		if (liveSource) {
+			usleep(1000);
+		}
+	}
+	return nullptr;
+}
+
+void MotionDetector::reserveBuffers(const cv::Size & detectionSize)
+{
+	//bands write to their rows only, so the detection images are allocated up front anyway
+	if (pyramidLevel > 0) {
+		pyramidFrame.create(detectionSize, CV_8U);
+	}
+	difference.create(detectionSize, CV_8U);
+	morphologyBuffer.create(detectionSize, CV_8U);
+	tileGate.setup(detectionSize);
+	blobExtractor.reserve(detectionSize.width, detectionSize.area() / PixelsPerReservedLabel);
+	measurements.reserve(ReservedBlobs);
+	tracker.reserve(ReservedTracks, ReservedBlobs);
+	setupBands(detectionSize);
+	//the threads are not running yet, so all three results can be accessed. they take turns, so each needs the capacity
+	for (uint32_t i = 0; i < 3; ++i) {
+		Result & result = results.getBuffer(i);
+		result.tracks.reserve(ReservedTracks);
+		if (useTiles) {
+			tileGate.getTileActivity().copyTo(result.tileActivity);
+		}
+	}
+}
+
+void MotionDetector::setupBands(const cv::Size & detectionSize)
+{
+	const int height = detectionSize.height;
+	const uint32_t wantedThreads = getThreadCount();
+	if (!workerPool || poolThreadCount != wantedThreads) {
+		workerPool = std::make_shared<WorkerPool>(wantedThreads);
+		poolThreadCount = wantedThreads;
+		bands.clear();
+	}
+	//bands with only a few rows are not worth the synchronization
+	const int bandCount = std::max(1, std::min<int>(workerPool->getThreadCount(), height / 16));
+	if ((int)bands.size() == bandCount && bands.back().rows.end == height) {
+		return;
+	}
+	bands.assign(bandCount, Band(kernel));
+	//the tile gate finds at most one region per tile
+	const uint32_t tileSize = tileGate.getTileSize();
+	const uint32_t tileCount = ((detectionSize.width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize);
+	bandExtractors.clear();
+	for (int b = 0; b < bandCount; ++b) {
+		bands[b].rows = cv::Range(height * b / bandCount, height * (b + 1) / bandCount);
+		//in tiled mode a band may get all regions, so reserve for the whole image
+		bands[b].blobExtractor.reserve(detectionSize.width, detectionSize.area() / PixelsPerReservedLabel);
+		bands[b].regions.reserve(tileCount);
+		bandExtractors.push_back(&bands[b].blobExtractor);
+	}
+}
+
+void MotionDetector::runBands(BandJob & job)
+{
+	workerPool->run(bands.size(), &MotionDetector::processBand, &job);
+}
+
+void MotionDetector::splitRegions(const std::vector<cv::Rect> & regions)
+{
+	uint64_t totalArea = 0;
+	for (auto rIt = regions.cbegin(); rIt != regions.cend(); ++rIt) {
+		totalArea += rIt->area();
+	}
+	auto rIt = regions.cbegin();
+	uint64_t area = 0;
+	for (size_t b = 0; b < bands.size(); ++b) {
+		//take regions till the band's share of the total area is reached. the last band takes the rest
+		const uint64_t bandEnd = b + 1 < bands.size() ? totalArea * (b + 1) / bands.size() : totalArea;
+		bands[b].regions.clear();
+		while (rIt != regions.cend() && area < bandEnd) {
+			bands[b].regions.push_back(*rIt);
+			area += rIt->area();
+			++rIt;
+		}
+	}
+}
+
+void MotionDetector::processBand(void * obj, uint32_t index)
+{
+	BandJob * job = reinterpret_cast<BandJob *>(obj);
+	MotionDetector * detector = job->detector;
+	Band & band = detector->bands[index];
+	//bands run on pool threads that may work for other detectors too, so count into a counter of this task
+	uint64_t allocationCount = 0;
+	uint64_t * threadCounter = AllocationCounter::countThread(&allocationCount);
+	switch (job->stage) {
+		case STAGE_DOWNSCALE:
+			band.kernel.downscale(*job->frame, job->format, job->scale, detector->pyramidFrame, band.rows);
+			break;
+		case STAGE_DETECT:
+			band.kernel.detect(*job->frame, job->format, detector->movingAverage, 0.050, job->threshold, detector->difference, job->outputDifference, job->selectiveUpdate, band.rows);
+			break;
+		case STAGE_ENGINE:
+			detector->backgroundEngine->apply(*job->frame, detector->difference, band.rows);
+			break;
+		case STAGE_THRESHOLD:
+			//same as cv::adaptiveThreshold with a 3x3 mean and C = -5, but without temporary images
+			band.kernel.adaptiveThreshold(detector->difference, detector->morphologyBuffer, 5, band.rows);
+			break;
+		case STAGE_DILATE:
+			band.morphology.dilate(detector->difference, detector->morphologyBuffer, job->radius, band.rows);
+			break;
+		case STAGE_ERODE:
+			band.morphology.erode(detector->morphologyBuffer, detector->difference, job->radius, band.rows);
+			break;
+		case STAGE_LABEL:
+			band.blobExtractor.extract(detector->difference, band.rows);
+			break;
+		case STAGE_REGIONS:
+			//regions don't overlap, so they are processed in place
+			for (auto rIt = band.regions.cbegin(); rIt != band.regions.cend(); ++rIt) {
+				cv::Mat region = detector->difference(*rIt);
+				band.morphology.dilate(region, region, job->radius);
+				band.morphology.erode(region, region, job->erodeRadius);
+			}
+			band.blobExtractor.extract(detector->difference, band.regions);
+			break;
+	}
+	AllocationCounter::countThread(threadCounter);
+	if (allocationCount > 0) {
+		detector->bandAllocations += allocationCount;
+	}
+}
+
+static uint64_t getImageMemory(const cv::Mat & image)
+{
+	return image.total() * image.elemSize();
+}
+
+uint64_t MotionDetector::getMemoryUsage()
+{
+	uint64_t result = frameRing.getMemoryUsage() + (frameSource ? frameSource->getBufferMemory() : 0);
+	result += getImageMemory(pyramidFrame) + getImageMemory(movingAverage) + getImageMemory(difference) + getImageMemory(morphologyBuffer);
+	result += kernel.getMemoryUsage() + blobExtractor.getMemoryUsage() + tileGate.getMemoryUsage() + tracker.getMemoryUsage();
+	//only the write buffer may be accessed here, the other two results are about the same size
+	const Result & writeResult = results.getWriteBuffer();
+	result += measurements.capacity() * sizeof(Tracker::Measurement) + 3 * (writeResult.tracks.capacity() * sizeof(Tracker::Track) + getImageMemory(writeResult.tileActivity));
+	result += getImageMemory(egoFrame) + phaseCorrelator.getMemoryUsage() + getImageMemory(egoBackground) + mosaic.getMemoryUsage();
+	result += backgroundEngine ? backgroundEngine->getMemoryUsage() : 0;
+	for (auto bIt = bands.cbegin(); bIt != bands.cend(); ++bIt) {
+		result += bIt->kernel.getMemoryUsage() + bIt->morphology.getMemoryUsage() + bIt->blobExtractor.getMemoryUsage() + bIt->regions.capacity() * sizeof(cv::Rect);
+	}
+	return result;
+}
+
+void MotionDetector::compensateEgoMotion(const cv::Mat & frame, const cv::Mat & detectionFrame, FrameSource::PixelFormat format, uint32_t scale)
+{
+	//phase correlation needs few pixels to find a global shift. downscale to at most 160 pixels wide
+	uint32_t factor = 1;
+	while (videoWidth / factor > 160 && factor < 16) {
+		factor *= 2;
+	}
+	kernel.downscale(frame, videoFormat, factor, egoFrame);
+	globalShift = cv::Point2f(0.0f, 0.0f);
+	//the correlator transforms in its own buffers, so it doesn't allocate once set up for the frame size
+	cv::Point2f shift;
+	if (phaseCorrelator.correlate(egoFrame, shift)) {
+		globalShift = shift * (float)factor;
+	}
+	//the view moves against the image content
+	cameraPose -= globalShift;
+	//sub-pixel shifts at detection resolution are noise
+	const float shiftX = globalShift.x / scale;
+	const float shiftY = globalShift.y / scale;
+	if (shiftX * shiftX + shiftY * shiftY < 0.5f * 0.5f || frameNr == 0) {
+		return;
+	}
+	if (backgroundEngine) {
+		//engine models can not be warped. start over with the new view
+		if (backgroundEngine->getSize() == detectionFrame.size()) {
+			backgroundEngine->initialize(detectionFrame);
+			tracker.shift(globalShift.x, globalShift.y);
+		}
+		return;
+	}
+	if (movingAverage.size() != detectionFrame.size()) {
+		return;
+	}
+	//move the background with the view. pixels that moved into view have no background yet, so start them with the current frame
+	kernel.initialize(detectionFrame, format, egoBackground, movingAverage.type());
+	if (useBackgroundMosaic) {
+		//parts seen before are better than the current frame, which may contain a target
+		mosaic.seed(egoBackground, getMosaicPosition(scale));
+	}
+	const cv::Matx23d transform(1.0, 0.0, shiftX, 0.0, 1.0, shiftY);
+	cv::warpAffine(movingAverage, egoBackground, transform, movingAverage.size(), cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
+	std::swap(movingAverage, egoBackground);
+	//tracks move with the view too, their velocities stay relative to the scene
+	tracker.shift(globalShift.x, globalShift.y);
+}
+
+cv::Point MotionDetector::getMosaicPosition(uint32_t scale) const
+{
+	return cv::Point(cvRound(cameraPose.x / scale), cvRound(cameraPose.y / scale));
+}
+
+bool MotionDetector::analyzeFrame(const cv::Mat & frame, uint64_t timestamp, MotionInformation & motion)
+{
+	//in pyramid mode detection runs on a downscaled luma image
+	const uint32_t scale = 1 << pyramidLevel;
+	const cv::Size detectionSize(videoWidth / scale, videoHeight / scale);
+	//split the detection image into horizontal bands that are processed in parallel
+	setupBands(detectionSize);
+	//switch the background engine. the running average is built in and needs no engine
+	const BackgroundEngine::Type engineType = backgroundEngineType;
+	if (engineType != (backgroundEngine ? backgroundEngine->getType() : BackgroundEngine::TYPE_RUNNING_AVERAGE)) {
+		backgroundEngine = BackgroundEngine::create(engineType);
+		if (backgroundEngine) {
+			movingAverage.release();
+			egoBackground.release();
+		}
+		frameNr = 0;
+	}
+	BandJob job = {this, STAGE_DOWNSCALE, &frame, videoFormat, scale, 0, 0, binaryThreshold, useAdaptiveThreshold, useSelectiveUpdate};
+	//engines need a greyscale frame. formats with a luma plane can use it directly at full resolution
+	cv::Mat lumaPlane;
+	const bool hasLumaPlane = videoFormat == FrameSource::FORMAT_GREY || videoFormat == FrameSource::FORMAT_NV12 || videoFormat == FrameSource::FORMAT_I420;
+	if (scale > 1 || (backgroundEngine && !hasLumaPlane)) {
+		//bands write to their rows only, so allocate the destination up front
+		pyramidFrame.create(detectionSize, CV_8U);
+		runBands(job);
+		job.frame = &pyramidFrame;
+		job.format = FrameSource::FORMAT_GREY;
+	}
+	else if (backgroundEngine) {
+		lumaPlane = FrameSource::getLuma(frame, videoFormat, pyramidFrame);
+		job.frame = &lumaPlane;
+		job.format = FrameSource::FORMAT_GREY;
+	}
+	const cv::Mat & detectionFrame = *job.frame;
+	//keep the moving average aligned with the view when the camera moves
+	if (useEgoMotionCompensation) {
+		compensateEgoMotion(frame, detectionFrame, job.format, scale);
+	}
+	//start over if the moving average representation or the pyramid level was changed
+	const int averageType = useFixedPointBackground ? CV_16U : CV_32F;
+	if (backgroundEngine ? backgroundEngine->getSize() != detectionFrame.size() : (movingAverage.type() != averageType || movingAverage.cols != detectionFrame.cols)) {
+		frameNr = 0;
+	}
+	//the mosaic is only valid as long as the camera pose is tracked. it stores the running average
+	const bool updateMosaic = useBackgroundMosaic && useEgoMotionCompensation && !backgroundEngine;
+	if (updateMosaic) {
+		mosaic.setup(averageType, scale);
+	}
+	//check if first frame
+	if (frameNr++ == 0) {
+		//on first frame only copy luma to running average or engine model. old tracks don't fit the new background
+		if (backgroundEngine) {
+			backgroundEngine->initialize(detectionFrame);
+		}
+		else {
+			kernel.initialize(detectionFrame, job.format, movingAverage, averageType);
+		}
+		tracker.setup(cv::Size(videoWidth, videoHeight));
+		//skip the warm-up if the view was seen before
+		if (updateMosaic && mosaic.seed(movingAverage, getMosaicPosition(scale)) >= 0.9f) {
+			frameNr = framesToIgnore;
+		}
+		return false;
+	}
+	difference.create(detectionSize, CV_8U);
+	morphologyBuffer.create(detectionSize, CV_8U);
+	if (backgroundEngine) {
+		//engines classify and update in one pass. they learn during the warm-up frames too
+		job.stage = STAGE_ENGINE;
+		runBands(job);
+		backgroundEngine->finishFrame();
+		if (frameNr < framesToIgnore) {
+			return false;
+		}
+	}
+	else if (frameNr < framesToIgnore) {
+		//accumulate frames, but nothing more
+		kernel.accumulate(detectionFrame, job.format, movingAverage, 0.10);
+		return false;
+	}
+	else {
+		//accumulate frame, calculate difference between average and current frame and convert to binary image in one pass.
+		//adaptive thresholding needs the difference image, so it is done separately
+		job.stage = STAGE_DETECT;
+		runBands(job);
+		if (job.outputDifference) {
+			job.stage = STAGE_THRESHOLD;
+			runBands(job);
+			std::swap(difference, morphologyBuffer);
+		}
+	}
+	//with morphology a close operation fills in the gaps in the binary image, which is 8 iterations of a 3x3 kernel or 17x17.
+	//without it blobs are grown by dilating and eroding with 12 and 8 iterations, which is 25x25 and 17x17.
+	//downscaled images need proportionally smaller kernels
+	const uint32_t dilateRadius = (useMorphology ? 8 : 12) / scale;
+	const uint32_t erodeRadius = 8 / scale;
+	if (useTiles) {
+		//only process tiles with changes plus the halo morphology can reach
+		const std::vector<cv::Rect> & regions = tileGate.update(difference, dilateRadius + erodeRadius);
+		if (regions.empty()) {
+			blobExtractor.extract(difference, regions);
+		}
+		else {
+			//regions are independent, so bands close and label their share of the regions in parallel
+			splitRegions(regions);
+			job.stage = STAGE_REGIONS;
+			job.radius = dilateRadius;
+			job.erodeRadius = erodeRadius;
+			runBands(job);
+			blobExtractor.joinRegions(bandExtractors);
+		}
+	}
+	else {
+		//bands read the rows of their neighbours up to the kernel radius, so dilation and erosion alternate between images
+		job.stage = STAGE_DILATE;
+		job.radius = dilateRadius;
+		runBands(job);
+		job.stage = STAGE_ERODE;
+		job.radius = erodeRadius;
+		runBands(job);
+		//find connected blobs in bands and join blobs crossing band borders
+		job.stage = STAGE_LABEL;
+		runBands(job);
+		blobExtractor.mergeBands(bandExtractors);
+	}
+	//pick the blob with the biggest area
+	const BlobExtractor::Blob * biggestBlob = blobExtractor.getBiggestBlob();
+	//store biggest blob if one exists
+	if (biggestBlob != nullptr && biggestBlob->area * scale * scale > 40) {
+		cv::Rect biggestRect = biggestBlob->boundingBox;
+		if (scale > 1) {
+			//refine the blob at full resolution. search the scaled up box plus one coarse pixel on each side
+			const cv::Rect region = cv::Rect((biggestRect.x - 1) * scale, (biggestRect.y - 1) * scale, (biggestRect.width + 2) * scale, (biggestRect.height + 2) * scale) & cv::Rect(0, 0, videoWidth, videoHeight);
+			//engines have no full resolution background to refine against
+			const cv::Rect refinedRect = backgroundEngine ? cv::Rect() : kernel.refine(frame, videoFormat, movingAverage, scale, region, job.threshold);
+			//keep the scaled up box if refining found no changed pixels
+			biggestRect = refinedRect.area() > 0 ? refinedRect : (cv::Rect(biggestRect.x * scale, biggestRect.y * scale, biggestRect.width * scale, biggestRect.height * scale) & region);
+		}
+		motion.motionDetected = true;
+		motion.area = biggestBlob->area * scale * scale;
+		motion.x = biggestRect.x;
+		motion.y = biggestRect.y;
+		motion.w = biggestRect.width;
+		motion.h = biggestRect.height;
+		motion.cx = biggestRect.x + biggestRect.width / 2;
+		motion.cy = biggestRect.y + biggestRect.height / 2;
+		//calculate distance to frame center
+		int dx = (videoWidth / 2 - motion.cx);
+		int dy = (videoHeight / 2 - motion.cy);
+		motion.distance2 = dx * dx + dy * dy;
+	}
+	motion.timestamp = timestamp;
+	//store the background of the view now and then while the camera rests
+	if (updateMosaic && frameNr % 10 == 0 && globalShift.x * globalShift.x + globalShift.y * globalShift.y < 0.25f * scale * scale) {
+		mosaic.store(movingAverage, getMosaicPosition(scale));
+	}
+	//follow all blobs big enough to be motion, not only the biggest
+	const std::vector<BlobExtractor::Blob> & blobs = blobExtractor.getBlobs();
+	const float offset = (scale - 1) / 2.0f;
+	int32_t biggestMeasurement = -1;
+	measurements.clear();
+	for (auto bIt = blobs.cbegin(); bIt != blobs.cend(); ++bIt) {
+		if (bIt->area * scale * scale > 40) {
+			if (&(*bIt) == biggestBlob) {
+				biggestMeasurement = measurements.size();
+			}
+			const cv::Rect & box = bIt->boundingBox;
+			Tracker::Measurement measurement = {bIt->cx * scale + offset, bIt->cy * scale + offset, cv::Rect(box.x * scale, box.y * scale, box.width * scale, box.height * scale), bIt->area * scale * scale};
+			measurements.push_back(measurement);
+		}
+	}
+	tracker.update(measurements, timestamp);
+	//the motion moves like the track of its blob. unconfirmed tracks have no reliable velocity yet
+	const Tracker::Track * track = biggestMeasurement >= 0 ? tracker.getMeasurementTrack(biggestMeasurement) : nullptr;
+	if (track != nullptr && track->confirmed) {
+		motion.trackId = track->id;
+		motion.vx = track->vx;
+		motion.vy = track->vy;
+	}
+	return true;
+}
+
 void * MotionDetector::frameLoop(void * obj)
 {
 	MotionDetector * detector = reinterpret_cast<MotionDetector *>(obj);
+	//count the allocations of the analysis in debug builds. band tasks count their own
+	uint64_t threadAllocations = 0;
+	AllocationCounter::countThread(&threadAllocations);
 	//start thread loop
     while (detector != nullptr && detector->active) {
-	    //block mutex for member variables
-    	pthread_mutex_lock(&detector->mutex);
-		//grab frame from camera/video if there are any
-		if (!detector->paused && detector->videoCapture.grab()) {
-			//frame's there, retrieve it
-			if (detector->videoCapture.retrieve(detector->frame)) {
+		//wait for the newest captured frame. older frames we didn't get to have been dropped by the ring
+		FrameRing::Slot * slot = detector->frameRing.acquireNewest(100);
+		if (slot == nullptr) {
+			continue;
+		}
+		if (detector->paused) {
+			detector->frameRing.release(slot);
+			continue;
+		}
+		const cv::Mat & frame = slot->image;
+		MotionInformation motion;
 #ifdef DO_TIMING
-                timespec startTime;
-                clock_gettime(CLOCK_THREAD_CPUTIME_ID, &startTime);
+		//bands run on several threads, so measure wall clock time
+		const uint64_t startTime = getTimestampUs();
 #endif
-				//convert image to greyscale
-				cv::cvtColor(detector->frame, detector->greyFrame, CV_BGR2GRAY);
-				//check if first frame
-				if (detector->frameNr++ == 0) {
-					//on first frame only copy image to running average
-					detector->greyFrame.convertTo(detector->movingAverage, CV_32F);//, 1.0, 0.0);
-				}
-				else if (detector->frameNr < detector->framesToIgnore) {
-				    //accumulate frames, but nothing more
-					cv::accumulateWeighted(detector->greyFrame, detector->movingAverage, 0.10);
-				}
-				else {
-					//accumulate frames
-					cv::accumulateWeighted(detector->greyFrame, detector->movingAverage, 0.050);
-					//convert moving average back to 8bit
-					detector->movingAverage.convertTo(detector->averageGrey, CV_8U);
-					//calculate difference between average and current frame
-					cv::absdiff(detector->averageGrey, detector->greyFrame, detector->difference);
-					//convert to binary image
-					if (detector->useAdaptiveThreshold) {
-					    cv::adaptiveThreshold(detector->difference, detector->difference, 255.0, cv::ADAPTIVE_THRESH_MEAN_C, CV_THRESH_BINARY, 3, -5);
-					}
-					else {
-					    cv::threshold(detector->difference, detector->difference, detector->binaryThreshold, 255.0, CV_THRESH_BINARY);
-					}
-					//detector->difference.convertTo(detector->frame, CV_8U);
-					//use different paths if the user wants to use morphology functions
-					std::vector<std::vector<cv::Point>> contours;
-					std::vector<cv::Vec4i> hierarchy;
-					if (detector->useMorphology) {
-						//perform morphological close operation to fill in the gaps in the binary image
-						//cv::Mat element = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(10, 10));
-						cv::morphologyEx(detector->difference, detector->difference, cv::MORPH_CLOSE, cv::Mat(), cv::Point(-1, -1), 8);
-						//create contours from binary image
-						cv::findContours(detector->difference, contours, hierarchy, CV_CHAIN_APPROX_TC89_L1, CV_CHAIN_APPROX_SIMPLE);
-					}
-					else {
-						//dilate and erode to get better blobs in the binary image
-						cv::dilate(detector->difference, detector->difference, cv::Mat(), cv::Point(-1, -1), 12);
-						cv::erode(detector->difference, detector->difference, cv::Mat(), cv::Point(-1, -1), 8);
-						//create contours from binary image
-						//CV_RETR_EXTERNAL, CV_RETR_CCOMP, CV_CHAIN_APPROX_TC89_L1, CV_CHAIN_APPROX_TC89_KCOS
-						cv::findContours(detector->difference, contours, hierarchy, CV_CHAIN_APPROX_TC89_L1, CV_CHAIN_APPROX_SIMPLE);
-					}
-					//analyze contours and find biggest contour
-					cv::Rect biggestRect;
-					auto biggestContour = contours.cend();
-					for(auto cIt = contours.cbegin(); cIt != contours.cend(); ++cIt) {
-						//bounding rectangle around the contour
-						cv::Rect rect = cv::boundingRect(*cIt);
-						if (rect.area() > biggestRect.area()) {
-							biggestRect = rect;
-							biggestContour = cIt;
-						}
-					}
-					//store biggest contour if one exists
-					if (biggestContour != contours.cend() && biggestRect.area() > 40) {
-						detector->lastMotion.motionDetected = true;
-						detector->lastMotion.x = biggestRect.x;
-						detector->lastMotion.y = biggestRect.y;
-						detector->lastMotion.w = biggestRect.width;
-						detector->lastMotion.h = biggestRect.height;
-						detector->lastMotion.cx = biggestRect.x + biggestRect.width / 2;
-						detector->lastMotion.cy = biggestRect.y + biggestRect.height / 2;
-						//calculate distance to frame center
-                        int dx = (detector->frame.size().width / 2 - detector->lastMotion.cx);
-                        int dy = (detector->frame.size().height / 2 - detector->lastMotion.cy);
-                        detector->lastMotion.distance2 = dx * dx + dy * dy;
-					}
-					else {
-						detector->lastMotion.motionDetected = false;
-					}
-					detector->motionChanged = true;
-					detector->frameChanged = true;
-				}
+		const uint64_t allocationCount = threadAllocations + detector->bandAllocations;
+		const bool motionAnalyzed = detector->analyzeFrame(frame, slot->timestamp, motion);
 #ifdef DO_TIMING
-                timespec endTime;
-                clock_gettime(CLOCK_THREAD_CPUTIME_ID, &endTime);
-                static float miliseconds = 0;
-                miliseconds += (endTime.tv_nsec - startTime.tv_nsec) / (1000.0f * 1000.0f);
-                if (detector->frameNr % 10 == 0) {
-                    std::cout << "Processing time " << miliseconds / 10.0f << "ms." << std::endl;
-                    miliseconds = 0;
-                }
+		static float miliseconds = 0;
+		miliseconds += (getTimestampUs() - startTime) / 1000.0f;
+		if (detector->frameNr % 10 == 0) {
+			std::cout << "Processing time " << miliseconds / 10.0f << "ms on " << detector->bands.size() << " bands, dropped " << detector->frameRing.getDroppedFrames() << " frames so far.";
+			if (detector->useTiles) {
+				std::cout << " " << detector->tileGate.getActiveTiles() << "/" << detector->tileGate.getTileCount().area() << " tiles active.";
+			}
+			std::cout << std::endl;
+			miliseconds = 0;
+		}
+#endif
+		if (motionAnalyzed) {
+			//fill the result buffer only this thread owns. the buffers are reused, so tracks and tile activity do not allocate
+			Result & result = detector->results.getWriteBuffer();
+			Statistics & statistics = result.statistics;
+			if (detector->useTiles) {
+				statistics.tileCount = detector->tileGate.getTileCount().area();
+				statistics.activeTiles = detector->tileGate.getActiveTiles();
+				statistics.processedTiles = detector->tileGate.getProcessedTiles();
+				detector->tileGate.getTileActivity().copyTo(result.tileActivity);
+			}
+			statistics.memoryBytes = detector->getMemoryUsage();
+			statistics.globalShiftX = detector->globalShift.x;
+			statistics.globalShiftY = detector->globalShift.y;
+			statistics.cameraX = detector->cameraPose.x;
+			statistics.cameraY = detector->cameraPose.y;
+			statistics.mosaicTiles = detector->mosaic.getTileCount();
+			result.sequence = ++detector->resultSequence;
+			result.motion = motion;
+			detector->tracker.getConfirmedTracks(result.tracks);
+			//the result keeps holding the slot, so the capture thread does not overwrite the published frame
+			result.frame = FrameHandle(&detector->frameRing, slot);
+			//buffers are reserved up front or grow during the first frames, so analysis should not allocate afterwards
+			const uint64_t frameAllocations = detector->frameNr > detector->framesToIgnore + AllocationWarmupFrames ? threadAllocations + detector->bandAllocations - allocationCount : 0;
+			detector->allocations += frameAllocations;
+			statistics.allocations = detector->allocations;
+			statistics.lastLatencyUs = getTimestampUs() - slot->timestamp;
+			const uint64_t sequence = result.sequence;
+			detector->results.publish();
+			//the new write buffer holds an old result. give its frame back, so the slot can be reused for capturing
+			detector->results.getWriteBuffer().frame.reset();
+			//wake up readers waiting for results and tell the subscribers
+			detector->resultNotifier.notify();
+			pthread_mutex_lock(&detector->subscriberMutex);
+			for (auto sIt = detector->subscribers.begin(); sIt != detector->subscribers.end(); ++sIt) {
+				if (sIt->sequence < sequence) {
+					sIt->sequence = sequence;
+					sIt->callback(sIt->context, sequence, motion);
+				}
+			}
+			pthread_mutex_unlock(&detector->subscriberMutex);
+			if (frameAllocations > 0) {
+				std::cout << ConsoleStyle(ConsoleStyle::RED) << "Frame " << detector->frameNr << " made " << frameAllocations << " heap allocations after warm-up!" << ConsoleStyle() << std::endl;
+#ifdef ABORT_ON_ALLOCATION
+				//stop right away, so the allocating frame can be inspected in a core dump
+				abort();
 #endif
 			}
 		}
-		//unlock mutex again
-		pthread_mutex_unlock(&detector->mutex);
-		//sleep between polling camera frames
-		usleep(detector->pollingInterval * 1000);
+		else {
+			detector->frameRing.release(slot);
+		}
+		detector->analyzedFrames++;
+	}
+	AllocationCounter::countThread(nullptr);
+	return nullptr;
+}
+
+double MotionDetector::benchmark(uint32_t width, uint32_t height, uint32_t frames)
+{
+	if (active) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Can not run benchmark while capturing!" << ConsoleStyle() << std::endl;
+		return -1.0;
+	}
+	videoWidth = width;
+	videoHeight = height;
+	videoFormat = FrameSource::FORMAT_GREY;
+	framesToIgnore = 3;
+	frameNr = 0;
+	//a few frames of static noise, so the background is not perfectly flat
+	std::vector<cv::Mat> noiseFrames(4);
+	uint32_t random = 12345;
+	for (auto nIt = noiseFrames.begin(); nIt != noiseFrames.end(); ++nIt) {
+		nIt->create(height, width, CV_8U);
+		for (uint32_t y = 0; y < height; ++y) {
+			uint8_t * row = nIt->ptr<uint8_t>(y);
+			for (uint32_t x = 0; x < width; ++x) {
+				random = random * 1103515245 + 12345;
+				row[x] = 64 + ((random >> 16) & 31);
+			}
+		}
 	}
+	//move a bright target across the frame and time detection only
+	cv::Mat frame(height, width, CV_8U);
+	const int targetSize = std::max<int>(8, height / 8);
+	uint64_t totalUs = 0;
+	uint32_t timedFrames = 0;
+	for (uint32_t i = 0; i < frames + framesToIgnore; ++i) {
+		noiseFrames[i % noiseFrames.size()].copyTo(frame);
+		const cv::Rect target = cv::Rect((i * 4) % width, height / 2 - targetSize / 2, targetSize, targetSize) & cv::Rect(0, 0, width, height);
+		frame(target).setTo(255);
+		MotionInformation motion;
+		const uint64_t startTime = getTimestampUs();
+		if (analyzeFrame(frame, startTime, motion)) {
+			totalUs += getTimestampUs() - startTime;
+			timedFrames++;
+		}
+	}
+	//publish the memory used, so it can be read with getStatistics()
+	Result & result = results.getWriteBuffer();
+	result.sequence = ++resultSequence;
+	result.statistics.memoryBytes = getMemoryUsage();
+	results.publish();
+	return timedFrames > 0 ? totalUs / (1000.0 * timedFrames) : 0.0;
 }
 
 MotionDetector::~MotionDetector()
 {
 	std::cout << "Shutting down motion detector." << std::endl;
+	active = false;
+	frameRing.close();
 	if (thread != 0) {
-		active = false;
 		pthread_join(thread, 0);
 		thread = 0;
 	}
-	if (videoCapture.isOpened()) {
-		videoCapture.release();
+	if (captureThread != 0) {
+		pthread_join(captureThread, 0);
+		captureThread = 0;
+	}
+	//results still hold frames. they are released before the ring is destroyed
+	if (frameSource) {
+		frameSource->close();
 	}
-	motionChanged = false;
-	frameChanged = false;
 }
 
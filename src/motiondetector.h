@@ -1,10 +1,27 @@
 #pragma once
 
+#include <atomic>
 #include <string>
+#include <memory>
 #include <pthread.h>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include "allocationcounter.h"
+#include "backgroundengine.h"
+#include "backgroundmosaic.h"
+#include "blobextractor.h"
+#include "eventnotifier.h"
+#include "framering.h"
+#include "framesource.h"
+#include "morphology.h"
+#include "motionkernel.h"
+#include "phasecorrelator.h"
+#include "tilegate.h"
+#include "tracker.h"
+#include "triplebuffer.h"
+#include "workerpool.h"
+
 
 class MotionDetector
 {
@@ -19,45 +36,218 @@ public:
 		uint32_t w; //!<width.
 		uint32_t h; //!<height.
 		uint32_t distance2; //!<squared distance of motion center to frame center.
+		uint32_t area; //!<number of changed pixels in the motion area after morphology.
+		uint64_t timestamp; //!<CLOCK_MONOTONIC capture time of the analyzed frame in us.
+		uint32_t trackId; //!<ID of the confirmed track of the motion or 0 if it has none yet.
+		float vx; //!<velocity of the motion center in x in pixels/s. 0 without a confirmed track.
+		float vy; //!<velocity of the motion center in y in pixels/s. 0 without a confirmed track.
 
 		MotionInformation()
-			: x(0), y(0), w(0), h(0), cx(0), cy(0), distance2(0), motionDetected(false) {};
+			: x(0), y(0), w(0), h(0), cx(0), cy(0), distance2(0), area(0), timestamp(0), trackId(0), vx(0.0f), vy(0.0f), motionDetected(false) {};
 		MotionInformation(uint32_t px, uint32_t py, uint32_t width, uint32_t height)
-			: x(px), y(py), w(width), h(height), cx(x + w / 2), cy(y + h / 2), distance2(0), motionDetected(false) {};
+			: x(px), y(py), w(width), h(height), cx(x + w / 2), cy(y + h / 2), distance2(0), area(0), timestamp(0), trackId(0), vx(0.0f), vy(0.0f), motionDetected(false) {};
+	};
+
+	struct Statistics
+	{
+		uint64_t capturedFrames; //!<Number of frames captured from the device.
+		uint64_t analyzedFrames; //!<Number of frames run through motion detection.
+		uint64_t droppedFrames; //!<Number of frames replaced by a newer frame before they could be analyzed.
+		uint64_t lastLatencyUs; //!<Time from capturing the last analyzed frame till its result was available in us.
+		uint32_t tileCount; //!<Number of tiles the frame is split into in tiled mode.
+		uint32_t activeTiles; //!<Number of tiles with changes in the last analyzed frame in tiled mode.
+		uint32_t processedTiles; //!<Number of tiles morphology and blob extraction ran on in the last analyzed frame, including the halo.
+		uint64_t memoryBytes; //!<Memory held for this source in bytes: captured frames, background model and scratch buffers. The shared worker pool is not included.
+		float globalShiftX; //!<Shift of the whole image against the previous frame in x in pixels when compensating camera motion.
+		float globalShiftY; //!<Shift of the whole image against the previous frame in y in pixels when compensating camera motion.
+		float cameraX; //!<Estimated camera position in x in pixels relative to where compensation started.
+		float cameraY; //!<Estimated camera position in y in pixels relative to where compensation started.
+		uint32_t mosaicTiles; //!<Number of tiles in the background mosaic.
+		uint64_t allocations; //!<Heap allocations made analyzing frames after the warm-up. Only counted in builds with COUNT_ALLOCATIONS, see \AllocationCounter. Builds with ABORT_ON_ALLOCATION abort instead.
+
+		Statistics()
+			: capturedFrames(0), analyzedFrames(0), droppedFrames(0), lastLatencyUs(0), tileCount(0), activeTiles(0), processedTiles(0), memoryBytes(0), globalShiftX(0.0f), globalShiftY(0.0f), cameraX(0.0f), cameraY(0.0f), mosaicTiles(0), allocations(0) {};
 	};
 
+	/*!
+	Function called by the analysis thread for every published result, see \subscribe.
+	\param[in] context Context pointer passed to \subscribe.
+	\param[in] sequence Sequence number of the result. Results are numbered consecutively, so a gap would mean a missed result.
+	\param[in] motion Motion found in the analyzed frame.
+	*/
+	typedef void (*ResultCallback)(void * context, uint64_t sequence, const MotionInformation & motion);
+
 private:
-	MotionInformation lastMotion; //!<Information of last motion detected or not.
-	bool motionChanged; //!<If the motion information has changed from the last getLastMotion() call.
+	struct Subscriber
+	{
+		uint32_t id; //!<ID returned by \subscribe.
+		ResultCallback callback; //!<Function to call.
+		void * context; //!<Context passed to callback.
+		uint64_t sequence; //!<Sequence number of the last result passed to the subscriber, so no result is passed twice.
+	};
 
-	pthread_t thread; //!<frame polling thread.
-	pthread_mutex_t mutex; //!<The mutex protecting the lastMotion and motionChanged members.
-	bool active; //!<flags to keep the thread running or stop it.
+	/*!
+	State of one horizontal band of the detection image. Bands are processed in parallel, so each needs its own scratch buffers.
+	*/
+	struct Band
+	{
+		cv::Range rows; //!<Rows of the detection image the band covers.
+		MotionKernel kernel; //!<Kernel of band. BGR conversion and downscaling use per kernel buffers.
+		Morphology morphology; //!<Dilation and erosion buffers of band.
+		BlobExtractor blobExtractor; //!<Blobs of band. Joined with the blobs of the other bands afterwards.
+		std::vector<cv::Rect> regions; //!<Regions of the tile gate the band processes in tiled mode.
+
+		Band(const MotionKernel & bandKernel) : kernel(bandKernel) {};
+	};
+
+	enum BandStage {STAGE_DOWNSCALE, STAGE_DETECT, STAGE_ENGINE, STAGE_THRESHOLD, STAGE_DILATE, STAGE_ERODE, STAGE_LABEL, STAGE_REGIONS}; //!<Steps of the detection chain run on bands. STAGE_REGIONS runs morphology and labelling on the tile gate regions of a band.
+
+	/*!
+	Parameters of a detection step passed to all bands. Settings are copied in once per frame, so all bands use the same.
+	*/
+	struct BandJob
+	{
+		MotionDetector * detector;
+		BandStage stage;
+		const cv::Mat * frame; //!<Frame to downscale or detect motion in.
+		FrameSource::PixelFormat format; //!<Pixel format of frame.
+		uint32_t scale; //!<Pyramid downscaling factor.
+		uint32_t radius; //!<Dilation or erosion radius.
+		uint32_t erodeRadius; //!<Erosion radius of STAGE_REGIONS, which dilates by radius first.
+		double threshold; //!<Binary threshold.
+		bool outputDifference; //!<Detect outputs the difference for adaptive thresholding.
+		bool selectiveUpdate; //!<Detect does not update the background of foreground pixels.
+	};
+
+	/*!
+	Everything the analysis thread publishes for an analyzed frame. Published as a whole, so frame, motion and tracks always match.
+	*/
+	struct Result
+	{
+		uint64_t sequence; //!<Number of the result. Starts at 1, 0 means nothing was published yet.
+		FrameHandle frame; //!<Analyzed frame in source pixel format. Holds its ring slot.
+		MotionInformation motion; //!<Motion found in frame.
+		std::vector<Tracker::Track> tracks; //!<Confirmed tracks after analyzing frame.
+		cv::Mat tileActivity; //!<Number of frames each tile was active in. Copy of the tile gate counters in tiled mode.
+		Statistics statistics; //!<Analysis counters. The capture counters are read from the ring.
+
+		Result() : sequence(0) {};
+	};
+
+	pthread_t captureThread; //!<frame capture thread.
+	pthread_t thread; //!<frame analysis thread.
+	bool active; //!<flags to keep the threads running or stop them.
 	bool paused; //!<Flag to pause motion detection loop. No detection will be done till flas is false.
 
-	cv::VideoCapture videoCapture; //!<OpenCV video capture object.
+	std::shared_ptr<FrameSource> frameSource; //!<Camera or video file frames are read from.
 	uint32_t videoWidth; //!<Width of video frames.
 	uint32_t videoHeight; //!<Height of video frames.
-    uint32_t videoBitsPerColor; //!<Bits per color of video frames.
-    uint32_t videoColors; //!<Number of channels in video frame, e.g. 3 for RGB.
+	FrameSource::PixelFormat videoFormat; //!<Pixel format of video frames.
 	double videoFps; //!<Fps of video capture.
-	uint32_t pollingInterval; //!<Time to sleep between polling frames.
-	uint32_t frameNr; //!<Nr of frame captured from device.
+	uint32_t frameNr; //!<Nr of frame analyzed since start or unpausing.
 	uint32_t framesToIgnore; //!<Nr of frames ignore after starting or unpausing motion detection.
 
-	bool frameChanged; //!<True if the frame has changed from the last getLastFrame() call.
-	cv::Mat frame; //!<Last captured frame.
-	cv::Mat greyFrame; //!<Captured frame converted to grayscale.
-	cv::Mat movingAverage; //!<Moving average of captured frames.
-	cv::Mat averageGrey; //!<Moving average as greyscale image.
-	cv::Mat difference; //!<difference between average greyscale and current greyscale frame.
+	FrameRing frameRing; //!<Preallocated frames passed from the capture to the analysis thread.
+	TripleBuffer<Result> results; //!<Results published by the analysis thread. Declared after frameRing, so its frame handles are released before the ring is destroyed.
+	uint64_t resultSequence; //!<Sequence number of the last published result. Analysis thread only.
+	uint64_t motionSequence; //!<Sequence number of the result getLastMotion() returned last. Reader thread only.
+	uint64_t tracksSequence; //!<Sequence number of the result getTracks() returned last. Reader thread only.
+	uint64_t frameSequence; //!<Sequence number of the result getLastFrame() returned last. Reader thread only.
+	std::atomic<uint64_t> analyzedFrames; //!<Number of frames run through motion detection, including the warm-up frames.
+	uint64_t allocations; //!<Heap allocations made analyzing frames after the warm-up. Analysis thread only.
+	std::atomic<uint64_t> bandAllocations; //!<Heap allocations of all band jobs. Added to by the threads running them.
+	EventNotifier resultNotifier; //!<Notified for every published result. Waited on by \waitForResult.
+	std::vector<Subscriber> subscribers; //!<Functions called for every published result.
+	pthread_mutex_t subscriberMutex; //!<The mutex protecting subscribers. Only held by the analysis thread while calling them.
+	uint32_t nextSubscriberId; //!<ID of the next subscriber.
+
+	MotionKernel kernel; //!<Fused background update, difference and threshold kernel.
+	BlobExtractor blobExtractor; //!<Connected component labelling of the binary difference image.
+	TileGate tileGate; //!<Finds the regions of the binary difference image that changed.
+	Tracker tracker; //!<Follows the blobs from frame to frame.
+	std::vector<Tracker::Measurement> measurements; //!<Blobs of the analyzed frame at full resolution.
+	cv::Mat pyramidFrame; //!<Luma of the analyzed frame downscaled to the pyramid level.
+	cv::Mat movingAverage; //!<Moving average of captured frames at pyramid level resolution. CV_32F or CV_16U Q8.8 fixed point.
+	cv::Mat difference; //!<Binary difference between average greyscale and current greyscale frame.
+	cv::Mat morphologyBuffer; //!<Intermediate image of adaptive thresholding and morphology. Bands read rows of their neighbours, so they can't work in place.
+	std::shared_ptr<WorkerPool> workerPool; //!<Threads processing the bands.
+	uint32_t poolThreadCount; //!<Thread count the worker pool was created with.
+	std::vector<Band> bands; //!<Horizontal bands of the detection image.
+	std::vector<BlobExtractor *> bandExtractors; //!<Blob extractors of all bands in top to bottom order.
+	cv::Mat egoFrame; //!<Luma of the analyzed frame downscaled for global motion estimation.
+	PhaseCorrelator phaseCorrelator; //!<Finds the shift of egoFrame against the previous one.
+	cv::Mat egoBackground; //!<Moving average warped to the view of the current frame.
+	cv::Point2f globalShift; //!<Shift of the whole image against the previous frame in full resolution pixels.
+	cv::Point2f cameraPose; //!<Position of the view in full resolution pixels, accumulated from the global shifts.
+	BackgroundMosaic mosaic; //!<Background of all views seen, at detection resolution.
+	std::shared_ptr<BackgroundEngine> backgroundEngine; //!<Engine classifying the pixels of the analyzed frame. Empty for the built-in running average.
+	BackgroundEngine::Type backgroundEngineType; //!<Engine selected by \setBackgroundEngine. Created by the analysis thread on the next frame.
 	
 	bool useMorphology; //!<Set to true to use OpenCV morphology filter.
 	bool useAdaptiveThreshold; //!<Set to true to use adaptive threshold instead of fixed threshold.
+	bool useFixedPointBackground; //!<Set to true to keep the moving average as Q8.8 fixed point instead of float.
+	bool useSelectiveUpdate; //!<Set to true to not update the moving average of foreground pixels.
+	bool useTiles; //!<Set to true to run morphology and blob extraction on changed tiles only.
+	bool useEgoMotionCompensation; //!<Set to true to move the moving average along with the camera.
+	bool useBackgroundMosaic; //!<Set to true to keep the background of all views and seed the moving average from it.
+	uint32_t pyramidLevel; //!<Detection runs on frames downscaled by 2^pyramidLevel.
+	uint32_t threadCount; //!<Number of threads processing bands. 0 means one per CPU core.
 	double binaryThreshold; //!<Threshold when converting greyscale image to binary.
 
-	bool setupCapture(cv::VideoCapture & captureDevice, uint32_t width = 320, uint32_t height = 240, double fps = 20.0);
+	bool setupCapture(std::shared_ptr<FrameSource> source);
 
+	/*!
+	Allocate the detection images and reserve the blob, track and result buffers for the detection size, so analysis
+	does not allocate after the first frames. Call before the threads are started.
+	*/
+	void reserveBuffers(const cv::Size & detectionSize);
+
+	/*!
+	(Re-)create worker pool and bands if the thread count or the detection image height changed.
+	*/
+	void setupBands(const cv::Size & detectionSize);
+
+	/*!
+	Run a detection step on all bands in parallel and wait till all are done.
+	*/
+	void runBands(BandJob & job);
+	static void processBand(void * obj, uint32_t index);
+
+	/*!
+	Split the tile gate regions between the bands. Every band gets a run of consecutive regions of about the same total
+	area, so joining the blobs of the bands in order gives the blobs of all regions in order.
+	*/
+	void splitRegions(const std::vector<cv::Rect> & regions);
+
+	/*!
+	Sum up the memory of all frame, background, result and scratch buffers. Call from the analysis thread only.
+	*/
+	uint64_t getMemoryUsage();
+
+	/*!
+	Estimate the shift of the whole frame against the previous one and move the moving average and tracks along with it.
+	\param[in] frame Frame in source pixel format.
+	\param[in] detectionFrame Frame at detection resolution.
+	\param[in] format Pixel format of detectionFrame.
+	\param[in] scale Pyramid downscaling factor of detectionFrame.
+	*/
+	void compensateEgoMotion(const cv::Mat & frame, const cv::Mat & detectionFrame, FrameSource::PixelFormat format, uint32_t scale);
+
+	/*!
+	Get the position of the current view in the background mosaic.
+	*/
+	cv::Point getMosaicPosition(uint32_t scale) const;
+
+	/*!
+	Run motion detection on a frame.
+	\param[in] frame Frame in source pixel format.
+	\param[in] timestamp Capture time of frame.
+	\param[out] motion Motion found in frame.
+	\return Returns true if the frame was analyzed and false if it was only used to build up the moving average.
+	*/
+	bool analyzeFrame(const cv::Mat & frame, uint64_t timestamp, MotionInformation & motion);
+
+	static void * captureLoop(void * obj);
 	static void * frameLoop(void * obj);
 
 public:
@@ -69,7 +259,7 @@ public:
 
     /*!
     Open video file for motion detection.
-    \param[in] fileName Video file open.
+    \param[in] fileName Video file open. Raw frame dumps are detected by their extension, see \RawFileSource.
     \param[in] width Optional. Preferred width of video mode.
     \param[in] height Optional. Preferred height of video mode.
     \param[in] fps Optional. Preferred frames/s of capture.
@@ -78,7 +268,7 @@ public:
     bool openVideo(const std::string & fileName, uint32_t width = 320, uint32_t height = 240, double fps = 20.0);
 
     /*!
-    Open camera for motion detection.
+    Open camera for motion detection. Native V4L2 capture is tried first, OpenCV capture is used as a fallback.
     \param[in] cameraIndex Optional. Index of camera to open.
     \param[in] width Optional. Preferred width of video mode.
     \param[in] height Optional. Preferred height of video mode.
@@ -107,6 +297,10 @@ public:
 	uint32_t getWidth() const;
 	uint32_t getHeight() const;
 	double getFps() const;
+	FrameSource::PixelFormat getFormat() const;
+
+	//results are published by the analysis thread without locking, so reading them never stalls detection and vice versa.
+	//the functions reading results must all be called from the same thread, e.g. the main loop
 
 	/*!
 	Returns true if the motion information has changed from the previous call to this one.
@@ -115,14 +309,82 @@ public:
 	*/
 	bool getLastMotion(MotionInformation & motionInfo);
 
+	/*!
+	Returns true if the tracks have changed from the previous call to this one.
+	Unlike \getLastMotion, which reports the biggest blob of a frame, tracks follow every moving object with a stable ID,
+	filtered position and velocity.
+	\param[out] tracks Confirmed tracks of the last analyzed frame. Modified when the function returns true.
+	\return Returns true if the tracks have changed since last call.
+	*/
+	bool getTracks(std::vector<Tracker::Track> & tracks);
+
 	/*!
 	Returns true if the frame has changed from the previous call to this one.
 	\param[out] lastFrame last captured frame returned if the function returns true.
-	\param[in] drawMotion Pass true for the function to draw a frame over the area motion was detected in.
+	\param[in] drawMotion Pass true for the function to draw a frame over the area motion was detected in and the tracks.
 	\return Returns true if the frame has changed since the last call.
+	\note The frame is converted to BGR only here, detection itself works on the luma plane.
 	*/
 	bool getLastFrame(cv::Mat & lastFrame, bool drawMotion = false);
 
+	/*!
+	Returns true if the frame has changed from the previous call to this one. Shares the changed flag with the BGR variant.
+	\param[out] handle Handle to the last analyzed frame in source pixel format, see \getFormat. Modified when the function returns true.
+	\return Returns true if the frame has changed since the last call.
+	\note The frame is not copied. Its ring slot is not reused for capturing while the handle is held, so release it soon.
+	*/
+	bool getLastFrame(FrameHandle & handle);
+
+	/*!
+	Wait till a result was published, so the results can be read without polling.
+	\param[in] timeoutMs Maximum time to wait in ms.
+	\return Returns true if a result was published since the last wait and false on timeout.
+	\note Results published before the first wait count too. Call from the thread reading the results.
+	*/
+	bool waitForResult(uint32_t timeoutMs);
+
+	/*!
+	Wait till motion information newer than the last returned by \getLastMotion is available and return it.
+	\param[out] motionInfo Motion information struct that will be modified when the function returns true.
+	\param[in] timeoutMs Maximum time to wait in ms.
+	\return Returns true if new motion information was returned and false on timeout.
+	*/
+	bool waitForMotion(MotionInformation & motionInfo, uint32_t timeoutMs);
+
+	/*!
+	Get a file descriptor that is readable while there are results \waitForResult has not returned yet, e.g. to wait for
+	several detectors and other descriptors at once with poll or epoll. Call \waitForResult(0) to clear it.
+	*/
+	int getResultDescriptor() const;
+
+	/*!
+	Call a function for every published result. The function is called from the analysis thread right after the result
+	was published, exactly once per result, so it must return quickly, e.g. after waking up another thread.
+	\param[in] callback Function to call. It must not call \subscribe or \unsubscribe.
+	\param[in] context Context pointer passed to callback.
+	\return Returns an ID to pass to \unsubscribe.
+	*/
+	uint32_t subscribe(ResultCallback callback, void * context);
+
+	/*!
+	Stop calling a subscribed function. When this returns, the function is not running anymore.
+	\param[in] id ID returned by \subscribe.
+	*/
+	void unsubscribe(uint32_t id);
+
+	/*!
+	Get capture and analysis counters, e.g. to check how many frames analysis could not keep up with.
+	\return Returns a copy of the current counters.
+	*/
+	Statistics getStatistics();
+
+	/*!
+	Get per tile activity in tiled mode.
+	\param[out] activity Number of frames each tile had changes in as CV_32S image with one pixel per tile.
+	\return Returns true if tile activity is available.
+	*/
+	bool getTileActivity(cv::Mat & activity);
+
     /*!
     Convert frame to other bit depth.
     \param[out] destination The conversion target.
@@ -152,5 +414,93 @@ public:
 	void setBinaryThreshold(double threshold = 50.0);
 	double getBinaryThreshold() const;
 
+	/*!
+	Keep moving average of frames as 16-bit Q8.8 fixed point instead of float. Halves its memory and bandwidth.
+	\param[in] enable Pass true to use fixed point. The moving average is restarted on the next frame.
+	*/
+	void setUseFixedPointBackground(bool enable);
+	bool getUseFixedPointBackground() const;
+
+	/*!
+	Do not update the moving average of pixels classified as foreground, so targets standing still are not absorbed into the background.
+	Pixels are classified using the binary threshold, also when adaptive threshold is enabled.
+	\param[in] enable Pass true to enable selective update on next frame.
+	\note Permanent changes to the scene will stay foreground until detection is paused and unpaused.
+	*/
+	void setUseSelectiveUpdate(bool enable);
+	bool getUseSelectiveUpdate() const;
+
+	/*!
+	Split the binary difference image into tiles and run morphology and blob extraction only on tiles with changes and
+	the tiles around them the morphology can reach. Results are the same as without tiles, but static scenes need a lot less CPU.
+	The changed regions are split between the worker threads like the bands are without tiles.
+	\param[in] enable Pass true to enable tiled mode on next frame.
+	*/
+	void setUseTiles(bool enable);
+	bool getUseTiles() const;
+
+	/*!
+	Compensate camera motion, e.g. when the camera is mounted on the launcher. The shift of the whole frame against the
+	previous one is estimated with phase correlation on a downscaled luma image and the moving average is moved along, so
+	detection keeps working while and after the camera moves. Parts of the view that were not seen before start with the
+	current frame as background.
+	\param[in] enable Pass true to enable compensation on next frame.
+	*/
+	void setUseEgoMotionCompensation(bool enable);
+	bool getUseEgoMotionCompensation() const;
+
+	/*!
+	Keep a panoramic background mosaic of all views the camera has seen, indexed by the camera pose estimated while
+	compensating camera motion. Parts of the view that come back into sight and restarts of the moving average are seeded
+	from the mosaic, so detection is valid on the first frame after a move instead of after the warm-up frames.
+	\param[in] enable Pass true to enable the mosaic on next frame. Only used while camera motion compensation is enabled.
+	\note The mosaic allocates 256 tiles of 64x64 pixels on the first frame it is used, the least recently used tiles are evicted.
+	*/
+	void setUseBackgroundMosaic(bool enable);
+	bool getUseBackgroundMosaic() const;
+
+	/*!
+	Select the background model used to classify pixels. The running average is the default and supports all options.
+	The other engines use their own update and classification rules, so the binary threshold, adaptive threshold,
+	fixed point background, selective update and background mosaic options do not apply to them. Blobs are not refined at
+	full resolution in pyramid mode and the model is restarted instead of moved along when compensating camera motion.
+	\param[in] type Engine to use. The model is restarted on the next frame.
+	*/
+	void setBackgroundEngine(BackgroundEngine::Type type);
+	BackgroundEngine::Type getBackgroundEngine() const;
+
+	/*!
+	Run background subtraction, thresholding and blob extraction on a downscaled pyramid level.
+	The bounding box of the biggest blob is then refined at full resolution, so motion information stays accurate.
+	\param[in] level 0 for full resolution, 1 for 1/2 and 2 for 1/4 resolution. The moving average is restarted on the next frame.
+	*/
+	void setPyramidLevel(uint32_t level);
+	uint32_t getPyramidLevel() const;
+
+	/*!
+	Set the number of threads the detection chain runs on. Frames are split into horizontal bands processed in parallel.
+	\param[in] count Number of threads including the analysis thread. 0 uses one thread per CPU core. Applied on the next frame.
+	*/
+	void setThreadCount(uint32_t count);
+	uint32_t getThreadCount() const;
+
+	/*!
+	Process bands on a worker pool shared with other detectors, e.g. one per camera, instead of an own pool.
+	Jobs of all detectors are handed to the same threads, so the cores are balanced between cameras.
+	\param[in] pool Worker pool to use. Overrides the thread count.
+	\note Call before \openVideo or \openCamera. Calling \setThreadCount afterwards creates an own pool again.
+	*/
+	void setWorkerPool(std::shared_ptr<WorkerPool> pool);
+
+	/*!
+	Measure the time motion detection needs per frame on synthetic greyscale frames with a moving target.
+	\param[in] width Frame width.
+	\param[in] height Frame height.
+	\param[in] frames Number of frames to analyze.
+	\return Returns the average wall clock time per frame in ms or a negative value if the detector is capturing.
+	\note Uses the current detection settings. Must not be called while capturing. The memory used is available from \getStatistics afterwards.
+	*/
+	double benchmark(uint32_t width, uint32_t height, uint32_t frames);
+
 	~MotionDetector();
 };
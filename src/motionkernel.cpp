@@ -0,0 +1,783 @@
+#include "motionkernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define KERNEL_X86
+	#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#define KERNEL_NEON
+	#include <arm_neon.h>
+#endif
+
+//Note that all floating point code in here must be compiled without contracting multiplies and adds to FMA
+//instructions (-ffp-contract=off), else the background update will not match accumulateWeighted bit for bit.
+
+//Fixed point BGR to greyscale coefficients used by OpenCV 2.4 and later versions
+static const int32_t GREY_COEFFICIENTS_14BIT[3] = {1868, 9617, 4899};
+static const int32_t GREY_COEFFICIENTS_15BIT[3] = {3735, 19235, 9798};
+
+
+//Background update of a single value
+template <int VARIANT>
+static inline float updateScalar(float grey, float background, float alpha, float beta)
+{
+	switch (VARIANT) {
+		case MotionKernel::UPDATE_WEIGHTED_SUM:
+			return grey * alpha + background * beta;
+		case MotionKernel::UPDATE_DIFFERENCE:
+			return background + (grey - background) * alpha;
+		default:
+			return std::fma(grey - background, alpha, background);
+	}
+}
+
+//Reference implementation. Also used for the pixels at the end of a row the SIMD paths do not handle.
+template <uint32_t STRIDE, int VARIANT>
+static void detectRowScalar(const uint8_t * luma, float * background, uint8_t * destination, uint32_t width, float alpha, int32_t threshold, bool outputDifference, bool selectiveUpdate)
+{
+	const float beta = 1.0f - alpha;
+	for (uint32_t x = 0; x < width; ++x) {
+		const int32_t grey = luma[x * STRIDE];
+		const float average = updateScalar<VARIANT>((float)grey, background[x], alpha, beta);
+		if (destination != nullptr) {
+			//convertTo(CV_8U) rounds to nearest even. the average can not leave the 0-255 range
+			const int32_t difference = std::abs((int32_t)lrintf(average) - grey);
+			destination[x] = outputDifference ? difference : (difference > threshold ? 255 : 0);
+			//keep background of foreground pixels
+			if (selectiveUpdate && difference > threshold) {
+				continue;
+			}
+		}
+		background[x] = average;
+	}
+}
+
+//Fixed point reference implementation. The background is stored in Q8.8, alpha in Q1.17.
+//(grey * 128 - background / 2) always fits into 16 bit, so the SIMD paths can update with a single 16x16 bit high multiply.
+template <uint32_t STRIDE>
+static void detectRowFixedScalar(const uint8_t * luma, uint16_t * background, uint8_t * destination, uint32_t width, int32_t alpha, int32_t threshold, bool outputDifference, bool selectiveUpdate)
+{
+	for (uint32_t x = 0; x < width; ++x) {
+		const int32_t grey = luma[x * STRIDE];
+		const int32_t halfDifference = (grey << 7) - (background[x] >> 1);
+		const int32_t average = background[x] + ((halfDifference * alpha) >> 16);
+		if (destination != nullptr) {
+			const int32_t difference = std::abs(((average + 128) >> 8) - grey);
+			destination[x] = outputDifference ? difference : (difference > threshold ? 255 : 0);
+			//keep background of foreground pixels
+			if (selectiveUpdate && difference > threshold) {
+				continue;
+			}
+		}
+		background[x] = average;
+	}
+}
+
+#ifdef KERNEL_X86
+
+template <int VARIANT>
+static inline __m128 updateSSE2(__m128 grey, __m128 background, __m128 alpha, __m128 beta)
+{
+	if (VARIANT == MotionKernel::UPDATE_WEIGHTED_SUM) {
+		return _mm_add_ps(_mm_mul_ps(grey, alpha), _mm_mul_ps(background, beta));
+	}
+	return _mm_add_ps(background, _mm_mul_ps(_mm_sub_ps(grey, background), alpha));
+}
+
+//select old where mask is set, else new
+static inline __m128 selectSSE2(__m128i mask, __m128 oldValue, __m128 newValue)
+{
+	const __m128 maskPs = _mm_castsi128_ps(mask);
+	return _mm_or_ps(_mm_and_ps(maskPs, oldValue), _mm_andnot_ps(maskPs, newValue));
+}
+
+//load 16 luma values as 2x8x16 bit
+template <uint32_t STRIDE>
+static inline void loadLumaSSE2(const uint8_t * luma, __m128i & grey0, __m128i & grey1)
+{
+	if (STRIDE == 1) {
+		const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(luma));
+		grey0 = _mm_unpacklo_epi8(pixels, _mm_setzero_si128());
+		grey1 = _mm_unpackhi_epi8(pixels, _mm_setzero_si128());
+	}
+	else {
+		//YUYV. luma is in the low byte of every 16 bit word
+		const __m128i lumaMask = _mm_set1_epi16(0x00ff);
+		grey0 = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(luma)), lumaMask);
+		grey1 = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(luma + 16)), lumaMask);
+	}
+}
+
+template <uint32_t STRIDE, int VARIANT>
+static void detectRowSSE2(const uint8_t * luma, float * background, uint8_t * destination, uint32_t width, float alpha, int32_t threshold, bool outputDifference, bool selectiveUpdate)
+{
+	const __m128 vAlpha = _mm_set1_ps(alpha);
+	const __m128 vBeta = _mm_set1_ps(1.0f - alpha);
+	const __m128i vThreshold = _mm_set1_epi16(threshold);
+	const __m128i zero = _mm_setzero_si128();
+	uint32_t x = 0;
+	for (; x + 16 <= width; x += 16) {
+		__m128i grey0;
+		__m128i grey1;
+		loadLumaSSE2<STRIDE>(luma + x * STRIDE, grey0, grey1);
+		__m128 average[4];
+		average[0] = updateSSE2<VARIANT>(_mm_cvtepi32_ps(_mm_unpacklo_epi16(grey0, zero)), _mm_loadu_ps(background + x), vAlpha, vBeta);
+		average[1] = updateSSE2<VARIANT>(_mm_cvtepi32_ps(_mm_unpackhi_epi16(grey0, zero)), _mm_loadu_ps(background + x + 4), vAlpha, vBeta);
+		average[2] = updateSSE2<VARIANT>(_mm_cvtepi32_ps(_mm_unpacklo_epi16(grey1, zero)), _mm_loadu_ps(background + x + 8), vAlpha, vBeta);
+		average[3] = updateSSE2<VARIANT>(_mm_cvtepi32_ps(_mm_unpackhi_epi16(grey1, zero)), _mm_loadu_ps(background + x + 12), vAlpha, vBeta);
+		if (destination != nullptr) {
+			//_mm_cvtps_epi32 rounds to nearest even like cvRound
+			const __m128i rounded0 = _mm_packs_epi32(_mm_cvtps_epi32(average[0]), _mm_cvtps_epi32(average[1]));
+			const __m128i rounded1 = _mm_packs_epi32(_mm_cvtps_epi32(average[2]), _mm_cvtps_epi32(average[3]));
+			const __m128i difference0 = _mm_sub_epi16(_mm_max_epi16(rounded0, grey0), _mm_min_epi16(rounded0, grey0));
+			const __m128i difference1 = _mm_sub_epi16(_mm_max_epi16(rounded1, grey1), _mm_min_epi16(rounded1, grey1));
+			const __m128i foreground0 = _mm_cmpgt_epi16(difference0, vThreshold);
+			const __m128i foreground1 = _mm_cmpgt_epi16(difference1, vThreshold);
+			const __m128i result = outputDifference ? _mm_packus_epi16(difference0, difference1) : _mm_packs_epi16(foreground0, foreground1);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(destination + x), result);
+			if (selectiveUpdate) {
+				//keep background of foreground pixels. widen 16 bit masks to 32 bit
+				average[0] = selectSSE2(_mm_unpacklo_epi16(foreground0, foreground0), _mm_loadu_ps(background + x), average[0]);
+				average[1] = selectSSE2(_mm_unpackhi_epi16(foreground0, foreground0), _mm_loadu_ps(background + x + 4), average[1]);
+				average[2] = selectSSE2(_mm_unpacklo_epi16(foreground1, foreground1), _mm_loadu_ps(background + x + 8), average[2]);
+				average[3] = selectSSE2(_mm_unpackhi_epi16(foreground1, foreground1), _mm_loadu_ps(background + x + 12), average[3]);
+			}
+		}
+		_mm_storeu_ps(background + x, average[0]);
+		_mm_storeu_ps(background + x + 4, average[1]);
+		_mm_storeu_ps(background + x + 8, average[2]);
+		_mm_storeu_ps(background + x + 12, average[3]);
+	}
+	detectRowScalar<STRIDE, VARIANT>(luma + x * STRIDE, background + x, destination != nullptr ? destination + x : nullptr, width - x, alpha, threshold, outputDifference, selectiveUpdate);
+}
+
+//update 8 fixed point background values. returns new background and stores foreground mask and difference or binary result
+static inline __m128i updateFixedSSE2(__m128i grey, __m128i background, __m128i alpha, __m128i threshold, bool outputDifference, bool selectiveUpdate, __m128i & result)
+{
+	const __m128i halfDifference = _mm_sub_epi16(_mm_slli_epi16(grey, 7), _mm_srli_epi16(background, 1));
+	const __m128i average = _mm_add_epi16(background, _mm_mulhi_epi16(halfDifference, alpha));
+	const __m128i rounded = _mm_srli_epi16(_mm_add_epi16(average, _mm_set1_epi16(128)), 8);
+	const __m128i difference = _mm_sub_epi16(_mm_max_epi16(rounded, grey), _mm_min_epi16(rounded, grey));
+	const __m128i foreground = _mm_cmpgt_epi16(difference, threshold);
+	result = outputDifference ? difference : foreground;
+	if (selectiveUpdate) {
+		return _mm_or_si128(_mm_and_si128(foreground, background), _mm_andnot_si128(foreground, average));
+	}
+	return average;
+}
+
+template <uint32_t STRIDE>
+static void detectRowFixedSSE2(const uint8_t * luma, uint16_t * background, uint8_t * destination, uint32_t width, int32_t alpha, int32_t threshold, bool outputDifference, bool selectiveUpdate)
+{
+	const __m128i vAlpha = _mm_set1_epi16(alpha);
+	const __m128i vThreshold = _mm_set1_epi16(threshold);
+	uint32_t x = 0;
+	for (; x + 16 <= width; x += 16) {
+		__m128i grey0;
+		__m128i grey1;
+		loadLumaSSE2<STRIDE>(luma + x * STRIDE, grey0, grey1);
+		__m128i * backgroundData = reinterpret_cast<__m128i *>(background + x);
+		__m128i result0;
+		__m128i result1;
+		const __m128i average0 = updateFixedSSE2(grey0, _mm_loadu_si128(backgroundData), vAlpha, vThreshold, outputDifference, selectiveUpdate && destination != nullptr, result0);
+		const __m128i average1 = updateFixedSSE2(grey1, _mm_loadu_si128(backgroundData + 1), vAlpha, vThreshold, outputDifference, selectiveUpdate && destination != nullptr, result1);
+		_mm_storeu_si128(backgroundData, average0);
+		_mm_storeu_si128(backgroundData + 1, average1);
+		if (destination != nullptr) {
+			const __m128i result = outputDifference ? _mm_packus_epi16(result0, result1) : _mm_packs_epi16(result0, result1);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(destination + x), result);
+		}
+	}
+	detectRowFixedScalar<STRIDE>(luma + x * STRIDE, background + x, destination != nullptr ? destination + x : nullptr, width - x, alpha, threshold, outputDifference, selectiveUpdate);
+}
+
+template <int VARIANT>
+__attribute__((target("avx2,fma")))
+static inline __m256 updateAVX2(__m256 grey, __m256 background, __m256 alpha, __m256 beta)
+{
+	if (VARIANT == MotionKernel::UPDATE_WEIGHTED_SUM) {
+		return _mm256_add_ps(_mm256_mul_ps(grey, alpha), _mm256_mul_ps(background, beta));
+	}
+	else if (VARIANT == MotionKernel::UPDATE_DIFFERENCE) {
+		return _mm256_add_ps(background, _mm256_mul_ps(_mm256_sub_ps(grey, background), alpha));
+	}
+	return _mm256_fmadd_ps(_mm256_sub_ps(grey, background), alpha, background);
+}
+
+//load 16 luma values as 16x16 bit
+template <uint32_t STRIDE>
+__attribute__((target("avx2")))
+static inline __m256i loadLumaAVX2(const uint8_t * luma)
+{
+	if (STRIDE == 1) {
+		return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(luma)));
+	}
+	return _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(luma)), _mm256_set1_epi16(0x00ff));
+}
+
+//pack 16x16 bit difference or mask values to 16x8 bit
+__attribute__((target("avx2")))
+static inline __m128i packResultAVX2(__m256i result, bool outputDifference)
+{
+	if (outputDifference) {
+		return _mm_packus_epi16(_mm256_castsi256_si128(result), _mm256_extracti128_si256(result, 1));
+	}
+	return _mm_packs_epi16(_mm256_castsi256_si128(result), _mm256_extracti128_si256(result, 1));
+}
+
+template <uint32_t STRIDE, int VARIANT>
+__attribute__((target("avx2,fma")))
+static void detectRowAVX2(const uint8_t * luma, float * background, uint8_t * destination, uint32_t width, float alpha, int32_t threshold, bool outputDifference, bool selectiveUpdate)
+{
+	const __m256 vAlpha = _mm256_set1_ps(alpha);
+	const __m256 vBeta = _mm256_set1_ps(1.0f - alpha);
+	const __m256i vThreshold = _mm256_set1_epi16(threshold);
+	uint32_t x = 0;
+	for (; x + 16 <= width; x += 16) {
+		const __m256i grey = loadLumaAVX2<STRIDE>(luma + x * STRIDE);
+		const __m256 grey0 = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(grey)));
+		const __m256 grey1 = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(grey, 1)));
+		__m256 average0 = updateAVX2<VARIANT>(grey0, _mm256_loadu_ps(background + x), vAlpha, vBeta);
+		__m256 average1 = updateAVX2<VARIANT>(grey1, _mm256_loadu_ps(background + x + 8), vAlpha, vBeta);
+		if (destination != nullptr) {
+			//packing works per 128 bit lane, so restore the order afterwards
+			const __m256i average = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_cvtps_epi32(average0), _mm256_cvtps_epi32(average1)), 0xd8);
+			const __m256i difference = _mm256_sub_epi16(_mm256_max_epi16(average, grey), _mm256_min_epi16(average, grey));
+			const __m256i foreground = _mm256_cmpgt_epi16(difference, vThreshold);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(destination + x), packResultAVX2(outputDifference ? difference : foreground, outputDifference));
+			if (selectiveUpdate) {
+				//keep background of foreground pixels. widen 16 bit masks to 32 bit
+				const __m256 keep0 = _mm256_castsi256_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(foreground)));
+				const __m256 keep1 = _mm256_castsi256_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(foreground, 1)));
+				average0 = _mm256_blendv_ps(average0, _mm256_loadu_ps(background + x), keep0);
+				average1 = _mm256_blendv_ps(average1, _mm256_loadu_ps(background + x + 8), keep1);
+			}
+		}
+		_mm256_storeu_ps(background + x, average0);
+		_mm256_storeu_ps(background + x + 8, average1);
+	}
+	detectRowScalar<STRIDE, VARIANT>(luma + x * STRIDE, background + x, destination != nullptr ? destination + x : nullptr, width - x, alpha, threshold, outputDifference, selectiveUpdate);
+}
+
+template <uint32_t STRIDE>
+__attribute__((target("avx2")))
+static void detectRowFixedAVX2(const uint8_t * luma, uint16_t * background, uint8_t * destination, uint32_t width, int32_t alpha, int32_t threshold, bool outputDifference, bool selectiveUpdate)
+{
+	const __m256i vAlpha = _mm256_set1_epi16(alpha);
+	const __m256i vThreshold = _mm256_set1_epi16(threshold);
+	const __m256i vHalf = _mm256_set1_epi16(128);
+	uint32_t x = 0;
+	for (; x + 16 <= width; x += 16) {
+		const __m256i grey = loadLumaAVX2<STRIDE>(luma + x * STRIDE);
+		__m256i * backgroundData = reinterpret_cast<__m256i *>(background + x);
+		const __m256i previous = _mm256_loadu_si256(backgroundData);
+		const __m256i halfDifference = _mm256_sub_epi16(_mm256_slli_epi16(grey, 7), _mm256_srli_epi16(previous, 1));
+		__m256i average = _mm256_add_epi16(previous, _mm256_mulhi_epi16(halfDifference, vAlpha));
+		if (destination != nullptr) {
+			const __m256i rounded = _mm256_srli_epi16(_mm256_add_epi16(average, vHalf), 8);
+			const __m256i difference = _mm256_sub_epi16(_mm256_max_epi16(rounded, grey), _mm256_min_epi16(rounded, grey));
+			const __m256i foreground = _mm256_cmpgt_epi16(difference, vThreshold);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(destination + x), packResultAVX2(outputDifference ? difference : foreground, outputDifference));
+			if (selectiveUpdate) {
+				average = _mm256_blendv_epi8(average, previous, foreground);
+			}
+		}
+		_mm256_storeu_si256(backgroundData, average);
+	}
+	detectRowFixedScalar<STRIDE>(luma + x * STRIDE, background + x, destination != nullptr ? destination + x : nullptr, width - x, alpha, threshold, outputDifference, selectiveUpdate);
+}
+
+#endif //KERNEL_X86
+
+#ifdef KERNEL_NEON
+
+template <int VARIANT>
+static inline float32x4_t updateNEON(float32x4_t grey, float32x4_t background, float32x4_t alpha, float32x4_t beta)
+{
+	if (VARIANT == MotionKernel::UPDATE_WEIGHTED_SUM) {
+		return vaddq_f32(vmulq_f32(grey, alpha), vmulq_f32(background, beta));
+	}
+#if defined(__ARM_FEATURE_FMA)
+	else if (VARIANT == MotionKernel::UPDATE_FUSED_DIFFERENCE) {
+		return vfmaq_f32(background, vsubq_f32(grey, background), alpha);
+	}
+#endif
+	return vaddq_f32(background, vmulq_f32(vsubq_f32(grey, background), alpha));
+}
+
+//round 8 floats to nearest even like cvRound and return them as 8x16 bit
+static inline uint16x8_t roundNEON(float32x4_t value0, float32x4_t value1)
+{
+	//adding and subtracting 1.5*2^23 rounds to nearest even. vcvtq_s32_f32 would truncate
+	const float32x4_t roundMagic = vdupq_n_f32(12582912.0f);
+	const int32x4_t rounded0 = vcvtq_s32_f32(vsubq_f32(vaddq_f32(value0, roundMagic), roundMagic));
+	const int32x4_t rounded1 = vcvtq_s32_f32(vsubq_f32(vaddq_f32(value1, roundMagic), roundMagic));
+	return vcombine_u16(vqmovun_s32(rounded0), vqmovun_s32(rounded1));
+}
+
+//load 16 luma values. vld2q_u8 deinterleaves YUYV, so luma ends up in val[0]
+template <uint32_t STRIDE>
+static inline uint8x16_t loadLumaNEON(const uint8_t * luma)
+{
+	if (STRIDE == 1) {
+		return vld1q_u8(luma);
+	}
+	return vld2q_u8(luma).val[0];
+}
+
+//keep old value where 16 bit mask is set, widening the mask to 32 bit
+static inline float32x4_t selectNEON(uint16x4_t mask, float32x4_t oldValue, float32x4_t newValue)
+{
+	return vbslq_f32(vreinterpretq_u32_s32(vmovl_s16(vreinterpret_s16_u16(mask))), oldValue, newValue);
+}
+
+template <uint32_t STRIDE, int VARIANT>
+static void detectRowNEON(const uint8_t * luma, float * background, uint8_t * destination, uint32_t width, float alpha, int32_t threshold, bool outputDifference, bool selectiveUpdate)
+{
+	const float32x4_t vAlpha = vdupq_n_f32(alpha);
+	const float32x4_t vBeta = vdupq_n_f32(1.0f - alpha);
+	const int16x8_t vThreshold = vdupq_n_s16(threshold);
+	uint32_t x = 0;
+	for (; x + 16 <= width; x += 16) {
+		const uint8x16_t pixels = loadLumaNEON<STRIDE>(luma + x * STRIDE);
+		const uint16x8_t grey0 = vmovl_u8(vget_low_u8(pixels));
+		const uint16x8_t grey1 = vmovl_u8(vget_high_u8(pixels));
+		float32x4_t average[4];
+		average[0] = updateNEON<VARIANT>(vcvtq_f32_u32(vmovl_u16(vget_low_u16(grey0))), vld1q_f32(background + x), vAlpha, vBeta);
+		average[1] = updateNEON<VARIANT>(vcvtq_f32_u32(vmovl_u16(vget_high_u16(grey0))), vld1q_f32(background + x + 4), vAlpha, vBeta);
+		average[2] = updateNEON<VARIANT>(vcvtq_f32_u32(vmovl_u16(vget_low_u16(grey1))), vld1q_f32(background + x + 8), vAlpha, vBeta);
+		average[3] = updateNEON<VARIANT>(vcvtq_f32_u32(vmovl_u16(vget_high_u16(grey1))), vld1q_f32(background + x + 12), vAlpha, vBeta);
+		if (destination != nullptr) {
+			const uint16x8_t difference0 = vabdq_u16(roundNEON(average[0], average[1]), grey0);
+			const uint16x8_t difference1 = vabdq_u16(roundNEON(average[2], average[3]), grey1);
+			const uint16x8_t foreground0 = vcgtq_s16(vreinterpretq_s16_u16(difference0), vThreshold);
+			const uint16x8_t foreground1 = vcgtq_s16(vreinterpretq_s16_u16(difference1), vThreshold);
+			if (outputDifference) {
+				vst1q_u8(destination + x, vcombine_u8(vmovn_u16(difference0), vmovn_u16(difference1)));
+			}
+			else {
+				vst1q_u8(destination + x, vcombine_u8(vmovn_u16(foreground0), vmovn_u16(foreground1)));
+			}
+			if (selectiveUpdate) {
+				//keep background of foreground pixels
+				average[0] = selectNEON(vget_low_u16(foreground0), vld1q_f32(background + x), average[0]);
+				average[1] = selectNEON(vget_high_u16(foreground0), vld1q_f32(background + x + 4), average[1]);
+				average[2] = selectNEON(vget_low_u16(foreground1), vld1q_f32(background + x + 8), average[2]);
+				average[3] = selectNEON(vget_high_u16(foreground1), vld1q_f32(background + x + 12), average[3]);
+			}
+		}
+		vst1q_f32(background + x, average[0]);
+		vst1q_f32(background + x + 4, average[1]);
+		vst1q_f32(background + x + 8, average[2]);
+		vst1q_f32(background + x + 12, average[3]);
+	}
+	detectRowScalar<STRIDE, VARIANT>(luma + x * STRIDE, background + x, destination != nullptr ? destination + x : nullptr, width - x, alpha, threshold, outputDifference, selectiveUpdate);
+}
+
+//update 8 fixed point background values. returns new background and stores difference and foreground mask
+static inline uint16x8_t updateFixedNEON(uint16x8_t grey, uint16x8_t background, int16x4_t alpha, uint16x8_t & difference)
+{
+	const int16x8_t halfDifference = vsubq_s16(vreinterpretq_s16_u16(vshlq_n_u16(grey, 7)), vreinterpretq_s16_u16(vshrq_n_u16(background, 1)));
+	const int16x4_t delta0 = vshrn_n_s32(vmull_s16(vget_low_s16(halfDifference), alpha), 16);
+	const int16x4_t delta1 = vshrn_n_s32(vmull_s16(vget_high_s16(halfDifference), alpha), 16);
+	const uint16x8_t average = vaddq_u16(background, vreinterpretq_u16_s16(vcombine_s16(delta0, delta1)));
+	difference = vabdq_u16(vrshrq_n_u16(average, 8), grey);
+	return average;
+}
+
+template <uint32_t STRIDE>
+static void detectRowFixedNEON(const uint8_t * luma, uint16_t * background, uint8_t * destination, uint32_t width, int32_t alpha, int32_t threshold, bool outputDifference, bool selectiveUpdate)
+{
+	const int16x4_t vAlpha = vdup_n_s16(alpha);
+	const int16x8_t vThreshold = vdupq_n_s16(threshold);
+	uint32_t x = 0;
+	for (; x + 16 <= width; x += 16) {
+		const uint8x16_t pixels = loadLumaNEON<STRIDE>(luma + x * STRIDE);
+		const uint16x8_t previous0 = vld1q_u16(background + x);
+		const uint16x8_t previous1 = vld1q_u16(background + x + 8);
+		uint16x8_t difference0;
+		uint16x8_t difference1;
+		uint16x8_t average0 = updateFixedNEON(vmovl_u8(vget_low_u8(pixels)), previous0, vAlpha, difference0);
+		uint16x8_t average1 = updateFixedNEON(vmovl_u8(vget_high_u8(pixels)), previous1, vAlpha, difference1);
+		if (destination != nullptr) {
+			const uint16x8_t foreground0 = vcgtq_s16(vreinterpretq_s16_u16(difference0), vThreshold);
+			const uint16x8_t foreground1 = vcgtq_s16(vreinterpretq_s16_u16(difference1), vThreshold);
+			if (outputDifference) {
+				vst1q_u8(destination + x, vcombine_u8(vmovn_u16(difference0), vmovn_u16(difference1)));
+			}
+			else {
+				vst1q_u8(destination + x, vcombine_u8(vmovn_u16(foreground0), vmovn_u16(foreground1)));
+			}
+			if (selectiveUpdate) {
+				average0 = vbslq_u16(foreground0, previous0, average0);
+				average1 = vbslq_u16(foreground1, previous1, average1);
+			}
+		}
+		vst1q_u16(background + x, average0);
+		vst1q_u16(background + x + 8, average1);
+	}
+	detectRowFixedScalar<STRIDE>(luma + x * STRIDE, background + x, destination != nullptr ? destination + x : nullptr, width - x, alpha, threshold, outputDifference, selectiveUpdate);
+}
+
+#endif //KERNEL_NEON
+
+//row functions of a code path for all update variants and pixel strides
+#define ROW_FUNCTIONS(FUNCTION) { \
+	{&FUNCTION<1, MotionKernel::UPDATE_WEIGHTED_SUM>, &FUNCTION<2, MotionKernel::UPDATE_WEIGHTED_SUM>}, \
+	{&FUNCTION<1, MotionKernel::UPDATE_DIFFERENCE>, &FUNCTION<2, MotionKernel::UPDATE_DIFFERENCE>}, \
+	{&FUNCTION<1, MotionKernel::UPDATE_FUSED_DIFFERENCE>, &FUNCTION<2, MotionKernel::UPDATE_FUSED_DIFFERENCE>}}
+
+
+MotionKernel::MotionKernel()
+	: instructionSet(SCALAR), updateVariant(UPDATE_WEIGHTED_SUM), greyShift(14)
+{
+	greyCoefficients[0] = GREY_COEFFICIENTS_14BIT[0];
+	greyCoefficients[1] = GREY_COEFFICIENTS_14BIT[1];
+	greyCoefficients[2] = GREY_COEFFICIENTS_14BIT[2];
+	//select fastest code path the CPU supports
+	const InstructionSet fastest[3] = {AVX2, SSE2, NEON};
+	for (int i = 0; i < 3 && instructionSet == SCALAR; ++i) {
+		if (isSupported(fastest[i])) {
+			instructionSet = fastest[i];
+		}
+	}
+	detectOpenCVVariants();
+	selectRowFunctions();
+}
+
+void MotionKernel::detectOpenCVVariants()
+{
+	//build a test row covering all byte values and some arbitrary background values
+	const int count = 256;
+	cv::Mat bgr(1, count, CV_8UC3);
+	cv::Mat grey(1, count, CV_8U);
+	cv::Mat background(1, count, CV_32F);
+	uint32_t random = 12345;
+	for (int x = 0; x < count; ++x) {
+		random = random * 1103515245 + 12345;
+		bgr.ptr<uint8_t>(0)[3 * x] = x;
+		bgr.ptr<uint8_t>(0)[3 * x + 1] = random >> 24;
+		bgr.ptr<uint8_t>(0)[3 * x + 2] = random >> 16;
+		grey.ptr<uint8_t>(0)[x] = random >> 8;
+		background.ptr<float>(0)[x] = (random & 0xffff) * (255.0f / 65535.0f);
+	}
+	//check which greyscale coefficients reproduce cvtColor
+	cv::Mat converted;
+	cv::cvtColor(bgr, converted, CV_BGR2GRAY);
+	bool matches14Bit = true;
+	for (int x = 0; x < count; ++x) {
+		const uint8_t * pixel = bgr.ptr<uint8_t>(0) + 3 * x;
+		const int32_t value = (pixel[0] * GREY_COEFFICIENTS_14BIT[0] + pixel[1] * GREY_COEFFICIENTS_14BIT[1] + pixel[2] * GREY_COEFFICIENTS_14BIT[2] + (1 << 13)) >> 14;
+		matches14Bit = matches14Bit && (value == converted.ptr<uint8_t>(0)[x]);
+	}
+	const int32_t * coefficients = matches14Bit ? GREY_COEFFICIENTS_14BIT : GREY_COEFFICIENTS_15BIT;
+	greyShift = matches14Bit ? 14 : 15;
+	greyCoefficients[0] = coefficients[0];
+	greyCoefficients[1] = coefficients[1];
+	greyCoefficients[2] = coefficients[2];
+	//check which update formula reproduces accumulateWeighted
+	cv::Mat accumulated = background.clone();
+	cv::accumulateWeighted(grey, accumulated, 0.05);
+	const UpdateVariant variants[3] = {UPDATE_WEIGHTED_SUM, UPDATE_FUSED_DIFFERENCE, UPDATE_DIFFERENCE};
+	RowFunction scalarFunctions[3][2] = ROW_FUNCTIONS(detectRowScalar);
+	for (int i = 0; i < 3; ++i) {
+		cv::Mat updated = background.clone();
+		scalarFunctions[variants[i]][0](grey.ptr<uint8_t>(0), updated.ptr<float>(0), nullptr, count, 0.05f, 0, false, false);
+		if (memcmp(updated.ptr<float>(0), accumulated.ptr<float>(0), count * sizeof(float)) == 0) {
+			updateVariant = variants[i];
+			break;
+		}
+	}
+}
+
+void MotionKernel::selectRowFunctions()
+{
+	RowFunction scalarFunctions[3][2] = ROW_FUNCTIONS(detectRowScalar);
+	rowFunctions[0] = scalarFunctions[updateVariant][0];
+	rowFunctions[1] = scalarFunctions[updateVariant][1];
+	fixedRowFunctions[0] = &detectRowFixedScalar<1>;
+	fixedRowFunctions[1] = &detectRowFixedScalar<2>;
+#if defined(KERNEL_X86)
+	if (instructionSet == AVX2) {
+		RowFunction avx2Functions[3][2] = ROW_FUNCTIONS(detectRowAVX2);
+		rowFunctions[0] = avx2Functions[updateVariant][0];
+		rowFunctions[1] = avx2Functions[updateVariant][1];
+		fixedRowFunctions[0] = &detectRowFixedAVX2<1>;
+		fixedRowFunctions[1] = &detectRowFixedAVX2<2>;
+	}
+	else if (instructionSet == SSE2) {
+		//SSE2 has no fused multiply-add, so that variant stays scalar
+		if (updateVariant != UPDATE_FUSED_DIFFERENCE) {
+			RowFunction sse2Functions[3][2] = ROW_FUNCTIONS(detectRowSSE2);
+			rowFunctions[0] = sse2Functions[updateVariant][0];
+			rowFunctions[1] = sse2Functions[updateVariant][1];
+		}
+		fixedRowFunctions[0] = &detectRowFixedSSE2<1>;
+		fixedRowFunctions[1] = &detectRowFixedSSE2<2>;
+	}
+#elif defined(KERNEL_NEON)
+	#if !defined(__ARM_FEATURE_FMA)
+	if (updateVariant != UPDATE_FUSED_DIFFERENCE)
+	#endif
+	{
+		RowFunction neonFunctions[3][2] = ROW_FUNCTIONS(detectRowNEON);
+		rowFunctions[0] = neonFunctions[updateVariant][0];
+		rowFunctions[1] = neonFunctions[updateVariant][1];
+	}
+	fixedRowFunctions[0] = &detectRowFixedNEON<1>;
+	fixedRowFunctions[1] = &detectRowFixedNEON<2>;
+#endif
+}
+
+MotionKernel::InstructionSet MotionKernel::getInstructionSet() const
+{
+	return instructionSet;
+}
+
+MotionKernel::UpdateVariant MotionKernel::getUpdateVariant() const
+{
+	return updateVariant;
+}
+
+bool MotionKernel::isSupported(InstructionSet set)
+{
+	switch (set) {
+		case SCALAR:
+			return true;
+#if defined(KERNEL_X86)
+		case SSE2:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("sse2");
+		case AVX2:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#elif defined(KERNEL_NEON)
+		case NEON:
+			return true;
+#endif
+		default:
+			return false;
+	}
+}
+
+bool MotionKernel::setInstructionSet(InstructionSet set)
+{
+	if (!isSupported(set)) {
+		return false;
+	}
+	instructionSet = set;
+	selectRowFunctions();
+	return true;
+}
+
+void MotionKernel::setUpdateVariant(UpdateVariant variant)
+{
+	updateVariant = variant;
+	selectRowFunctions();
+}
+
+const char * MotionKernel::getInstructionSetName(InstructionSet set)
+{
+	switch (set) {
+		case SSE2:
+			return "SSE2";
+		case AVX2:
+			return "AVX2";
+		case NEON:
+			return "NEON";
+		default:
+			return "scalar";
+	}
+}
+
+const uint8_t * MotionKernel::getLumaRow(const cv::Mat & image, FrameSource::PixelFormat format, uint32_t y, uint32_t & pixelStride)
+{
+	pixelStride = 1;
+	switch (format) {
+		case FrameSource::FORMAT_BGR: {
+			//convert row to greyscale like cvtColor(CV_BGR2GRAY)
+			const uint8_t * bgr = image.ptr<uint8_t>(y);
+			rowBuffer.resize(image.cols);
+			for (int x = 0; x < image.cols; ++x, bgr += 3) {
+				rowBuffer[x] = (bgr[0] * greyCoefficients[0] + bgr[1] * greyCoefficients[1] + bgr[2] * greyCoefficients[2] + (1 << (greyShift - 1))) >> greyShift;
+			}
+			return rowBuffer.data();
+		}
+		case FrameSource::FORMAT_YUYV:
+			pixelStride = 2;
+			return image.ptr<uint8_t>(y);
+		default:
+			//greyscale or luma plane of planar formats
+			return image.ptr<uint8_t>(y);
+	}
+}
+
+//get height of the luma plane of an image in source format
+static int getLumaHeight(const cv::Mat & image, FrameSource::PixelFormat format)
+{
+	return (format == FrameSource::FORMAT_NV12 || format == FrameSource::FORMAT_I420) ? image.rows * 2 / 3 : image.rows;
+}
+
+//convert background weight to Q1.17 fixed point. it needs to fit into a signed 16 bit value, so it is limited to < 0.25
+static int32_t getFixedPointAlpha(double alpha)
+{
+	const int32_t fixedAlpha = (int32_t)std::lround(alpha * 131072.0);
+	return fixedAlpha < 0 ? 0 : (fixedAlpha > 32767 ? 32767 : fixedAlpha);
+}
+
+void MotionKernel::initialize(const cv::Mat & image, FrameSource::PixelFormat format, cv::Mat & background, int type)
+{
+	const int height = getLumaHeight(image, format);
+	background.create(height, image.cols, type);
+	for (int y = 0; y < height; ++y) {
+		uint32_t pixelStride = 1;
+		const uint8_t * luma = getLumaRow(image, format, y, pixelStride);
+		if (type == CV_16U) {
+			uint16_t * backgroundRow = background.ptr<uint16_t>(y);
+			for (int x = 0; x < image.cols; ++x) {
+				backgroundRow[x] = luma[x * pixelStride] << 8;
+			}
+		}
+		else {
+			float * backgroundRow = background.ptr<float>(y);
+			for (int x = 0; x < image.cols; ++x) {
+				backgroundRow[x] = luma[x * pixelStride];
+			}
+		}
+	}
+}
+
+void MotionKernel::accumulate(const cv::Mat & image, FrameSource::PixelFormat format, cv::Mat & background, double alpha)
+{
+	const int height = getLumaHeight(image, format);
+	const int32_t fixedAlpha = getFixedPointAlpha(alpha);
+	for (int y = 0; y < height; ++y) {
+		uint32_t pixelStride = 1;
+		const uint8_t * luma = getLumaRow(image, format, y, pixelStride);
+		if (background.type() == CV_16U) {
+			fixedRowFunctions[pixelStride - 1](luma, background.ptr<uint16_t>(y), nullptr, image.cols, fixedAlpha, 0, false, false);
+		}
+		else {
+			rowFunctions[pixelStride - 1](luma, background.ptr<float>(y), nullptr, image.cols, (float)alpha, 0, false, false);
+		}
+	}
+}
+
+void MotionKernel::detect(const cv::Mat & image, FrameSource::PixelFormat format, cv::Mat & background, double alpha, double threshold, cv::Mat & destination, bool outputDifference, bool selectiveUpdate, const cv::Range & rows)
+{
+	const int height = getLumaHeight(image, format);
+	const cv::Range band = rows == cv::Range::all() ? cv::Range(0, height) : rows;
+	destination.create(height, image.cols, CV_8U);
+	const int32_t fixedAlpha = getFixedPointAlpha(alpha);
+	//cv::threshold uses the integer part of the threshold for 8 bit images. clamp to the range the kernels can handle
+	int32_t integerThreshold = (int32_t)std::floor(threshold);
+	integerThreshold = integerThreshold < -1 ? -1 : (integerThreshold > 255 ? 255 : integerThreshold);
+	for (int y = band.start; y < band.end; ++y) {
+		uint32_t pixelStride = 1;
+		const uint8_t * luma = getLumaRow(image, format, y, pixelStride);
+		if (background.type() == CV_16U) {
+			fixedRowFunctions[pixelStride - 1](luma, background.ptr<uint16_t>(y), destination.ptr<uint8_t>(y), image.cols, fixedAlpha, integerThreshold, outputDifference, selectiveUpdate);
+		}
+		else {
+			rowFunctions[pixelStride - 1](luma, background.ptr<float>(y), destination.ptr<uint8_t>(y), image.cols, (float)alpha, integerThreshold, outputDifference, selectiveUpdate);
+		}
+	}
+}
+
+void MotionKernel::downscale(const cv::Mat & image, FrameSource::PixelFormat format, uint32_t factor, cv::Mat & destination, const cv::Range & rows)
+{
+	const int width = image.cols / factor;
+	const int height = getLumaHeight(image, format) / factor;
+	const cv::Range band = rows == cv::Range::all() ? cv::Range(0, height) : rows;
+	const uint32_t area = factor * factor;
+	destination.create(height, width, CV_8U);
+	rowSums.resize(width);
+	for (int y = band.start; y < band.end; ++y) {
+		//sum up factor x factor blocks of source luma
+		std::fill(rowSums.begin(), rowSums.end(), 0);
+		for (uint32_t i = 0; i < factor; ++i) {
+			uint32_t pixelStride = 1;
+			const uint8_t * luma = getLumaRow(image, format, y * factor + i, pixelStride);
+			for (int x = 0; x < width; ++x) {
+				const uint8_t * block = luma + x * factor * pixelStride;
+				for (uint32_t j = 0; j < factor; ++j) {
+					rowSums[x] += block[j * pixelStride];
+				}
+			}
+		}
+		uint8_t * destinationRow = destination.ptr<uint8_t>(y);
+		for (int x = 0; x < width; ++x) {
+			destinationRow[x] = (rowSums[x] + area / 2) / area;
+		}
+	}
+}
+
+cv::Rect MotionKernel::refine(const cv::Mat & image, FrameSource::PixelFormat format, const cv::Mat & background, uint32_t factor, const cv::Rect & region, double threshold)
+{
+	const int32_t integerThreshold = (int32_t)std::floor(threshold);
+	int minX = region.x + region.width;
+	int minY = region.y + region.height;
+	int maxX = region.x - 1;
+	int maxY = region.y - 1;
+	for (int y = region.y; y < region.y + region.height; ++y) {
+		uint32_t pixelStride = 1;
+		const uint8_t * luma = getLumaRow(image, format, y, pixelStride);
+		//the background has a lower resolution. use the nearest background pixel
+		const int backgroundY = std::min<int>(y / factor, background.rows - 1);
+		for (int x = region.x; x < region.x + region.width; ++x) {
+			const int backgroundX = std::min<int>(x / factor, background.cols - 1);
+			int32_t average;
+			if (background.type() == CV_16U) {
+				average = (background.ptr<uint16_t>(backgroundY)[backgroundX] + 128) >> 8;
+			}
+			else {
+				average = (int32_t)lrintf(background.ptr<float>(backgroundY)[backgroundX]);
+			}
+			if (std::abs(average - (int32_t)luma[x * pixelStride]) > integerThreshold) {
+				minX = std::min(minX, x);
+				maxX = std::max(maxX, x);
+				minY = std::min(minY, y);
+				maxY = std::max(maxY, y);
+			}
+		}
+	}
+	return maxX >= minX ? cv::Rect(minX, minY, maxX - minX + 1, maxY - minY + 1) : cv::Rect();
+}
+
+void MotionKernel::adaptiveThreshold(const cv::Mat & difference, cv::Mat & destination, int32_t offset, const cv::Range & rows)
+{
+	const int width = difference.cols;
+	const int height = difference.rows;
+	const cv::Range band = rows == cv::Range::all() ? cv::Range(0, height) : rows;
+	destination.create(height, width, CV_8U);
+	//one extra column on each side replicates the border pixels
+	rowSums.resize(width + 2);
+	for (int y = band.start; y < band.end; ++y) {
+		//sum up the columns of the 3x3 neighbourhoods. rows outside of the image replicate the border rows
+		const uint8_t * above = difference.ptr<uint8_t>(std::max(y - 1, 0));
+		const uint8_t * row = difference.ptr<uint8_t>(y);
+		const uint8_t * below = difference.ptr<uint8_t>(std::min(y + 1, height - 1));
+		uint16_t * columnSums = rowSums.data() + 1;
+		for (int x = 0; x < width; ++x) {
+			columnSums[x] = above[x] + row[x] + below[x];
+		}
+		columnSums[-1] = columnSums[0];
+		columnSums[width] = columnSums[width - 1];
+		//the mean is rounded like cv::boxFilter does. sum / 9 is never exactly halfway between two integers
+		uint8_t * destinationRow = destination.ptr<uint8_t>(y);
+		for (int x = 0; x < width; ++x) {
+			const int32_t mean = ((columnSums[x - 1] + columnSums[x] + columnSums[x + 1]) * 2 + 9) / 18;
+			destinationRow[x] = (int32_t)row[x] - mean > offset ? 255 : 0;
+		}
+	}
+}
+
+uint64_t MotionKernel::getMemoryUsage() const
+{
+	return rowBuffer.capacity() + rowSums.capacity() * sizeof(uint16_t);
+}
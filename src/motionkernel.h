@@ -0,0 +1,166 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "framesource.h"
+
+
+/*!
+Fused per-pixel motion detection kernel.
+Replaces the OpenCV chain cvtColor -> accumulateWeighted -> convertTo(CV_8U) -> absdiff -> threshold with a single
+sweep that reads every source pixel once and writes the updated background and the binary mask in the same pass.
+The luma of the source frame is read in place for all formats but BGR, which is converted one row at a time.
+The background can be kept as CV_32F like accumulateWeighted does or as CV_16U Q8.8 fixed point, which halves its memory
+and is updated with integer SIMD. Fixed point results are close to, but not identical to the OpenCV chain.
+OpenCV versions differ in their greyscale coefficients and in how accumulateWeighted rounds, so the kernel checks which
+variants the linked OpenCV uses once on construction. That way results stay identical to the OpenCV chain bit for bit.
+SSE2/AVX2 code paths are selected at runtime, NEON is used when compiled for ARM.
+*/
+class MotionKernel
+{
+public:
+	enum InstructionSet {SCALAR, SSE2, AVX2, NEON}; //!<Code paths of the kernel.
+	enum UpdateVariant {UPDATE_WEIGHTED_SUM, UPDATE_DIFFERENCE, UPDATE_FUSED_DIFFERENCE}; //!<Background update formulas: src*a + bg*(1-a), bg + (src-bg)*a and the same with a fused multiply-add.
+
+	/*!
+	Kernel function for one row.
+	\param[in] luma Pointer to first luma value of row.
+	\param[in,out] background Pointer to first value of background row. Updated in place.
+	\param[out] destination Pointer to first value of mask or difference row. If nullptr only the background is updated.
+	\param[in] width Number of pixels in row.
+	\param[in] alpha Weight of current frame in background update.
+	\param[in] threshold Pixels with a difference greater than threshold are set to 255 in the mask, others to 0. If outputDifference is true, the difference is stored instead.
+	\param[in] selectiveUpdate If true the background of pixels with a difference greater than threshold is not updated.
+	*/
+	typedef void (*RowFunction)(const uint8_t * luma, float * background, uint8_t * destination, uint32_t width, float alpha, int32_t threshold, bool outputDifference, bool selectiveUpdate);
+
+	/*!
+	Kernel function for one row with a Q8.8 fixed point background. Parameters are the same as for \RowFunction, alpha is passed as Q1.17.
+	*/
+	typedef void (*FixedRowFunction)(const uint8_t * luma, uint16_t * background, uint8_t * destination, uint32_t width, int32_t alpha, int32_t threshold, bool outputDifference, bool selectiveUpdate);
+
+private:
+	InstructionSet instructionSet; //!<Code path used.
+	UpdateVariant updateVariant; //!<Background update formula matching accumulateWeighted.
+	RowFunction rowFunctions[2]; //!<Row kernels for luma pixel strides of 1 and 2 bytes.
+	FixedRowFunction fixedRowFunctions[2]; //!<Fixed point row kernels for luma pixel strides of 1 and 2 bytes.
+	int32_t greyShift; //!<Fixed point shift of BGR to greyscale conversion.
+	int32_t greyCoefficients[3]; //!<Fixed point B, G, R coefficients of BGR to greyscale conversion.
+	std::vector<uint8_t> rowBuffer; //!<Luma of one row for sources that have no luma channel, e.g. BGR.
+	std::vector<uint16_t> rowSums; //!<Block sums of one row when downscaling or column sums of one row when thresholding.
+
+	/*!
+	Find the greyscale coefficients and update formula the linked OpenCV uses.
+	*/
+	void detectOpenCVVariants();
+
+	/*!
+	Select row functions for instruction set and update variant.
+	*/
+	void selectRowFunctions();
+
+	/*!
+	Get pointer to luma of a row and its pixel stride. Converts BGR rows to rowBuffer.
+	*/
+	const uint8_t * getLumaRow(const cv::Mat & image, FrameSource::PixelFormat format, uint32_t y, uint32_t & pixelStride);
+
+public:
+	/*!
+	Create kernel and select fastest code path for the CPU.
+	*/
+	MotionKernel();
+
+	InstructionSet getInstructionSet() const;
+	UpdateVariant getUpdateVariant() const;
+	static const char * getInstructionSetName(InstructionSet set);
+
+	/*!
+	Check if the CPU can run a code path.
+	*/
+	static bool isSupported(InstructionSet set);
+
+	/*!
+	Select a code path other than the fastest one, e.g. to compare code paths in tests.
+	\param[in] set Code path to use.
+	\return Returns false if the CPU does not support the code path. The code path is not changed then.
+	*/
+	bool setInstructionSet(InstructionSet set);
+
+	/*!
+	Select a background update formula other than the one detected, e.g. to test the code paths of all formulas.
+	Results only match the OpenCV chain with the formula detected on construction.
+	*/
+	void setUpdateVariant(UpdateVariant variant);
+
+	/*!
+	Initialize background with the luma of a frame, like converting the greyscale frame to CV_32F.
+	\param[in] image Frame in source pixel format.
+	\param[in] format Source pixel format.
+	\param[out] background Background model. Will be (re-)allocated if needed.
+	\param[in] type Optional. Background type. CV_32F or CV_16U for Q8.8 fixed point.
+	*/
+	void initialize(const cv::Mat & image, FrameSource::PixelFormat format, cv::Mat & background, int type = CV_32F);
+
+	/*!
+	Update background with frame, like accumulateWeighted(grey, background, alpha).
+	\param[in] image Frame in source pixel format.
+	\param[in] format Source pixel format.
+	\param[in,out] background Background model.
+	\param[in] alpha Weight of current frame in background update. Limited to < 0.25 for fixed point backgrounds.
+	*/
+	void accumulate(const cv::Mat & image, FrameSource::PixelFormat format, cv::Mat & background, double alpha);
+
+	/*!
+	Update background with frame and threshold the difference between frame and updated background in one pass.
+	\param[in] image Frame in source pixel format.
+	\param[in] format Source pixel format.
+	\param[in,out] background Background model.
+	\param[in] alpha Weight of current frame in background update.
+	\param[in] threshold Binary threshold like passed to cv::threshold.
+	\param[out] destination Binary mask or difference image, CV_8U. Will be (re-)allocated if needed.
+	\param[in] outputDifference Optional. Pass true to store the absolute difference instead of the binary mask, e.g. for adaptive thresholding.
+	\param[in] selectiveUpdate Optional. Pass true to not update the background of pixels with a difference greater than threshold.
+	\param[in] rows Optional. Only process these rows, e.g. to split the frame between threads. Rows are independent, so bands need no overlap. Allocate destination before processing bands in parallel.
+	*/
+	void detect(const cv::Mat & image, FrameSource::PixelFormat format, cv::Mat & background, double alpha, double threshold, cv::Mat & destination, bool outputDifference = false, bool selectiveUpdate = false, const cv::Range & rows = cv::Range::all());
+
+	/*!
+	Downscale the luma of a frame by averaging blocks of pixels, e.g. for detecting on a coarser pyramid level.
+	\param[in] image Frame in source pixel format.
+	\param[in] format Source pixel format.
+	\param[in] factor Downscaling factor. Blocks of factor x factor pixels are averaged. Must be <= 16.
+	\param[out] destination Downscaled greyscale image, CV_8U. Will be (re-)allocated if needed.
+	\param[in] rows Optional. Only compute these rows of destination. Allocate destination before processing bands in parallel.
+	*/
+	void downscale(const cv::Mat & image, FrameSource::PixelFormat format, uint32_t factor, cv::Mat & destination, const cv::Range & rows = cv::Range::all());
+
+	/*!
+	Find the bounding box of the pixels in a region of a full resolution frame that differ from a downscaled background.
+	The background is not updated.
+	\param[in] image Frame in source pixel format.
+	\param[in] format Source pixel format.
+	\param[in] background Background model downscaled by factor.
+	\param[in] factor Downscaling factor of background.
+	\param[in] region Region of the frame to search.
+	\param[in] threshold Pixels with a difference greater than threshold are considered changed.
+	\return Returns the bounding box of the changed pixels in frame coordinates or an empty rectangle if there are none.
+	*/
+	cv::Rect refine(const cv::Mat & image, FrameSource::PixelFormat format, const cv::Mat & background, uint32_t factor, const cv::Rect & region, double threshold);
+
+	/*!
+	Convert a difference image to binary using the mean of the 3x3 neighbourhood of every pixel as threshold.
+	Gives the same result as cv::adaptiveThreshold with ADAPTIVE_THRESH_MEAN_C, THRESH_BINARY, a block size of 3 and C = -offset,
+	but does not allocate temporary images.
+	\param[in] difference Difference image, CV_8U.
+	\param[out] destination Binary mask, CV_8U. Will be (re-)allocated if needed. Must not be difference.
+	\param[in] offset Pixels greater than the mean of their neighbourhood plus offset are set to 255, others to 0.
+	\param[in] rows Optional. Only compute these rows of destination. The rows above and below are read too, so bands need no overlap. Allocate destination before processing bands in parallel.
+	*/
+	void adaptiveThreshold(const cv::Mat & difference, cv::Mat & destination, int32_t offset, const cv::Range & rows = cv::Range::all());
+
+	/*!
+	Get the size of the row buffers in bytes.
+	*/
+	uint64_t getMemoryUsage() const;
+};
@@ -0,0 +1,202 @@
+#include "phasecorrelator.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+
+//Smallest power of two not less than value
+static uint32_t getPowerOfTwo(uint32_t value)
+{
+	uint32_t result = 1;
+	while (result < value) {
+		result *= 2;
+	}
+	return result;
+}
+
+//Complex multiplication without the NaN and infinity handling of std::complex, which is not inlined
+static inline std::complex<float> multiply(const std::complex<float> & a, const std::complex<float> & b)
+{
+	return std::complex<float>(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+//Hanning window weights like cv::createHanningWindow
+static void setupWindow(std::vector<float> & weights, uint32_t length)
+{
+	weights.resize(length);
+	for (uint32_t i = 0; i < length; ++i) {
+		weights[i] = length > 1 ? 0.5f * (1.0f - std::cos(2.0f * (float)M_PI * i / (length - 1))) : 1.0f;
+	}
+}
+
+PhaseCorrelator::PhaseCorrelator()
+	: hasPrevious(false)
+{
+}
+
+void PhaseCorrelator::setupTransform(Transform & transform, uint32_t length)
+{
+	uint32_t bits = 0;
+	while ((1U << bits) < length) {
+		++bits;
+	}
+	transform.reversed.resize(length);
+	for (uint32_t i = 0; i < length; ++i) {
+		uint32_t reversed = 0;
+		for (uint32_t b = 0; b < bits; ++b) {
+			reversed |= ((i >> b) & 1) << (bits - 1 - b);
+		}
+		transform.reversed[i] = reversed;
+	}
+	transform.twiddles.resize(std::max<uint32_t>(1, length / 2));
+	for (uint32_t k = 0; k < transform.twiddles.size(); ++k) {
+		const double angle = -2.0 * M_PI * k / length;
+		transform.twiddles[k] = std::complex<float>((float)std::cos(angle), (float)std::sin(angle));
+	}
+}
+
+void PhaseCorrelator::transform(std::complex<float> * data, const Transform & tables, bool inverse)
+{
+	const uint32_t length = tables.reversed.size();
+	for (uint32_t i = 0; i < length; ++i) {
+		const uint32_t j = tables.reversed[i];
+		if (i < j) {
+			std::swap(data[i], data[j]);
+		}
+	}
+	//iterative radix-2 butterflies. the inverse transform uses the conjugate twiddles
+	for (uint32_t size = 2; size <= length; size *= 2) {
+		const uint32_t half = size / 2;
+		const uint32_t step = length / size;
+		for (uint32_t start = 0; start < length; start += size) {
+			for (uint32_t k = 0; k < half; ++k) {
+				const std::complex<float> & twiddle = tables.twiddles[k * step];
+				const std::complex<float> odd = multiply(data[start + k + half], inverse ? std::conj(twiddle) : twiddle);
+				data[start + k + half] = data[start + k] - odd;
+				data[start + k] += odd;
+			}
+		}
+	}
+}
+
+void PhaseCorrelator::transform2D(std::vector<std::complex<float>> & data, bool inverse)
+{
+	const int width = transformSize.width;
+	const int height = transformSize.height;
+	for (int y = 0; y < height; ++y) {
+		transform(&data[y * width], rowTransform, inverse);
+	}
+	for (int x = 0; x < width; ++x) {
+		for (int y = 0; y < height; ++y) {
+			column[y] = data[y * width + x];
+		}
+		transform(column.data(), columnTransform, inverse);
+		for (int y = 0; y < height; ++y) {
+			data[y * width + x] = column[y];
+		}
+	}
+}
+
+void PhaseCorrelator::setup(const cv::Size & size)
+{
+	frameSize = size;
+	transformSize = cv::Size(getPowerOfTwo(size.width), getPowerOfTwo(size.height));
+	setupTransform(rowTransform, transformSize.width);
+	setupTransform(columnTransform, transformSize.height);
+	std::vector<float> rowWeights;
+	std::vector<float> columnWeights;
+	setupWindow(columnWeights, size.width);
+	setupWindow(rowWeights, size.height);
+	window.resize(size.area());
+	for (int y = 0; y < size.height; ++y) {
+		for (int x = 0; x < size.width; ++x) {
+			window[y * size.width + x] = rowWeights[y] * columnWeights[x];
+		}
+	}
+	spectrum.assign(transformSize.area(), std::complex<float>(0.0f, 0.0f));
+	previousSpectrum.assign(transformSize.area(), std::complex<float>(0.0f, 0.0f));
+	crossPower.assign(transformSize.area(), std::complex<float>(0.0f, 0.0f));
+	column.resize(transformSize.height);
+	hasPrevious = false;
+}
+
+void PhaseCorrelator::reset()
+{
+	hasPrevious = false;
+}
+
+bool PhaseCorrelator::correlate(const cv::Mat & frame, cv::Point2f & shift)
+{
+	if (frame.size() != frameSize) {
+		setup(frame.size());
+	}
+	const int width = transformSize.width;
+	const int height = transformSize.height;
+	//window the frame to suppress the edges and zero-pad it to the transform size
+	std::fill(spectrum.begin(), spectrum.end(), std::complex<float>(0.0f, 0.0f));
+	for (int y = 0; y < frameSize.height; ++y) {
+		const uint8_t * row = frame.ptr<uint8_t>(y);
+		const float * weights = &window[y * frameSize.width];
+		std::complex<float> * destination = &spectrum[y * width];
+		for (int x = 0; x < frameSize.width; ++x) {
+			destination[x] = std::complex<float>(row[x] * weights[x], 0.0f);
+		}
+	}
+	transform2D(spectrum, false);
+	const bool correlated = hasPrevious;
+	if (correlated) {
+		//normalized cross-power spectrum of the previous and current frame. only the phase is kept
+		for (uint32_t i = 0; i < crossPower.size(); ++i) {
+			const std::complex<float> product = multiply(previousSpectrum[i], std::conj(spectrum[i]));
+			crossPower[i] = product / (std::abs(product) + FLT_EPSILON);
+		}
+		//its inverse transform peaks at the shift of the previous frame against the current one
+		transform2D(crossPower, true);
+		uint32_t peakIndex = 0;
+		for (uint32_t i = 1; i < crossPower.size(); ++i) {
+			if (crossPower[i].real() > crossPower[peakIndex].real()) {
+				peakIndex = i;
+			}
+		}
+		const int peakX = peakIndex % width;
+		const int peakY = peakIndex / width;
+		//refine the peak with the centroid of its 5x5 neighbourhood. the correlation wraps around at the edges
+		float sum = 0.0f;
+		float sumX = 0.0f;
+		float sumY = 0.0f;
+		for (int dy = -2; dy <= 2; ++dy) {
+			const std::complex<float> * row = &crossPower[((peakY + dy + height) % height) * width];
+			for (int dx = -2; dx <= 2; ++dx) {
+				const float value = row[(peakX + dx + width) % width].real();
+				sum += value;
+				sumX += value * dx;
+				sumY += value * dy;
+			}
+		}
+		cv::Point2f location((float)peakX, (float)peakY);
+		if (sum > 0.0f) {
+			location.x += sumX / sum;
+			location.y += sumY / sum;
+		}
+		//peaks in the upper half of the correlation are negative offsets
+		if (location.x > width / 2) {
+			location.x -= width;
+		}
+		if (location.y > height / 2) {
+			location.y -= height;
+		}
+		//the current frame is shifted against the previous one the other way round
+		shift = -location;
+	}
+	//keep the spectrum for the next frame
+	std::swap(previousSpectrum, spectrum);
+	hasPrevious = true;
+	return correlated;
+}
+
+uint64_t PhaseCorrelator::getMemoryUsage() const
+{
+	const uint64_t complexCount = spectrum.capacity() + previousSpectrum.capacity() + crossPower.capacity() + column.capacity() + rowTransform.twiddles.capacity() + columnTransform.twiddles.capacity();
+	return complexCount * sizeof(std::complex<float>) + window.capacity() * sizeof(float) + (rowTransform.reversed.capacity() + columnTransform.reversed.capacity()) * sizeof(uint32_t);
+}
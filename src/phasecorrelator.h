@@ -0,0 +1,73 @@
+#pragma once
+
+#include <complex>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+
+/*!
+Finds the global shift of a frame against the previous one by phase correlation, like cv::phaseCorrelate with a Hanning
+window. Frames are zero-padded to power of two sizes and transformed with a radix-2 FFT working in the buffers set up
+for the frame size, so correlating frames of the same size never allocates. cv::dft allocates scratch memory per call.
+Every frame is transformed once, its spectrum is kept for the next frame.
+*/
+class PhaseCorrelator
+{
+	struct Transform
+	{
+		std::vector<std::complex<float>> twiddles; //!<exp(-2 pi i k / length) for the first half of the transform length.
+		std::vector<uint32_t> reversed; //!<Bit reversed index of every element. Its size is the transform length.
+	};
+
+	cv::Size frameSize; //!<Size of the frames correlated.
+	cv::Size transformSize; //!<Size of the zero-padded frames. Powers of two.
+	Transform rowTransform; //!<Tables for transforming the rows.
+	Transform columnTransform; //!<Tables for transforming the columns.
+	std::vector<float> window; //!<Hanning window of the frame size.
+	std::vector<std::complex<float>> spectrum; //!<Spectrum of the current frame, row by row.
+	std::vector<std::complex<float>> previousSpectrum; //!<Spectrum of the previous frame.
+	std::vector<std::complex<float>> crossPower; //!<Normalized cross-power spectrum. Transformed into the correlation in place.
+	std::vector<std::complex<float>> column; //!<Column being transformed, so it is contiguous in memory.
+	bool hasPrevious; //!<true if previousSpectrum holds the spectrum of the previous frame.
+
+	/*!
+	Set up bit reversal and twiddle tables for a power of two transform length.
+	*/
+	static void setupTransform(Transform & transform, uint32_t length);
+
+	/*!
+	Transform a sequence in place. The inverse transform is not scaled.
+	*/
+	static void transform(std::complex<float> * data, const Transform & tables, bool inverse);
+
+	/*!
+	Transform the rows, then the columns of a padded image in place.
+	*/
+	void transform2D(std::vector<std::complex<float>> & data, bool inverse);
+
+public:
+	PhaseCorrelator();
+
+	/*!
+	Allocate the buffers for a frame size and forget the previous frame.
+	*/
+	void setup(const cv::Size & size);
+
+	/*!
+	Forget the previous frame, e.g. when the view jumped.
+	*/
+	void reset();
+
+	/*!
+	Transform a frame and correlate it with the previous one. Frames of another size than the previous one call \setup.
+	\param[in] frame Frame, CV_8U.
+	\param[out] shift Shift of the frame against the previous one in pixels.
+	\return Returns false if there is no previous frame of the same size. shift is not set then.
+	*/
+	bool correlate(const cv::Mat & frame, cv::Point2f & shift);
+
+	/*!
+	Get the size of the transform buffers in bytes.
+	*/
+	uint64_t getMemoryUsage() const;
+};
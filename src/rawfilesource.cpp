@@ -0,0 +1,100 @@
+#include "rawfilesource.h"
+
+#include <iostream>
+
+#include "consolestyle.h"
+#include "timestamp.h"
+
+
+//get pixel format from file name extension
+static FrameSource::PixelFormat formatFromFileName(const std::string & fileName)
+{
+	const std::string::size_type dot = fileName.find_last_of('.');
+	if (dot != std::string::npos) {
+		const std::string extension = fileName.substr(dot + 1);
+		if (extension == "yuyv") {
+			return FrameSource::FORMAT_YUYV;
+		}
+		else if (extension == "grey" || extension == "y8") {
+			return FrameSource::FORMAT_GREY;
+		}
+		else if (extension == "nv12") {
+			return FrameSource::FORMAT_NV12;
+		}
+		else if (extension == "i420" || extension == "yuv") {
+			return FrameSource::FORMAT_I420;
+		}
+	}
+	return FrameSource::FORMAT_UNKNOWN;
+}
+
+
+RawFileSource::RawFileSource()
+	: file(nullptr), frameBytes(0)
+{
+}
+
+bool RawFileSource::isRawFile(const std::string & fileName)
+{
+	return formatFromFileName(fileName) != FORMAT_UNKNOWN;
+}
+
+bool RawFileSource::open(const std::string & fileName, uint32_t frameWidth, uint32_t frameHeight, double frameFps)
+{
+	close();
+	format = formatFromFileName(fileName);
+	if (format == FORMAT_UNKNOWN) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Unknown raw frame format for \"" << fileName << "\"!" << ConsoleStyle() << std::endl;
+		return false;
+	}
+	file = fopen(fileName.c_str(), "rb");
+	if (file == nullptr) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to open raw video file \"" << fileName << "\" for motion detection!" << ConsoleStyle() << std::endl;
+		return false;
+	}
+	width = frameWidth;
+	height = frameHeight;
+	fps = frameFps;
+	frameBytes = (size_t)width * height * getBitsPerPixel(format) / 8;
+	std::cout << ConsoleStyle(ConsoleStyle::GREEN) << "Opened raw video file \"" << fileName << "\" for motion detection." << ConsoleStyle() << std::endl;
+	return true;
+}
+
+bool RawFileSource::isOpened() const
+{
+	return file != nullptr;
+}
+
+bool RawFileSource::isLive() const
+{
+	return false;
+}
+
+bool RawFileSource::read(cv::Mat & image, int32_t & bufferIndex, uint64_t & timestamp)
+{
+	bufferIndex = -1;
+	if (file == nullptr) {
+		return false;
+	}
+	//make sure the image is continuous and has the right size. a preallocated image is reused
+	const cv::Size imageSize = getImageSize();
+	image.create(imageSize, getImageType());
+	if (!image.isContinuous() || fread(image.data, 1, frameBytes, file) != frameBytes) {
+		return false;
+	}
+	timestamp = getTimestampUs();
+	return true;
+}
+
+void RawFileSource::close()
+{
+	if (file != nullptr) {
+		fclose(file);
+		file = nullptr;
+	}
+}
+
+RawFileSource::~RawFileSource()
+{
+	close();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdio>
+
+#include "framesource.h"
+
+
+/*!
+Frame source reading raw frame dumps, e.g. YUYV frames recorded from a camera with "v4l2-ctl --stream-to".
+This lets the native camera pixel formats be run through detection on a machine without a camera.
+The file contains no header, so the frame size must be known. The pixel format is taken from the file extension:
+".yuyv" for YUYV, ".grey" or ".y8" for 8-bit greyscale, ".nv12" for NV12 and ".i420" or ".yuv" for YUV420 frames.
+*/
+class RawFileSource : public FrameSource
+{
+	FILE * file; //!<Dump file.
+	size_t frameBytes; //!<Size of one frame in bytes.
+
+public:
+	RawFileSource();
+
+	/*!
+	Check if a file name has one of the supported raw dump extensions.
+	*/
+	static bool isRawFile(const std::string & fileName);
+
+	/*!
+	Open raw frame dump.
+	\param[in] fileName Dump file to open.
+	\param[in] width Width of frames in file.
+	\param[in] height Height of frames in file.
+	\param[in] fps Frames/s to play file at.
+	*/
+	bool open(const std::string & fileName, uint32_t width, uint32_t height, double fps);
+
+	bool isOpened() const;
+	bool isLive() const;
+	bool read(cv::Mat & image, int32_t & bufferIndex, uint64_t & timestamp);
+	void close();
+
+	~RawFileSource();
+};
@@ -0,0 +1,119 @@
+#include "reactor.h"
+
+#include <iostream>
+#include <errno.h>
+#include <unistd.h>
+
+#include "consolestyle.h"
+
+
+Reactor::Reactor()
+	: epollDescriptor(epoll_create1(EPOLL_CLOEXEC)), stopped(false)
+{
+	if (epollDescriptor < 0) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to create epoll instance!" << ConsoleStyle() << std::endl;
+		return;
+	}
+	add(wakeup.getDescriptor(), EPOLLIN, handleWakeup, this);
+}
+
+void Reactor::handleWakeup(void * obj, uint32_t events)
+{
+	Reactor * reactor = reinterpret_cast<Reactor *>(obj);
+	reactor->wakeup.wait(0);
+}
+
+bool Reactor::isAvailable() const
+{
+	return epollDescriptor >= 0 && wakeup.isAvailable();
+}
+
+bool Reactor::add(int descriptor, uint32_t events, EventFunction function, void * context)
+{
+	if (epollDescriptor < 0 || descriptor < 0) {
+		return false;
+	}
+	epoll_event event = {};
+	event.events = events;
+	event.data.fd = descriptor;
+	if (epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, descriptor, &event) != 0) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to add descriptor " << descriptor << " to epoll instance. Error: " << errno << "." << ConsoleStyle() << std::endl;
+		return false;
+	}
+	Handler handler = {descriptor, function, context};
+	handlers.push_back(handler);
+	readyEvents.resize(handlers.size());
+	return true;
+}
+
+bool Reactor::modify(int descriptor, uint32_t events)
+{
+	epoll_event event = {};
+	event.events = events;
+	event.data.fd = descriptor;
+	return epoll_ctl(epollDescriptor, EPOLL_CTL_MOD, descriptor, &event) == 0;
+}
+
+void Reactor::remove(int descriptor)
+{
+	for (auto hIt = handlers.begin(); hIt != handlers.end(); ++hIt) {
+		if (hIt->descriptor == descriptor) {
+			epoll_ctl(epollDescriptor, EPOLL_CTL_DEL, descriptor, nullptr);
+			handlers.erase(hIt);
+			return;
+		}
+	}
+}
+
+int Reactor::getDescriptor() const
+{
+	return epollDescriptor;
+}
+
+int Reactor::runOnce(int timeoutMs)
+{
+	if (epollDescriptor < 0) {
+		return -1;
+	}
+	const int count = epoll_wait(epollDescriptor, readyEvents.data(), readyEvents.size(), timeoutMs);
+	if (count < 0) {
+		//a signal is no error
+		return errno == EINTR ? 0 : -1;
+	}
+	for (int i = 0; i < count; ++i) {
+		//look the handler up now, a previous handler may have removed it
+		const int descriptor = readyEvents[i].data.fd;
+		for (auto hIt = handlers.cbegin(); hIt != handlers.cend(); ++hIt) {
+			if (hIt->descriptor == descriptor) {
+				//copy it. the function may add or remove handlers
+				const Handler handler = *hIt;
+				handler.function(handler.context, readyEvents[i].events);
+				break;
+			}
+		}
+	}
+	return count;
+}
+
+void Reactor::run()
+{
+	while (!stopped) {
+		if (runOnce(-1) < 0) {
+			std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to wait for events. Error: " << errno << "." << ConsoleStyle() << std::endl;
+			break;
+		}
+	}
+}
+
+void Reactor::stop()
+{
+	stopped = true;
+	wakeup.notify();
+}
+
+Reactor::~Reactor()
+{
+	if (epollDescriptor >= 0) {
+		close(epollDescriptor);
+	}
+}
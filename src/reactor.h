@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+#include <sys/epoll.h>
+
+#include "eventnotifier.h"
+
+
+/*!
+Event loop waiting for many file descriptors at once with epoll, e.g. input devices, eventfds, timerfds and USB.
+The thread running the loop sleeps till a descriptor is ready and then calls the function registered for it, so there is no
+polling interval adding latency and no wakeups while nothing happens.
+Descriptors are level triggered, so a function must handle all pending data or it is called again right away.
+Add and remove descriptors from the thread running the loop or before it runs. Handlers may add and remove descriptors.
+*/
+class Reactor
+{
+public:
+	/*!
+	Function called when a descriptor is ready.
+	\param[in] context Context pointer passed to \add.
+	\param[in] events Ready events, e.g. EPOLLIN, EPOLLOUT, EPOLLERR or EPOLLHUP.
+	*/
+	typedef void (*EventFunction)(void * context, uint32_t events);
+
+private:
+	struct Handler
+	{
+		int descriptor; //!<Descriptor waited for.
+		EventFunction function; //!<Function to call when descriptor is ready.
+		void * context; //!<Context passed to function.
+	};
+
+	int epollDescriptor; //!<epoll instance or -1.
+	std::vector<Handler> handlers; //!<Registered descriptors. Looked up by descriptor, so removing one while dispatching is safe.
+	std::vector<epoll_event> readyEvents; //!<Ready events of the last wait.
+	EventNotifier wakeup; //!<Notified to stop the loop from other threads.
+	std::atomic<bool> stopped; //!<If true \run returns. Set from other threads.
+
+	Reactor(const Reactor &);
+	Reactor & operator=(const Reactor &);
+
+	static void handleWakeup(void * obj, uint32_t events);
+
+public:
+	Reactor();
+
+	/*!
+	Check if the reactor can be used.
+	\return Returns true if the epoll instance could be created.
+	*/
+	bool isAvailable() const;
+
+	/*!
+	Wait for a descriptor.
+	\param[in] descriptor Descriptor to wait for.
+	\param[in] events Events to wait for, e.g. EPOLLIN or EPOLLOUT. Errors and hang-ups are always reported.
+	\param[in] function Function to call when descriptor is ready.
+	\param[in] context Context pointer passed to function.
+	\return Returns true if the descriptor was added.
+	*/
+	bool add(int descriptor, uint32_t events, EventFunction function, void * context);
+
+	/*!
+	Change the events to wait for on a descriptor, e.g. to wait for EPOLLOUT only while there is data to write.
+	\return Returns true if the events were changed.
+	*/
+	bool modify(int descriptor, uint32_t events);
+
+	/*!
+	Stop waiting for a descriptor. Call before closing it.
+	*/
+	void remove(int descriptor);
+
+	/*!
+	Get the epoll descriptor, e.g. to wait for this reactor in another one. It is readable while registered descriptors are
+	ready. Handle them with \runOnce(0).
+	*/
+	int getDescriptor() const;
+
+	/*!
+	Wait till descriptors are ready and call their functions.
+	\param[in] timeoutMs Maximum time to wait in ms. -1 waits till a descriptor is ready, 0 only checks.
+	\return Returns the number of ready descriptors or -1 on error.
+	*/
+	int runOnce(int timeoutMs);
+
+	/*!
+	Run the loop till \stop is called.
+	*/
+	void run();
+
+	/*!
+	Make \run return after the current dispatch. Can be called from any thread.
+	*/
+	void stop();
+
+	~Reactor();
+};
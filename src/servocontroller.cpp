@@ -0,0 +1,102 @@
+#include "servocontroller.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+//movement commands by horizontal and vertical direction. index is direction + 1
+static const MissileControl::LauncherCommand directionCommands[3][3] = {
+	{MissileControl::LEFTUP, MissileControl::UP, MissileControl::RIGHTUP},
+	{MissileControl::LEFT, MissileControl::NONE, MissileControl::RIGHT},
+	{MissileControl::LEFTDOWN, MissileControl::DOWN, MissileControl::RIGHTDOWN}
+};
+
+
+ServoController::ServoController(float kp, float ki, float band, int minPulse, int maxPulse)
+	: proportionalGain(kp), integralGain(ki), deadband(band), minPulseMs(minPulse), maxPulseMs(maxPulse),
+	  integralX(0.0f), integralY(0.0f), lastUpdate(0), busyUntil(0)
+{
+}
+
+void ServoController::setGains(float kp, float ki)
+{
+	proportionalGain = kp;
+	integralGain = ki;
+}
+
+void ServoController::setDeadband(float band)
+{
+	deadband = band;
+}
+
+void ServoController::setCalibration(const LauncherCalibration & model)
+{
+	calibration = model;
+}
+
+void ServoController::reset()
+{
+	integralX = 0.0f;
+	integralY = 0.0f;
+	lastUpdate = 0;
+	busyUntil = 0;
+}
+
+float ServoController::updateAxis(float error, float & integral, float dt, MissileControl::LauncherCommand negative, MissileControl::LauncherCommand positive) const
+{
+	//don't keep pushing once the target is reached
+	if (std::fabs(error) <= deadband) {
+		integral = 0.0f;
+		return 0.0f;
+	}
+	//the target was overshot, the accumulated error points the wrong way now
+	if ((error > 0.0f) != (integral > 0.0f)) {
+		integral = 0.0f;
+	}
+	integral += error * dt;
+	//limit the integral to what one pulse can do, so it doesn't wind up while the target is out of reach
+	if (integralGain > 0.0f) {
+		const float maxIntegral = maxPulseMs / integralGain;
+		integral = std::min(std::max(integral, -maxIntegral), maxIntegral);
+	}
+	//a calibrated launcher knows the pulse that removes the error
+	if (calibration.isValid()) {
+		const float pulse = error > 0.0f ? calibration.getPulseDuration(positive, error) : -calibration.getPulseDuration(negative, -error);
+		return pulse + integralGain * integral;
+	}
+	return proportionalGain * error + integralGain * integral;
+}
+
+ServoController::Command ServoController::update(float errorX, float errorY, uint64_t now)
+{
+	Command result = {MissileControl::NONE, 0};
+	//the error is stale while the launcher is still moving
+	if (now < busyUntil) {
+		return result;
+	}
+	//integrate over the time since the last update, but not over long pauses without target
+	const float dt = lastUpdate != 0 ? std::min((now - lastUpdate) / 1000000.0f, 0.2f) : 0.0f;
+	lastUpdate = now;
+	//pulses shorter than the launcher can do would overshoot small errors. leave them to the integral to build up
+	float pulseX = updateAxis(errorX, integralX, dt, MissileControl::LEFT, MissileControl::RIGHT);
+	float pulseY = updateAxis(errorY, integralY, dt, MissileControl::UP, MissileControl::DOWN);
+	pulseX = std::fabs(pulseX) < minPulseMs ? 0.0f : pulseX;
+	pulseY = std::fabs(pulseY) < minPulseMs ? 0.0f : pulseY;
+	const int directionX = pulseX > 0.0f ? 1 : (pulseX < 0.0f ? -1 : 0);
+	const int directionY = pulseY > 0.0f ? 1 : (pulseY < 0.0f ? -1 : 0);
+	result.command = directionCommands[directionY + 1][directionX + 1];
+	if (result.command == MissileControl::NONE) {
+		return result;
+	}
+	//diagonal commands move both axes equally long. the rest of the longer axis is done by the next pulse
+	float duration = 0.0f;
+	if (directionX != 0 && directionY != 0) {
+		duration = std::min(std::fabs(pulseX), std::fabs(pulseY));
+	}
+	else {
+		duration = std::max(std::fabs(pulseX), std::fabs(pulseY));
+	}
+	result.durationMs = std::min((int)duration, maxPulseMs);
+	busyUntil = now + result.durationMs * 1000;
+	return result;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "launchercalibration.h"
+#include "missilecontrol.h"
+
+
+/*!
+Steers the launcher towards a target with a PI controller per axis.
+The pixel error between target and aim point is turned into the duration of a movement pulse. If both axes need to
+move, a diagonal command moves them at the same time. Errors inside the deadband are ignored, so the launcher settles
+instead of jittering around the target. While a pulse is running no new one is issued, so the controller can be
+updated with every analyzed frame. Small errors that need less than the shortest pulse are left to the integral
+to build up, so the launcher does not overshoot them. With a \LauncherCalibration the proportional part is the pulse
+that removes the whole error at once.
+*/
+class ServoController
+{
+public:
+	struct Command
+	{
+		MissileControl::LauncherCommand command; //!<Movement command or NONE if no movement is needed.
+		int durationMs; //!<Pulse duration in ms.
+	};
+
+private:
+	float proportionalGain; //!<Pulse duration per pixel of error in ms.
+	float integralGain; //!<Pulse duration per accumulated error in ms/(pixels * s).
+	float deadband; //!<Errors up to this in pixels are ignored.
+	int minPulseMs; //!<Shortest pulse the launcher can execute in ms.
+	int maxPulseMs; //!<Longest pulse issued at once in ms.
+	float integralX; //!<Accumulated error in x in pixels * s.
+	float integralY; //!<Accumulated error in y in pixels * s.
+	uint64_t lastUpdate; //!<Time of last update in us or 0.
+	uint64_t busyUntil; //!<End of the running pulse in us.
+	LauncherCalibration calibration; //!<Pulse durations per pixel if valid.
+
+	/*!
+	Update the integral of one axis and get the signed pulse duration.
+	*/
+	float updateAxis(float error, float & integral, float dt, MissileControl::LauncherCommand negative, MissileControl::LauncherCommand positive) const;
+
+public:
+	/*!
+	Create controller.
+	\param[in] kp Optional. Pulse duration per pixel of error in ms.
+	\param[in] ki Optional. Pulse duration per accumulated error in ms/(pixels * s).
+	\param[in] band Optional. Errors up to this in pixels are ignored.
+	\param[in] minPulse Optional. Shortest pulse in ms. Should be the launcher control interval.
+	\param[in] maxPulse Optional. Longest pulse issued at once in ms.
+	*/
+	ServoController(float kp = 2.0f, float ki = 1.0f, float band = 4.0f, int minPulse = 20, int maxPulse = 250);
+
+	/*!
+	Set the controller gains.
+	\param[in] kp Pulse duration per pixel of error in ms.
+	\param[in] ki Pulse duration per accumulated error in ms/(pixels * s).
+	*/
+	void setGains(float kp, float ki);
+
+	/*!
+	Set the error below which the launcher is not moved.
+	\param[in] band Deadband in pixels.
+	*/
+	void setDeadband(float band);
+
+	/*!
+	Size pulses using a measured launcher model instead of the proportional gain.
+	\param[in] model Calibration. Ignored if not valid.
+	*/
+	void setCalibration(const LauncherCalibration & model);
+
+	/*!
+	Clear the accumulated error, e.g. when the target changed or the launcher was moved manually.
+	*/
+	void reset();
+
+	/*!
+	Calculate the next movement pulse.
+	\param[in] errorX Offset of target from aim point in x in pixels. Positive values move the launcher right.
+	\param[in] errorY Offset of target from aim point in y in pixels. Positive values move the launcher down.
+	\param[in] now Current CLOCK_MONOTONIC time in us.
+	\return Returns the command to execute. The command is NONE if the target is in the deadband or the last pulse is still running.
+	*/
+	Command update(float errorX, float errorY, uint64_t now);
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+
+/*!
+Lock-free first-in first-out queue from one producer thread to one consumer thread.
+Unlike \TripleBuffer no value is ever skipped: values are popped in the order they were pushed and a full queue refuses new
+values instead of overwriting old ones, so the producer can leave them where they came from till there is room.
+The storage is a fixed ring of Capacity values, so pushing and popping never allocate.
+*/
+template <typename T, uint32_t Capacity>
+class SpscQueue
+{
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+	T values[Capacity]; //!<Ring of values.
+	alignas(64) std::atomic<uint32_t> head; //!<Number of values popped. Written by the consumer. Own cache line, so the sides don't invalidate each other.
+	alignas(64) std::atomic<uint32_t> tail; //!<Number of values pushed. Written by the producer.
+
+	SpscQueue(const SpscQueue &);
+	SpscQueue & operator=(const SpscQueue &);
+
+public:
+	SpscQueue() : head(0), tail(0) {};
+
+	/*!
+	Get the number of values that can be pushed right now. Producer thread only.
+	*/
+	uint32_t getFreeCount() const
+	{
+		return Capacity - (tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire));
+	}
+
+	/*!
+	Append a value. Producer thread only.
+	\return Returns false if the queue is full. The value was not pushed then.
+	*/
+	bool push(const T & value)
+	{
+		const uint32_t position = tail.load(std::memory_order_relaxed);
+		if (position - head.load(std::memory_order_acquire) >= Capacity) {
+			return false;
+		}
+		values[position & (Capacity - 1)] = value;
+		tail.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	/*!
+	Remove the oldest value. Consumer thread only.
+	\return Returns false if the queue is empty.
+	*/
+	bool pop(T & value)
+	{
+		const uint32_t position = head.load(std::memory_order_relaxed);
+		if (position == tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		value = values[position & (Capacity - 1)];
+		head.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	/*!
+	Check if there are values to pop. Consumer thread only.
+	*/
+	bool isEmpty() const
+	{
+		return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire);
+	}
+};
@@ -0,0 +1,70 @@
+#include "targetselector.h"
+
+#include <algorithm>
+
+
+TargetSelector::TargetSelector(uint32_t sourceCount, uint64_t maxAge, float ratio)
+	: lastMotion(sourceCount), selectedSource(-1), maxAgeUs(maxAge), switchRatio(ratio)
+{
+}
+
+void TargetSelector::update(uint32_t source, const MotionDetector::MotionInformation & motion)
+{
+	if (source < lastMotion.size()) {
+		lastMotion[source] = motion;
+	}
+}
+
+bool TargetSelector::isValid(uint32_t source, uint64_t now) const
+{
+	const MotionDetector::MotionInformation & motion = lastMotion[source];
+	return motion.motionDetected && motion.timestamp + maxAgeUs >= now;
+}
+
+bool TargetSelector::isBigger(const Target & a, const Target & b)
+{
+	return a.motion.area > b.motion.area;
+}
+
+bool TargetSelector::select(uint64_t now, Target & target)
+{
+	//find the biggest recent motion
+	int32_t best = -1;
+	for (uint32_t source = 0; source < lastMotion.size(); ++source) {
+		if (isValid(source, now) && (best < 0 || lastMotion[source].area > lastMotion[best].area)) {
+			best = source;
+		}
+	}
+	//stay with the current target unless the new one is clearly bigger
+	if (best >= 0 && selectedSource >= 0 && best != selectedSource && isValid(selectedSource, now)) {
+		if (lastMotion[best].area < switchRatio * lastMotion[selectedSource].area) {
+			best = selectedSource;
+		}
+	}
+	selectedSource = best;
+	if (best < 0) {
+		return false;
+	}
+	target.source = best;
+	target.motion = lastMotion[best];
+	return true;
+}
+
+bool TargetSelector::selectAll(uint64_t now, std::vector<Target> & targets)
+{
+	targets.clear();
+	Target target;
+	if (!select(now, target)) {
+		return false;
+	}
+	targets.push_back(target);
+	for (uint32_t source = 0; source < lastMotion.size(); ++source) {
+		if (source != target.source && isValid(source, now)) {
+			Target other = {source, lastMotion[source]};
+			targets.push_back(other);
+		}
+	}
+	//the selected target stays first
+	std::sort(targets.begin() + 1, targets.end(), &TargetSelector::isBigger);
+	return true;
+}
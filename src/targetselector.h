@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+
+#include "motiondetector.h"
+
+
+/*!
+Picks the one target the launcher engages from the motion reported by several sources, e.g. cameras.
+The target with the biggest motion area wins. The current target is kept until it disappears or another one is clearly
+bigger, so the launcher does not flip between sources with similar motion.
+*/
+class TargetSelector
+{
+public:
+	struct Target
+	{
+		uint32_t source; //!<Index of the source the target was seen by.
+		MotionDetector::MotionInformation motion; //!<Last motion information of target.
+	};
+
+private:
+	std::vector<MotionDetector::MotionInformation> lastMotion; //!<Last motion reported per source.
+	int32_t selectedSource; //!<Source of the current target or -1.
+	uint64_t maxAgeUs; //!<Motion captured longer ago than this is ignored.
+	float switchRatio; //!<Another target must have a bigger area by this factor to replace the current target.
+
+	bool isValid(uint32_t source, uint64_t now) const;
+	static bool isBigger(const Target & a, const Target & b);
+
+public:
+	/*!
+	Create target selector.
+	\param[in] sourceCount Number of sources motion is reported from.
+	\param[in] maxAge Optional. Motion captured longer ago than this in us is ignored.
+	\param[in] ratio Optional. Another target must have a bigger area by this factor to replace the current target.
+	*/
+	TargetSelector(uint32_t sourceCount, uint64_t maxAge = 500000, float ratio = 2.0f);
+
+	/*!
+	Store new motion information of a source.
+	\param[in] source Index of source.
+	\param[in] motion Motion information from \MotionDetector::getLastMotion.
+	*/
+	void update(uint32_t source, const MotionDetector::MotionInformation & motion);
+
+	/*!
+	Select the target to engage.
+	\param[in] now Current CLOCK_MONOTONIC time in us.
+	\param[out] target The selected target if the function returns true.
+	\return Returns true if there is a target.
+	*/
+	bool select(uint64_t now, Target & target);
+
+	/*!
+	Select all targets, e.g. to engage them with several launchers.
+	\param[in] now Current CLOCK_MONOTONIC time in us.
+	\param[out] targets The target \select picks first, then the others with the biggest motion area first.
+	\return Returns true if there is a target.
+	*/
+	bool selectAll(uint64_t now, std::vector<Target> & targets);
+};
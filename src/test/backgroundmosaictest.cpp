@@ -0,0 +1,120 @@
+#include "tests.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+#include "allocationcounter.h"
+#include "backgroundmosaic.h"
+#include "consolestyle.h"
+
+
+//Small tiles and few of them, so views span several tiles and panning evicts tiles all the time
+static const uint32_t TileSize = 16;
+static const uint32_t MaxTiles = 64;
+//The last views stored fit into the mosaic without evicting each other. A view touches at most 4 x 3 tiles
+static const cv::Size ViewSize(40, 30);
+static const int KeptViews = 5;
+
+//Background value of a mosaic pixel, so seeded pixels can be checked wherever they came from
+static float getBackground(int x, int y)
+{
+	return (float)((x * 31 + y * 17) & 0xffff);
+}
+
+//Create a view of the background at a mosaic position
+static cv::Mat makeView(const cv::Point & position)
+{
+	cv::Mat view(ViewSize, CV_32F);
+	for (int y = 0; y < view.rows; ++y) {
+		float * row = view.ptr<float>(y);
+		for (int x = 0; x < view.cols; ++x) {
+			row[x] = getBackground(position.x + x, position.y + y);
+		}
+	}
+	return view;
+}
+
+//Seed a view and check that all seeded pixels hold the background of their position. Returns the fraction seeded
+static float checkSeed(BackgroundMosaic & mosaic, cv::Mat & view, const cv::Point & position, bool & passed, uint64_t & allocations)
+{
+	view.setTo(0xff);
+	uint64_t * previousCounter = AllocationCounter::countThread(&allocations);
+	const float fraction = mosaic.seed(view, position);
+	AllocationCounter::countThread(previousCounter);
+	int errors = 0;
+	int seeded = 0;
+	for (int y = 0; y < view.rows; ++y) {
+		const float * row = view.ptr<float>(y);
+		for (int x = 0; x < view.cols; ++x) {
+			//0xff bytes are a NaN, which compares unequal to everything
+			if (row[x] == row[x]) {
+				seeded++;
+				errors += row[x] != getBackground(position.x + x, position.y + y) ? 1 : 0;
+			}
+		}
+	}
+	if (errors > 0 || (float)seeded / view.total() != fraction) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Background mosaic at (" << position.x << ", " << position.y << "): " << errors << " pixels differ, " << seeded << " pixels seeded for fraction " << fraction << "!" << ConsoleStyle() << std::endl;
+		passed = false;
+	}
+	return fraction;
+}
+
+bool testBackgroundMosaic()
+{
+	BackgroundMosaic mosaic(TileSize, MaxTiles);
+	mosaic.setup(CV_32F, 1);
+	cv::Mat seedView(ViewSize, CV_32F);
+	bool passed = true;
+	uint64_t allocations = 0;
+	//pan randomly over an area many times larger than the mosaic, left of, above and right of the origin
+	cv::Point positions[KeptViews];
+	uint32_t random = 4711;
+	cv::Point position(0, 0);
+	for (int i = 0; i < 2000; ++i) {
+		random = random * 1103515245 + 12345;
+		position.x += (int)((random >> 16) % 41) - 20;
+		random = random * 1103515245 + 12345;
+		position.y += (int)((random >> 16) % 41) - 20;
+		position.x = std::max(-400, std::min(400, position.x));
+		position.y = std::max(-400, std::min(400, position.y));
+		//create the view before counting, so only the mosaic is counted
+		const cv::Mat view = makeView(position);
+		uint64_t * previousCounter = AllocationCounter::countThread(&allocations);
+		mosaic.store(view, position);
+		AllocationCounter::countThread(previousCounter);
+		positions[i % KeptViews] = position;
+		//views stored recently must be kept completely, older ones may be partly evicted
+		for (int k = 0; k < KeptViews && k <= i; ++k) {
+			if (checkSeed(mosaic, seedView, positions[k], passed, allocations) != 1.0f) {
+				std::cout << ConsoleStyle(ConsoleStyle::RED) << "Background mosaic evicted a recent view at (" << positions[k].x << ", " << positions[k].y << ")!" << ConsoleStyle() << std::endl;
+				passed = false;
+			}
+		}
+		random = random * 1103515245 + 12345;
+		const cv::Point oldPosition((int)((random >> 16) % 801) - 400, (int)((random >> 8) % 801) - 400);
+		checkSeed(mosaic, seedView, oldPosition, passed, allocations);
+		if (!passed) {
+			break;
+		}
+	}
+	if (mosaic.getTileCount() != MaxTiles) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Background mosaic holds " << mosaic.getTileCount() << " tiles instead of " << MaxTiles << "!" << ConsoleStyle() << std::endl;
+		passed = false;
+	}
+	//cleared tiles are not seeded
+	mosaic.clear();
+	if (checkSeed(mosaic, seedView, position, passed, allocations) != 0.0f || mosaic.getTileCount() != 0) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Background mosaic seeded after clear!" << ConsoleStyle() << std::endl;
+		passed = false;
+	}
+	if (allocations > 0) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Background mosaic allocated " << allocations << " times after setup!" << ConsoleStyle() << std::endl;
+		passed = false;
+	}
+	if (passed) {
+		std::cout << "Background mosaic keeps recent views and seeds only stored pixels." << std::endl;
+	}
+	return passed;
+}
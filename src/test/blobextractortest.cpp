@@ -0,0 +1,267 @@
+#include "tests.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "blobextractor.h"
+#include "consolestyle.h"
+
+
+//Maximum difference of centroids. BlobExtractor stores them as float
+static const double MaxCentroidError = 1e-3;
+
+//Blob statistics both labellings give
+struct Component
+{
+	cv::Rect box;
+	uint32_t area;
+	double cx;
+	double cy;
+
+	//order by position and size, so the components of both labellings can be compared one by one
+	bool operator<(const Component & other) const
+	{
+		if (box.y != other.box.y) {
+			return box.y < other.box.y;
+		}
+		if (box.x != other.box.x) {
+			return box.x < other.box.x;
+		}
+		if (box.width != other.box.width) {
+			return box.width < other.box.width;
+		}
+		if (box.height != other.box.height) {
+			return box.height < other.box.height;
+		}
+		return area < other.area;
+	}
+};
+
+//Create a random mask. Foreground pixels have random non-zero values, as all non-zero pixels are foreground
+static cv::Mat makeMask(const cv::Size & size, uint32_t percent, uint32_t seed)
+{
+	cv::Mat mask(size, CV_8U);
+	uint32_t random = seed;
+	for (int y = 0; y < size.height; ++y) {
+		uint8_t * row = mask.ptr<uint8_t>(y);
+		for (int x = 0; x < size.width; ++x) {
+			random = random * 1103515245 + 12345;
+			row[x] = (random >> 16) % 100 < percent ? 1 + (random >> 8) % 255 : 0;
+		}
+	}
+	return mask;
+}
+
+//Create a mask with diagonal structures only. Pixels of a blob only touch at their corners, so blobs are joined through
+//the upper left and the upper right neighbours only, and arms that are joined late need their labels united
+static cv::Mat makeDiagonalMask(const cv::Size & size, int pattern)
+{
+	cv::Mat mask(size, CV_8U);
+	mask = cv::Scalar(0);
+	for (int y = 0; y < size.height; ++y) {
+		uint8_t * row = mask.ptr<uint8_t>(y);
+		for (int x = 0; x < size.width; ++x) {
+			switch (pattern) {
+				case 0:
+					//checkerboard, a single blob
+					row[x] = (x + y) % 2 == 0 ? 255 : 0;
+					break;
+				case 1:
+					//lines falling to the right, one blob per line
+					row[x] = (x - y + 3 * size.height) % 3 == 0 ? 255 : 0;
+					break;
+				case 2:
+					//lines rising to the right, one blob per line
+					row[x] = (x + y) % 3 == 0 ? 255 : 0;
+					break;
+				default:
+					//V shapes whose arms only join at the bottom, every second one turned upside down
+					const int period = 10;
+					const int phase = x % period;
+					const int arm = phase < period / 2 ? phase : period - 1 - phase;
+					const int v = (x / period) % 2 == 0 ? y % (period / 2) : period / 2 - 1 - y % (period / 2);
+					row[x] = arm == v ? 255 : 0;
+					break;
+			}
+		}
+	}
+	return mask;
+}
+
+//Label a mask with OpenCV
+static std::vector<Component> getExpected(const cv::Mat & mask)
+{
+	cv::Mat labels;
+	cv::Mat stats;
+	cv::Mat centroids;
+	const int count = cv::connectedComponentsWithStats(mask, labels, stats, centroids, 8, CV_32S);
+	std::vector<Component> components;
+	//label 0 is the background
+	for (int i = 1; i < count; ++i) {
+		const int * stat = stats.ptr<int>(i);
+		const double * centroid = centroids.ptr<double>(i);
+		Component component = {cv::Rect(stat[cv::CC_STAT_LEFT], stat[cv::CC_STAT_TOP], stat[cv::CC_STAT_WIDTH], stat[cv::CC_STAT_HEIGHT]), (uint32_t)stat[cv::CC_STAT_AREA], centroid[0], centroid[1]};
+		components.push_back(component);
+	}
+	std::sort(components.begin(), components.end());
+	return components;
+}
+
+static std::vector<Component> getComponents(const std::vector<BlobExtractor::Blob> & blobs)
+{
+	std::vector<Component> components;
+	for (auto bIt = blobs.cbegin(); bIt != blobs.cend(); ++bIt) {
+		Component component = {bIt->boundingBox, bIt->area, bIt->cx, bIt->cy};
+		components.push_back(component);
+	}
+	std::sort(components.begin(), components.end());
+	return components;
+}
+
+//Compare the blobs found to the OpenCV components and report the first difference
+static bool compare(const std::vector<BlobExtractor::Blob> & blobs, const std::vector<Component> & expected, const std::string & description)
+{
+	const std::vector<Component> components = getComponents(blobs);
+	if (components.size() != expected.size()) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Blob extractor " << description << ": " << components.size() << " blobs instead of " << expected.size() << "!" << ConsoleStyle() << std::endl;
+		return false;
+	}
+	for (size_t i = 0; i < components.size(); ++i) {
+		const Component & c = components[i];
+		const Component & e = expected[i];
+		if (c.box.x != e.box.x || c.box.y != e.box.y || c.box.width != e.box.width || c.box.height != e.box.height || c.area != e.area || std::fabs(c.cx - e.cx) > MaxCentroidError || std::fabs(c.cy - e.cy) > MaxCentroidError) {
+			std::cout << ConsoleStyle(ConsoleStyle::RED) << "Blob extractor " << description << ": blob " << i << " at " << c.box.x << "," << c.box.y << " " << c.box.width << "x" << c.box.height << " area " << c.area << " centroid " << c.cx << "," << c.cy;
+			std::cout << " instead of " << e.box.x << "," << e.box.y << " " << e.box.width << "x" << e.box.height << " area " << e.area << " centroid " << e.cx << "," << e.cy << "!" << ConsoleStyle() << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool testBlobExtractor()
+{
+	//single rows and columns, sizes below and above the label reserve
+	const cv::Size sizes[5] = {cv::Size(97, 61), cv::Size(40, 30), cv::Size(7, 5), cv::Size(1, 17), cv::Size(23, 1)};
+	//sparse noise with small blobs up to dense masks where most pixels form one big blob
+	const uint32_t densities[4] = {5, 30, 50, 70};
+	bool passed = true;
+	//one extractor for all masks, so buffers left from bigger masks must not leak into the results
+	BlobExtractor extractor;
+	for (int s = 0; s < 5; ++s) {
+		for (int d = 0; d < 4; ++d) {
+			for (uint32_t seed = 0; seed < 4; ++seed) {
+				const cv::Mat mask = makeMask(sizes[s], densities[d], 4711 + 13 * seed + s);
+				std::stringstream description;
+				description << "on " << sizes[s].width << "x" << sizes[s].height << " mask with " << densities[d] << "% foreground, seed " << seed;
+				passed = compare(extractor.extract(mask), getExpected(mask), description.str()) && passed;
+			}
+		}
+		for (int pattern = 0; pattern < 4; ++pattern) {
+			const cv::Mat mask = makeDiagonalMask(sizes[s], pattern);
+			std::stringstream description;
+			description << "on " << sizes[s].width << "x" << sizes[s].height << " diagonal pattern " << pattern;
+			passed = compare(extractor.extract(mask), getExpected(mask), description.str()) && passed;
+		}
+	}
+	if (passed) {
+		std::cout << "Blob extractor matches cv::connectedComponentsWithStats." << std::endl;
+	}
+	return passed;
+}
+
+//Create a mask with blobs that span several band seams: a snake winding down the whole mask, vertical bars and lines
+//crossing seams diagonally only, over random noise
+static cv::Mat makeSeamMask(const cv::Size & size, uint32_t seed)
+{
+	cv::Mat mask = makeMask(size, 10, seed);
+	for (int y = 0; y < size.height; ++y) {
+		uint8_t * row = mask.ptr<uint8_t>(y);
+		//snake running left and right, joined at alternating ends every 4 rows
+		if (y % 4 == 0) {
+			for (int x = 0; x < size.width / 3; ++x) {
+				row[x] = 255;
+			}
+		}
+		else if (size.width / 3 > 0) {
+			row[(y / 4) % 2 == 0 ? size.width / 3 - 1 : 0] = 255;
+		}
+		//vertical bar and a diagonal line through all rows
+		row[size.width / 2] = 255;
+		row[std::min(size.width - 1, size.width * 2 / 3 + y % std::max(1, size.width / 3))] = 255;
+	}
+	return mask;
+}
+
+//Compare all statistics of the blobs of the bands to the blobs of the whole mask, in order
+static bool compareBlobs(const std::vector<BlobExtractor::Blob> & blobs, const std::vector<BlobExtractor::Blob> & expected, const std::string & description)
+{
+	if (blobs.size() != expected.size()) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Blob extractor " << description << ": " << blobs.size() << " blobs instead of " << expected.size() << "!" << ConsoleStyle() << std::endl;
+		return false;
+	}
+	for (size_t i = 0; i < blobs.size(); ++i) {
+		const BlobExtractor::Blob & b = blobs[i];
+		const BlobExtractor::Blob & e = expected[i];
+		//statistics are summed up as integers, so they are exactly the same
+		if (b.boundingBox.x != e.boundingBox.x || b.boundingBox.y != e.boundingBox.y || b.boundingBox.width != e.boundingBox.width || b.boundingBox.height != e.boundingBox.height || b.area != e.area || b.cx != e.cx || b.cy != e.cy || b.mu20 != e.mu20 || b.mu02 != e.mu02 || b.mu11 != e.mu11) {
+			std::cout << ConsoleStyle(ConsoleStyle::RED) << "Blob extractor " << description << ": blob " << i << " at " << b.boundingBox.x << "," << b.boundingBox.y << " " << b.boundingBox.width << "x" << b.boundingBox.height << " area " << b.area;
+			std::cout << " instead of " << e.boundingBox.x << "," << e.boundingBox.y << " " << e.boundingBox.width << "x" << e.boundingBox.height << " area " << e.area << "!" << ConsoleStyle() << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool testBlobExtractorBands()
+{
+	const cv::Size sizes[3] = {cv::Size(97, 61), cv::Size(40, 30), cv::Size(7, 16)};
+	//up to one band per row, so blobs span many seams
+	const int maxBandCount = 16;
+	bool passed = true;
+	for (int s = 0; s < 3; ++s) {
+		std::vector<cv::Mat> masks;
+		std::vector<std::string> maskNames;
+		for (uint32_t seed = 0; seed < 3; ++seed) {
+			const uint32_t densities[3] = {5, 40, 60};
+			masks.push_back(makeMask(sizes[s], densities[seed], 4711 + seed));
+			masks.push_back(makeSeamMask(sizes[s], 815 + seed));
+			std::stringstream randomName;
+			std::stringstream seamName;
+			randomName << densities[seed] << "% foreground";
+			seamName << "seam-crossing blobs, seed " << seed;
+			maskNames.push_back(randomName.str());
+			maskNames.push_back(seamName.str());
+		}
+		for (int pattern = 0; pattern < 4; ++pattern) {
+			std::stringstream patternName;
+			patternName << "diagonal pattern " << pattern;
+			masks.push_back(makeDiagonalMask(sizes[s], pattern));
+			maskNames.push_back(patternName.str());
+		}
+		for (size_t m = 0; m < masks.size(); ++m) {
+			BlobExtractor wholeExtractor;
+			const std::vector<BlobExtractor::Blob> expected = wholeExtractor.extract(masks[m]);
+			for (int bandCount = 2; bandCount <= std::min(maxBandCount, sizes[s].height); ++bandCount) {
+				//split rows like the detector does
+				std::vector<BlobExtractor> bandExtractors(bandCount);
+				std::vector<BlobExtractor *> bands;
+				for (int b = 0; b < bandCount; ++b) {
+					bandExtractors[b].extract(masks[m], cv::Range(sizes[s].height * b / bandCount, sizes[s].height * (b + 1) / bandCount));
+					bands.push_back(&bandExtractors[b]);
+				}
+				BlobExtractor mergedExtractor;
+				std::stringstream description;
+				description << "in " << bandCount << " bands on " << sizes[s].width << "x" << sizes[s].height << " mask with " << maskNames[m];
+				passed = compareBlobs(mergedExtractor.mergeBands(bands), expected, description.str()) && passed;
+			}
+		}
+	}
+	if (passed) {
+		std::cout << "Blob extractor bands merge to the blobs of the whole mask." << std::endl;
+	}
+	return passed;
+}
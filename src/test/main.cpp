@@ -0,0 +1,25 @@
+#include <iostream>
+
+#include "consolestyle.h"
+#include "tests.h"
+
+
+int main(int argc, char * argv[])
+{
+	bool passed = true;
+	passed = testRawFileSource() && passed;
+	passed = testMotionKernel() && passed;
+	passed = testMorphology() && passed;
+	passed = testBlobExtractor() && passed;
+	passed = testBlobExtractorBands() && passed;
+	passed = testTileGate() && passed;
+	passed = testTracker() && passed;
+	passed = testPhaseCorrelator() && passed;
+	passed = testBackgroundMosaic() && passed;
+	if (passed) {
+		std::cout << ConsoleStyle(ConsoleStyle::GREEN) << "All tests passed." << ConsoleStyle() << std::endl;
+		return 0;
+	}
+	std::cout << ConsoleStyle(ConsoleStyle::RED) << "Tests failed!" << ConsoleStyle() << std::endl;
+	return 1;
+}
@@ -0,0 +1,137 @@
+#include "tests.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "consolestyle.h"
+#include "morphology.h"
+
+
+//The detector dilates by 12 and erodes by 8 without morphology and closes by 8 with it
+static const uint32_t DilateRadius = 12;
+static const uint32_t ErodeRadius = 8;
+static const uint32_t CloseRadius = 8;
+
+//Create a test image. Binary images have sparse foreground and foreground in all corners, greyscale images random values
+static cv::Mat makeImage(const cv::Size & size, bool binary, uint32_t seed)
+{
+	cv::Mat image(size, CV_8U);
+	uint32_t random = seed;
+	for (int y = 0; y < size.height; ++y) {
+		uint8_t * row = image.ptr<uint8_t>(y);
+		for (int x = 0; x < size.width; ++x) {
+			random = random * 1103515245 + 12345;
+			row[x] = binary ? ((random >> 16) % 100 < 3 ? 255 : 0) : random >> 24;
+		}
+	}
+	if (binary) {
+		image.ptr<uint8_t>(0)[0] = 255;
+		image.ptr<uint8_t>(0)[size.width - 1] = 255;
+		image.ptr<uint8_t>(size.height - 1)[0] = 255;
+		image.ptr<uint8_t>(size.height - 1)[size.width - 1] = 255;
+	}
+	return image;
+}
+
+//Split rows into bands like the detector does
+static std::vector<cv::Range> getBands(int height, int count)
+{
+	std::vector<cv::Range> bands;
+	for (int b = 0; b < count; ++b) {
+		bands.push_back(cv::Range(height * b / count, height * (b + 1) / count));
+	}
+	return bands;
+}
+
+//Compare a result to the OpenCV result and report the pixels that differ
+static bool compare(const cv::Mat & result, const cv::Mat & expected, const std::string & description)
+{
+	const int errors = cv::countNonZero(result != expected);
+	if (errors > 0) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Morphology " << description << ": " << errors << " pixels differ!" << ConsoleStyle() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool testMorphology()
+{
+	//images larger and smaller than the kernels, so kernels reach over one or several borders
+	const cv::Size sizes[3] = {cv::Size(97, 61), cv::Size(40, 30), cv::Size(7, 5)};
+	//more bands than rows / radius, so bands read rows of several neighbours
+	const int bandCounts[4] = {2, 3, 7, 16};
+	bool passed = true;
+	for (int s = 0; s < 3; ++s) {
+		for (int binary = 0; binary < 2; ++binary) {
+			const cv::Mat image = makeImage(sizes[s], binary, 4711 + s);
+			std::stringstream imageName;
+			imageName << sizes[s].width << "x" << sizes[s].height << (binary ? " binary" : " greyscale") << " image";
+			cv::Mat expectedDilate;
+			cv::Mat expectedErode;
+			cv::Mat expectedClose;
+			cv::Mat expectedDilateErode;
+			cv::dilate(image, expectedDilate, cv::Mat(), cv::Point(-1, -1), DilateRadius);
+			cv::erode(image, expectedErode, cv::Mat(), cv::Point(-1, -1), ErodeRadius);
+			cv::morphologyEx(image, expectedClose, cv::MORPH_CLOSE, cv::Mat(), cv::Point(-1, -1), CloseRadius);
+			cv::erode(expectedDilate, expectedDilateErode, cv::Mat(), cv::Point(-1, -1), ErodeRadius);
+			//whole image
+			Morphology morphology;
+			cv::Mat result;
+			morphology.dilate(image, result, DilateRadius);
+			passed = compare(result, expectedDilate, "dilate on " + imageName.str()) && passed;
+			morphology.erode(image, result, ErodeRadius);
+			passed = compare(result, expectedErode, "erode on " + imageName.str()) && passed;
+			morphology.close(image, result, CloseRadius);
+			passed = compare(result, expectedClose, "close on " + imageName.str()) && passed;
+			image.copyTo(result);
+			morphology.dilate(result, result, DilateRadius);
+			passed = compare(result, expectedDilate, "in place dilate on " + imageName.str()) && passed;
+			//bands with their own buffers, like the detector runs them on several threads. bands are processed bottom
+			//up and the destination is filled with garbage first, so bands that depend on each other or leave rows out fail
+			for (int c = 0; c < 4; ++c) {
+				const std::vector<cv::Range> bands = getBands(sizes[s].height, std::min(bandCounts[c], sizes[s].height));
+				std::vector<Morphology> bandMorphologies(bands.size());
+				std::stringstream bandName;
+				bandName << " in " << bands.size() << " bands on " << imageName.str();
+				cv::Mat buffer(sizes[s], CV_8U);
+				result.create(sizes[s], CV_8U);
+				result = cv::Scalar(77);
+				for (int b = bands.size() - 1; b >= 0; --b) {
+					bandMorphologies[b].dilate(image, result, DilateRadius, bands[b]);
+				}
+				passed = compare(result, expectedDilate, "dilate" + bandName.str()) && passed;
+				result = cv::Scalar(77);
+				for (int b = bands.size() - 1; b >= 0; --b) {
+					bandMorphologies[b].erode(image, result, ErodeRadius, bands[b]);
+				}
+				passed = compare(result, expectedErode, "erode" + bandName.str()) && passed;
+				//close and dilate followed by erode, like the detector does with and without morphology
+				buffer = cv::Scalar(77);
+				result = cv::Scalar(77);
+				for (int b = bands.size() - 1; b >= 0; --b) {
+					bandMorphologies[b].dilate(image, buffer, CloseRadius, bands[b]);
+				}
+				for (int b = bands.size() - 1; b >= 0; --b) {
+					bandMorphologies[b].erode(buffer, result, CloseRadius, bands[b]);
+				}
+				passed = compare(result, expectedClose, "close" + bandName.str()) && passed;
+				buffer = cv::Scalar(77);
+				result = cv::Scalar(77);
+				for (int b = bands.size() - 1; b >= 0; --b) {
+					bandMorphologies[b].dilate(image, buffer, DilateRadius, bands[b]);
+				}
+				for (int b = bands.size() - 1; b >= 0; --b) {
+					bandMorphologies[b].erode(buffer, result, ErodeRadius, bands[b]);
+				}
+				passed = compare(result, expectedDilateErode, "dilate and erode" + bandName.str()) && passed;
+			}
+		}
+	}
+	if (passed) {
+		std::cout << "Morphology matches OpenCV for whole images and bands." << std::endl;
+	}
+	return passed;
+}
@@ -0,0 +1,211 @@
+#include "tests.h"
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "consolestyle.h"
+#include "framesource.h"
+#include "motionkernel.h"
+
+
+//The width is no multiple of the SIMD widths, so the scalar ends of the SIMD rows are tested too
+static const cv::Size FrameSize(78, 46);
+static const uint32_t FrameCount = 16;
+static const uint32_t AccumulateFrames = 3; //frames after the first that only update the background, like the warm-up of the detector
+static const double Alpha = 0.050;
+static const double Threshold = 20.0;
+static const int32_t AdaptiveOffset = 5;
+static const int BandSplit = 17; //detection is split into two bands at this row, like the detector does
+
+//Results of a frame sequence. Every frame gets its own images, so sequences can be compared frame by frame
+struct Sequence
+{
+	std::vector<cv::Mat> backgrounds;
+	std::vector<cv::Mat> masks;
+};
+
+static const char * getFormatName(FrameSource::PixelFormat format)
+{
+	switch (format) {
+		case FrameSource::FORMAT_BGR:
+			return "BGR";
+		case FrameSource::FORMAT_GREY:
+			return "GREY";
+		case FrameSource::FORMAT_YUYV:
+			return "YUYV";
+		case FrameSource::FORMAT_NV12:
+			return "NV12";
+		case FrameSource::FORMAT_I420:
+			return "I420";
+		default:
+			return "unknown";
+	}
+}
+
+//Create a synthetic frame. A fixed pattern with noise around the threshold is crossed by a bright block, so there is foreground
+static cv::Mat makeFrame(FrameSource::PixelFormat format, uint32_t index)
+{
+	cv::Mat frame;
+	switch (format) {
+		case FrameSource::FORMAT_BGR:
+			frame.create(FrameSize, CV_8UC3);
+			break;
+		case FrameSource::FORMAT_YUYV:
+			frame.create(FrameSize, CV_8UC2);
+			break;
+		case FrameSource::FORMAT_NV12:
+		case FrameSource::FORMAT_I420:
+			//the chroma planes follow the luma plane
+			frame.create(FrameSize.height * 3 / 2, FrameSize.width, CV_8U);
+			break;
+		default:
+			frame.create(FrameSize, CV_8U);
+			break;
+	}
+	const int channels = frame.channels();
+	const cv::Rect block(index * 5 % FrameSize.width, index * 3 % FrameSize.height, 12, 9);
+	uint32_t random = 12345 + index;
+	for (int y = 0; y < frame.rows; ++y) {
+		uint8_t * row = frame.ptr<uint8_t>(y);
+		for (int i = 0; i < frame.cols * channels; ++i) {
+			random = random * 1103515245 + 12345;
+			const int noise = (int)((random >> 16) % 49) - 24;
+			row[i] = block.contains(cv::Point(i / channels, y)) ? 230 - noise / 2 : (i * 7 + y * 13) % 180 + 40 + noise;
+		}
+	}
+	return frame;
+}
+
+//Run a kernel over a frame sequence like the detector does: initialize, accumulate during the warm-up, then detect in
+//two bands. Odd frames output the difference and threshold it adaptively
+static Sequence runKernel(MotionKernel & kernel, const std::vector<cv::Mat> & frames, FrameSource::PixelFormat format, int type, bool selectiveUpdate)
+{
+	Sequence sequence;
+	cv::Mat background;
+	cv::Mat difference;
+	cv::Mat mask;
+	kernel.initialize(frames[0], format, background, type);
+	for (uint32_t i = 1; i < frames.size(); ++i) {
+		if (i <= AccumulateFrames) {
+			kernel.accumulate(frames[i], format, background, Alpha);
+			mask = cv::Mat::zeros(FrameSize, CV_8U);
+		}
+		else {
+			const bool adaptive = i % 2 == 1;
+			difference.create(FrameSize, CV_8U);
+			kernel.detect(frames[i], format, background, Alpha, Threshold, difference, adaptive, selectiveUpdate, cv::Range(0, BandSplit));
+			kernel.detect(frames[i], format, background, Alpha, Threshold, difference, adaptive, selectiveUpdate, cv::Range(BandSplit, FrameSize.height));
+			if (adaptive) {
+				mask.create(FrameSize, CV_8U);
+				kernel.adaptiveThreshold(difference, mask, AdaptiveOffset, cv::Range(0, BandSplit));
+				kernel.adaptiveThreshold(difference, mask, AdaptiveOffset, cv::Range(BandSplit, FrameSize.height));
+			}
+			else {
+				difference.copyTo(mask);
+			}
+		}
+		sequence.backgrounds.push_back(background.clone());
+		sequence.masks.push_back(mask.clone());
+	}
+	return sequence;
+}
+
+//Run the OpenCV chain the kernel replaces over a frame sequence
+static Sequence runOpenCV(const std::vector<cv::Mat> & frames, FrameSource::PixelFormat format)
+{
+	Sequence sequence;
+	cv::Mat lumaBuffer;
+	cv::Mat background;
+	cv::Mat grey;
+	cv::Mat difference;
+	cv::Mat mask;
+	FrameSource::getLuma(frames[0], format, lumaBuffer).convertTo(background, CV_32F);
+	for (uint32_t i = 1; i < frames.size(); ++i) {
+		const cv::Mat luma = FrameSource::getLuma(frames[i], format, lumaBuffer);
+		cv::accumulateWeighted(luma, background, Alpha);
+		if (i <= AccumulateFrames) {
+			mask = cv::Mat::zeros(FrameSize, CV_8U);
+		}
+		else {
+			background.convertTo(grey, CV_8U);
+			cv::absdiff(grey, luma, difference);
+			if (i % 2 == 1) {
+				cv::adaptiveThreshold(difference, mask, 255.0, cv::ADAPTIVE_THRESH_MEAN_C, CV_THRESH_BINARY, 3, -AdaptiveOffset);
+			}
+			else {
+				cv::threshold(difference, mask, Threshold, 255.0, CV_THRESH_BINARY);
+			}
+		}
+		sequence.backgrounds.push_back(background.clone());
+		sequence.masks.push_back(mask.clone());
+	}
+	return sequence;
+}
+
+//Compare the results of two sequences and report the pixels that differ
+static bool compare(const Sequence & result, const Sequence & expected, const std::string & description)
+{
+	int backgroundErrors = 0;
+	int maskErrors = 0;
+	for (uint32_t i = 0; i < expected.masks.size(); ++i) {
+		backgroundErrors += cv::countNonZero(result.backgrounds[i] != expected.backgrounds[i]);
+		maskErrors += cv::countNonZero(result.masks[i] != expected.masks[i]);
+	}
+	if (backgroundErrors > 0 || maskErrors > 0) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Motion kernel " << description << ": " << backgroundErrors << " background and " << maskErrors << " mask pixels differ!" << ConsoleStyle() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool testMotionKernel()
+{
+	const FrameSource::PixelFormat formats[5] = {FrameSource::FORMAT_BGR, FrameSource::FORMAT_GREY, FrameSource::FORMAT_YUYV, FrameSource::FORMAT_NV12, FrameSource::FORMAT_I420};
+	const MotionKernel::InstructionSet sets[4] = {MotionKernel::SCALAR, MotionKernel::SSE2, MotionKernel::AVX2, MotionKernel::NEON};
+	const MotionKernel::UpdateVariant variants[3] = {MotionKernel::UPDATE_WEIGHTED_SUM, MotionKernel::UPDATE_DIFFERENCE, MotionKernel::UPDATE_FUSED_DIFFERENCE};
+	bool passed = true;
+	for (int f = 0; f < 5; ++f) {
+		std::vector<cv::Mat> frames;
+		for (uint32_t i = 0; i < FrameCount; ++i) {
+			frames.push_back(makeFrame(formats[f], i));
+		}
+		const Sequence expected = runOpenCV(frames, formats[f]);
+		for (int s = 0; s < 4; ++s) {
+			if (!MotionKernel::isSupported(sets[s])) {
+				continue;
+			}
+			//with the greyscale coefficients and update formula detected on construction results match OpenCV bit for bit
+			MotionKernel kernel;
+			kernel.setInstructionSet(sets[s]);
+			std::stringstream name;
+			name << MotionKernel::getInstructionSetName(sets[s]) << " on " << getFormatName(formats[f]);
+			passed = compare(runKernel(kernel, frames, formats[f], CV_32F, false), expected, name.str()) && passed;
+			if (sets[s] == MotionKernel::SCALAR) {
+				continue;
+			}
+			//the other update formulas, selective updates and fixed point don't match OpenCV, but the scalar code path
+			MotionKernel reference;
+			reference.setInstructionSet(MotionKernel::SCALAR);
+			for (int v = 0; v < 3; ++v) {
+				kernel.setUpdateVariant(variants[v]);
+				reference.setUpdateVariant(variants[v]);
+				for (int selective = 0; selective < 2; ++selective) {
+					std::stringstream variantName;
+					variantName << name.str() << " with update variant " << variants[v] << (selective ? " and selective update" : "");
+					passed = compare(runKernel(kernel, frames, formats[f], CV_32F, selective), runKernel(reference, frames, formats[f], CV_32F, selective), variantName.str()) && passed;
+				}
+			}
+			for (int selective = 0; selective < 2; ++selective) {
+				std::stringstream fixedName;
+				fixedName << name.str() << " with fixed point background" << (selective ? " and selective update" : "");
+				passed = compare(runKernel(kernel, frames, formats[f], CV_16U, selective), runKernel(reference, frames, formats[f], CV_16U, selective), fixedName.str()) && passed;
+			}
+		}
+	}
+	if (passed) {
+		std::cout << "Motion kernel matches the OpenCV chain and the scalar code path in all pixel formats." << std::endl;
+	}
+	return passed;
+}
@@ -0,0 +1,101 @@
+#include "tests.h"
+
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+#include "allocationcounter.h"
+#include "consolestyle.h"
+#include "phasecorrelator.h"
+
+
+//Maximum error of a found shift per axis in pixels. The centroid of the correlation peak, like in cv::phaseCorrelate,
+//pulls fractional shifts towards the nearest pixel
+static const float MaxIntegerShiftError = 0.1f;
+static const float MaxFractionalShiftError = 0.4f;
+
+//Random value of a texture grid point
+static float getNoise(int x, int y)
+{
+	uint32_t hash = (uint32_t)x * 73856093U ^ (uint32_t)y * 19349663U;
+	hash = (hash ^ (hash >> 13)) * 1274126177U;
+	return (float)((hash >> 16) & 0xff);
+}
+
+//Random texture interpolated bilinearly between grid points, so it can be sampled at fractional positions
+static float getTexture(float x, float y)
+{
+	const float gridX = (x + 1000.0f) / 2.0f;
+	const float gridY = (y + 1000.0f) / 2.0f;
+	const int x0 = (int)std::floor(gridX);
+	const int y0 = (int)std::floor(gridY);
+	const float fx = gridX - x0;
+	const float fy = gridY - y0;
+	const float top = getNoise(x0, y0) * (1.0f - fx) + getNoise(x0 + 1, y0) * fx;
+	const float bottom = getNoise(x0, y0 + 1) * (1.0f - fx) + getNoise(x0 + 1, y0 + 1) * fx;
+	return top * (1.0f - fy) + bottom * fy;
+}
+
+//Create a frame showing the texture moved by offset
+static cv::Mat makeFrame(const cv::Size & size, const cv::Point2f & offset)
+{
+	cv::Mat frame(size, CV_8U);
+	for (int y = 0; y < size.height; ++y) {
+		uint8_t * row = frame.ptr<uint8_t>(y);
+		for (int x = 0; x < size.width; ++x) {
+			row[x] = (uint8_t)std::floor(getTexture(x - offset.x, y - offset.y) + 0.5f);
+		}
+	}
+	return frame;
+}
+
+bool testPhaseCorrelator()
+{
+	//frame sizes of power of two and padded transforms
+	const cv::Size sizes[2] = {cv::Size(160, 120), cv::Size(64, 64)};
+	//integer and fractional shifts in all directions
+	const cv::Point2f shifts[6] = {cv::Point2f(0.0f, 0.0f), cv::Point2f(3.0f, 2.0f), cv::Point2f(-5.0f, 4.0f), cv::Point2f(2.0f, -7.0f), cv::Point2f(1.5f, -0.5f), cv::Point2f(-2.25f, 3.75f)};
+	bool passed = true;
+	for (int s = 0; s < 2; ++s) {
+		PhaseCorrelator correlator;
+		cv::Point2f shift;
+		//the first frame has no previous frame to correlate with
+		if (correlator.correlate(makeFrame(sizes[s], cv::Point2f(0.0f, 0.0f)), shift)) {
+			std::cout << ConsoleStyle(ConsoleStyle::RED) << "Phase correlator correlated the first frame!" << ConsoleStyle() << std::endl;
+			passed = false;
+		}
+		cv::Point2f position(0.0f, 0.0f);
+		for (int i = 0; i < 6; ++i) {
+			//create the frame before counting, so only the correlation is counted
+			position += shifts[i];
+			const cv::Mat frame = makeFrame(sizes[s], position);
+			uint64_t allocations = 0;
+			uint64_t * previousCounter = AllocationCounter::countThread(&allocations);
+			const bool correlated = correlator.correlate(frame, shift);
+			AllocationCounter::countThread(previousCounter);
+			std::stringstream description;
+			description << "Phase correlator " << sizes[s].width << "x" << sizes[s].height << " shift (" << shifts[i].x << ", " << shifts[i].y << ")";
+			if (!correlated) {
+				std::cout << ConsoleStyle(ConsoleStyle::RED) << description.str() << ": not correlated!" << ConsoleStyle() << std::endl;
+				passed = false;
+				continue;
+			}
+			const float maxError = shifts[i].x == std::floor(shifts[i].x) && shifts[i].y == std::floor(shifts[i].y) ? MaxIntegerShiftError : MaxFractionalShiftError;
+			if (std::fabs(shift.x - shifts[i].x) > maxError || std::fabs(shift.y - shifts[i].y) > maxError) {
+				std::cout << ConsoleStyle(ConsoleStyle::RED) << description.str() << ": found (" << shift.x << ", " << shift.y << ")!" << ConsoleStyle() << std::endl;
+				passed = false;
+			}
+			if (allocations > 0) {
+				std::cout << ConsoleStyle(ConsoleStyle::RED) << description.str() << ": " << allocations << " allocations!" << ConsoleStyle() << std::endl;
+				passed = false;
+			}
+		}
+	}
+	if (!AllocationCounter::isAvailable()) {
+		std::cout << ConsoleStyle(ConsoleStyle::YELLOW) << "Phase correlator allocations not checked. Build with COUNT_ALLOCATIONS to check them." << ConsoleStyle() << std::endl;
+	}
+	if (passed) {
+		std::cout << "Phase correlator finds integer and fractional shifts." << std::endl;
+	}
+	return passed;
+}
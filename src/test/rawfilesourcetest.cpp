@@ -0,0 +1,154 @@
+#include "tests.h"
+
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "consolestyle.h"
+#include "rawfilesource.h"
+
+
+//Frame size with even width and height, as chroma is subsampled by 2 in both directions in 4:2:0 formats
+static const uint32_t FrameWidth = 22;
+static const uint32_t FrameHeight = 14;
+static const uint32_t FrameCount = 3;
+
+//Compare two images of any type and report the number of pixel values that differ
+static bool compare(const cv::Mat & result, const cv::Mat & expected, const std::string & description)
+{
+	if (result.size() != expected.size() || result.type() != expected.type()) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Raw file source " << description << ": " << result.cols << "x" << result.rows << " image of type " << result.type() << " instead of " << expected.cols << "x" << expected.rows << " of type " << expected.type() << "!" << ConsoleStyle() << std::endl;
+		return false;
+	}
+	//compare all channels as one, countNonZero only takes single channel images
+	const int errors = cv::countNonZero(result.reshape(1) != expected.reshape(1));
+	if (errors > 0) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Raw file source " << description << ": " << errors << " values differ!" << ConsoleStyle() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//Create a frame in a raw pixel format. Luma and chroma have different gradients and noise, so mixed up planes, samples
+//or frames are noticed
+static cv::Mat makeFrame(FrameSource::PixelFormat format, uint32_t index)
+{
+	const bool planar = format == FrameSource::FORMAT_NV12 || format == FrameSource::FORMAT_I420;
+	cv::Mat frame(planar ? FrameHeight * 3 / 2 : FrameHeight, FrameWidth, format == FrameSource::FORMAT_YUYV ? CV_8UC2 : CV_8UC1);
+	uint32_t random = 4711 + index;
+	for (int y = 0; y < frame.rows; ++y) {
+		uint8_t * row = frame.ptr<uint8_t>(y);
+		for (int x = 0; x < frame.cols * frame.channels(); ++x) {
+			random = random * 1103515245 + 12345;
+			row[x] = (uint8_t)(16 + 7 * x + 11 * y + 29 * index + (random >> 16) % 32);
+		}
+	}
+	return frame;
+}
+
+//Get the luma plane of a frame without FrameSource, as reference
+static cv::Mat getExpectedLuma(const cv::Mat & frame, FrameSource::PixelFormat format)
+{
+	cv::Mat luma(FrameHeight, FrameWidth, CV_8U);
+	for (uint32_t y = 0; y < FrameHeight; ++y) {
+		const uint8_t * row = frame.ptr<uint8_t>(y);
+		for (uint32_t x = 0; x < FrameWidth; ++x) {
+			//YUYV stores Y0 U Y1 V, so luma is every second byte
+			luma.ptr<uint8_t>(y)[x] = format == FrameSource::FORMAT_YUYV ? row[2 * x] : row[x];
+		}
+	}
+	return luma;
+}
+
+static int getConversionCode(FrameSource::PixelFormat format)
+{
+	switch (format) {
+		case FrameSource::FORMAT_YUYV:
+			return CV_YUV2BGR_YUY2;
+		case FrameSource::FORMAT_NV12:
+			return CV_YUV2BGR_NV12;
+		case FrameSource::FORMAT_I420:
+			return CV_YUV2BGR_I420;
+		default:
+			return CV_GRAY2BGR;
+	}
+}
+
+bool testRawFileSource()
+{
+	const FrameSource::PixelFormat formats[4] = {FrameSource::FORMAT_YUYV, FrameSource::FORMAT_NV12, FrameSource::FORMAT_I420, FrameSource::FORMAT_GREY};
+	const char * fileNames[4] = {"meezee_test_frames.yuyv", "meezee_test_frames.nv12", "meezee_test_frames.i420", "meezee_test_frames.grey"};
+	bool passed = true;
+	for (int f = 0; f < 4; ++f) {
+		const std::string fileName = fileNames[f];
+		//dump frames like "v4l2-ctl --stream-to" does, without any header
+		std::vector<cv::Mat> frames;
+		FILE * file = fopen(fileName.c_str(), "wb");
+		if (file == nullptr) {
+			std::cout << ConsoleStyle(ConsoleStyle::RED) << "Raw file source: failed to create \"" << fileName << "\"!" << ConsoleStyle() << std::endl;
+			passed = false;
+			continue;
+		}
+		for (uint32_t i = 0; i < FrameCount; ++i) {
+			frames.push_back(makeFrame(formats[f], i));
+			fwrite(frames.back().data, 1, frames.back().total() * frames.back().elemSize(), file);
+		}
+		fclose(file);
+		RawFileSource source;
+		if (!RawFileSource::isRawFile(fileName) || !source.open(fileName, FrameWidth, FrameHeight, 25.0) || source.getFormat() != formats[f]) {
+			std::cout << ConsoleStyle(ConsoleStyle::RED) << "Raw file source: failed to open \"" << fileName << "\" in its pixel format!" << ConsoleStyle() << std::endl;
+			passed = false;
+			remove(fileName.c_str());
+			continue;
+		}
+		cv::Mat image;
+		const uint8_t * imageData = nullptr;
+		for (uint32_t i = 0; i < FrameCount; ++i) {
+			std::stringstream description;
+			description << "frame " << i << " of \"" << fileName << "\"";
+			int32_t bufferIndex = 0;
+			uint64_t timestamp = 0;
+			if (!source.read(image, bufferIndex, timestamp) || bufferIndex != -1) {
+				std::cout << ConsoleStyle(ConsoleStyle::RED) << "Raw file source: failed to read " << description.str() << "!" << ConsoleStyle() << std::endl;
+				passed = false;
+				break;
+			}
+			//the image passed in is reused, so reading does not allocate
+			if (i > 0 && image.data != imageData) {
+				std::cout << ConsoleStyle(ConsoleStyle::RED) << "Raw file source reallocated the image for " << description.str() << "!" << ConsoleStyle() << std::endl;
+				passed = false;
+			}
+			imageData = image.data;
+			passed = compare(image, frames[i], "read " + description.str()) && passed;
+			//planar formats and greyscale have a luma plane that detection reads in place
+			cv::Mat lumaBuffer;
+			const cv::Mat luma = FrameSource::getLuma(image, formats[f], lumaBuffer);
+			if (formats[f] != FrameSource::FORMAT_YUYV && (luma.data != image.data || !lumaBuffer.empty())) {
+				std::cout << ConsoleStyle(ConsoleStyle::RED) << "Raw file source luma of " << description.str() << " was copied instead of read in place!" << ConsoleStyle() << std::endl;
+				passed = false;
+			}
+			passed = compare(luma, getExpectedLuma(frames[i], formats[f]), "luma of " + description.str()) && passed;
+			//color conversion for display
+			cv::Mat bgr;
+			cv::Mat expectedBgr;
+			FrameSource::convertToBGR(bgr, image, formats[f]);
+			cv::cvtColor(frames[i], expectedBgr, getConversionCode(formats[f]));
+			passed = compare(bgr, expectedBgr, "BGR conversion of " + description.str()) && passed;
+		}
+		//the file holds whole frames only
+		int32_t bufferIndex = 0;
+		uint64_t timestamp = 0;
+		if (source.read(image, bufferIndex, timestamp)) {
+			std::cout << ConsoleStyle(ConsoleStyle::RED) << "Raw file source read a frame past the end of \"" << fileName << "\"!" << ConsoleStyle() << std::endl;
+			passed = false;
+		}
+		source.close();
+		remove(fileName.c_str());
+	}
+	if (passed) {
+		std::cout << "Raw file source reads YUYV, NV12, I420 and greyscale dumps." << std::endl;
+	}
+	return passed;
+}
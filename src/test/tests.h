@@ -0,0 +1,69 @@
+#pragma once
+
+
+/*!
+Write small raw YUYV, NV12, I420 and greyscale frame dumps and read them back with RawFileSource. Checks that frames
+are read unchanged into the same image, that the luma plane of planar formats is used in place and that
+FrameSource::convertToBGR matches cv::cvtColor.
+\return Returns true if all frames match.
+*/
+bool testRawFileSource();
+
+/*!
+Run the motion kernel on synthetic frames in all pixel formats with all code paths the CPU supports and compare the
+results to the OpenCV chain it replaces and to the scalar code path.
+\return Returns true if all results match.
+*/
+bool testMotionKernel();
+
+/*!
+Compare dilation, erosion and close of whole images and of bands to cv::dilate, cv::erode and cv::morphologyEx with the
+radii the detector uses, on images smaller and larger than the kernels.
+\return Returns true if all results match.
+*/
+bool testMorphology();
+
+/*!
+Compare the blobs extracted from random masks and from masks connected only diagonally to the boxes, areas and
+centroids of cv::connectedComponentsWithStats with 8-connectivity.
+\return Returns true if all blobs match.
+*/
+bool testBlobExtractor();
+
+/*!
+Extract the blobs of masks in 2 to 16 bands, merge them and compare them to the blobs of the whole mask, in the same
+order. Masks have blobs spanning many seams and blobs joined across seams through diagonal neighbours only.
+\return Returns true if all blobs match.
+*/
+bool testBlobExtractorBands();
+
+/*!
+Run morphology and blob extraction on the tile gate regions of masks only, like the detector does in tiled mode, and
+compare the mask and the blobs to running them on the whole mask. Blobs sit on tile and image borders and are joined
+across tiles by dilation. Also checks that joining the blobs of regions split between extractors keeps their order.
+\return Returns true if all masks and blobs match.
+*/
+bool testTileGate();
+
+/*!
+Track two targets moving with constant velocity that cross each other closer than the gate radius. Checks that both keep
+their IDs and that the filtered velocities converge. Also checks that a confirmed track coasts along its velocity while its
+target is not seen, is dropped after the maximum number of misses, and that an unconfirmed track is dropped on its first miss.
+\return Returns true if all checks pass.
+*/
+bool testTracker();
+
+/*!
+Correlate frames of a synthetic texture moved by integer and fractional shifts and compare the shifts found to the
+shifts applied. Also checks that correlating does not allocate when allocations are counted.
+\return Returns true if all shifts are found.
+*/
+bool testPhaseCorrelator();
+
+/*!
+Pan a background mosaic with few tiles over a large area, so tiles are evicted all the time. Checks that the views stored
+last are kept completely, that seeded pixels always come from their own position and that the mosaic does not allocate
+after setup when allocations are counted.
+\return Returns true if all checks pass.
+*/
+bool testBackgroundMosaic();
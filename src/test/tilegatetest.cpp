@@ -0,0 +1,156 @@
+#include "tests.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "blobextractor.h"
+#include "consolestyle.h"
+#include "morphology.h"
+#include "tilegate.h"
+
+
+//Dilation and erosion radii of the detector without and with morphology, at full resolution and downscaled by 2
+static const uint32_t DilateRadii[3] = {12, 8, 6};
+static const uint32_t ErodeRadii[3] = {8, 8, 4};
+//Number of parts the regions are split into, like the detector splits them between bands
+static const int PartCount = 3;
+
+//Create a mask with a few small blobs. Blobs sit on tile corners and borders, next to the image borders, and in pairs
+//just far enough apart to be in different tiles but close enough to be joined by dilation, so results differ if
+//regions miss the halo or cut blobs off
+static cv::Mat makeMask(const cv::Size & size, uint32_t tileSize, uint32_t blobCount, uint32_t seed)
+{
+	cv::Mat mask(size, CV_8U);
+	mask = cv::Scalar(0);
+	uint32_t random = seed;
+	for (uint32_t i = 0; i < blobCount; ++i) {
+		random = random * 1103515245 + 12345;
+		int x = (random >> 16) % size.width;
+		random = random * 1103515245 + 12345;
+		int y = (random >> 16) % size.height;
+		random = random * 1103515245 + 12345;
+		switch ((random >> 16) % 4) {
+			case 0:
+				//on a tile corner
+				x = std::min<int>(size.width - 1, x / tileSize * tileSize);
+				y = std::min<int>(size.height - 1, y / tileSize * tileSize);
+				break;
+			case 1:
+				//on the image border
+				x = (random >> 20) % 2 == 0 ? 0 : size.width - 1;
+				break;
+			default:
+				break;
+		}
+		const int width = 1 + (random >> 8) % 4;
+		const int height = 1 + (random >> 12) % 4;
+		mask(cv::Rect(x, y, width, height) & cv::Rect(0, 0, size.width, size.height)) = cv::Scalar(255);
+		//a partner one tile to the right, joined by dilation
+		const int partnerX = x + (int)tileSize + 4;
+		if (partnerX < size.width) {
+			mask(cv::Rect(partnerX, y, 1, 1) & cv::Rect(0, 0, size.width, size.height)) = cv::Scalar(255);
+		}
+	}
+	return mask;
+}
+
+//Order blobs by position. Tiled extraction finds blobs region by region, whole frame extraction in raster order
+static bool isBefore(const BlobExtractor::Blob & a, const BlobExtractor::Blob & b)
+{
+	if (a.boundingBox.y != b.boundingBox.y) {
+		return a.boundingBox.y < b.boundingBox.y;
+	}
+	if (a.boundingBox.x != b.boundingBox.x) {
+		return a.boundingBox.x < b.boundingBox.x;
+	}
+	return a.area < b.area;
+}
+
+static bool isSame(const BlobExtractor::Blob & a, const BlobExtractor::Blob & b)
+{
+	return a.boundingBox.x == b.boundingBox.x && a.boundingBox.y == b.boundingBox.y && a.boundingBox.width == b.boundingBox.width && a.boundingBox.height == b.boundingBox.height && a.area == b.area && a.cx == b.cx && a.cy == b.cy && a.mu20 == b.mu20 && a.mu02 == b.mu02 && a.mu11 == b.mu11;
+}
+
+//Compare blob lists. Lists are sorted first if the order may differ
+static bool compare(std::vector<BlobExtractor::Blob> blobs, std::vector<BlobExtractor::Blob> expected, bool sort, const std::string & description)
+{
+	if (sort) {
+		std::sort(blobs.begin(), blobs.end(), isBefore);
+		std::sort(expected.begin(), expected.end(), isBefore);
+	}
+	if (blobs.size() != expected.size()) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Tile gate " << description << ": " << blobs.size() << " blobs instead of " << expected.size() << "!" << ConsoleStyle() << std::endl;
+		return false;
+	}
+	for (size_t i = 0; i < blobs.size(); ++i) {
+		if (!isSame(blobs[i], expected[i])) {
+			std::cout << ConsoleStyle(ConsoleStyle::RED) << "Tile gate " << description << ": blob " << i << " at " << blobs[i].boundingBox.x << "," << blobs[i].boundingBox.y << " area " << blobs[i].area << " instead of " << expected[i].boundingBox.x << "," << expected[i].boundingBox.y << " area " << expected[i].area << "!" << ConsoleStyle() << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool testTileGate()
+{
+	//image sizes that are and are not multiples of the tile size
+	const cv::Size sizes[3] = {cv::Size(160, 128), cv::Size(97, 61), cv::Size(40, 30)};
+	//an empty mask, a few blobs with regions apart and many blobs with regions merged into few big ones
+	const uint32_t blobCounts[4] = {0, 3, 8, 40};
+	bool passed = true;
+	TileGate tileGate;
+	for (int s = 0; s < 3; ++s) {
+		for (int c = 0; c < 4; ++c) {
+			for (int r = 0; r < 3; ++r) {
+				const cv::Mat mask = makeMask(sizes[s], tileGate.getTileSize(), blobCounts[c], 4711 + 17 * c + s);
+				std::stringstream description;
+				description << "on " << sizes[s].width << "x" << sizes[s].height << " mask with " << blobCounts[c] << " blobs, dilate " << DilateRadii[r] << ", erode " << ErodeRadii[r];
+				//whole frame path
+				cv::Mat expected;
+				cv::dilate(mask, expected, cv::Mat(), cv::Point(-1, -1), DilateRadii[r]);
+				cv::erode(expected, expected, cv::Mat(), cv::Point(-1, -1), ErodeRadii[r]);
+				BlobExtractor wholeExtractor;
+				const std::vector<BlobExtractor::Blob> expectedBlobs = wholeExtractor.extract(expected);
+				//tiled path. regions are processed in place like the detector does
+				cv::Mat result = mask.clone();
+				const std::vector<cv::Rect> & regions = tileGate.update(result, DilateRadii[r] + ErodeRadii[r]);
+				if (blobCounts[c] == 0 && !regions.empty()) {
+					std::cout << ConsoleStyle(ConsoleStyle::RED) << "Tile gate " << description.str() << ": " << regions.size() << " regions in an empty mask!" << ConsoleStyle() << std::endl;
+					passed = false;
+				}
+				Morphology morphology;
+				for (auto rIt = regions.cbegin(); rIt != regions.cend(); ++rIt) {
+					cv::Mat region = result(*rIt);
+					morphology.dilate(region, region, DilateRadii[r]);
+					morphology.erode(region, region, ErodeRadii[r]);
+				}
+				const int errors = cv::countNonZero(result != expected);
+				if (errors > 0) {
+					std::cout << ConsoleStyle(ConsoleStyle::RED) << "Tile gate " << description.str() << ": " << errors << " pixels differ!" << ConsoleStyle() << std::endl;
+					passed = false;
+				}
+				BlobExtractor tiledExtractor;
+				const std::vector<BlobExtractor::Blob> & tiledBlobs = tiledExtractor.extract(result, regions);
+				passed = compare(tiledBlobs, expectedBlobs, true, description.str()) && passed;
+				//split the regions between extractors like the detector splits them between bands. joined in order, the
+				//blobs are the same as from extracting all regions at once
+				std::vector<BlobExtractor> partExtractors(PartCount);
+				std::vector<BlobExtractor *> parts;
+				for (int p = 0; p < PartCount; ++p) {
+					const std::vector<cv::Rect> partRegions(regions.begin() + regions.size() * p / PartCount, regions.begin() + regions.size() * (p + 1) / PartCount);
+					partExtractors[p].extract(result, partRegions);
+					parts.push_back(&partExtractors[p]);
+				}
+				BlobExtractor joinedExtractor;
+				passed = compare(joinedExtractor.joinRegions(parts), tiledBlobs, false, "joined " + description.str()) && passed;
+			}
+		}
+	}
+	if (passed) {
+		std::cout << "Tile gate regions give the same mask and blobs as the whole frame." << std::endl;
+	}
+	return passed;
+}
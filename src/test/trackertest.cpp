@@ -0,0 +1,166 @@
+#include "tests.h"
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "consolestyle.h"
+#include "tracker.h"
+
+
+static const cv::Size ImageSize(320, 240);
+static const uint64_t FrameIntervalUs = 33333;
+//Tracker defaults
+static const uint32_t ConfirmHits = 3;
+static const uint32_t MaxMisses = 10;
+//Maximum error of the filtered velocities in pixels/s once they converged
+static const float MaxVelocityError = 10.0f;
+
+//Target moving with constant velocity
+struct Target
+{
+	float x; //!<Position at time 0.
+	float y;
+	float vx; //!<Velocity in pixels/s.
+	float vy;
+};
+
+//Create the blob of a target in a frame. Centroids jitter by up to a pixel, like those of real blobs
+static Tracker::Measurement makeMeasurement(const Target & target, uint32_t frame, uint32_t & random)
+{
+	random = random * 1103515245 + 12345;
+	const float jitterX = ((random >> 16) % 201) / 100.0f - 1.0f;
+	random = random * 1103515245 + 12345;
+	const float jitterY = ((random >> 16) % 201) / 100.0f - 1.0f;
+	const float t = frame * FrameIntervalUs / 1000000.0f;
+	const float cx = target.x + target.vx * t + jitterX;
+	const float cy = target.y + target.vy * t + jitterY;
+	Tracker::Measurement measurement = {cx, cy, cv::Rect((int)cx - 4, (int)cy - 4, 9, 9), 81};
+	return measurement;
+}
+
+//Find the track closest to a position
+static const Tracker::Track * findTrack(const Tracker & tracker, float x, float y)
+{
+	const Tracker::Track * closest = nullptr;
+	float closestDistance = 0.0f;
+	const std::vector<Tracker::Track> & tracks = tracker.getTracks();
+	for (auto tIt = tracks.cbegin(); tIt != tracks.cend(); ++tIt) {
+		const float distance = (tIt->x - x) * (tIt->x - x) + (tIt->y - y) * (tIt->y - y);
+		if (closest == nullptr || distance < closestDistance) {
+			closest = &(*tIt);
+			closestDistance = distance;
+		}
+	}
+	return closest;
+}
+
+//Two targets crossing each other must keep their IDs and their velocities must converge
+static bool testCrossingTargets()
+{
+	//the targets pass each other 4 pixels apart after 1 s, well inside the gate radius
+	const Target targets[2] = {{20.0f, 100.0f, 150.0f, 20.0f}, {320.0f, 124.0f, -150.0f, 0.0f}};
+	const uint32_t frameCount = 60;
+	Tracker tracker;
+	tracker.setup(ImageSize);
+	uint32_t random = 4711;
+	uint32_t ids[2] = {0, 0};
+	std::vector<Tracker::Measurement> measurements;
+	bool passed = true;
+	for (uint32_t frame = 0; frame < frameCount; ++frame) {
+		measurements.clear();
+		for (int i = 0; i < 2; ++i) {
+			measurements.push_back(makeMeasurement(targets[i], frame, random));
+		}
+		tracker.update(measurements, frame * FrameIntervalUs);
+		for (int i = 0; i < 2; ++i) {
+			const Tracker::Track * track = tracker.getMeasurementTrack(i);
+			if (track == nullptr) {
+				std::cout << ConsoleStyle(ConsoleStyle::RED) << "Tracker lost target " << i << " in frame " << frame << "!" << ConsoleStyle() << std::endl;
+				return false;
+			}
+			if (frame == 0) {
+				ids[i] = track->id;
+			}
+			else if (track->id != ids[i]) {
+				std::cout << ConsoleStyle(ConsoleStyle::RED) << "Tracker gave target " << i << " ID " << track->id << " instead of " << ids[i] << " in frame " << frame << "!" << ConsoleStyle() << std::endl;
+				passed = false;
+			}
+			//velocities converge within the first half second, before the targets meet
+			if (frame >= 15 && (std::fabs(track->vx - targets[i].vx) > MaxVelocityError || std::fabs(track->vy - targets[i].vy) > MaxVelocityError)) {
+				std::cout << ConsoleStyle(ConsoleStyle::RED) << "Tracker velocity of target " << i << " in frame " << frame << " is " << track->vx << ", " << track->vy << " instead of " << targets[i].vx << ", " << targets[i].vy << "!" << ConsoleStyle() << std::endl;
+				passed = false;
+			}
+			if (frame >= ConfirmHits - 1 && !track->confirmed) {
+				std::cout << ConsoleStyle(ConsoleStyle::RED) << "Tracker did not confirm target " << i << " after " << frame + 1 << " hits!" << ConsoleStyle() << std::endl;
+				passed = false;
+			}
+		}
+		if (tracker.getTracks().size() != 2) {
+			std::cout << ConsoleStyle(ConsoleStyle::RED) << "Tracker has " << tracker.getTracks().size() << " tracks for 2 targets in frame " << frame << "!" << ConsoleStyle() << std::endl;
+			passed = false;
+		}
+		if (!passed) {
+			break;
+		}
+	}
+	return passed;
+}
+
+//A confirmed track coasts along its velocity while its target is not seen and is dropped after maxMisses frames.
+//Unconfirmed tracks are dropped on their first miss
+static bool testCoastingTrack()
+{
+	const Target target = {40.0f, 60.0f, 90.0f, 45.0f};
+	const uint32_t hitFrames = 20;
+	Tracker tracker(48.0f, ConfirmHits, MaxMisses);
+	tracker.setup(ImageSize);
+	uint32_t random = 815;
+	std::vector<Tracker::Measurement> measurements;
+	uint32_t id = 0;
+	for (uint32_t frame = 0; frame < hitFrames; ++frame) {
+		measurements.clear();
+		measurements.push_back(makeMeasurement(target, frame, random));
+		//a blob seen once far away starts an unconfirmed track
+		if (frame == hitFrames - 1) {
+			Tracker::Measurement clutter = {280.0f, 200.0f, cv::Rect(276, 196, 9, 9), 81};
+			measurements.push_back(clutter);
+		}
+		tracker.update(measurements, frame * FrameIntervalUs);
+		id = tracker.getMeasurementTrack(0)->id;
+	}
+	bool passed = true;
+	for (uint32_t miss = 1; miss <= MaxMisses + 1; ++miss) {
+		const uint32_t frame = hitFrames - 1 + miss;
+		measurements.clear();
+		tracker.update(measurements, frame * FrameIntervalUs);
+		const std::vector<Tracker::Track> & tracks = tracker.getTracks();
+		const uint32_t expectedTracks = miss <= MaxMisses ? 1 : 0;
+		if (tracks.size() != expectedTracks) {
+			std::cout << ConsoleStyle(ConsoleStyle::RED) << "Tracker has " << tracks.size() << " tracks instead of " << expectedTracks << " after " << miss << " misses!" << ConsoleStyle() << std::endl;
+			passed = false;
+			break;
+		}
+		if (expectedTracks > 0) {
+			//the coasting track follows the target it lost
+			const float t = frame * FrameIntervalUs / 1000000.0f;
+			const Tracker::Track * track = findTrack(tracker, target.x + target.vx * t, target.y + target.vy * t);
+			const float error = std::sqrt((track->x - target.x - target.vx * t) * (track->x - target.x - target.vx * t) + (track->y - target.y - target.vy * t) * (track->y - target.y - target.vy * t));
+			if (track->id != id || track->misses != miss || error > 3.0f) {
+				std::cout << ConsoleStyle(ConsoleStyle::RED) << "Tracker coasting track " << track->id << " with " << track->misses << " misses is " << error << " pixels off after " << miss << " misses!" << ConsoleStyle() << std::endl;
+				passed = false;
+			}
+		}
+	}
+	return passed;
+}
+
+bool testTracker()
+{
+	bool passed = testCrossingTargets();
+	passed = testCoastingTrack() && passed;
+	if (passed) {
+		std::cout << "Tracker keeps IDs of crossing targets and drops lost tracks." << std::endl;
+	}
+	return passed;
+}
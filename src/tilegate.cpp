@@ -0,0 +1,129 @@
+#include "tilegate.h"
+
+#include <algorithm>
+
+
+TileGate::TileGate(uint32_t size)
+	: tileSize(size < 1 ? 1 : size), activeCount(0), processedCount(0)
+{
+}
+
+void TileGate::setup(const cv::Size & size)
+{
+	imageSize = size;
+	const cv::Size tileCount = getTileCount();
+	activeTiles = cv::Mat::zeros(tileCount, CV_8U);
+	grownTiles = cv::Mat::zeros(tileCount, CV_8U);
+	tileActivity = cv::Mat::zeros(tileCount, CV_32S);
+	regions.clear();
+	//there can't be more regions than tiles, so updates never allocate
+	regions.reserve(tileCount.area());
+	tileGroups.reserve(tileCount.width, tileCount.area());
+	activeCount = 0;
+	processedCount = 0;
+}
+
+const std::vector<cv::Rect> & TileGate::update(const cv::Mat & mask, uint32_t halo)
+{
+	if (mask.size() != imageSize) {
+		setup(mask.size());
+	}
+	const cv::Size tileCount = getTileCount();
+	//a tile is active if any of its pixels is set
+	activeTiles.setTo(0);
+	activeCount = 0;
+	for (int y = 0; y < imageSize.height; ++y) {
+		const uint8_t * maskRow = mask.ptr<uint8_t>(y);
+		uint8_t * tileRow = activeTiles.ptr<uint8_t>(y / tileSize);
+		for (int tx = 0; tx < tileCount.width; ++tx) {
+			const int start = tx * tileSize;
+			const int end = std::min<int>(start + tileSize, imageSize.width);
+			uint8_t any = 0;
+			for (int x = start; x < end; ++x) {
+				any |= maskRow[x];
+			}
+			tileRow[tx] |= any;
+		}
+	}
+	for (int ty = 0; ty < tileCount.height; ++ty) {
+		const uint8_t * tileRow = activeTiles.ptr<uint8_t>(ty);
+		int32_t * activityRow = tileActivity.ptr<int32_t>(ty);
+		for (int tx = 0; tx < tileCount.width; ++tx) {
+			if (tileRow[tx] != 0) {
+				activityRow[tx]++;
+				activeCount++;
+			}
+		}
+	}
+	regions.clear();
+	processedCount = 0;
+	if (activeCount == 0) {
+		return regions;
+	}
+	//grow active tiles by the number of tiles the halo can reach into
+	const int haloTiles = (halo + tileSize - 1) / tileSize;
+	grownTiles.setTo(0);
+	for (int ty = 0; ty < tileCount.height; ++ty) {
+		const uint8_t * tileRow = activeTiles.ptr<uint8_t>(ty);
+		for (int tx = 0; tx < tileCount.width; ++tx) {
+			if (tileRow[tx] != 0) {
+				const cv::Rect grown = cv::Rect(tx - haloTiles, ty - haloTiles, 2 * haloTiles + 1, 2 * haloTiles + 1) & cv::Rect(0, 0, tileCount.width, tileCount.height);
+				grownTiles(grown).setTo(255);
+			}
+		}
+	}
+	//group connected tiles. the bounding boxes of groups may overlap, so merge those till all boxes are disjoint
+	const std::vector<BlobExtractor::Blob> & groups = tileGroups.extract(grownTiles);
+	for (auto gIt = groups.cbegin(); gIt != groups.cend(); ++gIt) {
+		cv::Rect box = gIt->boundingBox;
+		for (auto rIt = regions.begin(); rIt != regions.end();) {
+			if ((box & *rIt).area() > 0) {
+				box = box | *rIt;
+				regions.erase(rIt);
+				//the grown box might overlap boxes checked before now
+				rIt = regions.begin();
+			}
+			else {
+				++rIt;
+			}
+		}
+		regions.push_back(box);
+	}
+	//convert from tiles to pixels
+	const cv::Rect imageRect(0, 0, imageSize.width, imageSize.height);
+	for (auto rIt = regions.begin(); rIt != regions.end(); ++rIt) {
+		processedCount += rIt->area();
+		*rIt = cv::Rect(rIt->x * tileSize, rIt->y * tileSize, rIt->width * tileSize, rIt->height * tileSize) & imageRect;
+	}
+	return regions;
+}
+
+uint32_t TileGate::getTileSize() const
+{
+	return tileSize;
+}
+
+cv::Size TileGate::getTileCount() const
+{
+	return cv::Size((imageSize.width + tileSize - 1) / tileSize, (imageSize.height + tileSize - 1) / tileSize);
+}
+
+uint32_t TileGate::getActiveTiles() const
+{
+	return activeCount;
+}
+
+uint32_t TileGate::getProcessedTiles() const
+{
+	return processedCount;
+}
+
+const cv::Mat & TileGate::getTileActivity() const
+{
+	return tileActivity;
+}
+
+uint64_t TileGate::getMemoryUsage() const
+{
+	return activeTiles.total() + grownTiles.total() + tileActivity.total() * sizeof(int32_t) + regions.capacity() * sizeof(cv::Rect) + tileGroups.getMemoryUsage();
+}
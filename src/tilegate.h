@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "blobextractor.h"
+
+
+/*!
+Finds the parts of a binary foreground mask that need morphology and blob extraction.
+The mask is split into square tiles. Every tile with foreground pixels is active. Active tiles are grown by a halo
+covering the reach of the following morphology and grouped into non-overlapping regions. Pixels outside the regions
+can not become foreground during morphology, so processing the regions only gives the same result as processing
+the whole mask. In a static scene there are no regions at all.
+*/
+class TileGate
+{
+	uint32_t tileSize; //!<Width and height of tiles in pixels.
+	cv::Size imageSize; //!<Size of mask in pixels.
+	cv::Mat activeTiles; //!<Tiles with foreground in last mask, CV_8U.
+	cv::Mat grownTiles; //!<Active tiles grown by halo, CV_8U.
+	cv::Mat tileActivity; //!<Number of frames each tile was active in, CV_32S.
+	std::vector<cv::Rect> regions; //!<Regions that need processing in mask coordinates.
+	BlobExtractor tileGroups; //!<Groups neighbouring grown tiles.
+	uint32_t activeCount; //!<Number of active tiles in last mask.
+	uint32_t processedCount; //!<Number of tiles covered by regions in last mask.
+
+public:
+	/*!
+	Create tile gate.
+	\param[in] size Optional. Tile width and height in pixels.
+	*/
+	TileGate(uint32_t size = 16);
+
+	/*!
+	Set up tiles for masks of a specific size and clear activity counters.
+	*/
+	void setup(const cv::Size & size);
+
+	/*!
+	Find regions of mask that need processing.
+	\param[in] mask Binary foreground mask, CV_8U. All non-zero pixels are foreground.
+	\param[in] halo Number of pixels morphology can grow or look around foreground pixels, e.g. the sum of dilation and erosion radius.
+	\return Returns the regions that need processing. The list is valid until the next call.
+	*/
+	const std::vector<cv::Rect> & update(const cv::Mat & mask, uint32_t halo);
+
+	uint32_t getTileSize() const;
+	cv::Size getTileCount() const;
+	uint32_t getActiveTiles() const;
+	uint32_t getProcessedTiles() const;
+
+	/*!
+	Get the number of frames each tile was active in since \setup.
+	\return Returns a CV_32S image with one pixel per tile.
+	*/
+	const cv::Mat & getTileActivity() const;
+
+	/*!
+	Get the size of the tile maps and region buffers in bytes.
+	*/
+	uint64_t getMemoryUsage() const;
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+
+/*!
+Get the current time of the monotonic system clock.
+\return Returns the CLOCK_MONOTONIC time in microseconds.
+\note Use this for all capture, processing and launcher time stamps, so they can be compared to each other.
+*/
+inline uint64_t getTimestampUs()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
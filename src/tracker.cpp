@@ -0,0 +1,250 @@
+#include "tracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+//new tracks start with zero velocity, but may move this fast in pixels/s
+static const float InitialVelocityVariance = 200.0f * 200.0f;
+
+
+void Tracker::AxisFilter::initialize(float z, float positionVariance, float velocityVariance)
+{
+	position = z;
+	velocity = 0.0f;
+	p00 = positionVariance;
+	p01 = 0.0f;
+	p11 = velocityVariance;
+}
+
+void Tracker::AxisFilter::predict(float dt, float q)
+{
+	//state transition [1 dt; 0 1] with white noise acceleration
+	position += velocity * dt;
+	p00 += dt * (2.0f * p01 + dt * p11) + q * dt * dt * dt / 3.0f;
+	p01 += dt * p11 + q * dt * dt / 2.0f;
+	p11 += q * dt;
+}
+
+void Tracker::AxisFilter::update(float z, float r)
+{
+	//only the position is measured
+	const float s = p00 + r;
+	const float k0 = p00 / s;
+	const float k1 = p01 / s;
+	const float innovation = z - position;
+	position += k0 * innovation;
+	velocity += k1 * innovation;
+	p11 -= k1 * p01;
+	p01 -= k0 * p01;
+	p00 -= k0 * p00;
+}
+
+Tracker::Tracker(float gate, uint32_t hits, uint32_t misses)
+	: gateRadius(gate), measurementVariance(4.0f * 4.0f), accelerationNoise(2000.0f), confirmHits(hits), maxMisses(misses), nextId(1)
+{
+}
+
+void Tracker::setup(const cv::Size & size)
+{
+	imageSize = size;
+	//the gate radius is the cell size, so all tracks in gate range of a blob are in the 3x3 cells around it
+	gridSize = cv::Size(std::max(1, (int)std::ceil(size.width / gateRadius)), std::max(1, (int)std::ceil(size.height / gateRadius)));
+	cellStarts.resize(gridSize.area() + 1);
+	clear();
+}
+
+void Tracker::clear()
+{
+	tracks.clear();
+	filtersX.clear();
+	filtersY.clear();
+	measurementMatches.clear();
+}
+
+void Tracker::reserve(uint32_t trackCount, uint32_t measurementCount)
+{
+	//new tracks are appended after the kept ones, so there may be as many as tracks and blobs together for a moment
+	tracks.reserve(trackCount + measurementCount);
+	filtersX.reserve(trackCount + measurementCount);
+	filtersY.reserve(trackCount + measurementCount);
+	cellTracks.reserve(trackCount + measurementCount);
+	trackCells.reserve(trackCount + measurementCount);
+	trackMatches.reserve(trackCount + measurementCount);
+	measurementMatches.reserve(measurementCount);
+	//a blob is gated with the few tracks around it
+	candidates.reserve(4 * measurementCount);
+}
+
+void Tracker::shift(float dx, float dy)
+{
+	for (uint32_t i = 0; i < tracks.size(); ++i) {
+		filtersX[i].position += dx;
+		filtersY[i].position += dy;
+		tracks[i].x = filtersX[i].position;
+		tracks[i].y = filtersY[i].position;
+		tracks[i].boundingBox.x += cvRound(dx);
+		tracks[i].boundingBox.y += cvRound(dy);
+	}
+}
+
+uint32_t Tracker::getCell(float x, float y) const
+{
+	//predictions may leave the image, put them into the border cells
+	const int cellX = std::min(std::max((int)std::floor(x / gateRadius), 0), gridSize.width - 1);
+	const int cellY = std::min(std::max((int)std::floor(y / gateRadius), 0), gridSize.height - 1);
+	return cellY * gridSize.width + cellX;
+}
+
+void Tracker::buildGrid()
+{
+	//counting sort of the tracks by cell. afterwards the tracks of cell i are cellTracks[cellStarts[i]] to cellTracks[cellStarts[i + 1] - 1]
+	std::fill(cellStarts.begin(), cellStarts.end(), 0);
+	trackCells.resize(tracks.size());
+	for (uint32_t i = 0; i < tracks.size(); ++i) {
+		trackCells[i] = getCell(tracks[i].x, tracks[i].y);
+		cellStarts[trackCells[i]]++;
+	}
+	for (uint32_t i = 1; i < cellStarts.size(); ++i) {
+		cellStarts[i] += cellStarts[i - 1];
+	}
+	cellTracks.resize(tracks.size());
+	for (uint32_t i = 0; i < tracks.size(); ++i) {
+		cellTracks[--cellStarts[trackCells[i]]] = i;
+	}
+}
+
+void Tracker::associate(const std::vector<Measurement> & measurements)
+{
+	//collect all blob/track pairs closer than the gate radius. only the cells around a blob can contain those
+	candidates.clear();
+	const float gate2 = gateRadius * gateRadius;
+	for (uint32_t m = 0; m < measurements.size(); ++m) {
+		const Measurement & measurement = measurements[m];
+		const uint32_t cell = getCell(measurement.cx, measurement.cy);
+		const int cellX = cell % gridSize.width;
+		const int cellY = cell / gridSize.width;
+		for (int y = std::max(cellY - 1, 0); y <= std::min(cellY + 1, gridSize.height - 1); ++y) {
+			for (int x = std::max(cellX - 1, 0); x <= std::min(cellX + 1, gridSize.width - 1); ++x) {
+				const uint32_t neighbour = y * gridSize.width + x;
+				for (uint32_t i = cellStarts[neighbour]; i < cellStarts[neighbour + 1]; ++i) {
+					const Track & track = tracks[cellTracks[i]];
+					const float dx = measurement.cx - track.x;
+					const float dy = measurement.cy - track.y;
+					if (dx * dx + dy * dy <= gate2) {
+						//weight the distance by the uncertainty of the prediction, so coasting tracks don't steal blobs of certain ones
+						const float cost = dx * dx / (track.varianceX + measurementVariance) + dy * dy / (track.varianceY + measurementVariance);
+						Candidate candidate = {cost, cellTracks[i], m};
+						candidates.push_back(candidate);
+					}
+				}
+			}
+		}
+	}
+	//assign the cheapest pairs first
+	std::sort(candidates.begin(), candidates.end());
+	trackMatches.assign(tracks.size(), -1);
+	measurementMatches.assign(measurements.size(), -1);
+	for (auto cIt = candidates.cbegin(); cIt != candidates.cend(); ++cIt) {
+		if (trackMatches[cIt->track] < 0 && measurementMatches[cIt->measurement] < 0) {
+			trackMatches[cIt->track] = cIt->measurement;
+			measurementMatches[cIt->measurement] = cIt->track;
+		}
+	}
+}
+
+void Tracker::update(const std::vector<Measurement> & measurements, uint64_t timestamp)
+{
+	//predict tracks to frame time
+	for (uint32_t i = 0; i < tracks.size(); ++i) {
+		Track & track = tracks[i];
+		const float dt = timestamp > track.timestamp ? (timestamp - track.timestamp) / 1000000.0f : 0.0f;
+		filtersX[i].predict(dt, accelerationNoise);
+		filtersY[i].predict(dt, accelerationNoise);
+		track.x = filtersX[i].position;
+		track.y = filtersY[i].position;
+		track.varianceX = filtersX[i].p00;
+		track.varianceY = filtersY[i].p00;
+		track.timestamp = timestamp;
+	}
+	buildGrid();
+	associate(measurements);
+	//correct tracks with their blobs and drop the ones lost for too long
+	uint32_t kept = 0;
+	for (uint32_t i = 0; i < tracks.size(); ++i) {
+		Track & track = tracks[i];
+		if (trackMatches[i] >= 0) {
+			const Measurement & measurement = measurements[trackMatches[i]];
+			filtersX[i].update(measurement.cx, measurementVariance);
+			filtersY[i].update(measurement.cy, measurementVariance);
+			track.boundingBox = measurement.boundingBox;
+			track.area = measurement.area;
+			track.hits++;
+			track.misses = 0;
+			track.confirmed = track.confirmed || track.hits >= confirmHits;
+		}
+		else {
+			track.misses++;
+			if (!track.confirmed || track.misses > maxMisses) {
+				continue;
+			}
+		}
+		track.x = filtersX[i].position;
+		track.y = filtersY[i].position;
+		track.vx = filtersX[i].velocity;
+		track.vy = filtersY[i].velocity;
+		track.varianceX = filtersX[i].p00;
+		track.varianceY = filtersY[i].p00;
+		tracks[kept] = track;
+		filtersX[kept] = filtersX[i];
+		filtersY[kept] = filtersY[i];
+		if (trackMatches[i] >= 0) {
+			measurementMatches[trackMatches[i]] = kept;
+		}
+		kept++;
+	}
+	tracks.resize(kept);
+	filtersX.resize(kept);
+	filtersY.resize(kept);
+	//start new tracks for blobs no track was close to
+	for (uint32_t m = 0; m < measurements.size(); ++m) {
+		if (measurementMatches[m] < 0) {
+			const Measurement & measurement = measurements[m];
+			Track track = {nextId++, measurement.cx, measurement.cy, 0.0f, 0.0f, measurementVariance, measurementVariance, measurement.boundingBox, measurement.area, 1, 0, timestamp, timestamp, confirmHits <= 1};
+			AxisFilter filter;
+			filter.initialize(measurement.cx, measurementVariance, InitialVelocityVariance);
+			filtersX.push_back(filter);
+			filter.initialize(measurement.cy, measurementVariance, InitialVelocityVariance);
+			filtersY.push_back(filter);
+			measurementMatches[m] = tracks.size();
+			tracks.push_back(track);
+		}
+	}
+}
+
+const std::vector<Tracker::Track> & Tracker::getTracks() const
+{
+	return tracks;
+}
+
+const Tracker::Track * Tracker::getMeasurementTrack(uint32_t measurement) const
+{
+	return measurement < measurementMatches.size() ? &tracks[measurementMatches[measurement]] : nullptr;
+}
+
+void Tracker::getConfirmedTracks(std::vector<Track> & confirmed) const
+{
+	confirmed.clear();
+	for (auto tIt = tracks.cbegin(); tIt != tracks.cend(); ++tIt) {
+		if (tIt->confirmed) {
+			confirmed.push_back(*tIt);
+		}
+	}
+}
+
+uint64_t Tracker::getMemoryUsage() const
+{
+	return tracks.capacity() * sizeof(Track) + (filtersX.capacity() + filtersY.capacity()) * sizeof(AxisFilter)
+		+ (cellStarts.capacity() + cellTracks.capacity() + trackCells.capacity()) * sizeof(uint32_t)
+		+ candidates.capacity() * sizeof(Candidate) + (trackMatches.capacity() + measurementMatches.capacity()) * sizeof(int32_t);
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+
+/*!
+Follows moving objects from frame to frame. Every object gets a track with a stable ID and a constant velocity Kalman filter
+per axis. Blobs are associated with the predicted track positions. Candidate pairs are only searched in the grid cells around
+a blob, so association stays cheap with many blobs and tracks.
+*/
+class Tracker
+{
+public:
+	struct Measurement
+	{
+		float cx; //!<Centroid x.
+		float cy; //!<Centroid y.
+		cv::Rect boundingBox; //!<Bounding box of object.
+		uint32_t area; //!<Number of changed pixels of object.
+	};
+
+	struct Track
+	{
+		uint32_t id; //!<ID of track. IDs are not reused.
+		float x; //!<Filtered center x.
+		float y; //!<Filtered center y.
+		float vx; //!<Filtered velocity in x in pixels/s.
+		float vy; //!<Filtered velocity in y in pixels/s.
+		float varianceX; //!<Variance of x in pixels^2.
+		float varianceY; //!<Variance of y in pixels^2.
+		cv::Rect boundingBox; //!<Bounding box of last associated blob.
+		uint32_t area; //!<Area of last associated blob.
+		uint32_t hits; //!<Number of frames a blob was associated with the track.
+		uint32_t misses; //!<Number of frames since a blob was associated with the track.
+		uint64_t firstTimestamp; //!<Time the track was created in us.
+		uint64_t timestamp; //!<Time of the last prediction or update in us.
+		bool confirmed; //!<True if the track was seen often enough to be a real object.
+	};
+
+private:
+	/*!
+	Kalman filter for position and velocity along one axis.
+	*/
+	struct AxisFilter
+	{
+		float position;
+		float velocity;
+		float p00; //!<Variance of position.
+		float p01; //!<Covariance of position and velocity.
+		float p11; //!<Variance of velocity.
+
+		void initialize(float z, float positionVariance, float velocityVariance);
+		void predict(float dt, float q);
+		void update(float z, float r);
+	};
+
+	struct Candidate
+	{
+		float cost; //!<Normalized squared distance of blob and predicted track.
+		uint32_t track; //!<Index into tracks.
+		uint32_t measurement; //!<Index into measurements.
+
+		bool operator<(const Candidate & b) const { return cost < b.cost; };
+	};
+
+	std::vector<Track> tracks; //!<Current tracks.
+	std::vector<AxisFilter> filtersX; //!<Filters of tracks in x.
+	std::vector<AxisFilter> filtersY; //!<Filters of tracks in y.
+	std::vector<uint32_t> cellStarts; //!<Index of the first entry of every grid cell in cellTracks. One more than cells.
+	std::vector<uint32_t> cellTracks; //!<Track indices sorted by grid cell.
+	std::vector<uint32_t> trackCells; //!<Grid cell of every track.
+	std::vector<Candidate> candidates; //!<Gated blob/track pairs of current frame.
+	std::vector<int32_t> trackMatches; //!<Measurement associated with every track or -1.
+	std::vector<int32_t> measurementMatches; //!<Track associated with every measurement or -1. After \update the index of its track.
+	cv::Size imageSize; //!<Size of the images measurements come from.
+	cv::Size gridSize; //!<Number of grid cells.
+	float gateRadius; //!<Maximum distance of a blob to a predicted track position in pixels. Also the grid cell size.
+	float measurementVariance; //!<Variance of blob centroids in pixels^2.
+	float accelerationNoise; //!<Spectral density of acceleration in pixels^2/s^3.
+	uint32_t confirmHits; //!<Number of hits after which a track is confirmed.
+	uint32_t maxMisses; //!<Confirmed tracks are dropped after this number of frames without hit.
+	uint32_t nextId; //!<ID of next new track.
+
+	uint32_t getCell(float x, float y) const;
+	void buildGrid();
+	void associate(const std::vector<Measurement> & measurements);
+
+public:
+	/*!
+	Create tracker.
+	\param[in] gate Optional. Maximum distance of a blob to a predicted track position in pixels.
+	\param[in] hits Optional. Number of hits after which a track is confirmed.
+	\param[in] misses Optional. Confirmed tracks are dropped after this number of frames without hit. Unconfirmed tracks after the first.
+	*/
+	Tracker(float gate = 48.0f, uint32_t hits = 3, uint32_t misses = 10);
+
+	/*!
+	Set up tracker for images of a specific size and drop all tracks.
+	*/
+	void setup(const cv::Size & size);
+
+	/*!
+	Drop all tracks, e.g. when the camera view changed.
+	*/
+	void clear();
+
+	/*!
+	Reserve the track and association buffers up front, so updates do not allocate unless there are more tracks or blobs.
+	\param[in] trackCount Number of tracks to reserve for.
+	\param[in] measurementCount Number of blobs per frame to reserve for.
+	*/
+	void reserve(uint32_t trackCount, uint32_t measurementCount);
+
+	/*!
+	Move all tracks, e.g. when the camera moved and the whole image shifted.
+	\param[in] dx Shift in x in pixels.
+	\param[in] dy Shift in y in pixels.
+	*/
+	void shift(float dx, float dy);
+
+	/*!
+	Predict tracks to the time of a frame, associate the blobs of the frame with them and update the filters.
+	Blobs without a track start new tracks.
+	\param[in] measurements Blobs of the frame.
+	\param[in] timestamp Capture time of the frame in us.
+	*/
+	void update(const std::vector<Measurement> & measurements, uint64_t timestamp);
+
+	/*!
+	Get all tracks including unconfirmed ones.
+	\return Returns the current tracks. The list is valid until the next call to \update.
+	*/
+	const std::vector<Track> & getTracks() const;
+
+	/*!
+	Get the track a measurement of the last \update was associated with or started.
+	\param[in] measurement Index of the measurement.
+	\return Returns a pointer to the track or nullptr if the index is invalid. Valid until the next call to \update.
+	*/
+	const Track * getMeasurementTrack(uint32_t measurement) const;
+
+	/*!
+	Copy the confirmed tracks to a list.
+	\param[out] confirmed Receives the confirmed tracks.
+	*/
+	void getConfirmedTracks(std::vector<Track> & confirmed) const;
+
+	/*!
+	Get the size of the track and association buffers in bytes.
+	*/
+	uint64_t getMemoryUsage() const;
+};
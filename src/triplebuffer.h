@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+
+/*!
+Wait-free publication of values from one writer thread to one reader thread.
+Of the three buffers the writer owns one, the reader owns one and the third holds the newest published value.
+Publishing and fetching only swap buffer indices with one atomic exchange, so neither side ever waits for the other and
+values are never copied. The reader always gets the newest value, values published in between are skipped.
+Buffers are reused, so values holding memory, e.g. vectors or images, only allocate while they grow.
+*/
+template <typename T>
+class TripleBuffer
+{
+	static const uint32_t dirtyFlag = 4; //!<Set in middle if the middle buffer holds a value the reader has not fetched yet.
+
+	T buffers[3]; //!<The values.
+	std::atomic<uint32_t> middle; //!<Index of the buffer between writer and reader, plus dirtyFlag.
+	uint32_t back; //!<Index of the buffer owned by the writer.
+	uint32_t front; //!<Index of the buffer owned by the reader.
+
+	TripleBuffer(const TripleBuffer &);
+	TripleBuffer & operator=(const TripleBuffer &);
+
+public:
+	TripleBuffer() : middle(1), back(0), front(2) {};
+
+	/*!
+	Get the buffer to write the next value to. Writer thread only.
+	\return Returns the buffer owned by the writer. It holds an old value, which can be reused or overwritten.
+	*/
+	T & getWriteBuffer()
+	{
+		return buffers[back];
+	}
+
+	/*!
+	Publish the write buffer as the newest value. Writer thread only.
+	The writer gets the old middle buffer to write the next value to.
+	*/
+	void publish()
+	{
+		back = middle.exchange(back | dirtyFlag, std::memory_order_acq_rel) & 3;
+	}
+
+	/*!
+	Make the newest published value the read buffer. Reader thread only.
+	\return Returns true if a value was published since the last fetch.
+	*/
+	bool fetch()
+	{
+		if ((middle.load(std::memory_order_relaxed) & dirtyFlag) == 0) {
+			return false;
+		}
+		front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+		return true;
+	}
+
+	/*!
+	Get the value fetched last. Reader thread only.
+	\return Returns the buffer owned by the reader. It stays valid until the next \fetch.
+	*/
+	const T & getReadBuffer() const
+	{
+		return buffers[front];
+	}
+
+	/*!
+	Get any of the three buffers, e.g. to preallocate them before writer and reader start.
+	\param[in] index Buffer index from 0 to 2.
+	\note Not thread safe. Neither writer nor reader may use the buffers meanwhile.
+	*/
+	T & getBuffer(uint32_t index)
+	{
+		return buffers[index];
+	}
+};
@@ -0,0 +1,247 @@
+#include "v4l2source.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/videodev2.h>
+
+#include "consolestyle.h"
+#include "timestamp.h"
+
+
+const uint32_t V4L2Source::bufferCount = 8;
+const uint32_t V4L2Source::readTimeout = 1000;
+
+//ioctl wrapper retrying when interrupted by a signal
+static int xioctl(int descriptor, unsigned long request, void * argument)
+{
+	int result;
+	do {
+		result = ioctl(descriptor, request, argument);
+	} while (result == -1 && errno == EINTR);
+	return result;
+}
+
+
+V4L2Source::V4L2Source()
+	: deviceDescriptor(-1), bytesPerLine(0), streaming(false)
+{
+}
+
+bool V4L2Source::open(const std::string & devicePath, uint32_t preferredWidth, uint32_t preferredHeight, double preferredFps, uint32_t heldBuffers)
+{
+	close();
+	deviceDescriptor = ::open(devicePath.c_str(), O_RDWR | O_NONBLOCK);
+	if (deviceDescriptor < 0) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to open video device \"" << devicePath << "\"!" << ConsoleStyle() << std::endl;
+		return false;
+	}
+	//check if the device can capture using streaming I/O
+	v4l2_capability capability;
+	memset(&capability, 0, sizeof(capability));
+	if (xioctl(deviceDescriptor, VIDIOC_QUERYCAP, &capability) < 0 || !(capability.capabilities & V4L2_CAP_VIDEO_CAPTURE) || !(capability.capabilities & V4L2_CAP_STREAMING)) {
+		std::cout << ConsoleStyle(ConsoleStyle::YELLOW) << "\"" << devicePath << "\" is no streaming video capture device." << ConsoleStyle() << std::endl;
+		close();
+		return false;
+	}
+	//try pixel formats in order of preference. formats with a separate luma plane come first
+	static const struct { uint32_t fourcc; PixelFormat pixelFormat; } formats[] = {
+		{V4L2_PIX_FMT_GREY, FORMAT_GREY}, {V4L2_PIX_FMT_NV12, FORMAT_NV12}, {V4L2_PIX_FMT_YUV420, FORMAT_I420}, {V4L2_PIX_FMT_YUYV, FORMAT_YUYV}
+	};
+	v4l2_format videoFormat;
+	format = FORMAT_UNKNOWN;
+	for (uint32_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+		memset(&videoFormat, 0, sizeof(videoFormat));
+		videoFormat.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		videoFormat.fmt.pix.width = preferredWidth;
+		videoFormat.fmt.pix.height = preferredHeight;
+		videoFormat.fmt.pix.pixelformat = formats[i].fourcc;
+		videoFormat.fmt.pix.field = V4L2_FIELD_NONE;
+		//the driver may change the format to one it supports, so check what we really got
+		if (xioctl(deviceDescriptor, VIDIOC_S_FMT, &videoFormat) == 0 && videoFormat.fmt.pix.pixelformat == formats[i].fourcc) {
+			format = formats[i].pixelFormat;
+			break;
+		}
+	}
+	if (format == FORMAT_UNKNOWN) {
+		std::cout << ConsoleStyle(ConsoleStyle::YELLOW) << "\"" << devicePath << "\" supports none of the GREY, NV12, YUV420 or YUYV formats." << ConsoleStyle() << std::endl;
+		close();
+		return false;
+	}
+	width = videoFormat.fmt.pix.width;
+	height = videoFormat.fmt.pix.height;
+	bytesPerLine = videoFormat.fmt.pix.bytesperline;
+	if (bytesPerLine == 0) {
+		bytesPerLine = (format == FORMAT_YUYV ? width * 2 : width);
+	}
+	//try to set frame rate and read back what the driver actually uses
+	v4l2_streamparm streamParameters;
+	memset(&streamParameters, 0, sizeof(streamParameters));
+	streamParameters.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	streamParameters.parm.capture.timeperframe.numerator = 1000;
+	streamParameters.parm.capture.timeperframe.denominator = preferredFps * 1000;
+	xioctl(deviceDescriptor, VIDIOC_S_PARM, &streamParameters);
+	if (xioctl(deviceDescriptor, VIDIOC_G_PARM, &streamParameters) == 0 && streamParameters.parm.capture.timeperframe.numerator > 0) {
+		fps = (double)streamParameters.parm.capture.timeperframe.denominator / streamParameters.parm.capture.timeperframe.numerator;
+	}
+	else {
+		std::cout << ConsoleStyle(ConsoleStyle::YELLOW) << "Failed to properly set fps!" << ConsoleStyle() << std::endl;
+		fps = preferredFps;
+	}
+	//request memory-mapped driver buffers. held buffers are only requeued when the consumer lets go of them,
+	//so capture stalls if the driver doesn't get more buffers than can be held
+	v4l2_requestbuffers request;
+	memset(&request, 0, sizeof(request));
+	request.count = std::max(bufferCount, heldBuffers + 2);
+	request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	request.memory = V4L2_MEMORY_MMAP;
+	if (xioctl(deviceDescriptor, VIDIOC_REQBUFS, &request) < 0 || request.count < 2) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to get memory-mapped buffers from \"" << devicePath << "\"!" << ConsoleStyle() << std::endl;
+		close();
+		return false;
+	}
+	if (request.count <= heldBuffers) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Got only " << request.count << " buffers from \"" << devicePath << "\", but " << heldBuffers + 1 << " are needed!" << ConsoleStyle() << std::endl;
+		close();
+		return false;
+	}
+	buffers.resize(request.count);
+	for (uint32_t i = 0; i < buffers.size(); ++i) {
+		v4l2_buffer buffer;
+		memset(&buffer, 0, sizeof(buffer));
+		buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		buffer.memory = V4L2_MEMORY_MMAP;
+		buffer.index = i;
+		if (xioctl(deviceDescriptor, VIDIOC_QUERYBUF, &buffer) < 0) {
+			std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to query buffer #" << i << "!" << ConsoleStyle() << std::endl;
+			close();
+			return false;
+		}
+		void * start = mmap(nullptr, buffer.length, PROT_READ | PROT_WRITE, MAP_SHARED, deviceDescriptor, buffer.m.offset);
+		if (start == MAP_FAILED) {
+			std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to map buffer #" << i << "!" << ConsoleStyle() << std::endl;
+			close();
+			return false;
+		}
+		buffers[i].start = start;
+		buffers[i].length = buffer.length;
+		//hand buffer to driver
+		if (xioctl(deviceDescriptor, VIDIOC_QBUF, &buffer) < 0) {
+			std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to queue buffer #" << i << "!" << ConsoleStyle() << std::endl;
+			close();
+			return false;
+		}
+	}
+	//start streaming
+	v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	if (xioctl(deviceDescriptor, VIDIOC_STREAMON, &type) < 0) {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to start streaming from \"" << devicePath << "\"!" << ConsoleStyle() << std::endl;
+		close();
+		return false;
+	}
+	streaming = true;
+	std::cout << ConsoleStyle(ConsoleStyle::GREEN) << "Opened V4L2 device \"" << devicePath << "\" (" << capability.card << ") with " << buffers.size() << " mmap buffers for motion detection." << ConsoleStyle() << std::endl;
+	return true;
+}
+
+bool V4L2Source::isOpened() const
+{
+	return (deviceDescriptor >= 0 && streaming);
+}
+
+bool V4L2Source::isLive() const
+{
+	return true;
+}
+
+bool V4L2Source::usesDriverBuffers() const
+{
+	return true;
+}
+
+uint64_t V4L2Source::getBufferMemory() const
+{
+	uint64_t result = 0;
+	for (auto bIt = buffers.cbegin(); bIt != buffers.cend(); ++bIt) {
+		result += bIt->length;
+	}
+	return result;
+}
+
+bool V4L2Source::read(cv::Mat & image, int32_t & bufferIndex, uint64_t & timestamp)
+{
+	bufferIndex = -1;
+	if (!isOpened()) {
+		return false;
+	}
+	//wait for the driver to fill a buffer
+	pollfd descriptor;
+	descriptor.fd = deviceDescriptor;
+	descriptor.events = POLLIN;
+	descriptor.revents = 0;
+	if (poll(&descriptor, 1, readTimeout) <= 0) {
+		return false;
+	}
+	//dequeue filled buffer
+	v4l2_buffer buffer;
+	memset(&buffer, 0, sizeof(buffer));
+	buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	buffer.memory = V4L2_MEMORY_MMAP;
+	if (xioctl(deviceDescriptor, VIDIOC_DQBUF, &buffer) < 0 || buffer.index >= buffers.size()) {
+		return false;
+	}
+	//use the driver time stamp if it is taken from the monotonic clock, it is closer to the actual exposure
+	if ((buffer.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC) {
+		timestamp = (uint64_t)buffer.timestamp.tv_sec * 1000000 + buffer.timestamp.tv_usec;
+	}
+	else {
+		timestamp = getTimestampUs();
+	}
+	//refer to driver buffer. no copy is made
+	const cv::Size imageSize = getImageSize();
+	image = cv::Mat(imageSize.height, imageSize.width, getImageType(), buffers[buffer.index].start, bytesPerLine);
+	bufferIndex = buffer.index;
+	return true;
+}
+
+void V4L2Source::requeue(int32_t bufferIndex)
+{
+	if (isOpened() && bufferIndex >= 0 && bufferIndex < (int32_t)buffers.size()) {
+		v4l2_buffer buffer;
+		memset(&buffer, 0, sizeof(buffer));
+		buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		buffer.memory = V4L2_MEMORY_MMAP;
+		buffer.index = bufferIndex;
+		xioctl(deviceDescriptor, VIDIOC_QBUF, &buffer);
+	}
+}
+
+void V4L2Source::close()
+{
+	if (streaming) {
+		v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		xioctl(deviceDescriptor, VIDIOC_STREAMOFF, &type);
+		streaming = false;
+	}
+	for (auto bIt = buffers.begin(); bIt != buffers.end(); ++bIt) {
+		if (bIt->start != nullptr) {
+			munmap(bIt->start, bIt->length);
+		}
+	}
+	buffers.clear();
+	if (deviceDescriptor >= 0) {
+		::close(deviceDescriptor);
+		deviceDescriptor = -1;
+	}
+}
+
+V4L2Source::~V4L2Source()
+{
+	close();
+}
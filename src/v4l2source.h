@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+
+#include "framesource.h"
+
+
+/*!
+Native Video4Linux2 camera source using streaming I/O with memory-mapped driver buffers.
+Frames are handed out as headers referring to the driver buffers, so nothing is copied or color converted.
+Luma formats (GREY, NV12, YUV420) are preferred over YUYV, because their luma plane can be used directly.
+*/
+class V4L2Source : public FrameSource
+{
+	static const uint32_t bufferCount; //!<Minimum number of driver buffers to request. More are requested if the consumer holds more.
+	static const uint32_t readTimeout; //!<Time in ms to wait for a frame in \read.
+
+	struct Buffer
+	{
+		void * start; //!<Start of memory-mapped buffer.
+		size_t length; //!<Length of memory-mapped buffer in bytes.
+
+		Buffer() : start(nullptr), length(0) {};
+	};
+
+	int deviceDescriptor; //!<File descriptor of the video device.
+	std::vector<Buffer> buffers; //!<Memory-mapped driver buffers.
+	uint32_t bytesPerLine; //!<Stride of luma plane in bytes.
+	bool streaming; //!<True if streaming has been started.
+
+public:
+	V4L2Source();
+
+	/*!
+	Open video device and start streaming.
+	\param[in] devicePath Device path to open, e.g. "/dev/video0".
+	\param[in] width Preferred width of video mode.
+	\param[in] height Preferred height of video mode.
+	\param[in] fps Preferred frames/s of capture.
+	\param[in] heldBuffers Optional. Number of driver buffers the consumer may hold at once, e.g. the slot count of the \FrameRing they are read into. More buffers than that are needed, so the driver always has one to fill.
+	\return Returns false if the device can not be opened, does not support streaming I/O or none of the supported formats, or if it can not provide enough buffers.
+	*/
+	bool open(const std::string & devicePath, uint32_t width, uint32_t height, double fps, uint32_t heldBuffers = 1);
+
+	bool isOpened() const;
+	bool isLive() const;
+	bool usesDriverBuffers() const;
+	uint64_t getBufferMemory() const;
+	bool read(cv::Mat & image, int32_t & bufferIndex, uint64_t & timestamp);
+	void requeue(int32_t bufferIndex);
+	void close();
+
+	~V4L2Source();
+};
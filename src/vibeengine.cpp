@@ -0,0 +1,101 @@
+#include "vibeengine.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+
+const uint32_t VibeEngine::sampleCount = 16;
+const uint32_t VibeEngine::minMatches = 2;
+const uint32_t VibeEngine::subsampling = 16;
+
+//offsets of the 8 neighbours of a pixel
+static const int neighbourX[] = {-1, 0, 1, -1, 1, -1, 0, 1};
+static const int neighbourY[] = {-1, -1, -1, 0, 0, 1, 1, 1};
+
+
+//cheap integer hash, so every pixel gets independent random bits in every frame
+static uint32_t getRandom(uint32_t x, uint32_t y, uint32_t frame)
+{
+	uint32_t h = x * 0x8da6b343u ^ y * 0xd8163841u ^ frame * 0xcb1ab31fu;
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+	return h;
+}
+
+
+VibeEngine::VibeEngine(int matchRadius)
+	: radius(matchRadius), frameCounter(0)
+{
+}
+
+BackgroundEngine::Type VibeEngine::getType() const
+{
+	return TYPE_VIBE;
+}
+
+void VibeEngine::initialize(const cv::Mat & grey)
+{
+	size = grey.size();
+	const size_t planeSize = size.area();
+	samples.resize(sampleCount * planeSize);
+	//seed every sample from a random pixel of the 3x3 neighbourhood
+	for (int y = 0; y < size.height; ++y) {
+		for (int x = 0; x < size.width; ++x) {
+			for (uint32_t i = 0; i < sampleCount; ++i) {
+				const uint32_t neighbour = getRandom(x, y, i) % 9;
+				const int sourceX = std::min(std::max(x + (int)(neighbour % 3) - 1, 0), size.width - 1);
+				const int sourceY = std::min(std::max(y + (int)(neighbour / 3) - 1, 0), size.height - 1);
+				samples[i * planeSize + y * size.width + x] = grey.ptr<uint8_t>(sourceY)[sourceX];
+			}
+		}
+	}
+	frameCounter = 0;
+}
+
+void VibeEngine::apply(const cv::Mat & grey, cv::Mat & foreground, const cv::Range & rows)
+{
+	const size_t planeSize = size.area();
+	for (int y = rows.start; y < rows.end; ++y) {
+		const uint8_t * row = grey.ptr<uint8_t>(y);
+		uint8_t * foregroundRow = foreground.ptr<uint8_t>(y);
+		uint8_t * rowSamples = samples.data() + y * size.width;
+		for (int x = 0; x < size.width; ++x) {
+			const int value = row[x];
+			//most background pixels match in the first few samples
+			uint32_t matches = 0;
+			for (uint32_t i = 0; i < sampleCount && matches < minMatches; ++i) {
+				matches += std::abs(value - rowSamples[i * planeSize + x]) < radius;
+			}
+			if (matches < minMatches) {
+				foregroundRow[x] = 255;
+				continue;
+			}
+			foregroundRow[x] = 0;
+			//the lowest bits decide if to update, the higher bits which sample and neighbour
+			const uint32_t random = getRandom(x, y, frameCounter);
+			if ((random & (subsampling - 1)) == 0) {
+				rowSamples[((random >> 8) % sampleCount) * planeSize + x] = value;
+			}
+			if (((random >> 4) & (subsampling - 1)) == 0) {
+				//neighbours outside of the band belong to another thread
+				const uint32_t neighbour = (random >> 12) & 7;
+				const int neighbourColumn = std::min(std::max(x + neighbourX[neighbour], 0), size.width - 1);
+				const int neighbourRow = std::min(std::max(y + neighbourY[neighbour], rows.start), rows.end - 1);
+				samples[((random >> 16) % sampleCount) * planeSize + neighbourRow * size.width + neighbourColumn] = value;
+			}
+		}
+	}
+}
+
+void VibeEngine::finishFrame()
+{
+	frameCounter++;
+}
+
+uint64_t VibeEngine::getMemoryUsage() const
+{
+	return samples.capacity();
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+#include "backgroundengine.h"
+
+
+/*!
+Sample based background model after ViBe (Barnich and Van Droogenbroeck). Every pixel keeps a set of past grey values.
+A pixel is background if enough samples are close to its value. Background pixels randomly replace one of their samples
+and one of a neighbour's, so the model follows slow changes and absorbs dynamic background like foliage, while
+foreground pixels never update the model. The model is valid from the first frame, because it is seeded from the
+neighbourhood of each pixel.
+Samples are stored as one plane per sample index. Random numbers are hashed from pixel position and frame number, so
+bands can be processed in parallel without shared generator state.
+*/
+class VibeEngine : public BackgroundEngine
+{
+	static const uint32_t sampleCount; //!<Number of samples per pixel.
+	static const uint32_t minMatches; //!<Number of close samples needed for a pixel to be background.
+	static const uint32_t subsampling; //!<A background pixel updates the model with a probability of 1/subsampling. Power of two.
+
+	int radius; //!<Maximum grey level difference of a close sample.
+	std::vector<uint8_t> samples; //!<sampleCount planes of size.
+	uint32_t frameCounter; //!<Number of frames applied. Seeds the random numbers.
+
+public:
+	/*!
+	Create engine.
+	\param[in] matchRadius Optional. Maximum grey level difference of a sample matching a pixel.
+	*/
+	VibeEngine(int matchRadius = 20);
+
+	Type getType() const;
+	void initialize(const cv::Mat & grey);
+	void apply(const cv::Mat & grey, cv::Mat & foreground, const cv::Range & rows);
+	void finishFrame();
+	uint64_t getMemoryUsage() const;
+};
@@ -0,0 +1,102 @@
+#include "videocapturesource.h"
+
+#include <iostream>
+
+#include "consolestyle.h"
+#include "timestamp.h"
+
+
+VideoCaptureSource::VideoCaptureSource()
+	: live(false)
+{
+}
+
+bool VideoCaptureSource::openFile(const std::string & fileName, uint32_t width, uint32_t height, double fps)
+{
+	if (videoCapture.open(fileName)) {
+		std::cout << ConsoleStyle(ConsoleStyle::GREEN) << "Opened video file \"" << fileName << "\" for motion detection." << ConsoleStyle() << std::endl;
+		live = false;
+		return setupCapture(width, height, fps);
+	}
+	else {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to open video file \"" << fileName << "\" for motion detection!" << ConsoleStyle() << std::endl;
+	}
+	return false;
+}
+
+bool VideoCaptureSource::openCamera(int cameraIndex, uint32_t width, uint32_t height, double fps)
+{
+	if (videoCapture.open(cameraIndex)) {
+		std::cout << ConsoleStyle(ConsoleStyle::GREEN) << "Opened camera #" << cameraIndex << " for motion detection." << ConsoleStyle() << std::endl;
+		live = true;
+		return setupCapture(width, height, fps);
+	}
+	else {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to open camera #" << cameraIndex << " for motion detection!" << ConsoleStyle() << std::endl;
+	}
+	return false;
+}
+
+bool VideoCaptureSource::setupCapture(uint32_t preferredWidth, uint32_t preferredHeight, double preferredFps)
+{
+	//try capturing at wanted resolution and fps
+	videoCapture.set(CV_CAP_PROP_FRAME_WIDTH, preferredWidth);
+	videoCapture.set(CV_CAP_PROP_FRAME_HEIGHT, preferredHeight);
+	videoCapture.set(CV_CAP_PROP_FPS, preferredFps);
+	//poll first frame for checking values
+	cv::Mat frame;
+	if (videoCapture.grab() && videoCapture.retrieve(frame)) {
+		//get frame values
+		width = frame.size().width;
+		height = frame.size().height;
+		format = (frame.channels() == 1 ? FORMAT_GREY : FORMAT_BGR);
+		const double newFps = videoCapture.get(CV_CAP_PROP_FPS);
+		if (newFps > 0.0) {
+			fps = newFps;
+		}
+		else {
+			std::cout << ConsoleStyle(ConsoleStyle::YELLOW) << "Failed to properly set fps!" << ConsoleStyle() << std::endl;
+			fps = preferredFps;
+		}
+		return true;
+	}
+	else {
+		std::cout << ConsoleStyle(ConsoleStyle::RED) << "Failed to grab first frame!" << ConsoleStyle() << std::endl;
+		videoCapture.release();
+	}
+	return false;
+}
+
+bool VideoCaptureSource::isOpened() const
+{
+	return videoCapture.isOpened();
+}
+
+bool VideoCaptureSource::isLive() const
+{
+	return live;
+}
+
+bool VideoCaptureSource::read(cv::Mat & image, int32_t & bufferIndex, uint64_t & timestamp)
+{
+	bufferIndex = -1;
+	//grab frame from camera/video. this blocks till the next frame is available
+	if (videoCapture.grab()) {
+		timestamp = getTimestampUs();
+		//frame's there, retrieve it into the image passed
+		return videoCapture.retrieve(image);
+	}
+	return false;
+}
+
+void VideoCaptureSource::close()
+{
+	if (videoCapture.isOpened()) {
+		videoCapture.release();
+	}
+}
+
+VideoCaptureSource::~VideoCaptureSource()
+{
+	close();
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <opencv2/highgui/highgui.hpp>
+
+#include "framesource.h"
+
+
+/*!
+Frame source using OpenCV video capture for video files and cameras the native V4L2 source can not handle.
+Frames are always delivered as BGR.
+*/
+class VideoCaptureSource : public FrameSource
+{
+	cv::VideoCapture videoCapture; //!<OpenCV video capture object.
+	bool live; //!<True if capturing from a camera.
+
+	bool setupCapture(uint32_t width, uint32_t height, double fps);
+
+public:
+	VideoCaptureSource();
+
+	/*!
+	Open video file.
+	\param[in] fileName Video file open.
+	\param[in] width Preferred width of video mode.
+	\param[in] height Preferred height of video mode.
+	\param[in] fps Preferred frames/s of capture.
+	*/
+	bool openFile(const std::string & fileName, uint32_t width, uint32_t height, double fps);
+
+	/*!
+	Open camera.
+	\param[in] cameraIndex Index of camera to open.
+	\param[in] width Preferred width of video mode.
+	\param[in] height Preferred height of video mode.
+	\param[in] fps Preferred frames/s of capture.
+	*/
+	bool openCamera(int cameraIndex, uint32_t width, uint32_t height, double fps);
+
+	bool isOpened() const;
+	bool isLive() const;
+	bool read(cv::Mat & image, int32_t & bufferIndex, uint64_t & timestamp);
+	void close();
+
+	~VideoCaptureSource();
+};
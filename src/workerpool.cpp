@@ -0,0 +1,116 @@
+#include "workerpool.h"
+
+#include <algorithm>
+#include <iostream>
+#include <unistd.h>
+
+#include "consolestyle.h"
+
+
+WorkerPool::WorkerPool(uint32_t threadCount)
+	: mutex(PTHREAD_MUTEX_INITIALIZER), jobAvailable(PTHREAD_COND_INITIALIZER), jobFinished(PTHREAD_COND_INITIALIZER), active(true)
+{
+	if (threadCount == 0) {
+		threadCount = getCpuCount();
+	}
+	jobs.reserve(threadCount);
+	//the calling thread works too, so start one thread less
+	for (uint32_t i = 1; i < threadCount; ++i) {
+		pthread_t thread = 0;
+		if (pthread_create(&thread, nullptr, workerLoop, this) != 0) {
+			std::cout << ConsoleStyle(ConsoleStyle::YELLOW) << "Failed to start worker thread. Using " << threads.size() + 1 << " threads." << ConsoleStyle() << std::endl;
+			break;
+		}
+		threads.push_back(thread);
+	}
+}
+
+uint32_t WorkerPool::getThreadCount() const
+{
+	return threads.size() + 1;
+}
+
+uint32_t WorkerPool::getCpuCount()
+{
+	const long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count < 1 ? 1 : count;
+}
+
+uint32_t WorkerPool::takeTask(Job * job)
+{
+	const uint32_t index = job->next++;
+	if (job->next >= job->count) {
+		jobs.erase(std::find(jobs.begin(), jobs.end(), job));
+	}
+	return index;
+}
+
+void WorkerPool::finishTask(Job * job)
+{
+	if (++job->finished >= job->count) {
+		pthread_cond_broadcast(&jobFinished);
+	}
+}
+
+void WorkerPool::run(uint32_t count, TaskFunction function, void * context)
+{
+	if (count == 0) {
+		return;
+	}
+	//don't bother the workers with single tasks
+	if (count == 1 || threads.empty()) {
+		for (uint32_t i = 0; i < count; ++i) {
+			function(context, i);
+		}
+		return;
+	}
+	Job job = {function, context, count, 0, 0};
+	pthread_mutex_lock(&mutex);
+	jobs.push_back(&job);
+	pthread_cond_broadcast(&jobAvailable);
+	//work on own job till all tasks have been handed out
+	while (job.next < job.count) {
+		const uint32_t index = takeTask(&job);
+		pthread_mutex_unlock(&mutex);
+		function(context, index);
+		pthread_mutex_lock(&mutex);
+		finishTask(&job);
+	}
+	//wait for the workers to complete the remaining tasks. job lives on the stack, so it must not be left behind
+	while (job.finished < job.count) {
+		pthread_cond_wait(&jobFinished, &mutex);
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+void * WorkerPool::workerLoop(void * obj)
+{
+	WorkerPool * pool = reinterpret_cast<WorkerPool *>(obj);
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->active) {
+		if (pool->jobs.empty()) {
+			pthread_cond_wait(&pool->jobAvailable, &pool->mutex);
+			continue;
+		}
+		Job * job = pool->jobs.front();
+		const uint32_t index = pool->takeTask(job);
+		pthread_mutex_unlock(&pool->mutex);
+		job->function(job->context, index);
+		pthread_mutex_lock(&pool->mutex);
+		pool->finishTask(job);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return nullptr;
+}
+
+WorkerPool::~WorkerPool()
+{
+	pthread_mutex_lock(&mutex);
+	active = false;
+	pthread_cond_broadcast(&jobAvailable);
+	pthread_mutex_unlock(&mutex);
+	for (auto tIt = threads.begin(); tIt != threads.end(); ++tIt) {
+		pthread_join(*tIt, nullptr);
+	}
+	threads.clear();
+}
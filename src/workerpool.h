@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <pthread.h>
+#include <stdint.h>
+
+
+/*!
+Persistent pool of worker threads for data-parallel loops, e.g. processing the bands of a frame.
+Threads are started once and sleep between jobs, so running a job does not create threads or allocate.
+The calling thread works on its own job too. Several threads may run jobs at the same time, they share the workers.
+*/
+class WorkerPool
+{
+public:
+	/*!
+	Task function called once for every index of a job.
+	\param[in] context Context pointer passed to \run.
+	\param[in] index Task index from 0 to count - 1.
+	*/
+	typedef void (*TaskFunction)(void * context, uint32_t index);
+
+private:
+	struct Job
+	{
+		TaskFunction function; //!<Function to call for every task.
+		void * context; //!<Context passed to function.
+		uint32_t count; //!<Number of tasks.
+		uint32_t next; //!<Index of next task to hand out.
+		uint32_t finished; //!<Number of tasks that have been completed.
+	};
+
+	std::vector<pthread_t> threads; //!<The worker threads.
+	std::vector<Job *> jobs; //!<Jobs with tasks that have not been handed out yet.
+	pthread_mutex_t mutex; //!<The mutex protecting the job list and job counters.
+	pthread_cond_t jobAvailable; //!<Signalled when a job was added or the pool is shutting down.
+	pthread_cond_t jobFinished; //!<Signalled when the last task of a job was completed.
+	bool active; //!<If false the workers exit.
+
+	static void * workerLoop(void * obj);
+
+	/*!
+	Hand out the next task of a job and remove the job from the list if it was the last one. Call with mutex held.
+	*/
+	uint32_t takeTask(Job * job);
+
+	/*!
+	Mark a task of a job as completed. Call with mutex held.
+	*/
+	void finishTask(Job * job);
+
+public:
+	/*!
+	Create pool and start worker threads.
+	\param[in] threadCount Optional. Number of threads working on a job including the calling thread. 0 uses one thread per CPU core.
+	*/
+	WorkerPool(uint32_t threadCount = 0);
+
+	/*!
+	Get the number of threads working on a job including the calling thread.
+	*/
+	uint32_t getThreadCount() const;
+
+	/*!
+	Get the number of CPU cores currently online.
+	*/
+	static uint32_t getCpuCount();
+
+	/*!
+	Call a function for all task indices from 0 to count - 1 in parallel and wait until all calls returned.
+	\param[in] count Number of tasks.
+	\param[in] function Function to call for every task.
+	\param[in] context Context pointer passed to function.
+	*/
+	void run(uint32_t count, TaskFunction function, void * context);
+
+	~WorkerPool();
+};